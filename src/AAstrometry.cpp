@@ -4,19 +4,248 @@
  * @date 2021-04
  */
 
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
 #include "AAstrometry.h"
+#include "GLog.h"
+
+typedef std::chrono::steady_clock steady_clock;
 
 AAstrometry::AAstrometry(Parameter* param)
-	: ADIProcess(param) {
-	nameFunc_ = "astrometry";
+	: ADIProcess(param)
+	, solver_(&param->astrometry) {
+	nameFunc_  = "astrometry";
+	nameStage_ = "astrometry";
+	loadIndex_ = 0;
+	nWarm_  = nWarmHit_  = 0;
+	nBlind_ = nBlindHit_ = 0;
 }
 
 AAstrometry::~AAstrometry() {
-
+	if (nWarm_ || nBlind_) {
+		_gLog.Write("astrometry summary: warm start %d / %d, blind solve %d / %d",
+				nWarmHit_, nWarm_, nBlindHit_, nBlind_);
+	}
 }
 
 bool AAstrometry::do_real_process() {
+	if (!loadIndex_) load_index();
+	if (loadIndex_ != 1) return false;
+	if (frame_->bodies.size() < param_->astrometry.matchMin) {
+		// 区分原因: 未启用信号提取时没有目标可用于定位
+		if (!param_->sigExtract.enable)
+			_gLog.Write(LOG_WARN, "[%s]: no objects for astrometry, signal extraction is disabled (ResolveSignal Enable)",
+					frame_->filename.c_str());
+		else
+			_gLog.Write(LOG_WARN, "[%s]: too few objects for astrometry, %lu extracted, %u required",
+					frame_->filename.c_str(), frame_->bodies.size(), param_->astrometry.matchMin);
+		return false;
+	}
+
+	WCSTan& wcs = frame_->wcs;
+	string key = camera_key();
+	WCSMap::iterator it = lastWcs_.find(key);
+	const char* mode = "warm start";
+	double ms;
+	bool rslt(false);
+
+	// 快速定位
+	if (param_->astrometry.warmStart && it != lastWcs_.end()) {
+		steady_clock::time_point t0 = steady_clock::now();
+		++nWarm_;
+		if ((rslt = solve_warm(it->second, wcs))) ++nWarmHit_;
+		ms = std::chrono::duration<double, std::milli>(steady_clock::now() - t0).count();
+		if (!rslt) {
+			_gLog.Write(LOG_WARN, "[%s]: warm start failed, %.1f ms. fall back to blind solve",
+					frame_->filename.c_str(), ms);
+		}
+	}
+	// 盲定位
+	if (!rslt) {
+		int nquad, nverify;
+		mode = "blind solve";
+		++nBlind_;
+		if ((rslt = solver_.Solve(frame_->bodies, frame_->wImg, frame_->hImg, wcs))) ++nBlindHit_;
+		ms = solver_.LastStat(nquad, nverify);
+		if (!rslt) {
+			_gLog.Write(LOG_WARN, "[%s]: blind solve failed. %d quads, %d hypotheses, %.1f ms",
+					frame_->filename.c_str(), nquad, nverify, ms);
+			if (it != lastWcs_.end()) lastWcs_.erase(it);
+			return false;
+		}
+	}
+	refine(wcs);
+	lastWcs_[key] = wcs;
+	wcs.PixelToSky(frame_->wImg * 0.5, frame_->hImg * 0.5, frame_->coordCenter.x, frame_->coordCenter.y);
+	fill_equator();
+	_gLog.Write("[%s]: %s, center = (%.5f, %.5f), scale = %.3f\"/pixel, SIP order %d, %d stars matched, rms = %.2f\", %.1f ms",
+			frame_->filename.c_str(), mode, frame_->coordCenter.x, frame_->coordCenter.y,
+			wcs.Scale(), wcs.sipOrder, wcs.nmatch, wcs.rms, ms);
+	if (nWarm_) {
+		_gLog.Write("astrometry warm start hit rate: %.1f%% (%d / %d)",
+				nWarmHit_ * 100.0 / nWarm_, nWarmHit_, nWarm_);
+	}
 
 	frame_->succAstro = true;
 	return true;
 }
+
+void AAstrometry::SetCatalog(RefCatPtr refcat) {
+	refcat_ = refcat;
+}
+
+void AAstrometry::load_index() {
+	const string& path = param_->astrometry.pathIndex;
+	if (path.empty()) {
+		loadIndex_ = 2;
+		_gLog.Write(LOG_WARN, "plate index is not specified, astrometry is disabled");
+	}
+	else if (solver_.LoadIndex(path.c_str())) loadIndex_ = 1;
+	else {
+		loadIndex_ = 3;
+		_gLog.Write(LOG_FAULT, "failed to load plate index [%s]", path.c_str());
+	}
+}
+
+string AAstrometry::camera_key() {
+	char dims[40];
+	sprintf(dims, ":%ux%u", frame_->wImg, frame_->hImg);
+	return frame_->pathdir + dims;
+}
+
+bool AAstrometry::solve_warm(const WCSTan& last, WCSTan& wcs) {
+	const CeleBodyVec& bodies = frame_->bodies;
+	const ParamAstrometry& param = param_->astrometry;
+	unsigned w = frame_->wImg, h = frame_->hImg;
+	int n = int(bodies.size()), i;
+	int ncheck = std::min(n, std::max(int(param.starSolve) * 4, 100));
+	int nmin = std::max(int(param.matchMin), last.nmatch / 2);
+
+	// 参与匹配的最亮目标
+	ids_.resize(n);
+	for (i = 0; i < n; ++i) ids_[i] = i;
+	std::partial_sort(ids_.begin(), ids_.begin() + ncheck, ids_.end(), [&bodies](int i1, int i2) {
+		return bodies[i1].flux > bodies[i2].flux;
+	});
+	ids_.resize(ncheck);
+	grid_.Reset(0.0, 0.0, w, h, param.warmRadius);
+	for (i = 0; i < ncheck; ++i) grid_.Add(bodies[ids_[i]].ptBary.x, bodies[ids_[i]].ptBary.y);
+
+	// 以宽松半径匹配修正指向偏差, 再以匹配半径精化
+	WCSTan trial = last;
+	if (solver_.MatchRefine(bodies, ids_, grid_, w, h, param.warmRadius, trial) < nmin
+			|| solver_.MatchRefine(bodies, ids_, grid_, w, h, param.matchRadius, trial) < nmin)
+		return false;
+	wcs = trial;
+	return true;
+}
+
+/*!
+ * @brief 由曝光起始时间计算历元
+ * @param dateobs 格式: CCYY-MM-DDThh:mm:ss
+ * @return
+ * 历元, 量纲: 年. 0: 格式错误
+ */
+static double epoch_of(const string& dateobs) {
+	int year, month, day, hour(0), minute(0);
+	double second(0.0);
+	if (sscanf(dateobs.c_str(), "%d-%d-%dT%d:%d:%lf", &year, &month, &day, &hour, &minute, &second) < 3)
+		return 0.0;
+	static const int doy[] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+	if (month < 1 || month > 12) return 0.0;
+	double days = doy[month - 1] + day - 1 + (hour + (minute + second / 60.0) / 60.0) / 24.0;
+	if (month > 2 && ((year % 4 == 0 && year % 100) || year % 400 == 0)) days += 1.0;
+	return year + days / 365.25;
+}
+
+void AAstrometry::refine(WCSTan& wcs) {
+	const ParamAstrometry& param = param_->astrometry;
+	if (refcat_ && refcat_->IsOpen()) refine_catalog(wcs);
+	else if (param.sipOrder >= 2) {// 以索引中的参考星拟合畸变
+		const CeleBodyVec& bodies = frame_->bodies;
+		unsigned w = frame_->wImg, h = frame_->hImg;
+		int n = int(bodies.size()), i;
+
+		ids_.resize(n);
+		grid_.Reset(0.0, 0.0, w, h, param.matchRadius);
+		for (i = 0; i < n; ++i) {
+			ids_[i] = i;
+			grid_.Add(bodies[i].ptBary.x, bodies[i].ptBary.y);
+		}
+		WCSTan trial = wcs;
+		if (solver_.MatchRefine(bodies, ids_, grid_, w, h, param.matchRadius, trial, param.sipOrder) >= int(param.matchMin))
+			wcs = trial;
+	}
+}
+
+void AAstrometry::refine_catalog(WCSTan& wcs) {
+	const CeleBodyVec& bodies = frame_->bodies;
+	const ParamAstrometry& param = param_->astrometry;
+	unsigned w = frame_->wImg, h = frame_->hImg;
+	double rac, dcc, radius = sqrt(double(w) * w + double(h) * h) * 0.5 * wcs.Scale() / 3600.0 * 1.05;
+	double t = epoch_of(frame_->dateobs);
+	double dt = t > 0.0 ? t - refcat_->Header()->epoch : 0.0;
+	double px, py, snr;
+	std::vector<double> x, y, vra, vdc, wt;
+	int i, n(int(bodies.size())), id;
+
+	wcs.PixelToSky(w * 0.5, h * 0.5, rac, dcc);
+	refStars_.Clear();
+	refcat_->ConeSearch(rac, dcc, radius, param_->catalog.magLimit, refStars_);
+	if (refStars_.Size() < param.matchMin) return;
+
+	grid_.Reset(0.0, 0.0, w, h, param.matchRadius);
+	for (i = 0; i < n; ++i) grid_.Add(bodies[i].ptBary.x, bodies[i].ptBary.y);
+	// 自行改正至观测历元, 再批量投影至图像平面
+	n = int(refStars_.Size());
+	bufRA_.resize(n);
+	bufDC_.resize(n);
+	bufX_.resize(n);
+	bufY_.resize(n);
+	for (i = 0; i < n; ++i) {
+		bufDC_[i] = refStars_.dec[i] + refStars_.pmdec[i] * dt / 3.6E6;
+		bufRA_[i] = refStars_.ra[i] + refStars_.pmra[i] * dt / 3.6E6 / cos(refStars_.dec[i] * D2R);
+	}
+	wcs.SkyToPixel(n, bufRA_.data(), bufDC_.data(), bufX_.data(), bufY_.data());
+	for (i = 0; i < n; ++i) {
+		px = bufX_[i];
+		py = bufY_[i];
+		if (!(px >= 0.0 && py >= 0.0 && px < w && py < h)) continue;	// 含NAN
+		if ((id = grid_.Nearest(px, py, param.matchRadius)) >= 0) {
+			// 权重: 位置误差与信噪比成反比
+			snr = std::max(3.0, std::min(100.0, bodies[id].snr));
+			x.push_back(bodies[id].ptBary.x);
+			y.push_back(bodies[id].ptBary.y);
+			vra.push_back(bufRA_[i]);
+			vdc.push_back(bufDC_[i]);
+			wt.push_back(bodies[id].snr > 0.0 ? snr * snr : 1.0);
+		}
+	}
+	WCSTan trial;
+	if (int(x.size()) >= std::max(int(param.matchMin), wcs.nmatch)
+			&& trial.Fit(int(x.size()), x.data(), y.data(), vra.data(), vdc.data(), wt.data(),
+					w * 0.5, h * 0.5, rac, dcc, param.sipOrder)
+			&& trial.nmatch >= int(param.matchMin))
+		wcs = trial;
+}
+
+void AAstrometry::fill_equator() {
+	CeleBodyVec& bodies = frame_->bodies;
+	int n = int(bodies.size()), i;
+
+	bufX_.resize(n);
+	bufY_.resize(n);
+	bufRA_.resize(n);
+	bufDC_.resize(n);
+	for (i = 0; i < n; ++i) {
+		bufX_[i] = bodies[i].ptBary.x;
+		bufY_[i] = bodies[i].ptBary.y;
+	}
+	frame_->wcs.PixelToSky(n, bufX_.data(), bufY_.data(), bufRA_.data(), bufDC_.data());
+	for (i = 0; i < n; ++i) {
+		bodies[i].ptEquator.x = bufRA_[i];
+		bodies[i].ptEquator.y = bufDC_[i];
+	}
+}
@@ -2,23 +2,100 @@
  * @class AAstrometry 与天文星表匹配, 建立图像的WCS映射关系
  * @version 0.1
  * @date 2021-04
+ * @note
+ * 定位流程:
+ * - 以同一相机前一帧的WCS预测参考星位置, 与目标交叉匹配并拟合(快速定位)
+ * - 快速定位失败时执行盲定位
+ * - 以全部目标重新匹配并拟合TAN-SIP模型. 指定本地参考星表时使用星表中更暗的星
+ * - 定位成功后批量计算全部目标的赤道坐标
  */
 
 #ifndef AMATCHCATALOG_H_
 #define AMATCHCATALOG_H_
 
+#include <map>
 #include "ADIProcess.h"
+#include "APlateSolver.h"
+#include "ARefCatalog.h"
 
 class AAstrometry : public ADIProcess {
 public:
 	AAstrometry(Parameter* param);
 	virtual ~AAstrometry();
 
+protected:
+	typedef std::map<string, WCSTan> WCSMap;
+	typedef boost::shared_ptr<ARefCatalog> RefCatPtr;
+
+protected:
+	/*!
+	 * 索引加载标志.
+	 * 0: 未加载
+	 * 1: 已加载
+	 * 2: 未指定索引文件
+	 * 3: 索引加载失败
+	 */
+	int loadIndex_;
+	APlateSolver solver_;	/// 盲定位
+	WCSMap lastWcs_;		/// 各相机最近一次定位结果
+	GridIndex grid_;		/// 快速定位使用的目标网格索引
+	std::vector<int> ids_;	/// 参与快速定位的目标编号
+	RefCatPtr refcat_;		/// 本地参考星表
+	RefStarBatch refStars_;	/// 视场内参考星
+	std::vector<double> bufX_, bufY_;	/// 批量坐标转换缓存区: 像素坐标
+	std::vector<double> bufRA_, bufDC_;	/// 批量坐标转换缓存区: 赤道坐标
+	/* 统计 */
+	int nWarm_;			/// 尝试快速定位的帧数
+	int nWarmHit_;		/// 快速定位成功的帧数
+	int nBlind_;		/// 执行盲定位的帧数
+	int nBlindHit_;		/// 盲定位成功的帧数
+
+public:
+	/*!
+	 * @brief 设置本地参考星表
+	 * @param refcat 星表
+	 */
+	void SetCatalog(RefCatPtr refcat);
+
 protected:
 	/*!
 	 * @brief 在多进程模式下执行真正的处理流程
 	 */
 	bool do_real_process();
+	/*!
+	 * @brief 加载盲定位索引
+	 */
+	void load_index();
+	/*!
+	 * @brief 由图像帧生成相机标识
+	 * @return
+	 * 相机标识
+	 * @note
+	 * 以目录和图像尺寸区分相机
+	 */
+	string camera_key();
+	/*!
+	 * @brief 以前一帧的WCS作为初值快速定位
+	 * @param last  前一帧WCS
+	 * @param wcs   定位结果
+	 * @return
+	 * 定位结果
+	 */
+	bool solve_warm(const WCSTan& last, WCSTan& wcs);
+	/*!
+	 * @brief 以全部目标重新匹配, 精化WCS并拟合SIP畸变
+	 * @param wcs  输入: WCS初值; 输出: 精化结果
+	 */
+	void refine(WCSTan& wcs);
+	/*!
+	 * @brief 与本地参考星表交叉匹配并精化WCS
+	 * @param wcs  输入: WCS初值; 输出: 精化结果
+	 */
+	void refine_catalog(WCSTan& wcs);
+	/*!
+	 * @brief 批量计算目标质心的赤道坐标
+	 */
+	void fill_equator();
 };
 
 #endif /* AMATCHCATALOG_H_ */
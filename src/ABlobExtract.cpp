@@ -0,0 +1,288 @@
+/*!
+ * @class ABlobExtract 逐行提取信号并聚合为目标: 8连通游程标记, 仅保留上一行的游程
+ * @version 0.1
+ * @date 2021-05
+ */
+
+#include <math.h>
+#include <algorithm>
+#include "ABlobExtract.h"
+
+void ABlobExtract::Blob::Reset() {
+	npix = 0;
+	flux = fx = fy = fxx = fyy = fxy = 0.0;
+	back = var = 0.0;
+	xmin = ymin = 0xFFFFFFFF;
+	xmax = ymax = 0;
+	xpeak = ypeak = 0;
+	peak = -1E30f;
+	head = tail = -1;
+}
+
+void ABlobExtract::Blob::Merge(const Blob& other) {
+	npix += other.npix;
+	flux += other.flux;
+	fx   += other.fx;
+	fy   += other.fy;
+	fxx  += other.fxx;
+	fyy  += other.fyy;
+	fxy  += other.fxy;
+	back += other.back;
+	var  += other.var;
+	if (other.xmin < xmin) xmin = other.xmin;
+	if (other.xmax > xmax) xmax = other.xmax;
+	if (other.ymin < ymin) ymin = other.ymin;
+	if (other.ymax > ymax) ymax = other.ymax;
+	if (other.peak > peak) {
+		peak  = other.peak;
+		xpeak = other.xpeak;
+		ypeak = other.ypeak;
+	}
+}
+
+ABlobExtract::ABlobExtract(const ParamExtractSignal* sig, const ParamMeasureBlob* blob) {
+	paramSig_  = sig;
+	paramBlob_ = blob;
+	bodies_  = NULL;
+	mask_    = NULL;
+	width_   = 0;
+	lastRow_ = -1;
+	nblob_   = 0;
+	freeSpan_ = -1;
+}
+
+ABlobExtract::~ABlobExtract() {
+}
+
+void ABlobExtract::Begin(unsigned w, CeleBodyVec* bodies, char* mask) {
+	bodies_  = bodies;
+	mask_    = mask;
+	width_   = w;
+	lastRow_ = -1;
+	nblob_   = 0;
+	prev_.clear();
+	curr_.clear();
+	blobs_.clear();
+	parent_.clear();
+	idle_.clear();
+	merged_.clear();
+	alive_.clear();
+	spans_.clear();
+	freeSpan_ = -1;
+}
+
+void ABlobExtract::AddRow(unsigned y, const float* data, const float* back, const float* noise, const char* mask) {
+	size_t i, j, k;
+	unsigned x, w(width_);
+	float snr = paramSig_->sigMin;
+
+	if (lastRow_ >= 0 && int(y) != lastRow_ + 1) {// 行不连续: 上一行的目标全部结束
+		for (i = 0; i < prev_.size(); ++i) {
+			int root = find(prev_[i].id);
+			if (!alive_[root]) {
+				alive_[root] = 1;
+				finish(root);
+			}
+		}
+		for (i = 0; i < prev_.size(); ++i) alive_[prev_[i].id] = 0;
+		prev_.clear();
+	}
+	lastRow_ = int(y);
+
+	// 游程
+	curr_.clear();
+	for (x = 0; x < w; ++x) {
+		if (!(noise[x] > 0.0f && data[x] - back[x] > snr * noise[x]) || (mask && (mask[x] & MASK_STREAK))) continue;
+		Run run;
+		run.x0 = x;
+		while (x + 1 < w && noise[x + 1] > 0.0f && data[x + 1] - back[x + 1] > snr * noise[x + 1]
+				&& !(mask && (mask[x + 1] & MASK_STREAK))) ++x;
+		run.x1 = x;
+		run.id = -1;
+		curr_.push_back(run);
+	}
+
+	// 与上一行的相邻游程连接, 并累加像素
+	for (i = 0, j = 0; i < curr_.size(); ++i) {
+		Run& run = curr_[i];
+		int id(-1);
+		while (j < prev_.size() && prev_[j].x1 + 1 < run.x0) ++j;
+		for (k = j; k < prev_.size() && prev_[k].x0 <= run.x1 + 1; ++k) {
+			int root = find(prev_[k].id);
+			id = id < 0 ? root : unite(id, root);
+		}
+		if (id < 0) id = create();
+		run.id = id;
+
+		Blob& blob = blobs_[id];
+		for (x = run.x0; x <= run.x1; ++x) {
+			double f = double(data[x]) - back[x];
+			++blob.npix;
+			blob.flux += f;
+			blob.fx   += f * x;
+			blob.fy   += f * y;
+			blob.fxx  += f * x * x;
+			blob.fyy  += f * y * y;
+			blob.fxy  += f * x * y;
+			blob.back += back[x];
+			blob.var  += double(noise[x]) * noise[x];
+			if (float(f) > blob.peak) {
+				blob.peak  = float(f);
+				blob.xpeak = x;
+				blob.ypeak = y;
+			}
+		}
+		if (run.x0 < blob.xmin) blob.xmin = run.x0;
+		if (run.x1 > blob.xmax) blob.xmax = run.x1;
+		if (y < blob.ymin) blob.ymin = y;
+		if (y > blob.ymax) blob.ymax = y;
+		if (mask_) add_span(blob, y, run.x0, run.x1);
+	}
+
+	// 上一行中未在当前行延续的目标结束
+	for (i = 0; i < curr_.size(); ++i) {
+		curr_[i].id = find(curr_[i].id);
+		alive_[curr_[i].id] = 1;
+	}
+	for (i = 0; i < prev_.size(); ++i) {
+		int root = find(prev_[i].id);
+		if (!alive_[root]) {
+			alive_[root] = 1;
+			finish(root);
+		}
+	}
+	for (i = 0; i < prev_.size(); ++i) alive_[find(prev_[i].id)] = 0;
+	for (i = 0; i < curr_.size(); ++i) alive_[curr_[i].id] = 0;
+	// 游程均已指向根节点, 被合并的编号可以回收
+	idle_.insert(idle_.end(), merged_.begin(), merged_.end());
+	merged_.clear();
+	prev_.swap(curr_);
+}
+
+unsigned ABlobExtract::End() {
+	for (size_t i = 0; i < prev_.size(); ++i) {
+		int root = prev_[i].id;
+		if (!alive_[root]) {
+			alive_[root] = 1;
+			finish(root);
+		}
+	}
+	prev_.clear();
+	lastRow_ = -1;
+	return nblob_;
+}
+
+int ABlobExtract::find(int id) {
+	int root(id);
+	while (parent_[root] != root) root = parent_[root];
+	while (parent_[id] != root) {// 路径压缩
+		int next = parent_[id];
+		parent_[id] = root;
+		id = next;
+	}
+	return root;
+}
+
+int ABlobExtract::create() {
+	int id;
+	if (idle_.empty()) {
+		id = int(blobs_.size());
+		blobs_.push_back(Blob());
+		parent_.push_back(id);
+		alive_.push_back(0);
+	}
+	else {
+		id = idle_.back();
+		idle_.pop_back();
+		parent_[id] = id;
+		alive_[id]  = 0;
+	}
+	blobs_[id].Reset();
+	return id;
+}
+
+int ABlobExtract::unite(int a, int b) {
+	if (a == b) return a;
+	if (b < a) std::swap(a, b);
+	Blob &blob = blobs_[a], &other = blobs_[b];
+	if (other.head >= 0) {// 连接游程链表
+		if (blob.tail >= 0) spans_[blob.tail].next = other.head;
+		else blob.head = other.head;
+		blob.tail = other.tail;
+		other.head = other.tail = -1;
+	}
+	blob.Merge(other);
+	parent_[b] = a;
+	merged_.push_back(b);
+	return a;
+}
+
+void ABlobExtract::add_span(Blob& blob, unsigned y, unsigned x0, unsigned x1) {
+	int k;
+	if (freeSpan_ >= 0) {
+		k = freeSpan_;
+		freeSpan_ = spans_[k].next;
+	}
+	else {
+		k = int(spans_.size());
+		spans_.push_back(Span());
+	}
+	Span& span = spans_[k];
+	span.y    = y;
+	span.x0   = x0;
+	span.x1   = x1;
+	span.next = -1;
+	if (blob.tail >= 0) spans_[blob.tail].next = k;
+	else blob.head = k;
+	blob.tail = k;
+}
+
+void ABlobExtract::finish(int id) {
+	Blob& blob = blobs_[id];
+	++nblob_;
+	idle_.push_back(id);
+	// 积分信噪比: 剔除由噪声涨落连接成的虚假目标
+	double snr = blob.var > 0.0 ? blob.flux / sqrt(blob.var) : 0.0;
+	bool keep = blob.npix >= paramBlob_->pixMin && !(paramBlob_->pixMax && blob.npix > paramBlob_->pixMax)
+			&& blob.flux > 0.0 && snr >= paramBlob_->snrMin && bodies_;
+	if (blob.head >= 0) {// 标记检测掩模并回收游程链表
+		for (int k = blob.head; keep && k >= 0; k = spans_[k].next) {
+			const Span& span = spans_[k];
+			char* row = mask_ + size_t(span.y) * width_;
+			for (unsigned x = span.x0; x <= span.x1; ++x) row[x] |= MASK_DETECT;
+		}
+		spans_[blob.tail].next = freeSpan_;
+		freeSpan_ = blob.head;
+		blob.head = blob.tail = -1;
+	}
+	if (!keep) return;
+
+	CelestialBody body;
+	double xc = blob.fx / blob.flux, yc = blob.fy / blob.flux;
+	double x2 = blob.fxx / blob.flux - xc * xc;
+	double y2 = blob.fyy / blob.flux - yc * yc;
+	double xy = blob.fxy / blob.flux - xc * yc;
+	if (x2 * y2 - xy * xy < 1.0 / 144.0) {// 单像素或单行目标: 计入像素自身尺寸
+		x2 += 1.0 / 12.0;
+		y2 += 1.0 / 12.0;
+	}
+	double t1 = 0.5 * (x2 + y2), t2 = sqrt(0.25 * (x2 - y2) * (x2 - y2) + xy * xy);
+
+	body.ptBary.x   = xc;
+	body.ptBary.y   = yc;
+	body.ptCenter.x = 0.5 * (blob.xmin + blob.xmax);
+	body.ptCenter.y = 0.5 * (blob.ymin + blob.ymax);
+	body.ptPeak.x   = blob.xpeak;
+	body.ptPeak.y   = blob.ypeak;
+	body.ptPeak.z   = blob.peak;
+	body.a          = sqrt(t1 + t2);
+	body.b          = t1 > t2 ? sqrt(t1 - t2) : 0.0;
+	body.ellipcity  = 1.0 - body.b / body.a;
+	body.tilt       = 0.5 * atan2(2.0 * xy, x2 - y2) * 180.0 / M_PI;
+	body.area       = blob.npix;
+	body.back       = blob.back / blob.npix;
+	body.noise      = sqrt(blob.var / blob.npix);
+	body.flux       = blob.flux;
+	body.snr        = snr;
+	bodies_->push_back(body);
+}
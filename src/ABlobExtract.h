@@ -0,0 +1,130 @@
+/*!
+ * @class ABlobExtract 逐行提取信号并聚合为目标: 8连通游程标记, 仅保留上一行的游程
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * - 像素判据: 扣除背景后高于sigMin倍噪声, 且未被拖线屏蔽. 噪声无效(<=0)的像素不参与
+ * - 目标判据: 像素数在[pixMin, pixMax]范围内, 且积分信噪比(流量/噪声平方和的平方根)不低于snrMin
+ * - 当前行游程与上一行相邻游程归入同一目标, 连接多个目标时合并
+ * - 目标在某一行不再延续时完成测量, 输出顺序只取决于行序. 因此分带处理与整帧处理的结果一致,
+ *   跨越带边界的目标无需额外合并
+ * - 内存占用与行宽和同时延续的目标数有关, 与图像高度无关
+ * - 输出检测掩模时, 各目标记录其游程, 目标保留时将其像素标记为MASK_DETECT
+ */
+
+#ifndef ABLOBEXTRACT_H_
+#define ABLOBEXTRACT_H_
+
+#include <vector>
+#include "ImageFrame.hpp"
+#include "Parameter.hpp"
+
+class ABlobExtract {
+public:
+	ABlobExtract(const ParamExtractSignal* sig, const ParamMeasureBlob* blob);
+	virtual ~ABlobExtract();
+
+protected:
+	/*!
+	 * @struct Run 行内连续的信号像素
+	 */
+	struct Run {
+		unsigned x0, x1;	/// 起止位置, 含x1
+		int id;				/// 所属目标
+	};
+	typedef std::vector<Run> RunVec;
+
+	/*!
+	 * @struct Span 目标的游程链表节点. 仅输出检测掩模时记录
+	 */
+	struct Span {
+		unsigned y;			/// 行号
+		unsigned x0, x1;	/// 起止位置, 含x1
+		int next;			/// 下一节点. -1: 无
+	};
+
+	/*!
+	 * @struct Blob 目标累加量
+	 */
+	struct Blob {
+		unsigned npix;		/// 像素数
+		double flux;		/// 流量之和
+		double fx, fy;		/// 流量加权的一阶矩
+		double fxx, fyy, fxy;	/// 流量加权的二阶矩
+		double back;		/// 背景之和
+		double var;			/// 噪声平方之和
+		unsigned xmin, xmax, ymin, ymax;	/// 外接矩形
+		unsigned xpeak, ypeak;	/// 峰值位置
+		float peak;			/// 峰值, 扣除背景
+		int head, tail;		/// 游程链表首尾. -1: 空
+
+	public:
+		void Reset();
+		void Merge(const Blob& other);
+	};
+
+protected:
+	const ParamExtractSignal* paramSig_;	/// 信号提取参数
+	const ParamMeasureBlob* paramBlob_;		/// 目标测量参数
+	CeleBodyVec* bodies_;	/// 输出目标集合
+	char* mask_;			/// 检测掩模. NULL: 不输出
+	unsigned width_;		/// 行宽
+	int lastRow_;			/// 最近处理的行
+	RunVec prev_, curr_;	/// 上一行和当前行的游程
+	std::vector<Blob> blobs_;	/// 目标累加量
+	std::vector<int> parent_;	/// 合并关系. 根节点指向自身
+	std::vector<int> idle_;		/// 可复用的目标编号
+	std::vector<int> merged_;	/// 当前行被合并的目标编号, 行结束后回收
+	std::vector<char> alive_;	/// 标记: 目标在当前行延续
+	std::vector<Span> spans_;	/// 游程链表节点
+	int freeSpan_;			/// 可复用的节点链表
+	unsigned nblob_;		/// 已完成测量的目标数, 含被像素数和信噪比条件剔除的目标
+
+public:
+	/*!
+	 * @brief 开始处理一帧
+	 * @param w       图像宽度
+	 * @param bodies  输出目标集合, 追加在已有数据之后
+	 * @param mask    检测掩模, 整帧, 行宽为w. 非空时保留的目标像素标记MASK_DETECT
+	 */
+	void Begin(unsigned w, CeleBodyVec* bodies, char* mask = NULL);
+	/*!
+	 * @brief 处理一行. 行号须连续递增
+	 * @param y      行号
+	 * @param data   图像数据
+	 * @param back   逐像素背景
+	 * @param noise  逐像素噪声
+	 * @param mask   像素掩模. 可为NULL
+	 */
+	void AddRow(unsigned y, const float* data, const float* back, const float* noise, const char* mask);
+	/*!
+	 * @brief 完成一帧: 输出仍在延续的目标
+	 * @return
+	 * 已完成测量的目标数, 含被像素数和信噪比条件剔除的目标
+	 */
+	unsigned End();
+
+protected:
+	/*!
+	 * @brief 查找根节点
+	 */
+	int find(int id);
+	/*!
+	 * @brief 分配目标编号
+	 */
+	int create();
+	/*!
+	 * @brief 合并两个目标, 返回合并后的根节点
+	 */
+	int unite(int a, int b);
+	/*!
+	 * @brief 将游程加入目标的链表
+	 */
+	void add_span(Blob& blob, unsigned y, unsigned x0, unsigned x1);
+	/*!
+	 * @brief 完成测量并回收编号. 目标保留时标记检测掩模
+	 */
+	void finish(int id);
+};
+
+#endif /* ABLOBEXTRACT_H_ */
@@ -0,0 +1,591 @@
+/*!
+ * @class ACatalogWriter 目标星表输出: 在独立的I/O线程中将各帧处理结果写入FITS二进制表和/或列存储文件
+ * @version 0.1
+ * @date 2021-05
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <boost/bind/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "ACatalogWriter.h"
+#include "GLog.h"
+
+using namespace boost::filesystem;
+using namespace boost::posix_time;
+
+/*!
+ * @struct CatFrameRow FRAMES表的行
+ */
+struct CatFrameRow {
+	int frame;			/// 帧序号
+	char name[64];		/// 文件名(不含扩展名)
+	char dateobs[32];	/// 曝光起始时间
+	double expdur;		/// 曝光时间
+	double ra, dec;		/// 视场中心
+	double fwhm;		/// 半高全宽
+	double bkMean, bkSigma;	/// 背景
+	int astrometry;		/// 天文定位成功
+	int nobj, nstreak, ndiff;	/// 各表行数
+};
+
+/*!
+ * @struct CatColumn 列定义: 名称、单位、存储类型、宽度及在行结构中的偏移
+ * @note
+ * 行结构中的源数据类型: CAT_F64和CAT_F32为double, CAT_I32为int, CAT_STR为定长字符数组
+ */
+struct CatColumn {
+	const char* name;
+	const char* unit;
+	int type;
+	int width;
+	size_t offset;
+};
+
+/*!
+ * @struct CatTable 表定义
+ */
+struct CatTable {
+	const char* name;
+	const CatColumn* cols;
+	int ncol;
+	size_t stride;	/// 行结构长度
+};
+
+#define CAT_COL_F64(name, unit, T, m)	{ name, unit, CAT_F64, 8, offsetof(T, m) }
+#define CAT_COL_F32(name, unit, T, m)	{ name, unit, CAT_F32, 4, offsetof(T, m) }
+#define CAT_COL_I32(name, unit, T, m)	{ name, unit, CAT_I32, 4, offsetof(T, m) }
+#define CAT_COL_STR(name, T, m)			{ name, "",   CAT_STR, int(sizeof(((T*) 0)->m)), offsetof(T, m) }
+#define CAT_NCOL(cols)					int(sizeof(cols) / sizeof(CatColumn))
+
+static const CatColumn cols_frames[] = {
+	CAT_COL_I32("FRAME",      "",      CatFrameRow, frame),
+	CAT_COL_STR("NAME",                CatFrameRow, name),
+	CAT_COL_STR("DATEOBS",             CatFrameRow, dateobs),
+	CAT_COL_F32("EXPTIME",    "s",     CatFrameRow, expdur),
+	CAT_COL_F64("RA",         "deg",   CatFrameRow, ra),
+	CAT_COL_F64("DEC",        "deg",   CatFrameRow, dec),
+	CAT_COL_F32("FWHM",       "pixel", CatFrameRow, fwhm),
+	CAT_COL_F32("BKMEAN",     "ADU",   CatFrameRow, bkMean),
+	CAT_COL_F32("BKSIGMA",    "ADU",   CatFrameRow, bkSigma),
+	CAT_COL_I32("ASTROMETRY", "",      CatFrameRow, astrometry),
+	CAT_COL_I32("NOBJ",       "",      CatFrameRow, nobj),
+	CAT_COL_I32("NSTREAK",    "",      CatFrameRow, nstreak),
+	CAT_COL_I32("NDIFF",      "",      CatFrameRow, ndiff)
+};
+
+static const CatColumn cols_objects[] = {
+	CAT_COL_F64("X",     "pixel", CelestialBody, ptBary.x),
+	CAT_COL_F64("Y",     "pixel", CelestialBody, ptBary.y),
+	CAT_COL_F64("RA",    "deg",   CelestialBody, ptEquator.x),
+	CAT_COL_F64("DEC",   "deg",   CelestialBody, ptEquator.y),
+	CAT_COL_F32("PEAK",  "ADU",   CelestialBody, ptPeak.z),
+	CAT_COL_F32("FLUX",  "ADU",   CelestialBody, flux),
+	CAT_COL_F32("SNR",   "",      CelestialBody, snr),
+	CAT_COL_F32("BACK",  "ADU",   CelestialBody, back),
+	CAT_COL_F32("NOISE", "ADU",   CelestialBody, noise),
+	CAT_COL_F32("A",     "pixel", CelestialBody, a),
+	CAT_COL_F32("B",     "pixel", CelestialBody, b),
+	CAT_COL_F32("TILT",  "deg",   CelestialBody, tilt),
+	CAT_COL_F32("ELLIP", "",      CelestialBody, ellipcity),
+	CAT_COL_F32("AREA",  "pixel", CelestialBody, area),
+	CAT_COL_I32("TYPE",  "",      CelestialBody, type)
+};
+
+static const CatColumn cols_streaks[] = {
+	CAT_COL_F64("X1",     "pixel", StreakSegment, pt1.x),
+	CAT_COL_F64("Y1",     "pixel", StreakSegment, pt1.y),
+	CAT_COL_F64("X2",     "pixel", StreakSegment, pt2.x),
+	CAT_COL_F64("Y2",     "pixel", StreakSegment, pt2.y),
+	CAT_COL_F32("LENGTH", "pixel", StreakSegment, length),
+	CAT_COL_F32("WIDTH",  "pixel", StreakSegment, width),
+	CAT_COL_F32("TILT",   "deg",   StreakSegment, tilt),
+	CAT_COL_F32("FLUX",   "ADU",   StreakSegment, flux),
+	CAT_COL_F32("SNR",    "",      StreakSegment, snr),
+	CAT_COL_I32("NPIX",   "",      StreakSegment, npix)
+};
+
+static const CatColumn cols_diff[] = {
+	CAT_COL_F64("X",       "pixel", DiffSource, ptCenter.x),
+	CAT_COL_F64("Y",       "pixel", DiffSource, ptCenter.y),
+	CAT_COL_F64("RA",      "deg",   DiffSource, ptEquator.x),
+	CAT_COL_F64("DEC",     "deg",   DiffSource, ptEquator.y),
+	CAT_COL_F32("FLUX",    "ADU",   DiffSource, flux),
+	CAT_COL_F32("FLUXREF", "ADU",   DiffSource, fluxRef),
+	CAT_COL_F32("SNR",     "",      DiffSource, snr),
+	CAT_COL_I32("TYPE",    "",      DiffSource, type)
+};
+
+static const CatTable cat_tables[CAT_TABLES] = {
+	{ "FRAMES",  cols_frames,  CAT_NCOL(cols_frames),  sizeof(CatFrameRow) },
+	{ "OBJECTS", cols_objects, CAT_NCOL(cols_objects), sizeof(CelestialBody) },
+	{ "STREAKS", cols_streaks, CAT_NCOL(cols_streaks), sizeof(StreakSegment) },
+	{ "DIFF",    cols_diff,    CAT_NCOL(cols_diff),    sizeof(DiffSource) }
+};
+
+/*!
+ * @brief 按列提取行数据, 转换为存储类型
+ */
+static void gather_column(const CatColumn& col, const char* rows, size_t stride, size_t n, std::vector<char>& out) {
+	out.resize(n * col.width);
+	char* dst = out.data();
+	const char* src = rows + col.offset;
+	for (size_t i = 0; i < n; ++i, src += stride, dst += col.width) {
+		if      (col.type == CAT_F64) *(double*)  dst = *(const double*) src;
+		else if (col.type == CAT_F32) *(float*)   dst = float(*(const double*) src);
+		else if (col.type == CAT_I32) *(int32_t*) dst = int32_t(*(const int*) src);
+		else memcpy(dst, src, col.width);
+	}
+}
+
+/*!
+ * @brief 各表的行数据
+ */
+static void table_rows(int table, const CatFrameRow& frame, const CeleBodyVec& bodies, const StreakVec& streaks,
+		const DiffSrcVec& diffs, const char*& rows, size_t& n) {
+	if      (table == CAT_FRAMES)  { rows = (const char*) &frame;          n = 1; }
+	else if (table == CAT_OBJECTS) { rows = (const char*) bodies.data();  n = bodies.size(); }
+	else if (table == CAT_STREAKS) { rows = (const char*) streaks.data(); n = streaks.size(); }
+	else                           { rows = (const char*) diffs.data();   n = diffs.size(); }
+}
+
+/*!
+ * @brief 列存储文件头长度
+ */
+static long col_header_bytes() {
+	long bytes = 8 + 4 + 4;
+	for (int i = 0; i < CAT_TABLES; ++i) bytes += 16 + 4 + cat_tables[i].ncol * long(sizeof(CatColumnHeader));
+	return bytes;
+}
+
+static uint64_t pad8(uint64_t bytes) {
+	return (bytes + 7) & ~uint64_t(7);
+}
+
+ACatalogWriter::ACatalogWriter(Parameter* param) {
+	param_ = param;
+	nFrames_ = nFail_ = nSync_ = nStore_ = 0;
+}
+
+ACatalogWriter::~ACatalogWriter() {
+	Stop();
+}
+
+bool ACatalogWriter::Start() {
+	if (thrd_) return true;
+	jobs_.Reset(param_->output.catQueue);
+	nFrames_ = nFail_ = nSync_ = nStore_ = 0;
+	thrd_.reset(new boost::thread(boost::bind(&ACatalogWriter::thread_write, this)));
+	return true;
+}
+
+void ACatalogWriter::Stop() {
+	if (!thrd_) return;
+	jobs_.Stop();
+	thrd_->join();
+	thrd_.reset();
+	_gLog.Write("catalog summary: %d frames written, %d failed, queue depth max = %d, %d fsync, producer stalled %.1f ms",
+			nFrames_, nFail_, jobs_.DepthMax(), nSync_, jobs_.StallMs());
+	if (param_->output.detStore) _gLog.Write("detection store: %d frames appended", nStore_);
+}
+
+void ACatalogWriter::Push(ImgFrmPtr frame) {
+	JobPtr job(new CatalogJob);
+	job->filetit = frame->filetit;
+	job->pathdir = frame->pathdir;
+	job->dateobs = frame->dateobs;
+	job->expdur  = frame->expdur;
+	job->bkMean  = frame->bkMean;
+	job->bkSigma = frame->bkSigma;
+	job->fwhm    = frame->fwhm;
+	job->coordCenter = frame->coordCenter;
+	job->succAstro   = frame->succAstro;
+	job->bodies  = frame->bodies;
+	job->streaks = frame->streaks;
+	job->diffs   = frame->diffs;
+	jobs_.Push(job);
+}
+
+void ACatalogWriter::thread_write() {
+	bool night = param_->output.catNight;
+	JobDeque batch;
+	while (jobs_.PopAll(batch)) {
+		for (JobDeque::iterator it = batch.begin(); it != batch.end(); ++it) {
+			if (write_job(it->get())) ++nFrames_;
+			else ++nFail_;
+		}
+		// 整夜文件: 每批次刷新一次, 按帧数策略fsync
+		if (night) {
+			sync_file(fileFits_, false);
+			sync_file(fileCol_, false);
+		}
+		batch.clear();
+	}
+	close_file(fileFits_);
+	close_file(fileCol_);
+	store_.CloseAppend();
+}
+
+bool ACatalogWriter::write_job(CatalogJob* job) {
+	const ParamOutput& output = param_->output;
+	bool rslt(true);
+
+	if (output.catNight || output.detStore) {
+		std::string night = night_of(job->dateobs);
+		if (night != night_) {// 新的观测夜: 关闭前一夜的文件
+			close_file(fileFits_);
+			close_file(fileCol_);
+			store_.CloseAppend();
+			night_ = night;
+		}
+	}
+	if (output.detStore && job->succAstro && !store_append(job)) rslt = false;
+
+	path dir = output_dir(job, output.catNight);
+	boost::system::error_code ec;
+	if (!exists(dir, ec)) create_directories(dir, ec);
+	if (output.catNight) {
+		std::string base = (dir / ("night_" + night_)).string();
+		if (output.catFits) {
+			if (!fileFits_.fits && !fits_open(fileFits_, base + ".cat.fits", true)) rslt = false;
+			else if (!fits_append(fileFits_, job)) rslt = false;
+		}
+		if (output.catColumnar) {
+			if (!fileCol_.fp && !col_open(fileCol_, base + ".acol", true)) rslt = false;
+			else if (!col_append(fileCol_, job)) rslt = false;
+		}
+	}
+	else {
+		std::string base = (dir / job->filetit).string();
+		if (output.catFits) {
+			CatalogFile file;
+			if (!fits_open(file, base + ".cat.fits", false) || !fits_append(file, job)) rslt = false;
+			close_file(file);
+		}
+		if (output.catColumnar) {
+			CatalogFile file;
+			if (!col_open(file, base + ".acol", false) || !col_append(file, job)) rslt = false;
+			close_file(file);
+		}
+	}
+	if (!rslt) _gLog.Write(LOG_FAULT, "[%s]: failed to write catalog", job->filetit.c_str());
+	return rslt;
+}
+
+std::string ACatalogWriter::output_dir(CatalogJob* job, bool night) {
+	const std::string& dir = param_->output.catDir;
+	if (!dir.empty()) return dir;
+	if (!param_->preProc.pathWork.empty()) return param_->preProc.pathWork;
+	if (!night && !job->pathdir.empty()) return job->pathdir;
+	return ".";
+}
+
+bool ACatalogWriter::store_append(CatalogJob* job) {
+	double mjd = mjd_of(job->dateobs, job->expdur);
+	if (mjd <= 0.0) {
+		_gLog.Write(LOG_WARN, "[%s]: invalid DATE-OBS, not added to detection store", job->filetit.c_str());
+		return false;
+	}
+	if (!store_.Appending()) {
+		path dir = output_dir(job, true);
+		boost::system::error_code ec;
+		if (!exists(dir, ec)) create_directories(dir, ec);
+		path filepath = dir / ("night_" + night_ + ".det");
+		if (!store_.OpenAppend(filepath.c_str(), int(param_->output.detOrder))) {
+			_gLog.Write(LOG_FAULT, "failed to open detection store [%s]", filepath.c_str());
+			return false;
+		}
+	}
+
+	rows_.resize(job->bodies.size());
+	for (size_t i = 0; i < rows_.size(); ++i) {
+		const CelestialBody& body = job->bodies[i];
+		DetRecord& row = rows_[i];
+		row.ra   = body.ptEquator.x;
+		row.dec  = body.ptEquator.y;
+		row.x    = float(body.ptBary.x);
+		row.y    = float(body.ptBary.y);
+		row.flux = float(body.flux);
+		row.snr  = float(body.snr);
+		row.type = body.type;
+	}
+	if (!store_.Append(job->filetit.c_str(), mjd, rows_)) return false;
+	++nStore_;
+	return true;
+}
+
+double ACatalogWriter::mjd_of(const std::string& dateobs, double expdur) {
+	try {
+		ptime tm = from_iso_extended_string(dateobs);
+		return tm.date().modjulian_day() + (tm.time_of_day().total_microseconds() * 1E-6 + expdur * 0.5) / 86400.0;
+	}
+	catch(...) {
+		return 0.0;
+	}
+}
+
+std::string ACatalogWriter::night_of(const std::string& dateobs) {
+	try {
+		ptime tm = from_iso_extended_string(dateobs) - hours(12);
+		return to_iso_string(tm.date());
+	}
+	catch(...) {
+		return "unknown";
+	}
+}
+
+void ACatalogWriter::frame_row(const CatalogFile& file, const CatalogJob* job, CatFrameRow& frame) {
+	memset(&frame, 0, sizeof(frame));
+	frame.frame = int(file.frames + 1);
+	snprintf(frame.name,    sizeof(frame.name),    "%s", job->filetit.c_str());
+	snprintf(frame.dateobs, sizeof(frame.dateobs), "%s", job->dateobs.c_str());
+	frame.expdur  = job->expdur;
+	frame.ra      = job->coordCenter.x;
+	frame.dec     = job->coordCenter.y;
+	frame.fwhm    = job->fwhm;
+	frame.bkMean  = job->bkMean;
+	frame.bkSigma = job->bkSigma;
+	frame.astrometry = job->succAstro ? 1 : 0;
+	frame.nobj    = int(job->bodies.size());
+	frame.nstreak = int(job->streaks.size());
+	frame.ndiff   = int(job->diffs.size());
+}
+
+bool ACatalogWriter::fits_open(CatalogFile& file, const std::string& filepath, bool append) {
+	fitsfile* fits(NULL);
+	int state(0), i, j;
+
+	file.path   = filepath;
+	file.frames = 0;
+	if (append && exists(filepath)) {// 继续追加: 帧序号从已有帧数延续
+		long nrows(0);
+		fits_open_file(&fits, filepath.c_str(), READWRITE, &state);
+		fits_movnam_hdu(fits, BINARY_TBL, (char*) cat_tables[CAT_FRAMES].name, 0, &state);
+		fits_get_num_rows(fits, &nrows, &state);
+		file.frames = uint32_t(nrows);
+	}
+	else {
+		std::string pathNew = "!" + filepath;
+		fits_create_file(&fits, pathNew.c_str(), &state);
+		fits_create_img(fits, BYTE_IMG, 0, NULL, &state);
+		for (i = 0; i < CAT_TABLES && !state; ++i) {// 除FRAMES外各表首列为帧序号
+			const CatTable& table = cat_tables[i];
+			int extra = i == CAT_FRAMES ? 0 : 1, ncol = table.ncol + extra;
+			std::vector<std::string> forms(ncol);
+			std::vector<char*> ttype(ncol), tform(ncol), tunit(ncol);
+			if (extra) {
+				forms[0] = "1J";
+				ttype[0] = (char*) "FRAME";
+				tunit[0] = (char*) "";
+			}
+			for (j = 0; j < table.ncol; ++j) {
+				const CatColumn& col = table.cols[j];
+				forms[j + extra] = col.type == CAT_F64 ? "1D"
+						: (col.type == CAT_F32 ? "1E"
+							: (col.type == CAT_I32 ? "1J" : std::to_string(col.width) + "A"));
+				ttype[j + extra] = (char*) col.name;
+				tunit[j + extra] = (char*) col.unit;
+			}
+			for (j = 0; j < ncol; ++j) tform[j] = (char*) forms[j].c_str();
+			fits_create_tbl(fits, BINARY_TBL, 0, ncol, ttype.data(), tform.data(), tunit.data(), table.name, &state);
+		}
+	}
+	if (state) {
+		if (fits) {
+			int state1(0);
+			fits_close_file(fits, &state1);
+		}
+		_gLog.Write(LOG_FAULT, "failed to open catalog [%s], FITS status = %d", filepath.c_str(), state);
+		return false;
+	}
+	file.fits = fits;
+	return true;
+}
+
+bool ACatalogWriter::fits_append(CatalogFile& file, CatalogJob* job) {
+	CatFrameRow frame;
+	frame_row(file, job, frame);
+
+	std::vector<char> buff;
+	std::vector<int> frameIds;
+	std::vector<char*> strs;
+	int state(0);
+	for (int i = 0; i < CAT_TABLES && !state; ++i) {
+		const CatTable& table = cat_tables[i];
+		const char* rows;
+		size_t n;
+		long nrows(0);
+		table_rows(i, frame, job->bodies, job->streaks, job->diffs, rows, n);
+		if (!n) continue;
+
+		fits_movnam_hdu(file.fits, BINARY_TBL, (char*) table.name, 0, &state);
+		fits_get_num_rows(file.fits, &nrows, &state);
+		int colnum(1);
+		if (i != CAT_FRAMES) {
+			frameIds.assign(n, frame.frame);
+			fits_write_col(file.fits, TINT, colnum++, nrows + 1, 1, n, frameIds.data(), &state);
+		}
+		for (int j = 0; j < table.ncol; ++j, ++colnum) {
+			const CatColumn& col = table.cols[j];
+			gather_column(col, rows, table.stride, n, buff);
+			if (col.type == CAT_STR) {// 行结构中的字符串以0结尾
+				strs.resize(n);
+				for (size_t k = 0; k < n; ++k) strs[k] = buff.data() + k * col.width;
+				fits_write_col(file.fits, TSTRING, colnum, nrows + 1, 1, n, strs.data(), &state);
+			}
+			else {
+				int datatype = col.type == CAT_F64 ? TDOUBLE : (col.type == CAT_F32 ? TFLOAT : TINT);
+				fits_write_col(file.fits, datatype, colnum, nrows + 1, 1, n, buff.data(), &state);
+			}
+		}
+	}
+	if (state) {
+		_gLog.Write(LOG_FAULT, "failed to append to catalog [%s], FITS status = %d", file.path.c_str(), state);
+		return false;
+	}
+	++file.frames;
+	++file.unsynced;
+	return true;
+}
+
+bool ACatalogWriter::col_open(CatalogFile& file, const std::string& filepath, bool append) {
+	FILE* fp(NULL);
+	file.path   = filepath;
+	file.frames = 0;
+	if (append && exists(filepath)) {// 继续追加: 校验文件头, 统计已有帧数, 截去不完整的帧
+		char magic[8];
+		uint32_t version(0);
+		if (!(fp = fopen(filepath.c_str(), "r+b"))
+				|| fread(magic, 8, 1, fp) != 1 || memcmp(magic, CATALOG_MAGIC, 8)
+				|| fread(&version, 4, 1, fp) != 1 || version != CATALOG_VERSION) {
+			if (fp) fclose(fp);
+			_gLog.Write(LOG_FAULT, "[%s] is not a compatible columnar catalog", filepath.c_str());
+			return false;
+		}
+		off_t pos = col_header_bytes(), good = pos, end;
+		CatBlockHeader hdr;
+		fseeko(fp, 0, SEEK_END);
+		end = ftello(fp);
+		fseeko(fp, pos, SEEK_SET);
+		while (fread(&hdr, sizeof(hdr), 1, fp) == 1 && !memcmp(hdr.magic, CATALOG_BLOCK, 4)
+				&& pos + off_t(sizeof(hdr) + hdr.bytes) <= end) {
+			pos += sizeof(hdr) + hdr.bytes;
+			if (hdr.table == CAT_FRAMES) {// 帧的最后一个数据块
+				file.frames = std::max(file.frames, hdr.frame);
+				good = pos;
+			}
+			fseeko(fp, pos, SEEK_SET);
+		}
+		if (good < end) {
+			_gLog.Write(LOG_WARN, "[%s]: truncating incomplete frame at %lld", filepath.c_str(), (long long) good);
+			fflush(fp);
+			if (ftruncate(fileno(fp), good)) {}
+		}
+		fseeko(fp, good, SEEK_SET);
+	}
+	else if ((fp = fopen(filepath.c_str(), "w+b"))) {
+		uint32_t version(CATALOG_VERSION), ntable(CAT_TABLES);
+		fwrite(CATALOG_MAGIC, 8, 1, fp);
+		fwrite(&version, 4, 1, fp);
+		fwrite(&ntable,  4, 1, fp);
+		for (int i = 0; i < CAT_TABLES; ++i) {
+			const CatTable& table = cat_tables[i];
+			char name[16] = { 0 };
+			uint32_t ncol(table.ncol);
+			strncpy(name, table.name, sizeof(name) - 1);
+			fwrite(name,  16, 1, fp);
+			fwrite(&ncol, 4,  1, fp);
+			for (int j = 0; j < table.ncol; ++j) {
+				CatColumnHeader col;
+				memset(&col, 0, sizeof(col));
+				strncpy(col.name, table.cols[j].name, sizeof(col.name) - 1);
+				strncpy(col.unit, table.cols[j].unit, sizeof(col.unit) - 1);
+				col.type  = uint16_t(table.cols[j].type);
+				col.width = uint16_t(table.cols[j].width);
+				fwrite(&col, sizeof(col), 1, fp);
+			}
+		}
+		if (ferror(fp)) {
+			fclose(fp);
+			fp = NULL;
+		}
+	}
+	if (!fp) {
+		_gLog.Write(LOG_FAULT, "failed to open catalog [%s]", filepath.c_str());
+		return false;
+	}
+	file.fp = fp;
+	return true;
+}
+
+bool ACatalogWriter::col_append(CatalogFile& file, CatalogJob* job) {
+	CatFrameRow frame;
+	frame_row(file, job, frame);
+
+	static const char zeros[8] = { 0 };
+	std::vector<char> buff;
+	// FRAMES块最后写入: 追加时以FRAMES块判断帧是否完整
+	for (int k = 0; k < CAT_TABLES; ++k) {
+		int i = (k + 1) % CAT_TABLES;
+		const CatTable& table = cat_tables[i];
+		const char* rows;
+		size_t n;
+		table_rows(i, frame, job->bodies, job->streaks, job->diffs, rows, n);
+		if (!n) continue;
+
+		CatBlockHeader hdr;
+		memcpy(hdr.magic, CATALOG_BLOCK, 4);
+		hdr.table = uint16_t(i);
+		hdr.ncol  = uint16_t(table.ncol);
+		hdr.nrow  = uint32_t(n);
+		hdr.frame = uint32_t(frame.frame);
+		hdr.bytes = 0;
+		for (int j = 0; j < table.ncol; ++j) hdr.bytes += pad8(uint64_t(n) * table.cols[j].width);
+		fwrite(&hdr, sizeof(hdr), 1, file.fp);
+		for (int j = 0; j < table.ncol; ++j) {
+			gather_column(table.cols[j], rows, table.stride, n, buff);
+			fwrite(buff.data(), buff.size(), 1, file.fp);
+			fwrite(zeros, pad8(buff.size()) - buff.size(), 1, file.fp);
+		}
+	}
+	if (ferror(file.fp)) {
+		_gLog.Write(LOG_FAULT, "failed to append to catalog [%s]", file.path.c_str());
+		return false;
+	}
+	++file.frames;
+	++file.unsynced;
+	return true;
+}
+
+void ACatalogWriter::sync_file(CatalogFile& file, bool force) {
+	if (!file.fits && !file.fp) return;
+	if (file.fits) {
+		int state(0);
+		fits_flush_file(file.fits, &state);
+	}
+	if (file.fp) fflush(file.fp);
+
+	// fsync作用于文件而非描述符: FITS文件另行打开以获取描述符
+	unsigned frames = param_->output.catSyncFrames;
+	if (!frames || !file.unsynced || (!force && file.unsynced < int(frames))) return;
+	int fd = file.fp ? fileno(file.fp) : open(file.path.c_str(), O_RDONLY);
+	if (fd >= 0) {
+		fsync(fd);
+		++nSync_;
+		if (!file.fp) close(fd);
+	}
+	file.unsynced = 0;
+}
+
+void ACatalogWriter::close_file(CatalogFile& file) {
+	sync_file(file, true);
+	if (file.fits) {
+		int state(0);
+		fits_close_file(file.fits, &state);
+	}
+	if (file.fp) fclose(file.fp);
+	file = CatalogFile();
+}
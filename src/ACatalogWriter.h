@@ -0,0 +1,213 @@
+/*!
+ * @class ACatalogWriter 目标星表输出: 在独立的I/O线程中将各帧处理结果写入FITS二进制表和/或列存储文件
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * - 表: FRAMES(帧信息)、OBJECTS(目标)、STREAKS(拖线)、DIFF(残差源). 以帧序号FRAME关联:
+ *   FITS文件中除FRAMES外各表首列为FRAME; 列存储文件中FRAME记录在数据块头
+ * - 文件组织:
+ *   逐帧: 每帧一个文件, <目录>/<文件名>.cat.fits 或 .acol
+ *   整夜: 同一观测夜的结果追加到一个文件, <目录>/night_CCYYMMDD.cat.fits 或 .acol. 观测夜以UTC正午为界.
+ *   重新启动后继续追加, 帧序号延续
+ * - 目录: 配置的星表目录; 未配置时为工作目录; 均未配置时逐帧文件与图像同目录, 整夜文件在当前目录
+ * - 列存储格式(.acol):
+ *   文件头: 标识、版本、表结构(表名及各列名称、类型、宽度、单位);
+ *   数据块: 块头(标识、表编号、列数、行数、帧序号、数据长度), 其后各列数据依次连续存放, 每列按8字节对齐.
+ *   追加写入, 无需改写已有内容
+ * - 检测库: 天文定位成功的帧, 其目标追加到<目录>/night_CCYYMMDD.det, 见ADetectStore
+ * - 处理线程仅复制结果并入队, 不等待I/O. I/O线程每次取出全部待写帧批量写入, 按策略调用fsync
+ * - 待写队列有上限. 队列满时Push阻塞, 使结果副本不超出帧内存预算之外的固定数量
+ */
+
+#ifndef ACATALOGWRITER_H_
+#define ACATALOGWRITER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <longnam.h>
+#include <fitsio.h>
+#include <boost/thread/thread.hpp>
+#include "Parameter.hpp"
+#include "ImageFrame.hpp"
+#include "ADetectStore.h"
+#include "BoundedQueue.hpp"
+
+#define CATALOG_MAGIC	"ADIPSCOL"	/// 列存储文件标识
+#define CATALOG_VERSION	1			/// 列存储文件版本
+#define CATALOG_BLOCK	"CBLK"		/// 列存储数据块标识
+
+enum {// 列数据类型
+	CAT_F64 = 1,	/// 64位浮点
+	CAT_F32,		/// 32位浮点
+	CAT_I32,		/// 32位整数
+	CAT_STR			/// 定长字符串
+};
+
+enum {// 表编号
+	CAT_FRAMES,		/// 帧信息
+	CAT_OBJECTS,	/// 目标
+	CAT_STREAKS,	/// 拖线
+	CAT_DIFF,		/// 残差源
+	CAT_TABLES		/// 表数量
+};
+
+/*!
+ * @struct CatColumnHeader 列存储文件中的列定义
+ */
+struct CatColumnHeader {
+	char name[16];		/// 列名
+	char unit[12];		/// 单位
+	uint16_t type;		/// 数据类型
+	uint16_t width;		/// 单元宽度, 量纲: 字节
+};
+
+/*!
+ * @struct CatBlockHeader 列存储数据块头
+ */
+struct CatBlockHeader {
+	char magic[4];		/// 标识
+	uint16_t table;		/// 表编号
+	uint16_t ncol;		/// 列数
+	uint32_t nrow;		/// 行数
+	uint32_t frame;		/// 帧序号
+	uint64_t bytes;		/// 数据长度, 不含块头
+};
+
+struct CatFrameRow;
+
+class ACatalogWriter {
+public:
+	ACatalogWriter(Parameter* param);
+	virtual ~ACatalogWriter();
+
+protected:
+	typedef boost::shared_ptr<boost::thread> threadptr;
+
+	/*!
+	 * @struct CatalogJob 待写入的单帧结果. 复制自图像帧, 写入期间图像帧可继续使用或释放
+	 */
+	struct CatalogJob {
+		std::string filetit;	/// 文件名(不含扩展名)
+		std::string pathdir;	/// 图像所在目录
+		std::string dateobs;	/// 曝光起始时间
+		double expdur;			/// 曝光时间
+		double bkMean, bkSigma;	/// 背景
+		double fwhm;			/// 半高全宽
+		point_2f coordCenter;	/// 视场中心
+		bool succAstro;			/// 天文定位成功
+		CeleBodyVec bodies;		/// 目标
+		StreakVec streaks;		/// 拖线
+		DiffSrcVec diffs;		/// 残差源
+	};
+	typedef boost::shared_ptr<CatalogJob> JobPtr;
+	typedef BoundedQueue<JobPtr>::ItemDeque JobDeque;
+
+	/*!
+	 * @struct CatalogFile 已打开的输出文件
+	 */
+	struct CatalogFile {
+		std::string path;	/// 文件路径
+		fitsfile* fits;		/// FITS文件句柄
+		FILE* fp;			/// 列存储文件
+		uint32_t frames;	/// 已写入的帧数. 新帧序号为frames + 1
+		int unsynced;		/// 上次fsync后写入的帧数
+
+	public:
+		CatalogFile() {
+			fits   = NULL;
+			fp     = NULL;
+			frames = 0;
+			unsynced = 0;
+		}
+	};
+
+protected:
+	Parameter* param_;		/// 配置参数
+	BoundedQueue<JobPtr> jobs_;	/// 待写队列
+	threadptr thrd_;		/// I/O线程
+	std::string night_;		/// 整夜文件对应的观测夜, CCYYMMDD
+	CatalogFile fileFits_;	/// 整夜FITS文件
+	CatalogFile fileCol_;	/// 整夜列存储文件
+	ADetectStore store_;	/// 整夜检测库
+	std::vector<DetRecord> rows_;	/// 检测库记录缓冲区
+	/* 统计 */
+	int nFrames_;		/// 已写入的帧数
+	int nFail_;			/// 写入失败的帧数
+	int nSync_;			/// fsync次数
+	int nStore_;		/// 追加到检测库的帧数
+
+public:
+	/*!
+	 * @brief 启动I/O线程
+	 */
+	bool Start();
+	/*!
+	 * @brief 写入全部待写帧, 关闭文件并停止I/O线程
+	 */
+	void Stop();
+	/*!
+	 * @brief 复制图像帧的处理结果并加入待写队列. 队列满时等待I/O线程取走
+	 */
+	void Push(ImgFrmPtr frame);
+
+protected:
+	/*!
+	 * @brief I/O线程
+	 */
+	void thread_write();
+	/*!
+	 * @brief 写入单帧
+	 */
+	bool write_job(CatalogJob* job);
+	/*!
+	 * @brief 输出目录
+	 * @param night  整夜文件. 不使用图像所在目录
+	 */
+	std::string output_dir(CatalogJob* job, bool night);
+	/*!
+	 * @brief 将单帧目标追加到检测库
+	 */
+	bool store_append(CatalogJob* job);
+	/*!
+	 * @brief 观测夜: UTC正午为界, CCYYMMDD. 时间无效时为unknown
+	 */
+	static std::string night_of(const std::string& dateobs);
+	/*!
+	 * @brief 曝光中间时刻, 修正儒略日. 时间无效时为0
+	 */
+	static double mjd_of(const std::string& dateobs, double expdur);
+	/*!
+	 * @brief 填写FRAMES表的行. 帧序号为文件中已有帧数 + 1
+	 */
+	static void frame_row(const CatalogFile& file, const CatalogJob* job, CatFrameRow& frame);
+	/*!
+	 * @brief 打开或创建FITS文件. 新文件写入各表结构
+	 */
+	bool fits_open(CatalogFile& file, const std::string& path, bool append);
+	/*!
+	 * @brief 向FITS文件追加单帧
+	 */
+	bool fits_append(CatalogFile& file, CatalogJob* job);
+	/*!
+	 * @brief 打开或创建列存储文件. 新文件写入文件头
+	 */
+	bool col_open(CatalogFile& file, const std::string& path, bool append);
+	/*!
+	 * @brief 向列存储文件追加单帧
+	 */
+	bool col_append(CatalogFile& file, CatalogJob* job);
+	/*!
+	 * @brief 按策略将文件写入磁盘
+	 * @param force  忽略帧数策略. 用于关闭文件
+	 */
+	void sync_file(CatalogFile& file, bool force);
+	/*!
+	 * @brief 关闭文件
+	 */
+	void close_file(CatalogFile& file);
+};
+
+#endif /* ACATALOGWRITER_H_ */
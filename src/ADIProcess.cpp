@@ -6,11 +6,13 @@
 
 #include <boost/bind/bind.hpp>
 #include "ADIProcess.h"
+#include "ATrace.h"
 #include "GLog.h"
 
 ADIProcess::ADIProcess(Parameter* param) {
 	param_   = param;
 	working_ = false;
+	nameStage_ = "stage";
 }
 
 ADIProcess::~ADIProcess() {
@@ -41,8 +43,17 @@ bool ADIProcess::DoIt(ImgFrmPtr frame) {
 	return true;
 }
 
+void ADIProcess::Join() {
+	threadptr thrd = thrd_proc_;
+	if (thrd && thrd->get_id() != boost::this_thread::get_id()) thrd->join();
+}
+
 void ADIProcess::thread_process() {
-	bool rslt = do_real_process();
+	bool rslt;
+	{
+		ATraceScope scope(nameStage_, frame_->filename);
+		rslt = do_real_process();
+	}
 	_gLog.Write(rslt ? LOG_NORMAL : LOG_FAULT, "[%s] %s: %s",
 			frame_->filename.c_str(), nameFunc_.c_str(), rslt ? "Success" : "Fail");
 	working_ = false;
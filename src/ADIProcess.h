@@ -28,6 +28,7 @@ protected:
 	bool working_;			/// 工作标志
 	threadptr thrd_proc_;	/// 线程: 在线程中运行处理过程
 	string nameFunc_;		/// 功能名称
+	const char* nameStage_;	/// 环节名称, 用于性能跟踪
 	CBResult cbRslt_;		/// 回调函数
 	ImgFrmPtr frame_;		/// 图像帧
 
@@ -55,6 +56,10 @@ public:
 	 * @param imgData  图像数据存储地址
 	 */
 	bool DoIt(ImgFrmPtr frame);
+	/*!
+	 * @brief 等待处理线程及其结果回调结束. 在处理线程内调用时立即返回
+	 */
+	void Join();
 
 protected:
 	/*!
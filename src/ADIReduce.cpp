@@ -5,7 +5,12 @@
  */
 
 #include <math.h>
+#include <algorithm>
+#include <vector>
+#include <boost/filesystem.hpp>
 #include "ADIReduce.h"
+#include "AKernels.h"
+#include "ATrace.h"
 #include "GLog.h"
 
 #define BIG			1E30	/// 使用大数作为无效值
@@ -14,59 +19,164 @@
 ADIReduce::ADIReduce(Parameter* param)
 	: ADIProcess(param) {
 	nameFunc_ = "reducing";
+	nameStage_ = "reduce";
 	loadPreprocZero_ = 0;
 	loadPreprocDark_ = 0;
 	loadPreprocFlat_ = 0;
 	buffPtr_.reset(new MemoryBuffer(param->backStat.gridWidth, param->backStat.gridHeight));
 	histo_.reset(new int[MAXLEVELS]);
+	if (param->streak.enable) streak_.reset(new AStreakDetect(&param->streak));
+	if (param->preview.enable) preview_.reset(new APreview(&param->preview));
+	if (param->sigExtract.enable) blob_.reset(new ABlobExtract(&param->sigExtract, &param->blobMeasure));
+	bandCalib_    = false;
+	bandFlatNorm_ = 1.0;
 }
 
 ADIReduce::~ADIReduce() {
 }
 
+void ADIReduce::SetInterWriter(InterWriterPtr inter) {
+	inter_ = inter;
+}
+
 bool ADIReduce::do_real_process() {
-	// 读取图像文件头和数据
-	int retCode = fitsImg_.LoadImage(frame_->filepath.c_str());
-	if (retCode) {
-		_gLog.Write(LOG_FAULT, "[%s]: %s", frame_->filename.c_str(),
-				retCode == 1 ? "open error"
-					: (retCode == 2 ? "missing keywords"
-						: "data read error"));
-		return false;
+	const string& name = frame_->filename;
+	if (frame_->dataRaw) {// 内存数据: 关联外部存储区, 不复制
+		fitsImg_.Attach(frame_->dataRaw.get(), frame_->wImg, frame_->hImg, float(frame_->expdur), frame_->dateobs);
+	}
+	else {
+		// 大幅面图像: 文件保持打开, 分带处理
+		if (param_->preProc.bandRows && fitsImg_.OpenImage(frame_->filepath.c_str())) {
+			if (double(fitsImg_.wImg) * fitsImg_.hImg >= param_->preProc.bandMinMPix * 1E6) return do_band_process();
+			fitsImg_.CloseImage();
+		}
+		// 读取图像文件头和数据
+		int retCode;
+		{
+			ATraceScope scope("reduce.load", name);
+			retCode = fitsImg_.LoadImage(frame_->filepath.c_str());
+		}
+		if (retCode) {
+			_gLog.Write(LOG_FAULT, "[%s]: %s", frame_->filename.c_str(),
+					retCode == 1 ? "open error"
+						: (retCode == 2 ? "missing keywords"
+							: "data read error"));
+			return false;
+		}
 	}
 	frame_->wImg    = fitsImg_.wImg;
 	frame_->hImg    = fitsImg_.hImg;
 	frame_->expdur  = fitsImg_.expdur;
 	frame_->dateobs = fitsImg_.dateobs;
+	if (inter_) mask_ = AFramePool::Instance().Lease<char>(fitsImg_.wImg, fitsImg_.hImg, true);
 
 	/* 预处理 */
-	// 尝试加载预处理图像
-	if (!loadPreprocZero_) load_preproc_zero();
-	if (!loadPreprocDark_) load_preproc_dark();
-	if (!loadPreprocFlat_) load_preproc_flat();
-	if (loadPreprocZero_ == 1) preprocess_zero();
-	if (loadPreprocDark_ == 1) preprocess_dark();
-	if (loadPreprocFlat_ == 1) preprocess_flat();
+	{
+		ATraceScope scope("reduce.calibrate", name);
+		// 尝试加载预处理图像
+		if (!loadPreprocZero_) load_preproc_zero();
+		if (!loadPreprocDark_) load_preproc_dark();
+		if (!loadPreprocFlat_) load_preproc_flat();
+		if (loadPreprocZero_ == 1) preprocess_zero();
+		if (loadPreprocDark_ == 1) preprocess_dark();
+		if (loadPreprocFlat_ == 1) preprocess_flat();
+	}
 
 	// 背景统计
-	back_stat_global();
-	if      (param_->backStat.mode == FILTER_SPACE)       back_stat_grid();
-	else if (param_->backStat.mode == FILTER_FREQ_DOMAIN) {}
+	{
+		ATraceScope scope("reduce.background", name);
+		back_stat_global();
+		if      (param_->backStat.mode == FILTER_SPACE)       back_stat_grid();
+		else if (param_->backStat.mode == FILTER_FREQ_DOMAIN) {}
+	}
 
 	// 剔除坏像素
-	if (param_->preProc.badPixRemove) bad_pixels_remove();
+	if (param_->preProc.badPixRemove) {
+		ATraceScope scope("reduce.badpixel", name);
+		bad_pixels_remove();
+	}
 
-	// 提取信号
+	// 快视预览图: 屏蔽拖线前生成, 保留拖线供监视
+	if (preview_) {
+		ATraceScope scope("reduce.preview", name);
+		output_preview();
+	}
 
-	// 目标聚合
+	// 检测并屏蔽拖线
+	if (streak_) {
+		ATraceScope scope("reduce.streak", name);
+		detect_streak();
+	}
 
-	// 计算目标特征
+	// 提取信号, 目标聚合, 计算目标特征
+	if (blob_) {
+		ATraceScope scope("reduce.extract", name);
+		extract_signal();
+	}
 
 	// 处理特殊目标
 
+	// 合成跟踪和差分成像: 保留扣除背景后的图像供运动关联叠加或与参考图像相减
+	if ((param_->funcs.useMotion && param_->synTrack.enable) || param_->funcs.useDiff) {
+		ATraceScope scope("reduce.subtract", name);
+		unsigned pixels = fitsImg_.wImg * fitsImg_.hImg;
+		float* src = fitsImg_.data;
+		float back = float(frame_->bkMean);
+		frame_->dataSub = AFramePool::Instance().Lease<float>(fitsImg_.wImg, fitsImg_.hImg);
+		float* dst = frame_->dataSub.get();
+		for (unsigned i = 0; i < pixels; ++i) dst[i] = src[i] - back;
+	}
+	if (inter_) output_intermediate();
+
 	return true;
 }
 
+void ADIReduce::output_preview() {
+	namespace fs = boost::filesystem;
+	const ParamPreview& param = param_->preview;
+	fs::path dir = param.pathDir.empty() ? param_->preProc.pathWork : param.pathDir;
+	if (dir.empty()) dir = frame_->pathdir.empty() ? "." : frame_->pathdir;
+	boost::system::error_code ec;
+	if (!fs::exists(dir, ec)) fs::create_directories(dir, ec);
+	std::string filename = (param.latest ? "latest" : frame_->filetit) + (param.format == PREVIEW_PGM ? ".pgm" : ".png");
+	fs::path filepath = dir / filename;
+
+	unsigned w, h;
+	if (!preview_->Generate(fitsImg_.data, fitsImg_.wImg, fitsImg_.hImg, frame_->bkMean, frame_->bkSigma, filepath.string())) {
+		_gLog.Write(LOG_WARN, "[%s]: failed to write preview [%s]", frame_->filename.c_str(), filepath.c_str());
+	}
+	else {
+		double ms = preview_->LastStat(w, h);
+		_gLog.Write("[%s]: preview %ux%u, %.1f ms", frame_->filename.c_str(), w, h, ms);
+	}
+}
+
+void ADIReduce::output_intermediate() {
+	AInterWriter::ProductPtr product(new AInterWriter::InterProduct);
+	product->filetit = frame_->filetit;
+	product->pathdir = frame_->pathdir;
+	product->wImg    = fitsImg_.wImg;
+	product->hImg    = fitsImg_.hImg;
+	if (param_->backStat.mode == FILTER_SPACE && buffPtr_->nbkx) {
+		unsigned n = buffPtr_->nbkx * buffPtr_->nbky;
+		product->wGrid = param_->backStat.gridWidth;
+		product->hGrid = param_->backStat.gridHeight;
+		product->nbkx  = buffPtr_->nbkx;
+		product->nbky  = buffPtr_->nbky;
+		product->back.assign(buffPtr_->mean, buffPtr_->mean + n);
+		product->rms.assign(buffPtr_->sig, buffPtr_->sig + n);
+	}
+	else {// 未统计网格: 以全局背景作为单一网格
+		product->wGrid = product->wImg;
+		product->hGrid = product->hImg;
+		product->nbkx  = product->nbky = 1;
+		product->back.assign(1, float(frame_->bkMean));
+		product->rms.assign(1, float(frame_->bkSigma));
+	}
+	product->mask.swap(mask_);
+	inter_->Push(product);
+}
+
 /*---------------------------------------------------------------------------*/
 /* 功能: 预处理 */
 void ADIReduce::load_preproc_zero() {
@@ -93,11 +203,16 @@ void ADIReduce::load_preproc_flat() {
 			unsigned hflat  = fitsFlat_.hImg;
 			unsigned pixels = wflat * hflat;
 			float* flat = fitsFlat_.data;
-			double mean(0.0), recip;
-			for (unsigned i = 0; i < pixels; ++i) mean += flat[i];
+			const PixelKernels& kernels = AKernels::Get();
+			double mean(0.0), sum, sumsq, recip;
+			// 逐行累加, 与分带处理的统计顺序一致
+			for (unsigned y = 0; y < hflat; ++y) {
+				kernels.moments(flat + size_t(y) * wflat, wflat, wflat, 1, &sum, &sumsq);
+				mean += sum;
+			}
 			mean /= double(pixels);
 			recip = 1.0 / mean; // 均值倒数
-			for (unsigned i = 0; i < pixels; ++i, ++flat) *flat = float(*flat * recip);
+			kernels.scale(flat, recip, pixels);
 		}
 	}
 }
@@ -114,9 +229,7 @@ void ADIReduce::preprocess_zero() {
 				wimg, himg, wzero, hzero);
 	else {
 		unsigned pixels = wimg * himg;
-		float* img  = fitsImg_.data;
-		float* zero = fitsZero_.data;
-		for (unsigned i = 0; i < pixels; ++i, ++img, ++zero) *img -= *zero;
+		AKernels::Get().subtract(fitsImg_.data, fitsZero_.data, pixels);
 	}
 }
 
@@ -132,10 +245,7 @@ void ADIReduce::preprocess_dark() {
 				wimg, himg, wdark, hdark);
 	else {
 		unsigned pixels = wimg * himg;
-		float* img  = fitsImg_.data;
-		float* dark = fitsDark_.data;
-		float t = fitsImg_.expdur;
-		for (unsigned i = 0; i < pixels; ++i, ++img, ++dark) *img -= (*dark * t);
+		AKernels::Get().subtract_scaled(fitsImg_.data, fitsDark_.data, fitsImg_.expdur, pixels);
 	}
 }
 
@@ -151,10 +261,7 @@ void ADIReduce::preprocess_flat() {
 				wimg, himg, wflat, hflat);
 	else {
 		unsigned pixels = wimg * himg;
-		float* img  = fitsImg_.data;
-		float* flat = fitsFlat_.data;
-
-		for (unsigned i = 0; i < pixels; ++i, ++img, ++flat) *img /= *flat;
+		AKernels::Get().divide(fitsImg_.data, fitsFlat_.data, pixels);
 	}
 }
 
@@ -162,8 +269,8 @@ void ADIReduce::preprocess_flat() {
 /* 功能: 统计背景 */
 void ADIReduce::back_stat_global() {
 	BackGrid grid;
-	if (back_grid_stat (0, 0, fitsImg_.wImg, fitsImg_.hImg, grid)) {
-		back_grid_histo(0, 0, fitsImg_.wImg, fitsImg_.hImg, grid);
+	if (back_grid_stat (fitsImg_.data, fitsImg_.wImg, fitsImg_.hImg, 0, 0, fitsImg_.wImg, fitsImg_.hImg, grid)) {
+		back_grid_histo(fitsImg_.data, fitsImg_.wImg, fitsImg_.hImg, 0, 0, fitsImg_.wImg, fitsImg_.hImg, grid);
 		back_grid_guess(grid);
 	}
 	frame_->bkMean = grid.mean;
@@ -189,9 +296,11 @@ void ADIReduce::back_stat_grid() {
 
 	for (iy = 0, ik = 0; iy < hImg; iy += hGrid) {
 		for (ix = 0; ix < wImg; ix += wGrid, ++ik, ++mean, ++sig) {
-			if (back_grid_stat (ix, iy, wGrid, hGrid, grid)) {
-				back_grid_histo(ix, iy, wGrid, hGrid, grid);
+			if (back_grid_stat (fitsImg_.data, wImg, hImg, ix, iy, wGrid, hGrid, grid)) {
+				back_grid_histo(fitsImg_.data, wImg, hImg, ix, iy, wGrid, hGrid, grid);
 				back_grid_guess(grid);
+				*mean = grid.mean;
+				*sig  = grid.sig;
 			}
 			else {
 				*mean = -BIG;
@@ -203,26 +312,20 @@ void ADIReduce::back_stat_grid() {
 	// 生成网格二阶导数, 用于样条插值
 }
 
-bool ADIReduce::back_grid_stat(unsigned xstart, unsigned ystart, unsigned width, unsigned height, BackGrid& grid) {
-	unsigned wImg  = fitsImg_.wImg;
-	unsigned hImg  = fitsImg_.hImg;
+bool ADIReduce::back_grid_stat(const float* data, unsigned wImg, unsigned hImg, unsigned xstart, unsigned ystart,
+		unsigned width, unsigned height, BackGrid& grid) {
 	unsigned xstop = xstart + width;
 	unsigned ystop = ystart + height;
-	unsigned x, y;
-	double mean(0.0), sig(0.0);
-	float* dptr = fitsImg_.data + ystart * wImg;
-	float t, lcut, hcut;
+	double mean, sig;
+	const float* dptr = data + size_t(ystart) * wImg + xstart;
+	const PixelKernels& kernels = AKernels::Get();
+	float lcut, hcut;
 	int n0, n1;
 
 	if (xstop > wImg) xstop = wImg;
 	if (ystop > hImg) ystop = hImg;
 	n0 = (xstop - xstart) * (ystop - ystart);
-	for (y = ystart; y < ystop; ++y, dptr += wImg) {
-		for (x = xstart; x < xstop; ++x) {
-			mean += (t = dptr[x]);
-			sig  += (t * t);
-		}
-	}
+	kernels.moments(dptr, wImg, xstop - xstart, ystop - ystart, &mean, &sig);
 	mean /= n0;
 	sig = sig / n0 - mean * mean;
 	if (sig <= 0.0) {
@@ -234,17 +337,7 @@ bool ADIReduce::back_grid_stat(unsigned xstart, unsigned ystart, unsigned width,
 	lcut = float(mean - 2.0 * sig);
 	hcut = float(mean + 2.0 * sig);
 
-	dptr = fitsImg_.data + ystart * wImg;
-	mean = sig = 0.0;
-	for (y = ystart, n1 = 0; y < ystop; ++y, dptr += wImg) {
-		for (x = xstart; x < xstop; ++x) {
-			if ((t = dptr[x]) >= lcut && t <= hcut) {
-				++n1;
-				mean += t;
-				sig  += (t * t);
-			}
-		}
-	}
+	n1 = int(kernels.moments_clip(dptr, wImg, xstop - xstart, ystop - ystart, lcut, hcut, &mean, &sig));
 	mean /= n1;
 	sig = sig / n1 - mean * mean;
 	if (sig <= 0.0) {
@@ -253,11 +346,16 @@ bool ADIReduce::back_grid_stat(unsigned xstart, unsigned ystart, unsigned width,
 		return false;
 	}
 	sig = sqrt(sig);
+	// 截断统计结果作为初值, 由直方图修正
+	grid.mean  = float(mean);
+	grid.sig   = float(sig);
+	grid.count = n1;
 
 	return true;
 }
 
-void ADIReduce::back_grid_histo(unsigned xstart, unsigned ystart, unsigned width, unsigned height, BackGrid& grid) {
+void ADIReduce::back_grid_histo(const float* data, unsigned wImg, unsigned hImg, unsigned xstart, unsigned ystart,
+		unsigned width, unsigned height, BackGrid& grid) {
 
 }
 
@@ -269,6 +367,21 @@ void ADIReduce::back_grid_filter() {
 
 }
 
+/*---------------------------------------------------------------------------*/
+/* 功能: 拖线 */
+void ADIReduce::detect_streak() {
+	StreakVec& streaks = frame_->streaks;
+	int npoint, n = streak_->Detect(fitsImg_.data, fitsImg_.wImg, fitsImg_.hImg,
+			frame_->bkMean, frame_->bkSigma, streaks, mask_.get());
+	double ms = streak_->LastStat(npoint);
+
+	_gLog.Write("[%s]: %d streaks, %d votes, %.1f ms", frame_->filename.c_str(), n, npoint, ms);
+	for (StreakVec::iterator it = streaks.begin(); it != streaks.end(); ++it) {
+		_gLog.Write("streak: (%.1f, %.1f) - (%.1f, %.1f), length = %.1f, width = %.1f, tilt = %.1f, flux = %.0f, SNR = %.1f",
+				it->pt1.x, it->pt1.y, it->pt2.x, it->pt2.y, it->length, it->width, it->tilt, it->flux, it->snr);
+	}
+}
+
 /*---------------------------------------------------------------------------*/
 /* 功能: 坏像素 */
 void ADIReduce::bad_pixels_remove() {
@@ -283,33 +396,38 @@ void ADIReduce::bad_pixels_remove() {
 	 * - 像素值大于任一邻近值的k倍. k==3   ==> 热点
 	 * - 像素值小于任一邻近值             ==> 暗点
 	 */
-	float *bufDst   = fitsImg_.data;
-	float *bufSrc   = buffPtr_->backup;
-	char *badMarked = new char[w * h];
-	unsigned x1(1), y1(1), x2(w - 1), y2(h - 1); // 检测区域
+	// 输出中间结果时直接标记在帧掩模中
+	boost::shared_array<char> mask = mask_ ? mask_ : AFramePool::Instance().Lease<char>(w, h, true);
+	bad_pixels_rows(buffPtr_->backup, fitsImg_.data, mask.get(), w, 0, 1, h - 1);
+}
+
+void ADIReduce::bad_pixels_rows(const float* src, float* dst, char* mask, unsigned w, unsigned ybase, unsigned y1, unsigned y2) {
+	unsigned x1(1), x2(w - 1); // 检测区域
 	unsigned x, y;
-	unsigned pos;
+	size_t pos;
 	int step;
 	float pixv;
+	// 局部极值候选: 非极值像素不可能是坏像素, 以向量化的比较整行筛除
+	const PixelKernels& kernels = AKernels::Get();
+	std::vector<uint8_t> candidate(w);
+	uint8_t* cand = candidate.data();
 
 	// 遍历检测区
-	for (y = y1, pos = y1 * w; y < y2; ++y, pos += w) {
+	for (y = y1, pos = size_t(y1 - ybase) * w; y < y2; ++y, pos += w) {
+		kernels.extrema(src + pos - w, src + pos, src + pos + w, w, cand);
 		for (x = x1; x < x2; ++x) {
-			if ((step = bad_pixel_neighbor(badMarked, w, x, y))) x += step;
-			else if (bad_pixel_whether(bufSrc, w, x, y, pixv)) {
-				badMarked[pos + x] = 1;
-				bufDst[pos + x]    = pixv;
+			if ((step = bad_pixel_neighbor(mask, w, x, y, ybase))) x += step;
+			else if (cand[x] && bad_pixel_whether(src, w, x, y, ybase, pixv)) {
+				mask[pos + x] = MASK_BADPIX;
+				dst[pos + x]  = pixv;
 				++x;
 			}
 		}
 	}
-
-	// 释放临时存储区
-	delete []badMarked;
 }
 
-bool ADIReduce::bad_pixel_whether(float* data, unsigned w, unsigned x, unsigned y, float& pixv) {
-	unsigned pos = y * w + x;
+bool ADIReduce::bad_pixel_whether(const float* data, unsigned w, unsigned x, unsigned y, unsigned ybase, float& pixv) {
+	size_t pos = size_t(y - ybase) * w + x;
 	float val = data[pos], t;
 	double mean(0.0), sig(0.0);
 	int i, j, n(0);
@@ -346,11 +464,216 @@ bool ADIReduce::bad_pixel_whether(float* data, unsigned w, unsigned x, unsigned
 	return true;
 }
 
-int ADIReduce::bad_pixel_neighbor(char* mask, unsigned w, unsigned x, unsigned y) {
-	unsigned above = (y - 1) * w + x;
+int ADIReduce::bad_pixel_neighbor(const char* mask, unsigned w, unsigned x, unsigned y, unsigned ybase) {
+	size_t above = size_t(y - 1 - ybase) * w + x;
 	if (mask[above])     return 1;  // 正上方
 	if (mask[above + 1]) return 2;  // 右上方
 	return 0;
 }
 
 /*---------------------------------------------------------------------------*/
+/* 功能: 信号提取 */
+void ADIReduce::extract_signal() {
+	unsigned w = fitsImg_.wImg;
+	unsigned h = fitsImg_.hImg;
+	unsigned hGrid(param_->backStat.gridHeight), y;
+	bool grid = param_->backStat.mode == FILTER_SPACE && buffPtr_->nbkx;
+	std::vector<float> back(w), noise(w);
+	char* mask = mask_.get();
+
+	blob_->Begin(w, &frame_->bodies, mask);
+	for (y = 0; y < h; ++y) {
+		if (!y || (grid && y % hGrid == 0)) back_row(y, grid, back.data(), noise.data());
+		blob_->AddRow(y, fitsImg_.data + size_t(y) * w, back.data(), noise.data(), mask ? mask + size_t(y) * w : NULL);
+	}
+	unsigned nblob = blob_->End();
+	_gLog.Write("[%s]: %lu objects extracted from %u blobs", frame_->filename.c_str(), frame_->bodies.size(), nblob);
+}
+
+void ADIReduce::back_row(unsigned y, bool grid, float* back, float* noise) {
+	unsigned w = frame_->wImg, x, x1;
+	if (!grid) {
+		float b = float(frame_->bkMean), n = frame_->bkSigma > 0.0 ? float(frame_->bkSigma) : 0.0f;
+		std::fill(back,  back  + w, b);
+		std::fill(noise, noise + w, n);
+		return;
+	}
+
+	unsigned wGrid(param_->backStat.gridWidth), hGrid(param_->backStat.gridHeight);
+	const float* mean = buffPtr_->mean + (y / hGrid) * buffPtr_->nbkx;
+	const float* sig  = buffPtr_->sig  + (y / hGrid) * buffPtr_->nbkx;
+	for (x = 0; x < w; x = x1, ++mean, ++sig) {
+		bool valid = *sig > 0.0f;
+		x1 = std::min(w, x + wGrid);
+		std::fill(back  + x, back  + x1, valid ? *mean : 0.0f);
+		std::fill(noise + x, noise + x1, valid ? *sig  : 0.0f);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* 功能: 分带处理 */
+bool ADIReduce::do_band_process() {
+	const string& name = frame_->filename;
+	unsigned w = fitsImg_.wImg;
+	unsigned h = fitsImg_.hImg;
+	unsigned wGrid(param_->backStat.gridWidth), hGrid(param_->backStat.gridHeight);
+	// 带高取网格高度的整数倍: 网格不跨带, 统计结果与整帧处理一致
+	unsigned rows = (param_->preProc.bandRows + hGrid - 1) / hGrid * hGrid;
+	unsigned y0, y1, top(0), bottom, nread, ix, iy, ik, y;
+	double sumN(0.0), sumM(0.0), sumQ(0.0);
+
+	frame_->wImg    = w;
+	frame_->hImg    = h;
+	frame_->expdur  = fitsImg_.expdur;
+	frame_->dateobs = fitsImg_.dateobs;
+	_gLog.Write("[%s]: band mode, %u x %u, %u rows per band", name.c_str(), w, h, rows);
+	if (streak_ || preview_ || (param_->funcs.useMotion && param_->synTrack.enable) || param_->funcs.useDiff)
+		_gLog.Write(LOG_WARN, "[%s]: streak, preview and background subtracted image are skipped in band mode", name.c_str());
+
+	band_open_calib();
+	if ((bandZero_.IsOpen() && (bandZero_.wImg != w || bandZero_.hImg != h))
+			|| (bandDark_.IsOpen() && (bandDark_.wImg != w || bandDark_.hImg != h))
+			|| (bandFlat_.IsOpen() && (bandFlat_.wImg != w || bandFlat_.hImg != h)))
+		_gLog.Write(LOG_WARN, "[%s]: image dimension[%u, %u] does not match calibration images", name.c_str(), w, h);
+	// 缓冲区: 一带及上下各一行
+	AFramePool& pool = AFramePool::Instance();
+	boost::shared_array<float> leaseData  = pool.Lease<float>(w, rows + 2);
+	boost::shared_array<float> leaseSrc   = pool.Lease<float>(w, rows + 2);
+	boost::shared_array<float> leaseCalib = pool.Lease<float>(w, rows + 2);
+	boost::shared_array<char>  leaseMask  = pool.Lease<char>(w, rows + 2, true);
+	float* data = leaseData.get();
+	char* mask  = leaseMask.get();
+	std::vector<float> back(w), noise(w);
+	buffPtr_->ResizeGrid(w, h);
+	// 输出中间结果时生成整帧掩模: 各带的坏像素标记复制到其中, 目标像素由信号提取直接标记
+	if (inter_) mask_ = pool.Lease<char>(w, h, true);
+	if (blob_) blob_->Begin(w, &frame_->bodies, mask_.get());
+
+	for (y0 = 0; y0 < h; y0 = y1) {
+		unsigned topLast = top;
+		y1     = std::min(h, y0 + rows);
+		top    = y0 ? y0 - 1 : 0;
+		bottom = std::min(h, y1 + 1);
+		nread  = bottom - top;
+		{
+			ATraceScope scope("reduce.load", name);
+			if (!fitsImg_.ReadRows(top, nread, data)) {
+				_gLog.Write(LOG_FAULT, "[%s]: data read error at row %u", name.c_str(), top);
+				fitsImg_.CloseImage();
+				if (blob_) blob_->End();
+				mask_.reset();
+				return false;
+			}
+		}
+		{
+			ATraceScope scope("reduce.calibrate", name);
+			band_calibrate(top, nread, data, leaseCalib.get());
+		}
+
+		// 网格背景. 全局背景由各网格截断统计结果合并
+		{
+			ATraceScope scope("reduce.background", name);
+			const float* body = data + size_t(y0 - top) * w;
+			float *mean = buffPtr_->mean, *sig = buffPtr_->sig;
+			BackGrid grid;
+			for (iy = y0; iy < y1; iy += hGrid) {
+				for (ix = 0, ik = iy / hGrid * buffPtr_->nbkx; ix < w; ix += wGrid, ++ik) {
+					if (back_grid_stat (body, w, y1 - y0, ix, iy - y0, wGrid, hGrid, grid)) {
+						back_grid_histo(body, w, y1 - y0, ix, iy - y0, wGrid, hGrid, grid);
+						back_grid_guess(grid);
+						mean[ik] = grid.mean;
+						sig[ik]  = grid.sig;
+						sumN += grid.count;
+						sumM += double(grid.count) * grid.mean;
+						sumQ += double(grid.count) * (double(grid.sig) * grid.sig + double(grid.mean) * grid.mean);
+					}
+					else {
+						mean[ik] = -BIG;
+						sig[ik]  = -BIG;
+					}
+				}
+			}
+		}
+
+		// 剔除坏像素: 上下各一行作为邻近区, 上一带末行的标记移至首行
+		if (param_->preProc.badPixRemove) {
+			ATraceScope scope("reduce.badpixel", name);
+			memcpy(leaseSrc.get(), data, size_t(nread) * w * sizeof(float));
+			if (y0) memmove(mask, mask + size_t(y0 - 1 - topLast) * w, w);
+			memset(mask + (y0 ? w : 0), 0, size_t(nread - (y0 ? 1 : 0)) * w);
+			bad_pixels_rows(leaseSrc.get(), data, mask, w, top, std::max(y0, 1U), std::min(y1, h - 1));
+			if (mask_) memcpy(mask_.get() + size_t(y0) * w, mask + size_t(y0 - top) * w, size_t(y1 - y0) * w);
+		}
+
+		// 提取信号: 跨带目标由逐行聚合自然连接
+		if (blob_) {
+			ATraceScope scope("reduce.extract", name);
+			for (y = y0; y < y1; ++y) {
+				if (y == y0 || y % hGrid == 0) back_row(y, true, back.data(), noise.data());
+				blob_->AddRow(y, data + size_t(y - top) * w, back.data(), noise.data(), NULL);
+			}
+		}
+	}
+	fitsImg_.CloseImage();
+
+	if (sumN > 0.0) {
+		double mean = sumM / sumN, var = sumQ / sumN - mean * mean;
+		frame_->bkMean  = mean;
+		frame_->bkSigma = var > 0.0 ? sqrt(var) : 0.0;
+	}
+	_gLog.Write("global background statistics, pooled from grids. mean = %.1f, stdev = %.2f",
+			frame_->bkMean, frame_->bkSigma);
+	if (blob_) {
+		unsigned nblob = blob_->End();
+		_gLog.Write("[%s]: %lu objects extracted from %u blobs", name.c_str(), frame_->bodies.size(), nblob);
+	}
+	if (inter_) output_intermediate();
+
+	return true;
+}
+
+void ADIReduce::band_open_calib() {
+	if (bandCalib_) return;
+	bandCalib_ = true;
+
+	const ParamPreProcess& param = param_->preProc;
+	if (!param.pathZero.empty() && !bandZero_.OpenImage(param.pathZero.c_str()))
+		_gLog.Write(LOG_WARN, "failed to open zero image [%s]", param.pathZero.c_str());
+	if (!param.pathDark.empty() && !bandDark_.OpenImage(param.pathDark.c_str()))
+		_gLog.Write(LOG_WARN, "failed to open dark image [%s]", param.pathDark.c_str());
+	if (!param.pathFlat.empty()) {
+		if (!bandFlat_.OpenImage(param.pathFlat.c_str()))
+			_gLog.Write(LOG_WARN, "failed to open flat image [%s]", param.pathFlat.c_str());
+		else {// 平场均值: 逐行读取累加, 与整帧加载时的统计顺序一致
+			unsigned w = bandFlat_.wImg, h = bandFlat_.hImg, y;
+			std::vector<float> row(w);
+			double mean(0.0), sum, sumsq;
+			const PixelKernels& kernels = AKernels::Get();
+			for (y = 0; y < h && bandFlat_.ReadRows(y, 1, row.data()); ++y) {
+				kernels.moments(row.data(), w, w, 1, &sum, &sumsq);
+				mean += sum;
+			}
+			mean /= double(w) * h;
+			if (y < h || !(mean > 0.0)) {
+				_gLog.Write(LOG_WARN, "invalid flat image [%s]", param.pathFlat.c_str());
+				bandFlat_.CloseImage();
+			}
+			else bandFlatNorm_ = 1.0 / mean;
+		}
+	}
+}
+
+void ADIReduce::band_calibrate(unsigned row0, unsigned nrow, float* data, float* buff) {
+	unsigned w = fitsImg_.wImg, h = fitsImg_.hImg;
+	size_t n = size_t(nrow) * w;
+	const PixelKernels& kernels = AKernels::Get();
+
+	if (bandZero_.IsOpen() && bandZero_.wImg == w && bandZero_.hImg == h && bandZero_.ReadRows(row0, nrow, buff))
+		kernels.subtract(data, buff, n);
+	if (bandDark_.IsOpen() && bandDark_.wImg == w && bandDark_.hImg == h && bandDark_.ReadRows(row0, nrow, buff))
+		kernels.subtract_scaled(data, buff, fitsImg_.expdur, n);
+	if (bandFlat_.IsOpen() && bandFlat_.wImg == w && bandFlat_.hImg == h && bandFlat_.ReadRows(row0, nrow, buff)) {
+		kernels.scale(buff, bandFlatNorm_, n);
+		kernels.divide(data, buff, n);
+	}
+}
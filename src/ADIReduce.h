@@ -11,6 +11,11 @@
 #include <boost/smart_ptr/shared_array.hpp>
 #include "ADIProcess.h"
 #include "FITSHandlerImage.hpp"
+#include "AFramePool.h"
+#include "AStreakDetect.h"
+#include "AInterWriter.h"
+#include "APreview.h"
+#include "ABlobExtract.h"
 
 class ADIReduce : public ADIProcess {
 public:
@@ -27,10 +32,12 @@ protected:
 		float sig;		/// 噪声
 		float scale;	/// 比例尺
 		float zero;		/// 零点
+		int count;		/// 截断统计的像素数
 
 	public:
 		BackGrid() {
 			levels = 0;
+			count  = 0;
 			mean = sig = -1E30;
 			scale = zero = 0.0;
 		}
@@ -42,7 +49,7 @@ protected:
 	struct MemoryBuffer {
 		unsigned wImg, hImg;	/// 图像帧像素数
 		unsigned nbkx, nbky;	/// XY方向背景网格数量
-		float* backup;		/// 原始数据备份
+		float* backup;		/// 原始数据备份. 从AFramePool租用
 		float* mean;		/// 背景网格均值
 		float* sig;			/// 背景网格噪声
 		float* d2mean;		/// 均值二阶微分
@@ -50,6 +57,7 @@ protected:
 
 	protected:
 		unsigned bkw, bkh;	/// 背景网格宽度和高度
+		boost::shared_array<float> leaseBackup;	/// 备份区租约
 
 	public:
 		MemoryBuffer(unsigned bkGridW, unsigned bkGridH) {
@@ -63,7 +71,6 @@ protected:
 		}
 
 		virtual ~MemoryBuffer() {
-			if (backup) delete []backup;
 			if (mean)   delete []mean;
 			if (sig)    delete []sig;
 			if (d2mean) delete []d2mean;
@@ -76,20 +83,35 @@ protected:
 			return true;
 		}
 
+		/*!
+		 * @brief 仅分配网格区, 归还备份区. 用于分带处理
+		 */
+		bool ResizeGrid(unsigned wNew, unsigned hNew) {
+			leaseBackup.reset();
+			backup = NULL;
+			wImg = wNew;
+			hImg = hNew;
+			return resize_grid(wNew, hNew);
+		}
+
 	protected:
 		bool resize(unsigned wNew, unsigned hNew) {
 			unsigned pixOld = wImg * hImg;
 			unsigned pixNew = wNew * hNew;
-			// 检查并重新分配备份区
-			if (pixOld != pixNew && backup) {
-				delete []backup;
-				backup = NULL;
+			// 检查并重新租用备份区
+			if (pixOld != pixNew || !backup) {
+				leaseBackup.reset();
+				leaseBackup = AFramePool::Instance().Lease<float>(wNew, hNew);
+				backup = leaseBackup.get();
 			}
-			if (!backup) backup = new float[pixNew];
 			wImg = wNew;
 			hImg = hNew;
+			return resize_grid(wNew, hNew) && backup != NULL;
+		}
+
+		bool resize_grid(unsigned wNew, unsigned hNew) {
 			// 检查并重新分配网格区
-			pixOld = nbkx * nbky;
+			unsigned pixOld = nbkx * nbky, pixNew;
 			nbkx = (wNew - 1) / bkw + 1;
 			nbky = (hNew - 1) / bkh + 1;
 			pixNew = nbkx * nbky;
@@ -105,7 +127,7 @@ protected:
 			if (!d2mean) d2mean = new float[pixNew];
 			if (!d2sig)  d2sig  = new float[pixNew];
 
-			return (backup != NULL && mean != NULL && sig != NULL);
+			return (mean != NULL && sig != NULL);
 		}
 	};
 	using MembuffPtr = boost::shared_ptr<MemoryBuffer>;
@@ -128,6 +150,24 @@ protected:
 	FITSHandlerImage fitsImg_;	/// FITS图像文件访问接口
 	MembuffPtr buffPtr_;		/// 数据处理内存缓冲区
 	IntArray histo_;			/// 直方图
+	boost::shared_ptr<AStreakDetect> streak_;	/// 拖线检测
+	boost::shared_ptr<APreview> preview_;	/// 快视预览图
+	InterWriterPtr inter_;		/// 中间结果输出
+	boost::shared_array<char> mask_;	/// 当前帧的像素掩模. 仅输出中间结果时生成
+	boost::shared_ptr<ABlobExtract> blob_;	/// 信号提取与目标聚合
+	/* 分带处理 */
+	bool bandCalib_;			/// 已打开分带处理用的预处理图像
+	FITSHandlerImage bandZero_;	/// 持续打开的本底图像
+	FITSHandlerImage bandDark_;	/// 持续打开的暗场图像
+	FITSHandlerImage bandFlat_;	/// 持续打开的平场图像
+	double bandFlatNorm_;		/// 平场归一化系数: 平场均值的倒数
+
+public:
+	/*!
+	 * @brief 设置中间结果输出接口
+	 * @param inter  输出接口. 空: 不输出中间结果
+	 */
+	void SetInterWriter(InterWriterPtr inter);
 
 protected:
 	/* 功能: 数据处理流程 */
@@ -135,6 +175,18 @@ protected:
 	 * @brief 在多进程模式下执行真正的处理流程
 	 */
 	bool do_real_process();
+	/*!
+	 * @brief 分带处理: 逐带读取、预处理、统计网格背景、剔除坏像素和提取信号, 内存占用由带高决定
+	 */
+	bool do_band_process();
+	/*!
+	 * @brief 将背景、噪声网格和像素掩模提交输出
+	 */
+	void output_intermediate();
+	/*!
+	 * @brief 生成快视预览图
+	 */
+	void output_preview();
 
 protected:
 	/* 功能: 预处理 */
@@ -162,6 +214,18 @@ protected:
 	 * @brief 除平场
 	 */
 	void preprocess_flat();
+	/*!
+	 * @brief 打开分带处理用的预处理图像, 并统计平场归一化系数
+	 */
+	void band_open_calib();
+	/*!
+	 * @brief 预处理一带图像
+	 * @param row0  起始行
+	 * @param nrow  行数
+	 * @param data  图像数据
+	 * @param buff  预处理图像数据缓存区, 容量不少于nrow行
+	 */
+	void band_calibrate(unsigned row0, unsigned nrow, float* data, float* buff);
 
 protected:
 	/* 功能: 背景统计 */
@@ -175,6 +239,9 @@ protected:
 	void back_stat_grid();
 	/*!
 	 * @brief 统计单个网格
+	 * @param data    图像数据
+	 * @param wImg    图像宽度
+	 * @param hImg    图像高度
 	 * @param xstart  在原始数据中的X轴起始地址
 	 * @param ystart  在原始数据中的Y轴起始地址
 	 * @param width   宽度
@@ -183,11 +250,13 @@ protected:
 	 * @return
 	 * 网格符合统计规律
 	 */
-	bool back_grid_stat(unsigned xstart, unsigned ystart, unsigned width, unsigned height, BackGrid& grid);
+	bool back_grid_stat(const float* data, unsigned wImg, unsigned hImg, unsigned xstart, unsigned ystart,
+			unsigned width, unsigned height, BackGrid& grid);
 	/*!
 	 * @brief 统计单个网格直方图
 	 */
-	void back_grid_histo(unsigned xstart, unsigned ystart, unsigned width, unsigned height, BackGrid& grid);
+	void back_grid_histo(const float* data, unsigned wImg, unsigned hImg, unsigned xstart, unsigned ystart,
+			unsigned width, unsigned height, BackGrid& grid);
 	/*!
 	 * @brief 依据直方图计算网格统计结果
 	 */
@@ -197,33 +266,68 @@ protected:
 	 */
 	void back_grid_filter();
 
+protected:
+	/* 功能: 拖线 */
+	/*!
+	 * @brief 检测拖线, 以背景屏蔽其像素
+	 */
+	void detect_streak();
+
 protected:
 	/* 功能: 坏像素 */
 	/*!
 	 * @brief 移除坏像素
 	 */
 	void bad_pixels_remove();
+	/*!
+	 * @brief 移除[y1, y2)行的坏像素. 缓冲区首行对应图像第ybase行, 须包含y1 - 1至y2行
+	 * @param src    原始数据
+	 * @param dst    处理结果
+	 * @param mask   坏像素标记. y1 - 1行为已处理结果
+	 * @param w      图像帧宽度
+	 * @param ybase  缓冲区首行的行号
+	 * @param y1     起始行
+	 * @param y2     结束行, 不含
+	 */
+	void bad_pixels_rows(const float* src, float* dst, char* mask, unsigned w, unsigned ybase, unsigned y1, unsigned y2);
 	/*!
 	 * @brief 检查是否坏像素, 并在确认是坏像素时计算其修正值
 	 * @param data   原始数据
 	 * @param w      图像帧宽度
 	 * @param x      X坐标
 	 * @param y      Y坐标
+	 * @param ybase  数据首行的行号
 	 * @param pixv   修正值
 	 * @return
 	 * 坏像素判定结果
 	 */
-	bool bad_pixel_whether(float* data, unsigned w, unsigned x, unsigned y, float& pixv);
+	bool bad_pixel_whether(const float* data, unsigned w, unsigned x, unsigned y, unsigned ybase, float& pixv);
 	/*!
 	 * @brief 检查是否坏像素邻居
 	 * @param mask  坏像素标记
 	 * @param w      图像帧宽度
 	 * @param x      X坐标
 	 * @param y      Y坐标
+	 * @param ybase  标记首行的行号
 	 * @return
 	 * 判定结果
 	 */
-	int bad_pixel_neighbor(char* mask, unsigned w, unsigned x, unsigned y);
+	int bad_pixel_neighbor(const char* mask, unsigned w, unsigned x, unsigned y, unsigned ybase);
+
+protected:
+	/* 功能: 信号提取 */
+	/*!
+	 * @brief 逐行提取整帧图像的信号并聚合为目标
+	 */
+	void extract_signal();
+	/*!
+	 * @brief 生成一行的逐像素背景和噪声
+	 * @param y      行号
+	 * @param grid   使用网格统计结果. 否则使用全局背景
+	 * @param back   背景
+	 * @param noise  噪声. 统计无效的区域为0
+	 */
+	void back_row(unsigned y, bool grid, float* back, float* noise);
 };
 
 #endif /* ADIREDUCE_H_ */
@@ -4,20 +4,32 @@
  * @date 2021-04
  */
 
+#include <algorithm>
 #include <boost/bind/bind.hpp>
 #include <boost/filesystem.hpp>
 #include "ADIWorkFlow.h"
+#include "AFramePool.h"
+#include "AKernels.h"
+#include "ATrace.h"
+#include "FITSHandlerWCS.hpp"
 #include "GLog.h"
 
 using namespace boost::filesystem;
 using namespace boost::placeholders;
 
+/* 处理队列名称, 用于统计和性能跟踪 */
+static const char* queue_names[] = { "reduce", "astrometry", "diff", "photometry", "motion" };
+static const char* queue_trace[] = { "queue.reduce", "queue.astrometry", "queue.diff", "queue.photometry", "queue.motion" };
+
 ADIWorkFlow::ADIWorkFlow(boost::asio::io_service* ios)
 	: ios_(ios) {
 	param_     = NULL;
 	combine_   = 0;
 	running_   = false;
 	procCount_ = 0;
+	inflight_  = 0;
+	memInflight_ = memPeak_ = 0;
+	msStall_   = 0.0;
 }
 
 ADIWorkFlow::~ADIWorkFlow() {
@@ -27,19 +39,84 @@ bool ADIWorkFlow::Start(Parameter* param) {
 	param_     = param;
 	running_   = true;
 	procCount_ = 0;
+	inflight_  = 0;
+	memInflight_ = memPeak_ = 0;
+	msStall_   = 0.0;
+	for (int i = 0; i < QUEUE_MAX; ++i) metric_[i] = QueueMetric();
+	AFramePool::Instance().SetHugePage(param->budget.hugePage);
+	_gLog.SetLevel(LOG_TYPE(param->log.level));
+	_gLog.SetRateLimit(param->log.rateLimit);
+	_gLog.SetAsync(param->log.async);
+	if (param->trace.enable) ATrace::Instance().Start(param->trace.pathMetrics, param->trace.pathEvents);
+	if (!AKernels::Select(param->kernels.isa))
+		_gLog.Write(LOG_WARN, "pixel kernels [%s] not supported by this CPU, selected automatically", param->kernels.isa.c_str());
+	_gLog.Write("pixel kernels: %s", AKernels::Get().name);
+	if (param->sigExtract.modeFilter) {
+		_gLog.Write(LOG_WARN, "<ResolveSignal><Filter Mode=\"%d\"/> is obsolete and ignored", param->sigExtract.modeFilter);
+	}
+	if (!param->sigExtract.enable) {// 定位及后续环节、目标星表均依赖目标提取
+		std::string funcs;
+		if (param->funcs.useAstrometry) funcs += " astrometry";
+		if (param->funcs.useDiff)       funcs += " difference";
+		if (param->funcs.usePhotometry) funcs += " photometry";
+		if (param->funcs.useMotion)     funcs += " motion";
+		if (param->output.rsltFinal && (param->output.catFits || param->output.catColumnar || param->output.detStore))
+			funcs += " catalog";
+		if (!funcs.empty()) {
+			_gLog.Write(LOG_WARN, "object extraction is disabled by <ResolveSignal Enable=\"false\">, no result from:%s",
+					funcs.c_str());
+		}
+	}
 
 	const ADIReduce::CBResultSlot &slot1 = boost::bind(&ADIWorkFlow::DIReduceResult, this, _1);
 	reduce_.reset(new ADIReduce(param_));
 	reduce_->RegisterResult(slot1);
+	if (param->output.rsltInter) {
+		interWriter_.reset(new AInterWriter(param_));
+		interWriter_->Start();
+		reduce_->SetInterWriter(interWriter_);
+	}
+	if (!param->output.pathManifest.empty()) {
+		manifest_.reset(new AManifest(param_));
+		if (!manifest_->Open()) {
+			_gLog.Write(LOG_WARN, "failed to create manifest directory [%s]", param->output.pathManifest.c_str());
+			manifest_.reset();
+		}
+	}
+	if (param->output.rsltFinal && (param->output.catFits || param->output.catColumnar || param->output.detStore)) {
+		catWriter_.reset(new ACatalogWriter(param_));
+		catWriter_->Start();
+	}
 	thrd_reduce_.reset(new boost::thread(boost::bind(&ADIWorkFlow::thread_reduce, this)));
 
-	if (param->funcs.useAstrometry || param->funcs.usePhotometry || param->funcs.useMotion) {
+	if (param->funcs.useAstrometry || param->funcs.useDiff || param->funcs.usePhotometry || param->funcs.useMotion) {
+		// 启动时映射参考星表
+		if (!param->catalog.pathCatalog.empty()) {
+			refcat_.reset(new ARefCatalog);
+			if (refcat_->Open(param->catalog.pathCatalog.c_str())) {
+				_gLog.Write("catalog [%s] mapped, %lu stars", param->catalog.pathCatalog.c_str(),
+						(unsigned long) refcat_->Header()->nstar);
+			}
+			else {
+				_gLog.Write(LOG_WARN, "failed to open catalog [%s]", param->catalog.pathCatalog.c_str());
+				refcat_.reset();
+			}
+		}
+
 		const ADIReduce::CBResultSlot &slot2 = boost::bind(&ADIWorkFlow::AstrometryResult, this, _1);
 		astrometry_.reset(new AAstrometry(param_));
 		astrometry_->RegisterResult(slot2);
+		astrometry_->SetCatalog(refcat_);
 		thrd_astro_.reset(new boost::thread(boost::bind(&ADIWorkFlow::thread_astro, this)));
 	}
 
+	if (param->funcs.useDiff) {
+		const ADIReduce::CBResultSlot &slot2 = boost::bind(&ADIWorkFlow::DiffResult, this, _1);
+		diff_.reset(new ADiffImage(param_));
+		diff_->RegisterResult(slot2);
+		thrd_diff_.reset(new boost::thread(boost::bind(&ADIWorkFlow::thread_diff, this)));
+	}
+
 	if (param->funcs.usePhotometry || param->funcs.useMotion) {
 		const ADIReduce::CBResultSlot &slot2 = boost::bind(&ADIWorkFlow::PhotometryResult, this, _1);
 		photometry_.reset(new APhotometry(param_));
@@ -60,16 +137,83 @@ bool ADIWorkFlow::Start(Parameter* param) {
 
 void ADIWorkFlow::Stop() {
 	running_ = false;
+	cv_budget_.notify_all();
 
 	interrupt_thread(thrd_reduce_);
 	interrupt_thread(thrd_astro_);
+	interrupt_thread(thrd_diff_);
 	interrupt_thread(thrd_photo_);
 	interrupt_thread(thrd_motion_);
+	// 结果回调在各环节的处理线程中执行, 须在释放资源前结束
+	if (reduce_)     reduce_->Join();
+	if (astrometry_) astrometry_->Join();
+	if (diff_)       diff_->Join();
+	if (photometry_) photometry_->Join();
+	if (motion_)     motion_->Join();
 
 	dequeReduce_.clear();
 	dequeAstro_.clear();
+	dequeDiff_.clear();
 	dequePhoto_.clear();
 	dequeMotion_.clear();
+	ATrace::Instance().Stop();
+	if (interWriter_) {
+		interWriter_->Stop();
+		interWriter_.reset();
+	}
+	if (catWriter_) {// 写入全部待写帧
+		catWriter_->Stop();
+		catWriter_.reset();
+	}
+
+	if (manifest_) {
+		int nskip, nresume;
+		manifest_->GetStat(nskip, nresume);
+		if (nskip || nresume) _gLog.Write("manifest summary: %d frames skipped, %d frames resumed", nskip, nresume);
+	}
+
+	// 各处理队列统计: 平均深度持续增长的环节即瓶颈
+	for (int i = 0; i < QUEUE_MAX; ++i) {
+		const QueueMetric& metric = metric_[i];
+		if (!metric.count) continue;
+		_gLog.Write("queue %-10s: %d frames, depth mean = %.1f, max = %d, memory peak = %.1f MB",
+				queue_names[i], metric.count, metric.depthSum / metric.count, metric.depthMax, metric.memMax / 1048576.0);
+	}
+	if (memPeak_) {
+		_gLog.Write("budget summary: memory peak = %.1f MB, input stalled %.1f ms", memPeak_ / 1048576.0, msStall_);
+	}
+	int nalloc, nreuse;
+	size_t bytes;
+	AFramePool::Instance().GetStat(nalloc, nreuse, bytes);
+	if (nalloc) {
+		_gLog.Write("buffer pool: %d allocations, %d reuses, %.1f MB held", nalloc, nreuse, bytes / 1048576.0);
+	}
+
+	mutex_lock lck(mtx_latency_);
+	if (latency_.size()) {
+		int n = int(latency_.size());
+		std::sort(latency_.begin(), latency_.end());
+		_gLog.Write("latency summary: %d frames, median = %.1f ms, 90%% = %.1f ms, max = %.1f ms",
+				n, latency_[n / 2], latency_[n * 9 / 10], latency_[n - 1]);
+		latency_.clear();
+	}
+	_gLog.Flush();
+}
+
+void ADIWorkFlow::Interrupt() {
+	{
+		mutex_lock lck(mtx_budget_);
+		running_ = false;
+	}
+	cv_budget_.notify_all();
+}
+
+void ADIWorkFlow::BeginInput() {
+	++procCount_;
+}
+
+void ADIWorkFlow::EndInput() {
+	if (!--procCount_ && ios_) ios_->stop();	// 完成处理流程, 退出程序
 }
 
 void ADIWorkFlow::BeginCombine(Parameter* param, int mode) {
@@ -86,7 +230,7 @@ void ADIWorkFlow::EndCombine() {
 	vecCombine_.clear();
 }
 
-void ADIWorkFlow::ProcessImage(const char* filePath) {
+bool ADIWorkFlow::ProcessImage(const char* filePath) {
 	ImgFrmPtr frame;
 	frame.reset(new ImageFrame);
 
@@ -96,88 +240,276 @@ void ADIWorkFlow::ProcessImage(const char* filePath) {
 	frame->pathdir  = pathFull.parent_path().string();
 	frame->filename = pathFull.filename().string();
 	frame->filetit  = pathFull.stem().string();
+	if (manifest_) {
+		int stage = manifest_->Resume(frame);
+		if (stage != STAGE_REDUCE) return resume_frame(frame, stage);
+	}
+	return ProcessImage(frame);
+}
+
+bool ADIWorkFlow::ProcessImage(ImgFrmPtr frame) {
+	// 先计数再等待预算: 等待期间处理流程不会因计数归零而退出
 	++procCount_;
-	if (thrd_astro_.unique())  ++procCount_;
-	if (thrd_photo_.unique())  ++procCount_;
-	if (thrd_motion_.unique()) ++procCount_;
+	if (!budget_enter(frame)) {
+		--procCount_;
+		return false;
+	}
+	frame->tmArrive = std::chrono::steady_clock::now();
 
 	// 加入队列并启动处理流程
 	mutex_lock lck(mtx_frm_reduce_);
 	dequeReduce_.push_back(frame);
+	queue_metric(QUEUE_REDUCE, dequeReduce_);
 	if (!reduce_->IsWorking()) cv_reduce_.notify_one();
+	return true;
+}
+
+void ADIWorkFlow::RegisterFrame(const CBFrameSlot& slot) {
+	if (!cbFrame_.empty()) cbFrame_.disconnect_all_slots();
+	cbFrame_.connect(slot);
 }
 
 /* 回调函数接口 */
 void ADIWorkFlow::DIReduceResult(bool rslt) {
-	--procCount_;
-	if (rslt) {// 处理成功
-		ImgFrmPtr frame = reduce_->GetFrame();
-		if (param_->funcs.useAstrometry || param_->funcs.usePhotometry || param_->funcs.useMotion) {// 后续处理: 触发定位
-			mutex_lock lck(mtx_frm_astro_);
-			dequeAstro_.push_back(frame);
-			cv_astro_.notify_one();
-		}
-		else OutputFrame(frame);
+	ImgFrmPtr frame = reduce_->GetFrame();
+	frame->dataRaw.reset();	// 原始数据仅用于图像处理. 共享内存帧槽在此归还生产者
+	if (rslt) frame->stageDone = STAGE_REDUCE;
+	else frame->stageFail = STAGE_REDUCE;
+	budget_update(frame);
+	if (rslt && (param_->funcs.useAstrometry || param_->funcs.useDiff
+			|| param_->funcs.usePhotometry || param_->funcs.useMotion)) {// 后续处理: 触发定位
+		mutex_lock lck(mtx_frm_astro_);
+		dequeAstro_.push_back(frame);
+		queue_metric(QUEUE_ASTRO, dequeAstro_);
+		cv_astro_.notify_one();
+	}
+	else {
+		OutputFrame(frame);
+		frame_done(frame);
 	}
 	if (dequeReduce_.size()) {// 尝试处理缓存区中其它图像
 		cv_reduce_.notify_one();
 	}
-	else if (!procCount_ && ios_) {// 完成处理流程, 退出程序
-		ios_->stop();
-	}
 }
 
 void ADIWorkFlow::AstrometryResult(bool rslt) {
-	--procCount_;
 	ImgFrmPtr frame = astrometry_->GetFrame();
-	if (rslt && (param_->funcs.usePhotometry || param_->funcs.useMotion)) {// 后续处理: 触发测光
+	if (rslt) frame->stageDone = STAGE_ASTROMETRY;
+	else frame->stageFail = STAGE_ASTROMETRY;
+	budget_update(frame);
+	if (rslt && param_->funcs.useDiff) {// 后续处理: 触发差分
+		mutex_lock lck(mtx_frm_diff_);
+		dequeDiff_.push_back(frame);
+		queue_metric(QUEUE_DIFF, dequeDiff_);
+		cv_diff_.notify_one();
+	}
+	else if (rslt && (param_->funcs.usePhotometry || param_->funcs.useMotion)) {// 后续处理: 触发测光
 		mutex_lock lck(mtx_frm_photo_);
 		dequePhoto_.push_back(frame);
+		queue_metric(QUEUE_PHOTO, dequePhoto_);
 		cv_photo_.notify_one();
 	}
-	else OutputFrame(frame);
+	else {
+		OutputFrame(frame);
+		frame_done(frame);
+	}
 
 	if (dequeAstro_.size()) {// 尝试处理缓存区中其它图像
 		cv_astro_.notify_one();
 	}
-	else if (!procCount_ && ios_) {// 完成处理流程, 退出程序
-		ios_->stop();
+}
+
+void ADIWorkFlow::DiffResult(bool rslt) {
+	ImgFrmPtr frame = diff_->GetFrame();
+	frame->stageDone = STAGE_DIFF;
+	budget_update(frame);
+	if (param_->funcs.usePhotometry || param_->funcs.useMotion) {// 后续处理: 触发测光. 差分失败不影响测光
+		mutex_lock lck(mtx_frm_photo_);
+		dequePhoto_.push_back(frame);
+		queue_metric(QUEUE_PHOTO, dequePhoto_);
+		cv_photo_.notify_one();
+	}
+	else {
+		OutputFrame(frame);
+		frame_done(frame);
+	}
+
+	if (dequeDiff_.size()) {// 尝试处理缓存区中其它图像
+		cv_diff_.notify_one();
 	}
 }
 
 void ADIWorkFlow::PhotometryResult(bool rslt) {
-	--procCount_;
 	ImgFrmPtr frame = photometry_->GetFrame();
+	if (rslt) frame->stageDone = STAGE_PHOTOMETRY;
+	else frame->stageFail = STAGE_PHOTOMETRY;
 	OutputFrame(frame);
 
 	if (rslt && param_->funcs.useMotion) {// 后续处理: 触发运动关联
+		budget_update(frame);
 		mutex_lock lck(mtx_frm_motion_);
 		dequeMotion_.push_back(frame);
+		queue_metric(QUEUE_MOTION, dequeMotion_);
 		cv_motion_.notify_one();
 	}
+	else frame_done(frame);
 	if (dequePhoto_.size()) {// 尝试处理缓存区中其它图像
 		cv_photo_.notify_one();
 	}
-	else if (!procCount_ && ios_) {// 完成处理流程, 退出程序
-		ios_->stop();
-	}
 }
 
 void ADIWorkFlow::MotionResult(bool rslt) {
-	--procCount_;
+	frame_done(motion_->GetFrame());
 	if (dequeMotion_.size()) {// 尝试处理缓存区中其它图像
 		cv_motion_.notify_one();
 	}
-	else if (!procCount_ && ios_) {// 完成处理流程, 退出程序
-		ios_->stop();
-	}
 }
 
 void ADIWorkFlow::OutputFrame(ImgFrmPtr frame) {
-	if (param_->output.rsltFinal) {//...输出目标测量结果
+	if (catWriter_) catWriter_->Push(frame);
+	if (frame->succAstro && !frame->filepath.empty()) {// 输出天文定位结果. 内存数据无对应文件
+		FITSHandlerWCS fitsWcs;
+		int retCode;
+		if (param_->output.wcsAlone) {
+			path pathWcs = path(frame->pathdir) / (frame->filetit + ".wcs");
+			retCode = fitsWcs.SaveAlone(pathWcs.string().c_str(), frame->wcs, frame->wImg, frame->hImg);
+		}
+		else retCode = fitsWcs.UpdateImage(frame->filepath.c_str(), frame->wcs);
+		if (retCode) {
+			_gLog.Write(LOG_FAULT, "[%s]: failed to write WCS, %s", frame->filename.c_str(),
+					retCode == 1 ? "open error" : "write error");
+		}
 	}
-	if (frame->succAstro) {//...输出天文定位结果
+
+	if (manifest_ && !frame->filepath.empty() && !manifest_->Save(frame)) {
+		_gLog.Write(LOG_WARN, "[%s]: failed to write manifest record", frame->filename.c_str());
 	}
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	double ms = std::chrono::duration<double, std::milli>(now - frame->tmArrive).count();
+	if (ATrace::Enabled()) {
+		ATrace::Instance().Record("frame.latency", frame->filename, frame->tmArrive, now);
+		ATrace::Instance().Tick();
+	}
+	_gLog.Write("[%s]: result ready, latency = %.1f ms", frame->filename.c_str(), ms);
+	{
+		mutex_lock lck(mtx_latency_);
+		latency_.push_back(ms);
+	}
+	cbFrame_(frame);
+}
+
+bool ADIWorkFlow::resume_frame(ImgFrmPtr frame, int stage) {
+	frame->tmArrive = std::chrono::steady_clock::now();
+	if (stage == STAGE_MAX) {
+		_gLog.Write("[%s]: results still valid, skipped", frame->filename.c_str());
+		// 输出文件缺失时重新输出
+		if (frame->succAstro && param_->output.wcsAlone
+				&& !exists(path(frame->pathdir) / (frame->filetit + ".wcs")))
+			OutputFrame(frame);
+		else cbFrame_(frame);
+		// 运动关联依赖帧序列: 以恢复的结果重建关联状态
+		if (frame->succPhoto && thrd_motion_.unique()) {
+			++procCount_;
+			if (!budget_enter(frame)) {
+				--procCount_;
+				return false;
+			}
+			mutex_lock lck(mtx_frm_motion_);
+			dequeMotion_.push_back(frame);
+			queue_metric(QUEUE_MOTION, dequeMotion_);
+			cv_motion_.notify_one();
+		}
+		return true;
+	}
+
+	_gLog.Write("[%s]: resumed at %s", frame->filename.c_str(), AManifest::StageName(stage));
+	++procCount_;
+	if (!budget_enter(frame)) {
+		--procCount_;
+		return false;
+	}
+	frame->tmArrive = std::chrono::steady_clock::now();
+
+	if (stage == STAGE_ASTROMETRY) {
+		mutex_lock lck(mtx_frm_astro_);
+		dequeAstro_.push_back(frame);
+		queue_metric(QUEUE_ASTRO, dequeAstro_);
+		cv_astro_.notify_one();
+	}
+	else if (stage == STAGE_DIFF) {
+		mutex_lock lck(mtx_frm_diff_);
+		dequeDiff_.push_back(frame);
+		queue_metric(QUEUE_DIFF, dequeDiff_);
+		cv_diff_.notify_one();
+	}
+	else {
+		mutex_lock lck(mtx_frm_photo_);
+		dequePhoto_.push_back(frame);
+		queue_metric(QUEUE_PHOTO, dequePhoto_);
+		cv_photo_.notify_one();
+	}
+	return true;
+}
+
+bool ADIWorkFlow::budget_enter(ImgFrmPtr frame) {
+	const ParamBudget& budget = param_->budget;
+	size_t memLimit = size_t(budget.memoryMB) << 20;
+	mutex_lock lck(mtx_budget_);
+
+	// 至少允许一帧进入, 避免单帧超出内存预算时死锁
+	if (running_ && inflight_ && ((budget.frames && inflight_ >= int(budget.frames))
+			|| (memLimit && memInflight_ >= memLimit))) {
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		do {
+			cv_budget_.wait_for(lck, boost::chrono::milliseconds(100));
+		} while (running_ && inflight_ && ((budget.frames && inflight_ >= int(budget.frames))
+				|| (memLimit && memInflight_ >= memLimit)));
+		msStall_ += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+	}
+	if (!running_) return false;
+	++inflight_;
+	frame->memCharged = frame->MemoryBytes();
+	memInflight_ += frame->memCharged;
+	if (memInflight_ > memPeak_) memPeak_ = memInflight_;
+	return true;
+}
+
+void ADIWorkFlow::budget_update(ImgFrmPtr frame) {
+	if (!frame->memCharged) return;
+	mutex_lock lck(mtx_budget_);
+	size_t bytes = frame->MemoryBytes();
+	memInflight_ = memInflight_ - frame->memCharged + bytes;
+	frame->memCharged = bytes;
+	if (memInflight_ > memPeak_) memPeak_ = memInflight_;
+}
+
+void ADIWorkFlow::frame_done(ImgFrmPtr frame) {
+	budget_leave(frame);
+	if (!--procCount_ && ios_) ios_->stop();	// 完成处理流程, 退出程序
+}
+
+void ADIWorkFlow::budget_leave(ImgFrmPtr frame) {
+	if (!frame || !frame->memCharged) return;
+	{
+		mutex_lock lck(mtx_budget_);
+		--inflight_;
+		memInflight_ -= frame->memCharged;
+		frame->memCharged = 0;
+	}
+	cv_budget_.notify_all();
+}
+
+void ADIWorkFlow::queue_metric(int queue, const ImgFrmDeque& deq) {
+	QueueMetric& metric = metric_[queue];
+	int depth = int(deq.size());
+	if (ATrace::Enabled()) deq.back()->tmQueue = std::chrono::steady_clock::now();
+	size_t bytes(0);
+	for (ImgFrmDeque::const_iterator it = deq.begin(); it != deq.end(); ++it) bytes += (*it)->memCharged;
+	++metric.count;
+	metric.depthSum += depth;
+	if (depth > metric.depthMax) metric.depthMax = depth;
+	if (bytes > metric.memMax) metric.memMax = bytes;
 }
 
 /* 线程接口 */
@@ -192,7 +524,13 @@ void ADIWorkFlow::thread_reduce() {
 			ImgFrmPtr frame;
 			frame = dequeReduce_.front();
 			dequeReduce_.pop_front();
-			if (!reduce_->DoIt(frame)) --procCount_;
+			if (ATrace::Enabled()) {
+				ATrace::Instance().Record(queue_trace[QUEUE_REDUCE], frame->filename, frame->tmQueue,
+						std::chrono::steady_clock::now());
+			}
+			if (!reduce_->DoIt(frame)) {
+				frame_done(frame);
+			}
 		}
 	}
 }
@@ -209,7 +547,36 @@ void ADIWorkFlow::thread_astro() {
 			ImgFrmPtr frame;
 			frame = dequeAstro_.front();
 			dequeAstro_.pop_front();
-			if (!astrometry_->DoIt(frame)) --procCount_;
+			if (ATrace::Enabled()) {
+				ATrace::Instance().Record(queue_trace[QUEUE_ASTRO], frame->filename, frame->tmQueue,
+						std::chrono::steady_clock::now());
+			}
+			if (!astrometry_->DoIt(frame)) {
+				frame_done(frame);
+			}
+		}
+	}
+}
+
+void ADIWorkFlow::thread_diff() {
+	boost::mutex mtx;
+	mutex_lock lck(mtx);
+
+	while (running_) {
+		cv_diff_.wait(lck);
+
+		while (running_ && !diff_->IsWorking() && dequeDiff_.size()) {
+			mutex_lock lck1(mtx_frm_diff_);
+			ImgFrmPtr frame;
+			frame = dequeDiff_.front();
+			dequeDiff_.pop_front();
+			if (ATrace::Enabled()) {
+				ATrace::Instance().Record(queue_trace[QUEUE_DIFF], frame->filename, frame->tmQueue,
+						std::chrono::steady_clock::now());
+			}
+			if (!diff_->DoIt(frame)) {
+				frame_done(frame);
+			}
 		}
 	}
 }
@@ -226,7 +593,13 @@ void ADIWorkFlow::thread_photo() {
 			ImgFrmPtr frame;
 			frame = dequePhoto_.front();
 			dequePhoto_.pop_front();
-			if (!photometry_->DoIt(frame)) --procCount_;
+			if (ATrace::Enabled()) {
+				ATrace::Instance().Record(queue_trace[QUEUE_PHOTO], frame->filename, frame->tmQueue,
+						std::chrono::steady_clock::now());
+			}
+			if (!photometry_->DoIt(frame)) {
+				frame_done(frame);
+			}
 		}
 	}
 }
@@ -243,7 +616,13 @@ void ADIWorkFlow::thread_motion() {
 			ImgFrmPtr frame;
 			frame = dequeMotion_.front();
 			dequeMotion_.pop_front();
-			if (!motion_->DoIt(frame)) --procCount_;
+			if (ATrace::Enabled()) {
+				ATrace::Instance().Record(queue_trace[QUEUE_MOTION], frame->filename, frame->tmQueue,
+						std::chrono::steady_clock::now());
+			}
+			if (!motion_->DoIt(frame)) {
+				frame_done(frame);
+			}
 		}
 	}
 }
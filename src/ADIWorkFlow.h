@@ -6,6 +6,8 @@
  * 作业流程:
  * - 维护数据处理队列
  * - 维护数据处理线程
+ * - 资源预算: 处理流程中的帧数或内存超出预算时, ProcessImage阻塞直至下游释放,
+ *   从而将下游环节的拥塞反压至数据输入端
  */
 
 #ifndef ADIWORKFLOW_H_
@@ -16,6 +18,8 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
 #include <boost/asio/io_service.hpp>
+#include <boost/signals2.hpp>
+#include <atomic>
 #include <string>
 #include <vector>
 
@@ -23,8 +27,12 @@
 #include "ImageFrame.hpp"
 #include "ADIReduce.h"
 #include "AAstrometry.h"
+#include "ADiffImage.h"
 #include "APhotometry.h"
 #include "AFindPV.h"
+#include "ARefCatalog.h"
+#include "AManifest.h"
+#include "ACatalogWriter.h"
 
 enum {
 	MODE_ZERO = 1,	/// 合并本底
@@ -37,22 +45,68 @@ public:
 	ADIWorkFlow(boost::asio::io_service* ios = NULL);
 	virtual ~ADIWorkFlow();
 
+public:
+	typedef boost::signals2::signal<void (ImgFrmPtr)> CBFrame;	///< 图像帧处理结果回调函数
+	typedef CBFrame::slot_type CBFrameSlot;		///< 图像帧处理结果回调函数插槽
+
 protected:
 	typedef boost::shared_ptr<boost::thread> threadptr;
 	typedef boost::unique_lock<boost::mutex> mutex_lock;
 	typedef std::vector<std::string> strvec;
 
+	enum {// 处理队列
+		QUEUE_REDUCE,	/// 图像处理
+		QUEUE_ASTRO,	/// 天文定位
+		QUEUE_DIFF,		/// 差分成像
+		QUEUE_PHOTO,	/// 测光
+		QUEUE_MOTION,	/// 运动关联
+		QUEUE_MAX
+	};
+
+	/*!
+	 * @struct QueueMetric 处理队列统计, 用于定位瓶颈环节
+	 */
+	struct QueueMetric {
+		int depthMax;		/// 最大队列深度
+		double depthSum;	/// 入队时队列深度之和
+		int count;			/// 入队帧数
+		size_t memMax;		/// 队列中各帧占用内存的峰值, 量纲: 字节
+
+	public:
+		QueueMetric() {
+			depthMax = count = 0;
+			depthSum = 0.0;
+			memMax   = 0;
+		}
+	};
+
 protected:
 	Parameter* param_;	/// 配置参数
 	boost::asio::io_service* ios_;	/// 输入输出接口
 	bool running_;		/// 运行标志
-	int procCount_;		/// 未完成处理过程计数
+	std::atomic<int> procCount_;	/// 处理流程中尚未完成的帧数
+	std::vector<double> latency_;	/// 各帧从进入处理流程至输出结果的延迟, 量纲: 毫秒
+	boost::mutex mtx_latency_;		/// 互斥锁: 延迟统计
+	CBFrame cbFrame_;	/// 图像帧处理结果回调函数
+	/* 资源预算 */
+	int inflight_;			/// 处理流程中的帧数
+	size_t memInflight_;	/// 处理流程中各帧占用的内存, 量纲: 字节
+	size_t memPeak_;		/// 处理流程中各帧占用内存的峰值, 量纲: 字节
+	double msStall_;		/// 因超出预算阻塞输入的累计时间, 量纲: 毫秒
+	boost::mutex mtx_budget_;	/// 互斥锁: 资源预算
+	boost::condition_variable cv_budget_;	/// 事件: 帧离开处理流程
+	QueueMetric metric_[QUEUE_MAX];	/// 各处理队列统计
 
 	/* 数据处理接口 */
 	boost::shared_ptr<ADIReduce>   reduce_;
 	boost::shared_ptr<AAstrometry> astrometry_;
+	boost::shared_ptr<ADiffImage>  diff_;
 	boost::shared_ptr<APhotometry> photometry_;
 	boost::shared_ptr<AFindPV>     motion_;
+	boost::shared_ptr<ARefCatalog> refcat_;	/// 本地参考星表
+	boost::shared_ptr<AManifest>   manifest_;	/// 结果清单
+	boost::shared_ptr<ACatalogWriter> catWriter_;	/// 目标星表输出
+	InterWriterPtr interWriter_;	/// 中间结果输出
 
 	/* 图像合并 */
 	int combine_;	/// 合并模式
@@ -60,20 +114,24 @@ protected:
 	/* 以参与处理流程的数据队列 */
 	ImgFrmDeque dequeReduce_;	/// 图像处理队列
 	ImgFrmDeque dequeAstro_;	/// 天文定位队列
+	ImgFrmDeque dequeDiff_;		/// 差分成像队列
 	ImgFrmDeque dequePhoto_;	/// 天文测光队列
 	ImgFrmDeque dequeMotion_;	/// 运动关联队列
 	boost::mutex mtx_frm_reduce_;	/// 互斥锁: 图像处理队列
 	boost::mutex mtx_frm_astro_;	/// 互斥锁: 天文定位队列
+	boost::mutex mtx_frm_diff_;		/// 互斥锁: 差分成像队列
 	boost::mutex mtx_frm_photo_;	/// 互斥锁: 天文测光队列
 	boost::mutex mtx_frm_motion_;	/// 互斥锁: 运动关联队列
 	/* 以线程实现对不同处理流程的并行 */
 	threadptr thrd_reduce_;		/// 图像处理线程
 	threadptr thrd_astro_;		/// 天文定位线程
+	threadptr thrd_diff_;		/// 差分成像线程
 	threadptr thrd_photo_;		/// 天文测光线程
 	threadptr thrd_motion_;		/// 运动关联线程
 	/* 条件变量触发推动处理流程 */
 	boost::condition_variable cv_reduce_;	/// 事件: 图像处理
 	boost::condition_variable cv_astro_;	/// 事件: 天文定位
+	boost::condition_variable cv_diff_;		/// 事件: 差分成像
 	boost::condition_variable cv_photo_;	/// 事件: 天文测光
 	boost::condition_variable cv_motion_;	/// 事件: 运动关联
 
@@ -89,6 +147,23 @@ public:
 	 * @brief 停止数据处理流程服务
 	 */
 	void Stop();
+	/*!
+	 * @brief 中断数据处理流程
+	 * @note
+	 * 唤醒因超出资源预算而阻塞的ProcessImage, 之后提交的帧不再进入处理流程.
+	 * 可在信号处理等其它线程中调用, 随后由输入线程结束后调用Stop
+	 */
+	void Interrupt();
+	/*!
+	 * @brief 开始连续输入
+	 * @note
+	 * 输入期间处理流程不因已提交的帧全部完成而退出程序. 与EndInput成对调用
+	 */
+	void BeginInput();
+	/*!
+	 * @brief 结束连续输入. 处理流程中已无帧时退出程序
+	 */
+	void EndInput();
 	/*!
 	 * @brief 合并前准备
 	 */
@@ -105,8 +180,29 @@ public:
 	/*!
 	 * @brief 处理单帧图像文件
 	 * @param filePath 文件路径
+	 * @note
+	 * 调用时刻视为图像到达时刻. 守护模式下由目录监视在文件写入完成时调用.
+	 * 启用结果清单时, 跳过仍然有效的处理环节
+	 * @return
+	 * 处理流程已中断时返回false
+	 */
+	bool ProcessImage(const char* filePath);
+	/*!
+	 * @brief 处理单帧图像
+	 * @param frame  图像帧. 由调用者填充文件路径或内存数据(dataRaw及尺寸、曝光时间)
+	 * @note
+	 * 超出资源预算时阻塞, 直至处理流程中的帧离开或处理流程中断
+	 * @return
+	 * 处理流程已中断时返回false, 帧未进入处理流程
+	 */
+	bool ProcessImage(ImgFrmPtr frame);
+	/*!
+	 * @brief 注册图像帧处理结果回调函数
+	 * @param slot 函数插槽
+	 * @note
+	 * 每帧调用一次, 包括处理失败的帧. 在处理线程中执行
 	 */
-	void ProcessImage(const char* filePath);
+	void RegisterFrame(const CBFrameSlot& slot);
 
 protected:
 	/*!
@@ -119,6 +215,11 @@ protected:
 	 * @param rslt  天文定位结果
 	 */
 	void AstrometryResult(bool rslt);
+	/*!
+	 * @brief 差分成像回调函数
+	 * @param rslt  差分处理结果
+	 */
+	void DiffResult(bool rslt);
 	/*!
 	 * @brief 天文测光回调函数
 	 * @param rslt  测光处理结果
@@ -134,6 +235,38 @@ protected:
 	 * @param frame  图像帧
 	 */
 	void OutputFrame(ImgFrmPtr frame);
+	/*!
+	 * @brief 从结果清单恢复的图像帧进入处理流程
+	 * @param frame  图像帧
+	 * @param stage  继续处理的环节. STAGE_MAX: 无需处理
+	 * @return
+	 * 处理流程已中断时返回false
+	 */
+	bool resume_frame(ImgFrmPtr frame, int stage);
+	/*!
+	 * @brief 帧完成或提前结束处理流程. 流程中已无帧时退出程序
+	 * @note
+	 * 按帧计数, 任一环节失败后跳过的后续环节无需另行扣减
+	 */
+	void frame_done(ImgFrmPtr frame);
+	/*!
+	 * @brief 帧进入处理流程. 超出预算时等待
+	 * @return
+	 * 处理流程已中断时返回false, 帧未计入预算
+	 */
+	bool budget_enter(ImgFrmPtr frame);
+	/*!
+	 * @brief 按帧当前占用的内存更新预算
+	 */
+	void budget_update(ImgFrmPtr frame);
+	/*!
+	 * @brief 帧离开处理流程, 唤醒等待的输入
+	 */
+	void budget_leave(ImgFrmPtr frame);
+	/*!
+	 * @brief 统计入队后的队列深度和内存. 在持有队列互斥锁时调用
+	 */
+	void queue_metric(int queue, const ImgFrmDeque& deq);
 
 protected:
 	/* 线程接口 */
@@ -145,6 +278,10 @@ protected:
 	 * @brief 线程: 天文定位
 	 */
 	void thread_astro();
+	/*!
+	 * @brief 线程: 差分成像
+	 */
+	void thread_diff();
 	/*!
 	 * @brief 线程: 流量定标/较差测光
 	 */
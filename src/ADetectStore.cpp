@@ -0,0 +1,337 @@
+/*!
+ * @class ADetectStore 整夜检测结果库: 只追加写入, 以内存映射方式检索
+ * @version 0.1
+ * @date 2021-05
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "ADetectStore.h"
+#include "Healpix.hpp"
+#include "GLog.h"
+
+using std::vector;
+
+#define DEG2RAD	0.017453292519943295	/// 角度转换为弧度
+
+ADetectStore::ADetectStore() {
+	fd_    = -1;
+	addr_  = NULL;
+	size_  = 0;
+	order_ = 0;
+	nrow_  = 0;
+	fdAppend_ = -1;
+	orderAppend_ = 0;
+	frames_   = 0;
+}
+
+ADetectStore::~ADetectStore() {
+	Close();
+	CloseAppend();
+}
+
+bool ADetectStore::Open(const char* filepath) {
+	Close();
+	if ((fd_ = open(filepath, O_RDONLY)) < 0) return false;
+	if (!Refresh()) {
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool ADetectStore::Refresh() {
+	struct stat st;
+
+	if (fd_ < 0 || fstat(fd_, &st) || size_t(st.st_size) < sizeof(DetStoreHeader)) return false;
+	if (addr_ && size_t(st.st_size) == size_) return true;
+	if (addr_) munmap(addr_, size_);
+	segs_.clear();
+	nrow_ = 0;
+	size_ = st.st_size;
+	addr_ = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd_, 0);
+	if (addr_ == MAP_FAILED) {
+		addr_ = NULL;
+		size_ = 0;
+		return false;
+	}
+
+	const DetStoreHeader* header = (const DetStoreHeader*) addr_;
+	if (memcmp(header->magic, DET_STORE_MAGIC, 8) || header->version != DET_STORE_VERSION || header->order > 13) {
+		munmap(addr_, size_);
+		addr_ = NULL;
+		size_ = 0;
+		return false;
+	}
+	order_ = int(header->order);
+	scan((const char*) addr_, size_, &segs_);
+	for (vector<Segment>::iterator it = segs_.begin(); it != segs_.end(); ++it) nrow_ += it->header->nrow;
+	return true;
+}
+
+void ADetectStore::Close() {
+	if (addr_) munmap(addr_, size_);
+	if (fd_ >= 0) close(fd_);
+	fd_   = -1;
+	addr_ = NULL;
+	size_ = 0;
+	nrow_ = 0;
+	segs_.clear();
+}
+
+size_t ADetectStore::FrameCount() const {
+	return segs_.size();
+}
+
+uint64_t ADetectStore::RowCount() const {
+	return nrow_;
+}
+
+const DetSegmentHeader* ADetectStore::Frame(size_t i) const {
+	return i < segs_.size() ? segs_[i].header : NULL;
+}
+
+size_t ADetectStore::ConeSearch(double ra, double dec, double radius, double mjd0, double mjd1,
+		vector<DetRecord>& rows) const {
+	if (!addr_) return 0;
+
+	/*!
+	 * 检索区覆盖的天区按层级遍历, 以存储阶数的天区编号区间表示.
+	 * NESTED编号下, 低阶天区对应高阶天区的连续区间; 完全位于锥形内的天区无需逐条检查
+	 */
+	struct Node {
+		int order;
+		uint64_t pix;
+	};
+	struct Range {
+		uint64_t lo, hi;
+		bool inside;
+	};
+	vector<Node> stack;
+	vector<Range> ranges;
+	Node node;
+	double a(ra * DEG2RAD), d(dec * DEG2RAD), r(radius * DEG2RAD);
+	double cx(cos(d) * cos(a)), cy(cos(d) * sin(a)), cz(sin(d)), cosr(cos(r));
+	double z, phi, s, dist, pixrad;
+	size_t n0 = rows.size();
+	int j;
+
+	for (node.order = 0, node.pix = 0; node.pix < 12; ++node.pix) stack.push_back(node);
+	while (stack.size()) {
+		node = stack.back();
+		stack.pop_back();
+		Healpix::pix2loc(node.order, node.pix, z, phi);
+		s      = sqrt((1.0 - z) * (1.0 + z));
+		dist   = acos(std::max(-1.0, std::min(1.0, s * cos(phi) * cx + s * sin(phi) * cy + z * cz)));
+		pixrad = Healpix::max_pixrad(node.order);
+		if (dist > r + pixrad) continue;
+		bool inside = dist + pixrad <= r;
+		if (!inside && node.order < order_) {// 进入下一阶
+			Node child;
+			child.order = node.order + 1;
+			for (j = 0; j < 4; ++j) {
+				child.pix = (node.pix << 2) + j;
+				stack.push_back(child);
+			}
+			continue;
+		}
+		Range range;
+		int shift = 2 * (order_ - node.order);
+		range.lo = node.pix << shift;
+		range.hi = (node.pix + 1) << shift;
+		range.inside = inside;
+		ranges.push_back(range);
+	}
+	std::sort(ranges.begin(), ranges.end(), [](const Range& x, const Range& y) {
+		return x.lo < y.lo;
+	});
+
+	for (vector<Segment>::const_iterator seg = segs_.begin(); seg != segs_.end(); ++seg) {
+		const DetSegmentHeader* header = seg->header;
+		if (header->mjd < mjd0 || header->mjd > mjd1 || !header->ntile) continue;
+		const DetTileEntry* tile0 = seg->tiles;
+		const DetTileEntry* tile1 = seg->tiles + header->ntile;
+		const DetTileEntry* tile = tile0;
+		for (vector<Range>::iterator it = ranges.begin(); it != ranges.end() && tile != tile1; ++it) {
+			// 区间升序, 查找起点不回退
+			tile = std::lower_bound(tile, tile1, it->lo, [](const DetTileEntry& e, uint64_t v) {
+				return e.tile < v;
+			});
+			for (; tile != tile1 && tile->tile < it->hi; ++tile) {
+				const DetRecord* row  = seg->rows + tile->start;
+				const DetRecord* row1 = row + tile->count;
+				for (; row != row1; ++row) {
+					if (!it->inside) {
+						double cd = cos(row->dec * DEG2RAD);
+						double sx = cd * cos(row->ra * DEG2RAD);
+						double sy = cd * sin(row->ra * DEG2RAD);
+						double sz = sin(row->dec * DEG2RAD);
+						if (sx * cx + sy * cy + sz * cz < cosr) continue;
+					}
+					rows.push_back(*row);
+				}
+			}
+		}
+	}
+
+	return rows.size() - n0;
+}
+
+size_t ADetectStore::TimeSearch(double mjd0, double mjd1, vector<DetRecord>& rows) const {
+	size_t n0 = rows.size();
+	for (vector<Segment>::const_iterator seg = segs_.begin(); seg != segs_.end(); ++seg) {
+		const DetSegmentHeader* header = seg->header;
+		if (header->mjd >= mjd0 && header->mjd <= mjd1) rows.insert(rows.end(), seg->rows, seg->rows + header->nrow);
+	}
+	return rows.size() - n0;
+}
+
+size_t ADetectStore::scan(const char* base, size_t size, vector<Segment>* segs) {
+	size_t pos = sizeof(DetStoreHeader);
+	while (pos + sizeof(DetSegmentHeader) <= size) {
+		const DetSegmentHeader* header = (const DetSegmentHeader*) (base + pos);
+		uint64_t bytes = sizeof(DetSegmentHeader) + uint64_t(header->ntile) * sizeof(DetTileEntry)
+				+ uint64_t(header->nrow) * sizeof(DetRecord);
+		if (memcmp(header->magic, DET_SEGMENT_MAGIC, 4) || header->bytes != bytes || pos + bytes > size) break;
+		if (segs) {
+			Segment seg;
+			seg.header = header;
+			seg.tiles  = (const DetTileEntry*) (header + 1);
+			seg.rows   = (const DetRecord*) (seg.tiles + header->ntile);
+			segs->push_back(seg);
+		}
+		pos += bytes;
+	}
+	return pos;
+}
+
+bool ADetectStore::OpenAppend(const char* filepath, int order) {
+	struct stat st;
+
+	CloseAppend();
+	frames_ = 0;
+	if ((fdAppend_ = open(filepath, O_RDWR | O_CREAT, 0644)) < 0) return false;
+	if (fstat(fdAppend_, &st)) {
+		CloseAppend();
+		return false;
+	}
+	if (st.st_size == 0) {// 新文件
+		DetStoreHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, DET_STORE_MAGIC, 8);
+		header.version = DET_STORE_VERSION;
+		header.order   = uint32_t(std::max(0, std::min(13, order)));
+		orderAppend_   = int(header.order);
+		if (write(fdAppend_, &header, sizeof(header)) != ssize_t(sizeof(header))) {
+			CloseAppend();
+			return false;
+		}
+		return true;
+	}
+
+	// 已有文件: 校验文件头, 统计帧数, 截去不完整的末段
+	size_t size = st.st_size, good(0);
+	void* addr = size >= sizeof(DetStoreHeader) ? mmap(NULL, size, PROT_READ, MAP_SHARED, fdAppend_, 0) : MAP_FAILED;
+	if (addr != MAP_FAILED) {
+		const DetStoreHeader* header = (const DetStoreHeader*) addr;
+		if (!memcmp(header->magic, DET_STORE_MAGIC, 8) && header->version == DET_STORE_VERSION) {
+			vector<Segment> segs;
+			good = scan((const char*) addr, size, &segs);
+			orderAppend_ = int(header->order);
+			for (vector<Segment>::iterator it = segs.begin(); it != segs.end(); ++it) {
+				frames_ = std::max(frames_, it->header->frame);
+			}
+		}
+		munmap(addr, size);
+	}
+	if (!good) {
+		_gLog.Write(LOG_FAULT, "[%s] is not a compatible detection store", filepath);
+		CloseAppend();
+		return false;
+	}
+	if (good < size) {
+		_gLog.Write(LOG_WARN, "[%s]: truncating incomplete segment at %lu", filepath, (unsigned long) good);
+		if (ftruncate(fdAppend_, off_t(good))) {}
+	}
+	lseek(fdAppend_, off_t(good), SEEK_SET);
+	return true;
+}
+
+bool ADetectStore::Append(const char* name, double mjd, vector<DetRecord>& rows) {
+	if (fdAppend_ < 0) return false;
+
+	int order = orderAppend_;
+	size_t n = rows.size(), i, ntile(0);
+	uint32_t frame = frames_ + 1;
+	vector<uint64_t> tileOf(n);
+	vector<size_t> idx(n);
+
+	for (i = 0; i < n; ++i) {
+		double d = rows[i].dec * DEG2RAD;
+		tileOf[i] = Healpix::loc2pix(order, sin(d), rows[i].ra * DEG2RAD);
+		idx[i]    = i;
+	}
+	std::sort(idx.begin(), idx.end(), [&tileOf](size_t i1, size_t i2) {
+		return tileOf[i1] < tileOf[i2];
+	});
+	for (i = 0; i < n; ++i) {
+		if (!i || tileOf[idx[i]] != tileOf[idx[i - 1]]) ++ntile;
+	}
+
+	// 段在内存中组装后一次写入
+	size_t bytes = sizeof(DetSegmentHeader) + ntile * sizeof(DetTileEntry) + n * sizeof(DetRecord);
+	buff_.assign(bytes, 0);
+	DetSegmentHeader* seg = (DetSegmentHeader*) buff_.data();
+	DetTileEntry* tile    = (DetTileEntry*) (seg + 1);
+	DetRecord* row        = (DetRecord*) (tile + ntile);
+	memcpy(seg->magic, DET_SEGMENT_MAGIC, 4);
+	seg->frame = frame;
+	seg->mjd   = mjd;
+	seg->nrow  = uint32_t(n);
+	seg->ntile = uint32_t(ntile);
+	seg->bytes = bytes;
+	strncpy(seg->name, name, sizeof(seg->name) - 1);
+	--tile;
+	for (i = 0; i < n; ++i, ++row) {
+		if (!i || tileOf[idx[i]] != tileOf[idx[i - 1]]) {
+			++tile;
+			tile->tile  = tileOf[idx[i]];
+			tile->start = uint32_t(i);
+		}
+		++tile->count;
+		*row = rows[idx[i]];
+		row->frame = frame;
+		row->mjd   = mjd;
+	}
+
+	const char* ptr = buff_.data();
+	off_t start = lseek(fdAppend_, 0, SEEK_CUR);
+	while (bytes) {
+		ssize_t nw = write(fdAppend_, ptr, bytes);
+		if (nw <= 0) {// 撤销不完整的段
+			_gLog.Write(LOG_FAULT, "failed to append to detection store");
+			if (ftruncate(fdAppend_, start)) {}
+			lseek(fdAppend_, start, SEEK_SET);
+			return false;
+		}
+		ptr   += nw;
+		bytes -= size_t(nw);
+	}
+	++frames_;
+	return true;
+}
+
+bool ADetectStore::Appending() const {
+	return fdAppend_ >= 0;
+}
+
+void ADetectStore::CloseAppend() {
+	if (fdAppend_ >= 0) close(fdAppend_);
+	fdAppend_ = -1;
+}
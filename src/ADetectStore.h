@@ -0,0 +1,188 @@
+/*!
+ * @class ADetectStore 整夜检测结果库: 只追加写入, 以内存映射方式检索
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * 文件格式:
+ * - 文件头之后为连续的帧段. 每帧一个段, 段内记录按HEALPix(NESTED)天区排序
+ * - 段: 段头(标识、帧序号、曝光中间时刻、记录数、天区数、文件名、长度), 天区目录(天区编号、起始记录、记录数), 记录
+ * - 时间检索以段头时刻筛选; 锥形检索由检索区覆盖的天区区间在各段天区目录中二分查找
+ * - 打开追加时截去不完整的末段. 写入方只追加, 检索方可在文件增长后调用Refresh重新映射
+ */
+
+#ifndef ADETECTSTORE_H_
+#define ADETECTSTORE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#define DET_STORE_MAGIC		"ADIPSDET"	/// 检测库文件标识
+#define DET_STORE_VERSION	1			/// 检测库文件版本
+#define DET_SEGMENT_MAGIC	"DSEG"		/// 帧段标识
+
+/*!
+ * @struct DetStoreHeader 检测库文件头
+ */
+struct DetStoreHeader {
+	char magic[8];		/// 文件标识
+	uint32_t version;	/// 版本
+	uint32_t order;		/// HEALPix阶数
+};
+
+/*!
+ * @struct DetSegmentHeader 帧段头
+ */
+struct DetSegmentHeader {
+	char magic[4];		/// 标识
+	uint32_t frame;		/// 帧序号, 从1开始
+	double mjd;			/// 曝光中间时刻, 修正儒略日
+	uint32_t nrow;		/// 记录数
+	uint32_t ntile;		/// 天区数
+	char name[64];		/// 文件名(不含扩展名)
+	uint64_t bytes;		/// 段长度, 含段头
+};
+
+/*!
+ * @struct DetTileEntry 天区目录项
+ */
+struct DetTileEntry {
+	uint64_t tile;		/// 天区编号
+	uint32_t start;		/// 段内起始记录
+	uint32_t count;		/// 记录数
+};
+
+/*!
+ * @struct DetRecord 检测记录
+ */
+struct DetRecord {
+	double ra, dec;		/// 赤道坐标, 量纲: 角度
+	double mjd;			/// 曝光中间时刻, 修正儒略日
+	float x, y;			/// 像素坐标
+	float flux;			/// 积分流量
+	float snr;			/// 信噪比
+	uint32_t frame;		/// 帧序号
+	int32_t type;		/// 匹配类型, 见CelestialBody
+};
+
+class ADetectStore {
+public:
+	ADetectStore();
+	virtual ~ADetectStore();
+
+protected:
+	/*!
+	 * @struct Segment 已映射的帧段
+	 */
+	struct Segment {
+		const DetSegmentHeader* header;
+		const DetTileEntry* tiles;
+		const DetRecord* rows;
+	};
+
+protected:
+	/* 检索 */
+	int fd_;			/// 文件描述符
+	void* addr_;		/// 内存映射地址
+	size_t size_;		/// 映射长度
+	int order_;			/// HEALPix阶数
+	std::vector<Segment> segs_;	/// 帧段
+	uint64_t nrow_;		/// 记录总数
+	/* 追加 */
+	int fdAppend_;		/// 追加写入的文件描述符
+	int orderAppend_;	/// 追加文件的HEALPix阶数
+	uint32_t frames_;	/// 已写入的帧数
+	std::vector<char> buff_;	/// 段缓冲区
+
+public:
+	/*!
+	 * @brief 以内存映射方式打开检测库, 用于检索
+	 * @param filepath 文件路径
+	 * @return
+	 * 打开结果
+	 */
+	bool Open(const char* filepath);
+	/*!
+	 * @brief 文件增长后重新映射
+	 */
+	bool Refresh();
+	/*!
+	 * @brief 关闭检测库
+	 */
+	void Close();
+	/*!
+	 * @brief 帧数
+	 */
+	size_t FrameCount() const;
+	/*!
+	 * @brief 记录总数
+	 */
+	uint64_t RowCount() const;
+	/*!
+	 * @brief 查看帧段头
+	 * @param i  段索引
+	 */
+	const DetSegmentHeader* Frame(size_t i) const;
+	/*!
+	 * @brief 锥形检索
+	 * @param ra      中心赤经, 量纲: 角度
+	 * @param dec     中心赤纬, 量纲: 角度
+	 * @param radius  半径, 量纲: 角度
+	 * @param mjd0    起始时刻, 修正儒略日
+	 * @param mjd1    结束时刻, 修正儒略日
+	 * @param rows    检索结果, 追加在已有数据之后. 按帧排列
+	 * @return
+	 * 本次检索得到的记录数
+	 */
+	size_t ConeSearch(double ra, double dec, double radius, double mjd0, double mjd1,
+			std::vector<DetRecord>& rows) const;
+	/*!
+	 * @brief 时间检索
+	 * @param mjd0  起始时刻, 修正儒略日
+	 * @param mjd1  结束时刻, 修正儒略日
+	 * @param rows  检索结果, 追加在已有数据之后
+	 * @return
+	 * 本次检索得到的记录数
+	 */
+	size_t TimeSearch(double mjd0, double mjd1, std::vector<DetRecord>& rows) const;
+
+public:
+	/*!
+	 * @brief 打开或创建检测库, 用于追加写入
+	 * @param filepath  文件路径
+	 * @param order     HEALPix阶数. 打开已有文件时以文件为准
+	 * @return
+	 * 打开结果
+	 */
+	bool OpenAppend(const char* filepath, int order);
+	/*!
+	 * @brief 检查是否已打开用于追加写入
+	 */
+	bool Appending() const;
+	/*!
+	 * @brief 追加一帧
+	 * @param name  文件名(不含扩展名)
+	 * @param mjd   曝光中间时刻
+	 * @param rows  记录. 帧序号和时刻由本函数填写; 记录按天区重新排序
+	 * @return
+	 * 写入结果
+	 */
+	bool Append(const char* name, double mjd, std::vector<DetRecord>& rows);
+	/*!
+	 * @brief 关闭追加写入
+	 */
+	void CloseAppend();
+
+protected:
+	/*!
+	 * @brief 校验并登记帧段
+	 * @param base   文件起始地址
+	 * @param size   文件长度
+	 * @param segs   帧段
+	 * @return
+	 * 完整帧段的结束偏移量
+	 */
+	static size_t scan(const char* base, size_t size, std::vector<Segment>* segs);
+};
+
+#endif /* ADETECTSTORE_H_ */
@@ -0,0 +1,163 @@
+/*!
+ * @class ADiffImage 差分成像: 扣除同一视场的参考图像, 探测暂现源和变源
+ * @version 0.1
+ * @date 2021-05
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <boost/filesystem.hpp>
+#include "ADiffImage.h"
+#include "GLog.h"
+
+using namespace boost::filesystem;
+
+ADiffImage::ADiffImage(Parameter* param)
+	: ADIProcess(param) {
+	nameFunc_ = "difference imaging";
+	nameStage_ = "diff";
+	nFrame_ = nNew_ = nVar_ = 0;
+	scan_reference();
+}
+
+ADiffImage::~ADiffImage() {
+	for (DiffFieldVec::iterator it = fields_.begin(); it != fields_.end(); ++it) {
+		if (it->subtract->CombineCount()) {
+			_gLog.Write(LOG_WARN, "reference [%s] discarded with %d frames", it->filepath.c_str(),
+					it->subtract->CombineCount());
+		}
+	}
+	if (nFrame_) _gLog.Write("difference imaging summary: %d frames, %d new, %d variable", nFrame_, nNew_, nVar_);
+}
+
+bool ADiffImage::do_real_process() {
+	if (!frame_->succAstro || !frame_->dataSub) return false;
+	if (param_->diff.pathRef.empty()) {
+		release_data();
+		return false;
+	}
+
+	DiffField& fld = field();
+	AImageSubtract* subtract = fld.subtract.get();
+	const float* data = frame_->dataSub.get();
+	unsigned w(frame_->wImg), h(frame_->hImg);
+
+	if (!subtract->IsOpen()) {// 合并参考图像
+		if (!subtract->CombineCount()) subtract->BeginCombine(w, h, frame_->wcs);
+		int n = subtract->AddCombine(data, w, h, frame_->wcs);
+		_gLog.Write("[%s]: reference frame %d / %u", frame_->filename.c_str(), n, param_->diff.refFrames);
+		if (n >= int(param_->diff.refFrames)) {
+			if (subtract->EndCombine(fld.filepath.c_str())) {
+				_gLog.Write("reference [%s] created from %d frames, FWHM = %.2f", fld.filepath.c_str(),
+						n, subtract->Header()->fwhm);
+			}
+			else _gLog.Write(LOG_FAULT, "failed to write reference [%s]", fld.filepath.c_str());
+		}
+		release_data();
+		return true;
+	}
+
+	DiffSrcVec& diffs = frame_->diffs;
+	if (subtract->Subtract(data, w, h, frame_->wcs, frame_->bkSigma, diffs) < 0) {
+		release_data();
+		return false;
+	}
+
+	// 赤道坐标及分类统计
+	int n(int(diffs.size())), i, nnew(0), nvar(0);
+	bufX_.resize(n);
+	bufY_.resize(n);
+	bufRA_.resize(n);
+	bufDC_.resize(n);
+	for (i = 0; i < n; ++i) {
+		bufX_[i] = diffs[i].ptCenter.x;
+		bufY_[i] = diffs[i].ptCenter.y;
+	}
+	frame_->wcs.PixelToSky(n, bufX_.data(), bufY_.data(), bufRA_.data(), bufDC_.data());
+	for (i = 0; i < n; ++i) {
+		diffs[i].ptEquator.x = bufRA_[i];
+		diffs[i].ptEquator.y = bufDC_[i];
+		if (diffs[i].type == 1) ++nnew;
+		else ++nvar;
+	}
+	++nFrame_;
+	nNew_ += nnew;
+	nVar_ += nvar;
+
+	double fwhm, fwhmRef, scale, ms;
+	bool reuse;
+	ms = subtract->LastStat(fwhm, fwhmRef, scale, reuse);
+	_gLog.Write("[%s]: %d residual sources, %d new, %d variable. FWHM = %.2f, reference = %.2f, scale = %.3f, %.1f ms%s",
+			frame_->filename.c_str(), n, nnew, nvar, fwhm, fwhmRef, scale, ms,
+			reuse ? ", aligned reference reused" : "");
+	release_data();
+
+	return true;
+}
+
+void ADiffImage::scan_reference() {
+	const string& dir = param_->diff.pathRef;
+	if (dir.empty()) {
+		_gLog.Write(LOG_WARN, "reference directory is not specified, difference imaging is disabled");
+		return;
+	}
+	if (!exists(dir)) {
+		boost::system::error_code ec;
+		create_directories(dir, ec);
+		if (ec) _gLog.Write(LOG_FAULT, "failed to create reference directory [%s]", dir.c_str());
+		return;
+	}
+
+	for (directory_iterator x = directory_iterator(dir); x != directory_iterator(); ++x) {
+		if (x->path().extension().string() != ".ref") continue;
+		DiffField fld;
+		fld.subtract.reset(new AImageSubtract(&param_->diff));
+		fld.filepath = x->path().string();
+		if (!fld.subtract->Open(fld.filepath.c_str())) {
+			_gLog.Write(LOG_WARN, "invalid reference [%s]", fld.filepath.c_str());
+			continue;
+		}
+		const RefImageHeader* header = fld.subtract->Header();
+		fld.wImg = header->width;
+		fld.hImg = header->height;
+		header->wcs.PixelToSky(fld.wImg * 0.5, fld.hImg * 0.5, fld.ra, fld.dc);
+		fld.radius = sqrt(double(fld.wImg) * fld.wImg + double(fld.hImg) * fld.hImg)
+				* 0.5 * header->wcs.Scale() / 3600.0;
+		fields_.push_back(fld);
+	}
+	_gLog.Write("%d reference images mapped from [%s]", int(fields_.size()), dir.c_str());
+}
+
+ADiffImage::DiffField& ADiffImage::field() {
+	double ra1(frame_->coordCenter.x * D2R), dc1(frame_->coordCenter.y * D2R), ra0, dc0, cosd;
+
+	// 同尺寸且视场中心偏差小于容差
+	for (DiffFieldVec::iterator it = fields_.begin(); it != fields_.end(); ++it) {
+		if (it->wImg != frame_->wImg || it->hImg != frame_->hImg) continue;
+		ra0  = it->ra * D2R;
+		dc0  = it->dc * D2R;
+		cosd = sin(dc0) * sin(dc1) + cos(dc0) * cos(dc1) * cos(ra1 - ra0);
+		if (acos(std::min(1.0, cosd)) * R2D < param_->diff.fieldTol * it->radius) return *it;
+	}
+
+	char name[80];
+	sprintf(name, "ref_%08.4f%+08.4f_%ux%u.ref", frame_->coordCenter.x, frame_->coordCenter.y,
+			frame_->wImg, frame_->hImg);
+	DiffField fld;
+	fld.subtract.reset(new AImageSubtract(&param_->diff));
+	fld.filepath = (path(param_->diff.pathRef) / name).string();
+	fld.wImg   = frame_->wImg;
+	fld.hImg   = frame_->hImg;
+	fld.ra     = frame_->coordCenter.x;
+	fld.dc     = frame_->coordCenter.y;
+	fld.radius = sqrt(double(fld.wImg) * fld.wImg + double(fld.hImg) * fld.hImg)
+			* 0.5 * frame_->wcs.Scale() / 3600.0;
+	fields_.push_back(fld);
+	_gLog.Write("[%s]: new field, reference [%s] to be combined from %u frames", frame_->filename.c_str(),
+			fld.filepath.c_str(), param_->diff.refFrames);
+	return fields_.back();
+}
+
+void ADiffImage::release_data() {
+	if (!(param_->funcs.useMotion && param_->synTrack.enable)) frame_->dataSub.reset();
+}
@@ -0,0 +1,64 @@
+/*!
+ * @class ADiffImage 差分成像: 扣除同一视场的参考图像, 探测暂现源和变源
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * - 天文定位后执行. 以图像尺寸和视场中心匹配参考图像目录中的参考图像
+ * - 视场无参考图像时, 以该视场最初的若干帧合并生成参考图像并写入参考图像目录
+ * - 对齐、PSF匹配、相减和残差源探测见AImageSubtract. 残差源记录于ImageFrame::diffs
+ */
+
+#ifndef ADIFFIMAGE_H_
+#define ADIFFIMAGE_H_
+
+#include "ADIProcess.h"
+#include "AImageSubtract.h"
+
+class ADiffImage : public ADIProcess {
+public:
+	ADiffImage(Parameter* param);
+	virtual ~ADiffImage();
+
+protected:
+	typedef boost::shared_ptr<AImageSubtract> SubtractPtr;
+	/*!
+	 * @struct DiffField 视场及其参考图像
+	 */
+	struct DiffField {
+		SubtractPtr subtract;	/// 参考图像与差分算法
+		string filepath;		/// 参考图像文件路径
+		unsigned wImg, hImg;	/// 图像尺寸
+		double ra, dc;			/// 视场中心, 量纲: 角度
+		double radius;			/// 视场半径, 量纲: 角度
+	};
+	typedef std::vector<DiffField> DiffFieldVec;
+
+protected:
+	DiffFieldVec fields_;	/// 视场
+	std::vector<double> bufX_, bufY_;	/// 批量坐标转换缓存区: 像素坐标
+	std::vector<double> bufRA_, bufDC_;	/// 批量坐标转换缓存区: 赤道坐标
+	/* 统计 */
+	int nFrame_;		/// 完成差分的帧数
+	int nNew_;			/// 新出现的残差源数量
+	int nVar_;			/// 变亮或变暗的残差源数量
+
+protected:
+	/*!
+	 * @brief 在多进程模式下执行真正的处理流程
+	 */
+	bool do_real_process();
+	/*!
+	 * @brief 映射参考图像目录中已有的参考图像
+	 */
+	void scan_reference();
+	/*!
+	 * @brief 查找或建立当前帧所属的视场
+	 */
+	DiffField& field();
+	/*!
+	 * @brief 释放扣除背景后的图像数据. 启用合成跟踪时由运动关联释放
+	 */
+	void release_data();
+};
+
+#endif /* ADIFFIMAGE_H_ */
@@ -4,17 +4,186 @@
  * @date 2021-04
  */
 
+#include <stdio.h>
+#include <math.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
 #include "AFindPV.h"
+#include "GLog.h"
+
+using namespace boost::posix_time;
 
 AFindPV::AFindPV(Parameter* param)
 	: ADIProcess(param) {
 	nameFunc_ = "finding motion objects";
+	nameStage_ = "motion";
+	nTracklet_ = 0;
 }
 
 AFindPV::~AFindPV() {
-
+	for (PVSeqMap::iterator it = seqs_.begin(); it != seqs_.end(); ++it) {
+		it->second.linker->Flush();
+		report(it->second);
+	}
+	if (nTracklet_) _gLog.Write("motion summary: %d tracklets", nTracklet_);
 }
 
 bool AFindPV::do_real_process() {
+	if (!frame_->succAstro) return false;
+
+	// 曝光中间时刻
+	double t;
+	try {
+		ptime tmobs = from_iso_extended_string(frame_->dateobs);
+		t = (tmobs - ptime(boost::gregorian::date(1970, 1, 1))).total_microseconds() * 1E-6
+				+ frame_->expdur * 0.5;
+	}
+	catch(std::exception& ex) {
+		_gLog.Write(LOG_WARN, "[%s]: invalid DATE-OBS <%s>", frame_->filename.c_str(), frame_->dateobs.c_str());
+		return false;
+	}
+
+	// 投影至序列的公共切平面
+	PVSequence& seq = sequence(t);
+	CeleBodyVec& bodies = frame_->bodies;
+	int n(int(bodies.size())), i, nmove(0), nnew, ntr;
+	bufRA_.resize(n);
+	bufDC_.resize(n);
+	bufX_.resize(n);
+	bufY_.resize(n);
+	status_.resize(n);
+	for (i = 0; i < n; ++i) {
+		bufRA_[i] = bodies[i].ptEquator.x;
+		bufDC_[i] = bodies[i].ptEquator.y;
+	}
+	seq.plane.SkyToPixel(n, bufRA_.data(), bufDC_.data(), bufX_.data(), bufY_.data());
+
+	nnew = seq.linker->AddFrame(t, n, bufX_.data(), bufY_.data(), status_.data());
+	for (i = 0; i < n; ++i) {
+		if (status_[i] == PV_STATIC) bodies[i].type = 1;
+		else if (status_[i] == PV_MOVING) {
+			bodies[i].type = 2;
+			++nmove;
+		}
+	}
+	double ms = seq.linker->LastStat(ntr);
+	_gLog.Write("[%s]: %d transients, %d moving objects, %d new tracklets, %.1f ms",
+			frame_->filename.c_str(), ntr, nmove, nnew, ms);
+	report(seq);
+	if (param_->synTrack.enable && frame_->dataSub) synthetic_track(seq, t);
+
 	return true;
 }
+
+AFindPV::PVSequence& AFindPV::sequence(double t) {
+	char dims[40];
+	sprintf(dims, ":%ux%u", frame_->wImg, frame_->hImg);
+	string key = frame_->pathdir + dims;
+	const WCSTan& wcs = frame_->wcs;
+	PVSeqMap::iterator it = seqs_.find(key);
+
+	if (it != seqs_.end()) {// 检查指向和时间连续性
+		PVSequence& seq = it->second;
+		double ra0(seq.plane.crval[0] * D2R), dc0(seq.plane.crval[1] * D2R);
+		double ra1(frame_->coordCenter.x * D2R), dc1(frame_->coordCenter.y * D2R);
+		double cosd = sin(dc0) * sin(dc1) + cos(dc0) * cos(dc1) * cos(ra1 - ra0);
+		if (t > seq.tLast && acos(std::min(1.0, cosd)) * R2D < seq.radius) {
+			seq.tLast = t;
+			return seq;
+		}
+		seq.linker->Flush();
+		report(seq);
+		if (seq.stack && seq.stack->Count()) {
+			_gLog.Write(LOG_WARN, "synthetic tracking window discarded with %d frames", seq.stack->Count());
+		}
+		seqs_.erase(it);
+	}
+
+	PVSequence& seq = seqs_[key];
+	seq.linker.reset(new APVLinker(&param_->motion));
+	if (param_->synTrack.enable) seq.stack.reset(new AShiftStack(&param_->synTrack));
+	seq.plane.valid    = true;
+	seq.plane.crval[0] = frame_->coordCenter.x;
+	seq.plane.crval[1] = frame_->coordCenter.y;
+	seq.plane.cd[0][0] = seq.plane.cd[1][1] = 1.0 / 3600.0;
+	seq.radius = sqrt(double(frame_->wImg) * frame_->wImg + double(frame_->hImg) * frame_->hImg)
+			* 0.5 * wcs.Scale() / 3600.0;
+	seq.tLast  = t;
+	return seq;
+}
+
+void AFindPV::report(PVSequence& seq) {
+	PVTrackletVec tracklets;
+	double ra, dc, rate, pa;
+
+	seq.linker->TakeFinished(tracklets);
+	for (PVTrackletVec::iterator it = tracklets.begin(); it != tracklets.end(); ++it, ++nTracklet_) {
+		seq.plane.PixelToSky(it->x0, it->y0, ra, dc);
+		rate = sqrt(it->vx * it->vx + it->vy * it->vy);
+		pa   = atan2(it->vx, it->vy) * R2D;
+		if (pa < 0.0) pa += 360.0;
+		_gLog.Write("tracklet %d: %d frames, (%.5f, %.5f) at %.1f, rate = %.3f\"/s, PA = %.1f, rms = %.2f\"",
+				it->id, int(it->pts.size()), ra, dc, it->t0, rate, pa, it->rms);
+	}
+}
+
+void AFindPV::synthetic_track(PVSequence& seq, double t) {
+	int w(int(frame_->wImg)), h(int(frame_->hImg)), x, y, x0, y0, x1, y1;
+	double r(param_->synTrack.rMask), r2(r * r);
+	float* data = frame_->dataSub.get();
+
+	// 屏蔽静态源
+	for (CeleBodyVec::iterator it = frame_->bodies.begin(); it != frame_->bodies.end(); ++it) {
+		if (it->type != 1) continue;
+		x0 = std::max(0, int(it->ptBary.x - r));
+		y0 = std::max(0, int(it->ptBary.y - r));
+		x1 = std::min(w - 1, int(it->ptBary.x + r) + 1);
+		y1 = std::min(h - 1, int(it->ptBary.y + r) + 1);
+		for (y = y0; y <= y1; ++y) {
+			for (x = x0; x <= x1; ++x) {
+				double dx(x - it->ptBary.x), dy(y - it->ptBary.y);
+				if (dx * dx + dy * dy <= r2) data[y * w + x] = 0.0f;
+			}
+		}
+	}
+
+	// 指向偏移: 参考帧视场中心在本帧中的位置
+	int offx(0), offy(0);
+	if (!seq.stack->Count()) {
+		seq.wcsRef  = frame_->wcs;
+		seq.dateRef = frame_->dateobs;
+	}
+	else {
+		double ra, dc, xc(w * 0.5), yc(h * 0.5), xf, yf;
+		seq.wcsRef.PixelToSky(xc, yc, ra, dc);
+		if (frame_->wcs.SkyToPixel(ra, dc, xf, yf)) {
+			offx = int(lround(xf - xc));
+			offy = int(lround(yf - yc));
+		}
+	}
+	seq.stack->AddFrame(t, frame_->dataSub, w, h, frame_->bkSigma, offx, offy);
+	frame_->dataSub.reset();
+	if (!seq.stack->Full()) return;
+
+	// 搜索. 窗口内位移小于2像素的速度与静态源不可区分
+	double scale = seq.wcsRef.Scale(), span = t - seq.stack->RefTime();
+	double vmin = std::max(param_->motion.rateMin / scale, 2.0 / span);
+	double vmax = param_->synTrack.rateMax / scale;
+	double hitRate, ms, ra0, dc0, ra1, dc1, dra, pa;
+	SynCandVec cands;
+	int nvel = seq.stack->Search(vmin, vmax, cands);
+	ms = seq.stack->LastStat(hitRate);
+	_gLog.Write("synthetic tracking: %d frames, %d velocities, %d candidates, %.1f ms, cache hit %.1f%%",
+			seq.stack->Count(), nvel, int(cands.size()), ms, hitRate * 100.0);
+	for (SynCandVec::iterator it = cands.begin(); it != cands.end(); ++it) {
+		seq.wcsRef.PixelToSky(it->x, it->y, ra0, dc0);
+		seq.wcsRef.PixelToSky(it->x + it->vx * span, it->y + it->vy * span, ra1, dc1);
+		dra = ra1 - ra0;	// 跨越赤经0点时归算到[-180, 180)
+		if (dra >= 180.0) dra -= 360.0;
+		else if (dra < -180.0) dra += 360.0;
+		pa = atan2(dra * cos(dc0 * D2R), dc1 - dc0) * R2D;
+		if (pa < 0.0) pa += 360.0;
+		_gLog.Write("synthetic candidate: (%.5f, %.5f) at %s, rate = %.4f\"/s, PA = %.1f, SNR = %.1f",
+				ra0, dc0, seq.dateRef.c_str(), sqrt(it->vx * it->vx + it->vy * it->vy) * scale, pa, it->snr);
+	}
+	seq.stack->Reset();
+}
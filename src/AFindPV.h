@@ -2,23 +2,69 @@
  * @class AFindPV 关联识别视场内的运动目标目标
  * @version 0.1
  * @date 2021-04
+ * @note
+ * - 以相机区分图像序列, 每个序列以首帧视场中心为切点建立公共切平面
+ * - 指向变化超过视场半径或时间倒序时结束序列
+ * - 关联算法见APVLinker
+ * - 启用合成跟踪时, 屏蔽静态源后的图像加入窗口, 窗口满时平移叠加搜索暗弱运动目标(见AShiftStack)
  */
 
 #ifndef AASSOCIATEMOTION_H_
 #define AASSOCIATEMOTION_H_
 
+#include <map>
 #include "ADIProcess.h"
+#include "APVLinker.h"
+#include "AShiftStack.h"
 
 class AFindPV : public ADIProcess {
 public:
 	AFindPV(Parameter* param);
 	virtual ~AFindPV();
 
+protected:
+	typedef boost::shared_ptr<APVLinker> LinkerPtr;
+	typedef boost::shared_ptr<AShiftStack> StackPtr;
+	/*!
+	 * @struct PVSequence 同一相机的图像序列
+	 */
+	struct PVSequence {
+		LinkerPtr linker;	/// 关联算法
+		WCSTan plane;		/// 公共切平面, 坐标量纲: 角秒
+		double radius;		/// 视场半径, 量纲: 角度
+		double tLast;		/// 最近一帧的时间, 量纲: 秒
+		StackPtr stack;		/// 合成跟踪图像窗口
+		WCSTan wcsRef;		/// 合成跟踪参考帧WCS
+		string dateRef;		/// 合成跟踪参考帧曝光起始时间
+	};
+	typedef std::map<string, PVSequence> PVSeqMap;
+
+protected:
+	PVSeqMap seqs_;		/// 各相机的图像序列
+	std::vector<double> bufRA_, bufDC_;	/// 批量坐标转换缓存区: 赤道坐标
+	std::vector<double> bufX_, bufY_;	/// 批量坐标转换缓存区: 切平面坐标
+	std::vector<int> status_;			/// 目标分类
+	int nTracklet_;		/// 已结束的轨迹段数量
+
 protected:
 	/*!
 	 * @brief 在多进程模式下执行真正的处理流程
 	 */
 	bool do_real_process();
+	/*!
+	 * @brief 查找或建立当前帧所属的图像序列
+	 * @param t  当前帧时间, 量纲: 秒
+	 */
+	PVSequence& sequence(double t);
+	/*!
+	 * @brief 输出已结束的轨迹段
+	 */
+	void report(PVSequence& seq);
+	/*!
+	 * @brief 合成跟踪: 当前帧加入图像窗口, 窗口满时搜索
+	 * @param t  当前帧时间, 量纲: 秒
+	 */
+	void synthetic_track(PVSequence& seq, double t);
 };
 
 #endif /* AASSOCIATEMOTION_H_ */
@@ -0,0 +1,221 @@
+/*!
+ * @class AFitsIndex FITS文件头索引: 用于大批量文件的排序和分组
+ * @version 0.1
+ * @date 2021-05
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <boost/bind/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+#include "AFitsIndex.h"
+#include "FITSHandlerImage.hpp"
+#include "GLog.h"
+
+using namespace boost::filesystem;
+
+#define INDEX_FILENAME	".adips-index"			/// 索引文件名
+#define INDEX_TITLE		"# adips fits index v1"	/// 索引文件标识行
+
+AFitsIndex::AFitsIndex(unsigned nthread) {
+	// 文件头读取以I/O为主: 线程数不少于4
+	nthread_ = nthread ? nthread : std::max(4U, boost::thread::hardware_concurrency());
+	nlook_   = ncache_ = 0;
+	if (nthread_ > 1 && !fits_is_reentrant()) {// cfitsio未以线程安全方式编译: 不能并行打开文件
+		_gLog.Write(LOG_WARN, "cfitsio is not reentrant, FITS headers are read by one thread");
+		nthread_ = 1;
+	}
+}
+
+AFitsIndex::~AFitsIndex() {
+}
+
+void AFitsIndex::Scan(const strvec& files, FitsIdxVec& entries) {
+	typedef std::map<std::string, EntryMap> DirMap;
+	DirMap dirs;
+	std::vector<int> todo;
+	boost::system::error_code ec;
+	int n(int(files.size())), i;
+
+	nlook_ = ncache_ = 0;
+	entries.clear();
+	entries.resize(n);
+	// 文件状态, 并与目录索引比对
+	for (i = 0; i < n; ++i) {
+		FitsIndexEntry& entry = entries[i];
+		path filepath(files[i]);
+		std::string dir = filepath.parent_path().string();
+		DirMap::iterator itd = dirs.find(dir);
+		if (itd == dirs.end()) {
+			itd = dirs.insert(DirMap::value_type(dir, EntryMap())).first;
+			load_index(dir, itd->second);
+		}
+
+		entry.filepath = files[i];
+		entry.size  = file_size(filepath, ec);
+		entry.mtime = int64_t(last_write_time(filepath, ec));
+		EntryMap::iterator itf = itd->second.find(filepath.filename().string());
+		if (itf != itd->second.end() && itf->second.size == entry.size && itf->second.mtime == entry.mtime) {
+			entry = itf->second;
+			entry.filepath = files[i];
+			++ncache_;
+		}
+		else todo.push_back(i);
+	}
+
+	// 并行读取失效文件的文件头
+	if ((nlook_ = int(todo.size()))) {
+		std::atomic<int> next(0);
+		boost::thread_group grp;
+		unsigned nthread = std::min(nthread_, unsigned(nlook_));
+		for (unsigned k = 0; k < nthread; ++k) {
+			grp.create_thread(boost::bind(&AFitsIndex::look_thread, &entries, &todo, &next));
+		}
+		grp.join_all();
+
+		// 更新目录索引
+		std::map<std::string, bool> dirty;
+		for (std::vector<int>::iterator it = todo.begin(); it != todo.end(); ++it) {
+			path filepath(entries[*it].filepath);
+			std::string dir = filepath.parent_path().string();
+			dirs[dir][filepath.filename().string()] = entries[*it];
+			dirty[dir] = true;
+		}
+		for (std::map<std::string, bool>::iterator it = dirty.begin(); it != dirty.end(); ++it) {
+			if (!save_index(it->first, dirs[it->first]))
+				_gLog.Write(LOG_WARN, "failed to write FITS index in [%s]", it->first.c_str());
+		}
+	}
+
+	// 文件头未记录相机时以目录区分
+	for (i = 0; i < n; ++i) {
+		if (entries[i].camera.empty()) entries[i].camera = path(files[i]).parent_path().string();
+	}
+}
+
+void AFitsIndex::LastStat(int& nlook, int& ncache) const {
+	nlook  = nlook_;
+	ncache = ncache_;
+}
+
+int AFitsIndex::Sort(FitsIdxVec& entries) {
+	for (FitsIdxVec::iterator it = entries.begin(); it != entries.end(); ) {
+		if (it->valid) ++it;
+		else {
+			_gLog.Write(LOG_WARN, "[%s]: open error or missing keywords, skipped", it->filepath.c_str());
+			it = entries.erase(it);
+		}
+	}
+	if (entries.empty()) return 0;
+
+	// 分组键
+	auto group_less = [](const FitsIndexEntry& x, const FitsIndexEntry& y) {
+		if (x.camera != y.camera) return x.camera < y.camera;
+		if (x.wImg != y.wImg) return x.wImg < y.wImg;
+		if (x.hImg != y.hImg) return x.hImg < y.hImg;
+		if (x.xBin != y.xBin) return x.xBin < y.xBin;
+		return x.yBin < y.yBin;
+	};
+	auto same_group = [&group_less](const FitsIndexEntry& x, const FitsIndexEntry& y) {
+		return !group_less(x, y) && !group_less(y, x);
+	};
+	// 组内按曝光起始时间排序
+	std::sort(entries.begin(), entries.end(), [&group_less](const FitsIndexEntry& x, const FitsIndexEntry& y) {
+		if (group_less(x, y)) return true;
+		if (group_less(y, x)) return false;
+		if (x.dateobs != y.dateobs) return x.dateobs < y.dateobs;
+		return x.filepath < y.filepath;
+	});
+
+	// 组间按首帧时间排序
+	typedef std::pair<int, int> range;	// [起始, 结束)
+	std::vector<range> groups;
+	int n(int(entries.size())), i, j;
+	for (i = 0; i < n; i = j) {
+		for (j = i + 1; j < n && same_group(entries[i], entries[j]); ++j);
+		groups.push_back(range(i, j));
+	}
+	std::stable_sort(groups.begin(), groups.end(), [&entries](const range& x, const range& y) {
+		return entries[x.first].dateobs < entries[y.first].dateobs;
+	});
+	FitsIdxVec sorted;
+	sorted.reserve(n);
+	for (std::vector<range>::iterator it = groups.begin(); it != groups.end(); ++it) {
+		sorted.insert(sorted.end(), entries.begin() + it->first, entries.begin() + it->second);
+	}
+	entries.swap(sorted);
+
+	return int(groups.size());
+}
+
+void AFitsIndex::load_index(const std::string& dir, EntryMap& entries) {
+	std::ifstream in((path(dir) / INDEX_FILENAME).string().c_str());
+	std::string line, field;
+
+	if (!in.good() || !std::getline(in, line) || line != INDEX_TITLE) return;
+	// 每行: 文件名 长度 修改时间 有效 宽度 高度 X合并 Y合并 曝光时间 曝光起始时间 相机. 以制表符分隔
+	while (std::getline(in, line)) {
+		std::vector<std::string> fields;
+		std::istringstream is(line);
+		while (std::getline(is, field, '\t')) fields.push_back(field);
+		if (line.size() && line[line.size() - 1] == '\t') fields.push_back("");
+		if (fields.size() != 11) continue;
+
+		FitsIndexEntry entry;
+		entry.size    = strtoull(fields[1].c_str(), NULL, 10);
+		entry.mtime   = strtoll(fields[2].c_str(), NULL, 10);
+		entry.valid   = fields[3] == "1";
+		entry.wImg    = unsigned(strtoul(fields[4].c_str(), NULL, 10));
+		entry.hImg    = unsigned(strtoul(fields[5].c_str(), NULL, 10));
+		entry.xBin    = unsigned(strtoul(fields[6].c_str(), NULL, 10));
+		entry.yBin    = unsigned(strtoul(fields[7].c_str(), NULL, 10));
+		entry.expdur  = strtod(fields[8].c_str(), NULL);
+		entry.dateobs = fields[9];
+		entry.camera  = fields[10];
+		entries[fields[0]] = entry;
+	}
+}
+
+bool AFitsIndex::save_index(const std::string& dir, const EntryMap& entries) {
+	std::string filepath = (path(dir) / INDEX_FILENAME).string();
+	std::string tmppath  = filepath + ".tmp";
+	FILE* fp = fopen(tmppath.c_str(), "w");
+	if (!fp) return false;
+
+	fprintf(fp, "%s\n", INDEX_TITLE);
+	for (EntryMap::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+		const FitsIndexEntry& entry = it->second;
+		fprintf(fp, "%s\t%llu\t%lld\t%d\t%u\t%u\t%u\t%u\t%.6f\t%s\t%s\n", it->first.c_str(),
+				(unsigned long long) entry.size, (long long) entry.mtime, entry.valid ? 1 : 0,
+				entry.wImg, entry.hImg, entry.xBin, entry.yBin, entry.expdur,
+				entry.dateobs.c_str(), entry.camera.c_str());
+	}
+	bool rslt = !ferror(fp);
+	rslt = !fclose(fp) && rslt;
+	// 替换方式写入: 中断时不损坏原索引
+	if (rslt) rslt = !rename(tmppath.c_str(), filepath.c_str());
+	if (!rslt) remove(tmppath.c_str());
+	return rslt;
+}
+
+void AFitsIndex::look_thread(FitsIdxVec* entries, const std::vector<int>* todo, std::atomic<int>* next) {
+	FITSHandlerImage fits;
+	int i, n(int(todo->size()));
+
+	while ((i = (*next)++) < n) {
+		FitsIndexEntry& entry = (*entries)[(*todo)[i]];
+		if ((entry.valid = fits.LookImage(entry.filepath.c_str()))) {
+			entry.wImg    = fits.wImg;
+			entry.hImg    = fits.hImg;
+			entry.xBin    = fits.xBin;
+			entry.yBin    = fits.yBin;
+			entry.expdur  = fits.expdur;
+			entry.dateobs = fits.dateobs;
+			entry.camera  = fits.camera;
+		}
+	}
+}
@@ -0,0 +1,100 @@
+/*!
+ * @class AFitsIndex FITS文件头索引: 用于大批量文件的排序和分组
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * - 仅读取文件头关键字(见FITSHandlerImage::LookImage), 多线程并行. cfitsio不可重入时单线程读取
+ * - 每个目录维护索引文件.adips-index, 记录文件长度、修改时间及文件头信息.
+ *   长度和修改时间均未变化的文件直接使用索引, 不再打开
+ * - 排序: 按相机(INSTRUME, 缺省时为目录)、图像尺寸和合并因子分组;
+ *   组间按首帧曝光时间排序, 组内按曝光起始时间(DATE-OBS)排序
+ */
+
+#ifndef AFITSINDEX_H_
+#define AFITSINDEX_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+
+/*!
+ * @struct FitsIndexEntry 单个文件的索引
+ */
+struct FitsIndexEntry {
+	std::string filepath;	/// 全路径名
+	uint64_t size;		/// 文件长度
+	int64_t mtime;		/// 修改时间
+	bool valid;			/// 文件头包含关键信息
+	unsigned wImg, hImg;	/// 图像尺寸
+	unsigned xBin, yBin;	/// 合并因子
+	double expdur;		/// 曝光时间, 量纲: 秒
+	std::string dateobs;	/// 曝光起始时间, 格式: CCYY-MM-DDThh:mm:ss<.sss<sss>>, UTC
+	std::string camera;	/// 相机. 文件头未记录时为所在目录
+
+public:
+	FitsIndexEntry() {
+		size  = 0;
+		mtime = 0;
+		valid = false;
+		wImg = hImg = 0;
+		xBin = yBin = 1;
+		expdur = 0.0;
+	}
+};
+typedef std::vector<FitsIndexEntry> FitsIdxVec;
+
+class AFitsIndex {
+public:
+	AFitsIndex(unsigned nthread = 0);
+	virtual ~AFitsIndex();
+
+protected:
+	typedef std::vector<std::string> strvec;
+	typedef std::map<std::string, FitsIndexEntry> EntryMap;	///< 文件名与索引的映射
+
+protected:
+	unsigned nthread_;	/// 读取文件头的线程数
+	int nlook_;			/// 最近一次扫描读取文件头的文件数
+	int ncache_;		/// 最近一次扫描使用索引的文件数
+
+public:
+	/*!
+	 * @brief 建立文件索引. 索引已失效的文件重新读取文件头, 并更新所在目录的索引文件
+	 * @param files    文件路径
+	 * @param entries  索引, 与files一一对应
+	 */
+	void Scan(const strvec& files, FitsIdxVec& entries);
+	/*!
+	 * @brief 查看最近一次扫描的统计
+	 * @param nlook   读取文件头的文件数
+	 * @param ncache  使用索引的文件数
+	 */
+	void LastStat(int& nlook, int& ncache) const;
+	/*!
+	 * @brief 分组并排序. 剔除无效文件
+	 * @return
+	 * 分组数量
+	 */
+	static int Sort(FitsIdxVec& entries);
+
+protected:
+	/*!
+	 * @brief 加载目录的索引文件
+	 */
+	static void load_index(const std::string& dir, EntryMap& entries);
+	/*!
+	 * @brief 写入目录的索引文件
+	 */
+	static bool save_index(const std::string& dir, const EntryMap& entries);
+	/*!
+	 * @brief 线程: 读取文件头
+	 * @param entries  索引
+	 * @param todo     待读取的索引编号
+	 * @param next     下一个待读取位置
+	 */
+	static void look_thread(FitsIdxVec* entries, const std::vector<int>* todo, std::atomic<int>* next);
+};
+
+#endif /* AFITSINDEX_H_ */
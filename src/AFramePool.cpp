@@ -0,0 +1,127 @@
+/*!
+ * @class AFramePool 帧缓存区池: 复用整帧尺寸的大块内存, 避免逐帧分配和缺页
+ * @version 0.1
+ * @date 2021-05
+ */
+
+#include <stdlib.h>
+#include <new>
+#include <sys/mman.h>
+#include "AFramePool.h"
+
+#define POOL_ALIGN		64				/// 对齐长度: 缓存行
+#define HUGE_PAGE_SIZE	(2UL << 20)		/// 大页长度
+#define POOL_MAX_IDLE	8				/// 每种尺寸保留的最多空闲缓存区数量
+
+AFramePool::AFramePool() {
+	hugePage_  = false;
+	maxIdle_   = POOL_MAX_IDLE;
+	nAlloc_    = nReuse_ = 0;
+	bytesHeld_ = 0;
+}
+
+AFramePool::~AFramePool() {
+	Trim();
+}
+
+AFramePool& AFramePool::Instance() {
+	static AFramePool* pool = new AFramePool;
+	return *pool;
+}
+
+void AFramePool::SetHugePage(bool enable) {
+	mutex_lock lck(mtx_);
+	hugePage_ = enable;
+}
+
+void AFramePool::Trim() {
+	mutex_lock lck(mtx_);
+	for (FreeMap::iterator it = free_.begin(); it != free_.end(); ++it) {
+		for (BlockVec::iterator blk = it->second.begin(); blk != it->second.end(); ++blk) {
+			deallocate(blk->ptr, it->first, blk->mapped);
+			bytesHeld_ -= it->first;
+		}
+	}
+	free_.clear();
+}
+
+void AFramePool::GetStat(int& nalloc, int& nreuse, size_t& bytes) {
+	mutex_lock lck(mtx_);
+	nalloc = nAlloc_;
+	nreuse = nReuse_;
+	bytes  = bytesHeld_;
+}
+
+void* AFramePool::acquire(size_t bytes, bool& mapped) {
+	{
+		mutex_lock lck(mtx_);
+		FreeMap::iterator it = free_.find(bytes);
+		if (it != free_.end() && it->second.size()) {
+			Block blk = it->second.back();
+			it->second.pop_back();
+			++nReuse_;
+			mapped = blk.mapped;
+			return blk.ptr;
+		}
+	}
+	// 在锁外分配: 写零整块内存耗时较长
+	void* ptr = allocate(bytes, mapped);
+	mutex_lock lck(mtx_);
+	++nAlloc_;
+	bytesHeld_ += bytes;
+	return ptr;
+}
+
+void AFramePool::release(void* ptr, size_t bytes, bool mapped) {
+	{
+		mutex_lock lck(mtx_);
+		BlockVec& blocks = free_[bytes];
+		if (blocks.size() < maxIdle_) {
+			Block blk;
+			blk.ptr    = ptr;
+			blk.mapped = mapped;
+			blocks.push_back(blk);
+			return;
+		}
+		bytesHeld_ -= bytes;
+	}
+	deallocate(ptr, bytes, mapped);
+}
+
+void* AFramePool::allocate(size_t bytes, bool& mapped) {
+	void* ptr(NULL);
+	bool huge;
+	{
+		mutex_lock lck(mtx_);
+		huge = hugePage_;
+	}
+
+	mapped = false;
+#ifdef __linux__
+	if (huge && bytes >= HUGE_PAGE_SIZE) {
+		size_t len = round_bytes(bytes, true);
+		ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (ptr == MAP_FAILED) {// 未预留大页: 使用透明大页
+			ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (ptr != MAP_FAILED) madvise(ptr, len, MADV_HUGEPAGE);
+		}
+		if (ptr == MAP_FAILED) ptr = NULL;
+		else mapped = true;
+	}
+#endif
+	if (!ptr && posix_memalign(&ptr, POOL_ALIGN, round_bytes(bytes, false))) throw std::bad_alloc();
+	// 逐页写零: 缺页在分配时一次完成
+	memset(ptr, 0, bytes);
+	return ptr;
+}
+
+void AFramePool::deallocate(void* ptr, size_t bytes, bool mapped) {
+	if (mapped) munmap(ptr, round_bytes(bytes, true));
+	else free(ptr);
+}
+
+size_t AFramePool::round_bytes(size_t bytes, bool huge) {
+	size_t align = huge ? HUGE_PAGE_SIZE : POOL_ALIGN;
+	if (!bytes) bytes = 1;
+	return (bytes + align - 1) / align * align;
+}
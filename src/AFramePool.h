@@ -0,0 +1,128 @@
+/*!
+ * @class AFramePool 帧缓存区池: 复用整帧尺寸的大块内存, 避免逐帧分配和缺页
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * - 以字节数为键(图像尺寸×元素长度)维护空闲缓存区. 尺寸和类型长度相同的请求共用缓存区
+ * - 缓存区64字节对齐, 分配时逐页写零, 复用时不再产生缺页
+ * - 可选大页: 优先使用MAP_HUGETLB, 系统未预留大页时退化为透明大页(MADV_HUGEPAGE)
+ * - 租用: Lease返回boost::shared_array, 最后一个引用释放时自动归还池中.
+ *   可直接存入ImageFrame::dataSub等成员, 跨线程传递
+ * - 进程内唯一实例, 线程安全
+ */
+
+#ifndef AFRAMEPOOL_H_
+#define AFRAMEPOOL_H_
+
+#include <stddef.h>
+#include <string.h>
+#include <map>
+#include <vector>
+#include <boost/smart_ptr/shared_array.hpp>
+#include <boost/thread/mutex.hpp>
+
+class AFramePool {
+protected:
+	AFramePool();
+	virtual ~AFramePool();
+
+protected:
+	typedef boost::unique_lock<boost::mutex> mutex_lock;
+
+	/*!
+	 * @struct Block 缓存区
+	 */
+	struct Block {
+		void* ptr;		/// 地址
+		bool mapped;	/// 以mmap分配
+	};
+	typedef std::vector<Block> BlockVec;
+	typedef std::map<size_t, BlockVec> FreeMap;	///< 字节数与空闲缓存区的映射
+
+	/*!
+	 * @struct Releaser shared_array删除器: 将缓存区归还池中
+	 */
+	struct Releaser {
+		size_t bytes;	/// 字节数
+		bool mapped;	/// 以mmap分配
+
+	public:
+		Releaser(size_t n, bool m) {
+			bytes  = n;
+			mapped = m;
+		}
+
+		void operator()(void* ptr) {
+			AFramePool::Instance().release(ptr, bytes, mapped);
+		}
+	};
+
+protected:
+	boost::mutex mtx_;	/// 互斥锁
+	FreeMap free_;		/// 空闲缓存区
+	bool hugePage_;		/// 使用大页
+	unsigned maxIdle_;	/// 每种尺寸保留的最多空闲缓存区数量
+	int nAlloc_;		/// 统计: 新分配次数
+	int nReuse_;		/// 统计: 复用次数
+	size_t bytesHeld_;	/// 统计: 已分配的总字节数, 包括使用中和空闲的缓存区
+
+public:
+	/*!
+	 * @brief 进程内唯一实例. 不析构, 避免退出时仍有租用的缓存区
+	 */
+	static AFramePool& Instance();
+	/*!
+	 * @brief 设置是否使用大页. 仅影响此后新分配的缓存区
+	 */
+	void SetHugePage(bool enable);
+	/*!
+	 * @brief 租用缓存区
+	 * @param w     宽度
+	 * @param h     高度
+	 * @param zero  清零. 复用的缓存区保留上次使用的内容
+	 * @return
+	 * 缓存区, 元素未构造. 仅用于float、char等基本类型
+	 */
+	template<class T> boost::shared_array<T> Lease(unsigned w, unsigned h, bool zero = false) {
+		size_t bytes = size_t(w) * h * sizeof(T);
+		bool mapped;
+		void* ptr = acquire(bytes, mapped);
+		if (zero) memset(ptr, 0, bytes);
+		return boost::shared_array<T>((T*) ptr, Releaser(bytes, mapped));
+	}
+	/*!
+	 * @brief 释放全部空闲缓存区
+	 */
+	void Trim();
+	/*!
+	 * @brief 查看统计
+	 * @param nalloc  新分配次数
+	 * @param nreuse  复用次数
+	 * @param bytes   已分配的总字节数
+	 */
+	void GetStat(int& nalloc, int& nreuse, size_t& bytes);
+
+protected:
+	/*!
+	 * @brief 取得空闲缓存区或新分配
+	 */
+	void* acquire(size_t bytes, bool& mapped);
+	/*!
+	 * @brief 归还缓存区. 空闲数量超出上限时释放
+	 */
+	void release(void* ptr, size_t bytes, bool mapped);
+	/*!
+	 * @brief 新分配缓存区并逐页写零
+	 */
+	void* allocate(size_t bytes, bool& mapped);
+	/*!
+	 * @brief 释放缓存区
+	 */
+	static void deallocate(void* ptr, size_t bytes, bool mapped);
+	/*!
+	 * @brief 分配长度: 对齐至缓存行, 大页分配对齐至大页
+	 */
+	static size_t round_bytes(size_t bytes, bool huge);
+};
+
+#endif /* AFRAMEPOOL_H_ */
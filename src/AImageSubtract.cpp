@@ -0,0 +1,664 @@
+/*!
+ * @class AImageSubtract 参考图像差分: 对齐、PSF匹配、相减并探测残差源
+ * @version 0.1
+ * @date 2021-05
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <boost/bind/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include "AImageSubtract.h"
+#include "AKernels.h"
+
+using std::vector;
+using namespace boost::placeholders;
+typedef std::chrono::steady_clock steady_clock;
+
+#define MAP_STEP		64		/// 像素映射网格间隔
+#define MAP_TOL			0.02	/// 复用已对齐参考图像的映射偏差上限, 量纲: 像素
+#define STAR_MAX		1000	/// 用于估计半高全宽和流量比例的亮星数量上限
+#define STAR_HALF		8		/// 亮星二阶矩窗口半宽
+#define STAR_SNR		20.0	/// 亮星峰值阈值, 量纲: 背景噪声
+#define FWHM_SIGMA		2.3548200450309493	/// 半高全宽与高斯标准差之比
+#define DIFF_RESIDUAL	0.05	/// 差分流量低于参考流量的该比例时视为亮星相减残差
+
+AImageSubtract::AImageSubtract(const ParamDiff* param) {
+	param_   = param;
+	nthread_ = param->threads ? param->threads : boost::thread::hardware_concurrency();
+	if (!nthread_) nthread_ = 1;
+	fd_      = -1;
+	addr_    = NULL;
+	size_    = 0;
+	header_  = NULL;
+	ref_     = NULL;
+	wComb_ = hComb_ = 0;
+	nComb_   = 0;
+	map_.w = map_.h = mapAln_.w = mapAln_.h = 0;
+	map_.nx = map_.ny = mapAln_.nx = mapAln_.ny = 0;
+	sigConv_  = -1.0;
+	msElapse_ = 0.0;
+	fwhmImg_ = fwhmRef_ = 0.0;
+	scale_    = 1.0;
+	reuse_    = false;
+}
+
+AImageSubtract::~AImageSubtract() {
+	Close();
+}
+
+bool AImageSubtract::Open(const char* filepath) {
+	struct stat st;
+
+	Close();
+	if ((fd_ = open(filepath, O_RDONLY)) < 0) return false;
+	if (fstat(fd_, &st) || size_t(st.st_size) < sizeof(RefImageHeader)) {
+		Close();
+		return false;
+	}
+	size_ = st.st_size;
+	addr_ = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd_, 0);
+	if (addr_ == MAP_FAILED) {
+		addr_ = NULL;
+		Close();
+		return false;
+	}
+
+	const char* base = (const char*) addr_;
+	header_ = (const RefImageHeader*) base;
+	if (memcmp(header_->magic, REF_IMAGE_MAGIC, 8) || header_->version != REF_IMAGE_VERSION
+			|| !header_->width || !header_->height || !header_->wcs.valid
+			|| header_->offData + uint64_t(header_->width) * header_->height * sizeof(float) > size_) {
+		header_ = NULL;
+		Close();
+		return false;
+	}
+	ref_ = (const float*) (base + header_->offData);
+
+	return true;
+}
+
+void AImageSubtract::Close() {
+	if (addr_) munmap(addr_, size_);
+	if (fd_ >= 0) close(fd_);
+	fd_     = -1;
+	addr_   = NULL;
+	size_   = 0;
+	header_ = NULL;
+	ref_    = NULL;
+	mapAln_.w = mapAln_.h = 0;
+	sigConv_  = -1.0;
+}
+
+bool AImageSubtract::IsOpen() const {
+	return header_ != NULL;
+}
+
+const RefImageHeader* AImageSubtract::Header() const {
+	return header_;
+}
+
+void AImageSubtract::BeginCombine(unsigned w, unsigned h, const WCSTan& wcs) {
+	size_t n = size_t(w) * h;
+
+	wComb_   = w;
+	hComb_   = h;
+	wcsComb_ = wcs;
+	nComb_   = 0;
+	sum_.assign(n, 0.0f);
+	min_.assign(n, HUGE_VALF);
+	max_.assign(n, -HUGE_VALF);
+	count_.assign(n, 0);
+}
+
+int AImageSubtract::AddCombine(const float* data, unsigned w, unsigned h, const WCSTan& wcs) {
+	if (!wComb_ || w != wComb_ || h != hComb_ || nComb_ >= 65535) return -1;
+
+	// 参考图像像素映射至当前帧
+	PixelMap map;
+	build_map(wcsComb_, wComb_, hComb_, wcs, map);
+	parallel(hComb_, boost::bind(&AImageSubtract::combine_rows, this, data, w, h, &map, _1, _2));
+	return ++nComb_;
+}
+
+int AImageSubtract::CombineCount() const {
+	return nComb_;
+}
+
+bool AImageSubtract::EndCombine(const char* filepath) {
+	if (!nComb_) return false;
+
+	// 剔除最小值和最大值后取均值. 有效帧数不足3时取均值
+	size_t n = size_t(wComb_) * hComb_, i;
+	float* data = sum_.data();
+	int c;
+	for (i = 0; i < n; ++i) {
+		c = count_[i];
+		if (c >= 3)  data[i] = (data[i] - min_[i] - max_[i]) / (c - 2);
+		else if (c)  data[i] /= c;
+		else         data[i] = NAN;
+	}
+
+	RefImageHeader header = RefImageHeader();
+	memcpy(header.magic, REF_IMAGE_MAGIC, 8);
+	header.version = REF_IMAGE_VERSION;
+	header.nframe  = nComb_;
+	header.width   = wComb_;
+	header.height  = hComb_;
+	header.sig     = robust_sigma(data, n);
+	header.wcs     = wcsComb_;
+	header.offData = (sizeof(RefImageHeader) + 4095) & ~uint64_t(4095);
+	stars_.clear();
+	parallel(hComb_, boost::bind(&AImageSubtract::find_stars, this, data, int(wComb_), int(hComb_),
+			float(STAR_SNR * header.sig), _1, _2));
+	select_stars();
+	header.fwhm = measure_fwhm(data, int(wComb_));
+
+	// 先写入临时文件, 完成后更名, 避免其它进程映射不完整的文件
+	std::string pathTmp = std::string(filepath) + ".tmp";
+	FILE* fp = fopen(pathTmp.c_str(), "wb");
+	bool rslt(fp != NULL);
+	if (rslt) {
+		vector<char> pad(header.offData - sizeof(RefImageHeader), 0);
+		rslt = fwrite(&header, sizeof(RefImageHeader), 1, fp) == 1
+				&& fwrite(pad.data(), 1, pad.size(), fp) == pad.size()
+				&& fwrite(data, sizeof(float), n, fp) == n;
+		rslt = (fclose(fp) == 0) && rslt;
+		if (rslt) rslt = rename(pathTmp.c_str(), filepath) == 0;
+		if (!rslt) remove(pathTmp.c_str());
+	}
+
+	// 释放合并缓冲区
+	FloatVec().swap(sum_);
+	FloatVec().swap(min_);
+	FloatVec().swap(max_);
+	vector<uint16_t>().swap(count_);
+	wComb_ = hComb_ = 0;
+	nComb_ = 0;
+
+	return rslt && Open(filepath);
+}
+
+int AImageSubtract::Subtract(const float* data, unsigned w, unsigned h, const WCSTan& wcs, double sig,
+		DiffSrcVec& srcs) {
+	steady_clock::time_point tmStart = steady_clock::now();
+	srcs.clear();
+	if (!header_ || !w || !h || sig <= 0.0) return -1;
+
+	size_t n = size_t(w) * h, i;
+	unsigned wr(header_->width), hr(header_->height);
+
+	// 对齐. 像素映射与已对齐参考图像一致时复用
+	build_map(wcs, w, h, header_->wcs, map_);
+	if (!(reuse_ = same_map(map_, mapAln_))) {
+		const float* ref = ref_;
+		const PixelMap* map = &map_;
+		float* dst;
+		alnRaw_.resize(n);
+		dst = alnRaw_.data();
+		parallel(h, [=](int row0, int row1) {
+			resample(ref, wr, hr, map, dst + size_t(row0) * w, row0, row1);
+		});
+		mapAln_  = map_;
+		sigConv_ = -1.0;
+	}
+
+	// 半高全宽
+	stars_.clear();
+	parallel(h, boost::bind(&AImageSubtract::find_stars, this, data, int(w), int(h), float(STAR_SNR * sig), _1, _2));
+	select_stars();
+	fwhmImg_ = measure_fwhm(data, int(w));
+	fwhmRef_ = measure_fwhm(alnRaw_.data(), int(w));
+
+	// PSF匹配: 以高斯核卷积较锐利的图像
+	const float *img(data), *ref(alnRaw_.data());
+	if (fwhmImg_ > 0.0 && fwhmRef_ > 0.0) {
+		double s2 = (fwhmImg_ * fwhmImg_ - fwhmRef_ * fwhmRef_) / (FWHM_SIGMA * FWHM_SIGMA);
+		if (s2 > 0.01) {
+			double s = sqrt(s2);
+			if (fabs(s - sigConv_) > 0.02) {
+				convolve(alnRaw_.data(), w, h, s, alnConv_);
+				sigConv_ = s;
+			}
+			ref = alnConv_.data();
+		}
+		else if (s2 < -0.01) {
+			convolve(data, w, h, sqrt(-s2), work_);
+			img = work_.data();
+		}
+	}
+
+	// 流量比例: 亮星孔径流量比的中值
+	double r = std::max(3.0, 2.0 * std::max(fwhmImg_, fwhmRef_)), fi, fr;
+	vector<double> ratio;
+	for (i = 0; i < stars_.size(); ++i) {
+		fi = aperture(img, w, h, stars_[i].x, stars_[i].y, r);
+		fr = aperture(ref, w, h, stars_[i].x, stars_[i].y, r);
+		if (fi > 0.0 && fr > 0.0) ratio.push_back(fi / fr);
+	}
+	if (ratio.size() >= 5) {
+		std::nth_element(ratio.begin(), ratio.begin() + ratio.size() / 2, ratio.end());
+		scale_ = ratio[ratio.size() / 2];
+	}
+	else scale_ = 1.0;
+
+	// 相减并探测
+	diff_.resize(n);
+	tmp_.resize(n);
+	parallel(h, boost::bind(&AImageSubtract::subtract_rows, this, img, ref, float(scale_), int(w), _1, _2));
+	parallel(h, boost::bind(&AImageSubtract::box_rows, this, int(w), int(h), _1, _2));
+	double sigBox = robust_sigma(tmp_.data(), n);
+	double sigRef = robust_sigma(ref, n) * scale_;
+	double radius = std::max(1.5, param_->rMatch * std::max(fwhmImg_, fwhmRef_));
+	srcs_.clear();
+	if (sigBox > 0.0) {
+		double thresh = param_->snr * sigBox;
+		float scale = float(scale_);
+		parallel(h, [=](int row0, int row1) {
+			detect_rows(ref, scale, int(w), int(h), thresh, sigBox, sigRef, radius, row0, row1);
+		});
+	}
+	std::sort(srcs_.begin(), srcs_.end(), [](const DiffSource& s1, const DiffSource& s2) {
+		return s1.snr > s2.snr;
+	});
+	if (srcs_.size() > param_->maxCount) srcs_.resize(param_->maxCount);
+	srcs = srcs_;
+
+	msElapse_ = std::chrono::duration<double, std::milli>(steady_clock::now() - tmStart).count();
+	return int(srcs.size());
+}
+
+const float* AImageSubtract::Difference() const {
+	return diff_.empty() ? NULL : diff_.data();
+}
+
+double AImageSubtract::LastStat(double& fwhm, double& fwhmRef, double& scale, bool& reuse) const {
+	fwhm    = fwhmImg_;
+	fwhmRef = fwhmRef_;
+	scale   = scale_;
+	reuse   = reuse_;
+	return msElapse_;
+}
+
+void AImageSubtract::parallel(int n, const boost::function<void (int, int)>& func) {
+	int nt = std::min(int(nthread_), n), step, i;
+	if (nt <= 1) {
+		func(0, n);
+		return;
+	}
+	boost::thread_group thrds;
+	step = (n + nt - 1) / nt;
+	for (i = 0; i < nt && i * step < n; ++i)
+		thrds.create_thread(boost::bind(func, i * step, std::min(n, (i + 1) * step)));
+	thrds.join_all();
+}
+
+void AImageSubtract::build_map(const WCSTan& wcs, unsigned w, unsigned h, const WCSTan& wcsTo, PixelMap& map) {
+	int i, j, k, n;
+
+	map.w  = w;
+	map.h  = h;
+	map.nx = int(w - 1) / MAP_STEP + 2;
+	map.ny = int(h - 1) / MAP_STEP + 2;
+	n = map.nx * map.ny;
+	vector<double> x(n), y(n), ra(n), dc(n);
+	for (j = k = 0; j < map.ny; ++j) {
+		for (i = 0; i < map.nx; ++i, ++k) {
+			x[k] = i * MAP_STEP;
+			y[k] = j * MAP_STEP;
+		}
+	}
+	wcs.PixelToSky(n, x.data(), y.data(), ra.data(), dc.data());
+	wcsTo.SkyToPixel(n, ra.data(), dc.data(), x.data(), y.data());
+	map.x.resize(n);
+	map.y.resize(n);
+	for (k = 0; k < n; ++k) {
+		map.x[k] = float(x[k]);
+		map.y[k] = float(y[k]);
+	}
+}
+
+bool AImageSubtract::same_map(const PixelMap& map1, const PixelMap& map2) {
+	if (map1.w != map2.w || map1.h != map2.h || map1.nx != map2.nx || map1.ny != map2.ny) return false;
+	for (size_t k = 0; k < map1.x.size(); ++k) {
+		if (!(fabs(map1.x[k] - map2.x[k]) < MAP_TOL && fabs(map1.y[k] - map2.y[k]) < MAP_TOL)) return false;
+	}
+	return true;
+}
+
+/*!
+ * @brief 双三次插值权重(a = -0.5)
+ */
+static inline void cubic_weight(double t, double* wt) {
+	wt[0] = ((-0.5 * t + 1.0) * t - 0.5) * t;
+	wt[1] = (1.5 * t - 2.5) * t * t + 1.0;
+	wt[2] = ((-1.5 * t + 2.0) * t + 0.5) * t;
+	wt[3] = (0.5 * t - 0.5) * t * t;
+}
+
+void AImageSubtract::resample(const float* src, unsigned ws, unsigned hs, const PixelMap* map, float* dst,
+		int row0, int row1) {
+	int w(map->w), nx(map->nx), x, y, i, j, gx, gy, ix, iy;
+	FloatVec rx(nx), ry(nx);
+	double sx, sy, fx, wx[4], wy[4], v;
+	float fy;
+
+	for (y = row0; y < row1; ++y, dst += w) {
+		// 行在网格中的映射
+		gy = y / MAP_STEP;
+		fy = float(y - gy * MAP_STEP) / MAP_STEP;
+		const float *x0 = map->x.data() + gy * nx, *x1 = x0 + nx;
+		const float *y0 = map->y.data() + gy * nx, *y1 = y0 + nx;
+		for (i = 0; i < nx; ++i) {
+			rx[i] = x0[i] + (x1[i] - x0[i]) * fy;
+			ry[i] = y0[i] + (y1[i] - y0[i]) * fy;
+		}
+
+		for (x = 0; x < w; ++x) {
+			gx = x / MAP_STEP;
+			fx = double(x - gx * MAP_STEP) / MAP_STEP;
+			sx = rx[gx] + (rx[gx + 1] - rx[gx]) * fx;
+			sy = ry[gx] + (ry[gx + 1] - ry[gx]) * fx;
+			ix = int(floor(sx));
+			iy = int(floor(sy));
+			if (ix < 1 || iy < 1 || ix >= int(ws) - 2 || iy >= int(hs) - 2) {
+				dst[x] = NAN;
+				continue;
+			}
+			cubic_weight(sx - ix, wx);
+			cubic_weight(sy - iy, wy);
+			const float* p = src + size_t(iy - 1) * ws + ix - 1;
+			for (j = 0, v = 0.0; j < 4; ++j, p += ws)
+				v += wy[j] * (wx[0] * p[0] + wx[1] * p[1] + wx[2] * p[2] + wx[3] * p[3]);
+			dst[x] = float(v);
+		}
+	}
+}
+
+void AImageSubtract::combine_rows(const float* data, unsigned w, unsigned h, const PixelMap* map,
+		int row0, int row1) {
+	FloatVec row(wComb_);
+	unsigned x;
+	int y;
+	float v;
+
+	for (y = row0; y < row1; ++y) {
+		resample(data, w, h, map, row.data(), y, y + 1);
+		size_t off = size_t(y) * wComb_;
+		float* sum = sum_.data() + off;
+		float* bot = min_.data() + off;
+		float* top = max_.data() + off;
+		uint16_t* cnt = count_.data() + off;
+		for (x = 0; x < wComb_; ++x) {
+			v = row[x];
+			if (v != v) continue;
+			sum[x] += v;
+			if (v < bot[x]) bot[x] = v;
+			if (v > top[x]) top[x] = v;
+			++cnt[x];
+		}
+	}
+}
+
+void AImageSubtract::convolve(const float* src, unsigned w, unsigned h, double sigma, FloatVec& dst) {
+	int r = std::max(1, int(ceil(3.0 * sigma))), i;
+	FloatVec kernel(2 * r + 1);
+	double sum(0.0);
+
+	for (i = -r; i <= r; ++i) sum += (kernel[i + r] = float(exp(-0.5 * i * i / (sigma * sigma))));
+	for (i = 0; i <= 2 * r; ++i) kernel[i] = float(kernel[i] / sum);
+	tmp_.resize(size_t(w) * h);
+	dst.resize(size_t(w) * h);
+	parallel(h, boost::bind(&AImageSubtract::conv_rows, src, int(w), &kernel, tmp_.data(), _1, _2));
+	parallel(h, boost::bind(&AImageSubtract::conv_cols, tmp_.data(), int(w), int(h), &kernel, dst.data(), _1, _2));
+}
+
+void AImageSubtract::conv_rows(const float* src, int w, const FloatVec* kernel, float* dst, int row0, int row1) {
+	int nk(int(kernel->size())), r(nk / 2), x, y, j;
+	FloatVec pad(w + nk);
+	const float* k = kernel->data();
+	const PixelKernels& kernels = AKernels::Get();
+
+	for (y = row0; y < row1; ++y) {
+		// 边界外的像素取边界值
+		const float* in = src + size_t(y) * w;
+		float* __restrict out = dst + size_t(y) * w;
+		for (x = 0; x < r; ++x) pad[x] = in[0];
+		memcpy(pad.data() + r, in, w * sizeof(float));
+		for (x = 0; x < r; ++x) pad[r + w + x] = in[w - 1];
+
+		memset(out, 0, w * sizeof(float));
+		for (j = 0; j < nk; ++j) kernels.axpy(out, pad.data() + j, k[j], w);
+	}
+}
+
+void AImageSubtract::conv_cols(const float* src, int w, int h, const FloatVec* kernel, float* dst,
+		int row0, int row1) {
+	int nk(int(kernel->size())), r(nk / 2), y, j, yy;
+	const float* k = kernel->data();
+	const PixelKernels& kernels = AKernels::Get();
+
+	for (y = row0; y < row1; ++y) {
+		float* __restrict out = dst + size_t(y) * w;
+		memset(out, 0, w * sizeof(float));
+		for (j = 0; j < nk; ++j) {
+			yy = std::min(h - 1, std::max(0, y + j - r));
+			kernels.axpy(out, src + size_t(yy) * w, k[j], w);
+		}
+	}
+}
+
+void AImageSubtract::find_stars(const float* data, int w, int h, float thresh, int row0, int row1) {
+	vector<StarPos> stars;
+	int x, y, i, j;
+	float v, q;
+	bool peak;
+
+	for (y = std::max(row0, STAR_HALF); y < std::min(row1, h - STAR_HALF); ++y) {
+		const float* row = data + size_t(y) * w;
+		for (x = STAR_HALF; x < w - STAR_HALF; ++x) {
+			if (!((v = row[x]) > thresh)) continue;
+			// 5*5邻域内的极大值. 相等时取左上
+			for (j = -2, peak = true; j <= 2 && peak; ++j) {
+				const float* p = row + j * w;
+				for (i = -2; i <= 2 && peak; ++i) {
+					if (!i && !j) continue;
+					q = p[x + i];
+					if (q > v || (q == v && (j < 0 || (j == 0 && i < 0)))) peak = false;
+				}
+			}
+			if (!peak) continue;
+			StarPos star;
+			star.x    = x;
+			star.y    = y;
+			star.peak = v;
+			stars.push_back(star);
+		}
+	}
+
+	mutex_lock lck(mtx_);
+	stars_.insert(stars_.end(), stars.begin(), stars.end());
+}
+
+void AImageSubtract::select_stars() {
+	std::sort(stars_.begin(), stars_.end(), [](const StarPos& s1, const StarPos& s2) {
+		return s1.peak > s2.peak;
+	});
+	if (stars_.size() > 50) stars_.erase(stars_.begin(), stars_.begin() + stars_.size() / 10);
+	if (stars_.size() > STAR_MAX) stars_.resize(STAR_MAX);
+}
+
+double AImageSubtract::measure_fwhm(const float* data, int w) const {
+	vector<double> sigs;
+	double sw, cx, cy, sum, sx, sy, srr, wt, m, s2, dx, dy, v;
+	int i, j, iter;
+	bool good;
+
+	for (size_t k = 0; k < stars_.size(); ++k) {
+		const StarPos& star = stars_[k];
+		// 自适应高斯加权: 对高斯轮廓, 权重宽度为sw时加权二阶矩 m = s2 * sw2 / (s2 + sw2)
+		sw = 1.5;
+		cx = star.x;
+		cy = star.y;
+		for (iter = 0, good = true; iter < 5 && good; ++iter) {
+			sum = sx = sy = srr = 0.0;
+			for (j = -STAR_HALF; j <= STAR_HALF; ++j) {
+				const float* row = data + size_t(star.y + j) * w + star.x;
+				for (i = -STAR_HALF; i <= STAR_HALF; ++i) {
+					dx = star.x + i - cx;
+					dy = star.y + j - cy;
+					wt = exp(-0.5 * (dx * dx + dy * dy) / (sw * sw));
+					v  = row[i] * wt;
+					sum += v;
+					sx  += v * dx;
+					sy  += v * dy;
+					srr += v * (dx * dx + dy * dy);
+				}
+			}
+			if (!(sum > 0.0)) good = false;
+			else {
+				cx += sx / sum;
+				cy += sy / sum;
+				m  = 0.5 * srr / sum;
+				if (m <= 0.0 || m >= sw * sw) good = false;
+				else if ((s2 = m * sw * sw / (sw * sw - m)) > STAR_HALF * STAR_HALF * 0.25) good = false;
+				else sw = sqrt(s2);
+			}
+		}
+		if (good) sigs.push_back(sw);
+	}
+	if (sigs.empty()) return 0.0;
+	std::nth_element(sigs.begin(), sigs.begin() + sigs.size() / 2, sigs.end());
+	return sigs[sigs.size() / 2] * FWHM_SIGMA;
+}
+
+double AImageSubtract::aperture(const float* data, int w, int h, double x, double y, double r, int* npix) {
+	int x0 = int(floor(x - r)), x1 = int(ceil(x + r)), y0 = int(floor(y - r)), y1 = int(ceil(y + r)), i, j, n(0);
+	double r2(r * r), sum(0.0), dy;
+
+	if (x0 < 0 || y0 < 0 || x1 >= w || y1 >= h) return NAN;
+	for (j = y0; j <= y1; ++j) {
+		const float* row = data + size_t(j) * w;
+		dy = (j - y) * (j - y);
+		for (i = x0; i <= x1; ++i) {
+			if ((i - x) * (i - x) + dy > r2) continue;
+			sum += row[i];
+			++n;
+		}
+	}
+	if (npix) *npix = n;
+	return sum;
+}
+
+void AImageSubtract::subtract_rows(const float* img, const float* ref, float scale, int w, int row0, int row1) {
+	size_t i0(size_t(row0) * w), i1(size_t(row1) * w), i;
+	float* __restrict dst = diff_.data();
+
+	for (i = i0; i < i1; ++i) dst[i] = img[i] - scale * ref[i];
+}
+
+void AImageSubtract::box_rows(int w, int h, int row0, int row1) {
+	FloatVec col(w);
+	const PixelKernels& kernels = AKernels::Get();
+	int y;
+
+	for (y = row0; y < row1; ++y) {
+		float* out = tmp_.data() + size_t(y) * w;
+		if (y == 0 || y == h - 1) {
+			std::fill(out, out + w, NAN);
+			continue;
+		}
+		// 先列后行
+		const float* d0 = diff_.data() + size_t(y - 1) * w;
+		kernels.sum3(col.data(), d0, d0 + w, d0 + 2 * w, w);
+		out[0] = out[w - 1] = NAN;
+		kernels.sum3(out + 1, col.data(), col.data() + 1, col.data() + 2, w - 2);
+	}
+}
+
+void AImageSubtract::detect_rows(const float* ref, float scale, int w, int h, double thresh, double sigBox,
+		double sigRef, double radius, int row0, int row1) {
+	DiffSrcVec srcs;
+	int x, y, i, j, npix;
+	float b, a, q;
+	double sum, sx, sy, v, sign;
+	bool peak;
+
+	for (y = std::max(row0, 2); y < std::min(row1, h - 2); ++y) {
+		const float* row = tmp_.data() + size_t(y) * w;
+		for (x = 2; x < w - 2; ++x) {
+			b = row[x];
+			if (!((a = fabs(b)) >= thresh)) continue;
+			// 同号邻域和的极值. 相等时取左上; 邻域含无效像素时放弃
+			for (j = -1, peak = true; j <= 1 && peak; ++j) {
+				for (i = -1; i <= 1 && peak; ++i) {
+					if (!i && !j) continue;
+					q = row[j * w + x + i];
+					if (q != q) peak = false;
+					else {
+						if (b < 0.0f) q = -q;
+						if (q > a || (q == a && (j < 0 || (j == 0 && i < 0)))) peak = false;
+					}
+				}
+			}
+			if (!peak) continue;
+
+			// 质心
+			sign = b > 0.0f ? 1.0 : -1.0;
+			sum = sx = sy = 0.0;
+			for (j = -1; j <= 1; ++j) {
+				const float* d = diff_.data() + size_t(y + j) * w + x;
+				for (i = -1; i <= 1; ++i) {
+					if ((v = d[i] * sign) <= 0.0) continue;
+					sum += v;
+					sx  += v * i;
+					sy  += v * j;
+				}
+			}
+			if (!(sum > 0.0)) continue;
+
+			DiffSource src;
+			src.ptCenter.x  = x + sx / sum;
+			src.ptCenter.y  = y + sy / sum;
+			src.ptEquator.x = src.ptEquator.y = 0.0;
+			src.flux    = aperture(diff_.data(), w, h, src.ptCenter.x, src.ptCenter.y, radius, &npix);
+			src.fluxRef = aperture(ref, w, h, src.ptCenter.x, src.ptCenter.y, radius) * scale;
+			if (src.flux != src.flux || src.fluxRef != src.fluxRef) continue;
+			if (fabs(src.flux) < DIFF_RESIDUAL * fabs(src.fluxRef)) continue;
+			src.snr  = a / sigBox;
+			if (b < 0.0f) src.type = 3;
+			else src.type = src.fluxRef > param_->snr * sigRef * sqrt(double(npix)) ? 2 : 1;
+			srcs.push_back(src);
+		}
+	}
+
+	mutex_lock lck(mtx_);
+	srcs_.insert(srcs_.end(), srcs.begin(), srcs.end());
+}
+
+double AImageSubtract::robust_sigma(const float* data, size_t n) {
+	size_t step = std::max(size_t(1), n / 100000), i;
+	vector<float> buf;
+	float v;
+
+	buf.reserve(n / step + 1);
+	for (i = 0; i < n; i += step) {
+		v = data[i];
+		if (v == v) buf.push_back(v);
+	}
+	if (buf.size() < 10) return 0.0;
+	size_t mid = buf.size() / 2;
+	std::nth_element(buf.begin(), buf.begin() + mid, buf.end());
+	float med = buf[mid];
+	for (i = 0; i < buf.size(); ++i) buf[i] = fabs(buf[i] - med);
+	std::nth_element(buf.begin(), buf.begin() + mid, buf.end());
+	return 1.4826 * buf[mid];
+}
@@ -0,0 +1,265 @@
+/*!
+ * @class AImageSubtract 参考图像差分: 对齐、PSF匹配、相减并探测残差源
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * 参考图像:
+ * - 由同一视场的若干帧扣除背景后的图像合并生成. 各帧重采样至首帧像素网格,
+ *   逐像素剔除最小值和最大值后取均值, 以抑制宇宙线、运动目标和卫星.
+ *   对称剔除使星像轮廓与各帧平均轮廓一致
+ * - 参考图像文件包含文件头(WCS、噪声、半高全宽)及页对齐的像素数据, 以内存映射方式访问
+ * 差分:
+ * - 像素映射由两幅图像的WCS在64像素间隔的网格上计算, 网格内双线性插值;
+ *   参考图像以双三次插值重采样至当前帧. 指向不变时复用已对齐的参考图像
+ * - 以亮星的二阶矩估计两幅图像的半高全宽, 以高斯核卷积较锐利的一幅;
+ *   流量比例取亮星孔径流量比的中值
+ * - 差分图像3*3邻域和的极值(正负)超过阈值时确认为残差源, 按参考图像流量分类
+ * - 重采样、卷积和探测均按行分段, 由多线程并行. 卷积按行向量化
+ */
+
+#ifndef AIMAGESUBTRACT_H_
+#define AIMAGESUBTRACT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include "ImageFrame.hpp"
+#include "Parameter.hpp"
+
+#define REF_IMAGE_MAGIC		"ADIPSREF"	/// 参考图像文件标识
+#define REF_IMAGE_VERSION	1			/// 参考图像文件版本
+
+/*!
+ * @struct RefImageHeader 参考图像文件头
+ */
+struct RefImageHeader {
+	char magic[8];		/// 文件标识
+	uint32_t version;	/// 版本
+	uint32_t nframe;	/// 参与合并的帧数
+	uint32_t width;		/// 图像宽度
+	uint32_t height;	/// 图像高度
+	double sig;			/// 背景噪声
+	double fwhm;		/// 半高全宽, 量纲: 像素
+	WCSTan wcs;			/// WCS
+	uint64_t offData;	/// 像素数据在文件中的偏移量. 无覆盖的像素为NaN
+};
+
+class AImageSubtract {
+public:
+	AImageSubtract(const ParamDiff* param);
+	virtual ~AImageSubtract();
+
+protected:
+	typedef std::vector<float> FloatVec;
+	typedef boost::unique_lock<boost::mutex> mutex_lock;
+
+	/*!
+	 * @struct PixelMap 像素映射网格: 当前图像像素至目标图像像素
+	 */
+	struct PixelMap {
+		unsigned w, h;	/// 当前图像尺寸
+		int nx, ny;		/// 网格节点数
+		FloatVec x, y;	/// 节点在目标图像中的坐标
+	};
+
+	/*!
+	 * @struct StarPos 用于估计半高全宽和流量比例的亮星
+	 */
+	struct StarPos {
+		int x, y;	/// 峰值位置
+		float peak;	/// 峰值
+	};
+
+protected:
+	const ParamDiff* param_;	/// 配置参数
+	unsigned nthread_;	/// 线程数
+	/* 参考图像 */
+	int fd_;			/// 文件描述符
+	void* addr_;		/// 映射地址
+	size_t size_;		/// 文件长度
+	const RefImageHeader* header_;	/// 文件头
+	const float* ref_;	/// 像素数据
+	/* 合并 */
+	unsigned wComb_, hComb_;	/// 参考图像尺寸
+	WCSTan wcsComb_;	/// 参考图像WCS
+	FloatVec sum_;		/// 逐像素累加和
+	FloatVec min_, max_;	/// 逐像素最小值和最大值
+	std::vector<uint16_t> count_;	/// 逐像素有效帧数
+	int nComb_;			/// 已合并帧数
+	/* 已对齐的参考图像 */
+	PixelMap map_;		/// 当前帧至参考图像的像素映射
+	PixelMap mapAln_;	/// 已对齐参考图像对应的像素映射
+	FloatVec alnRaw_;	/// 重采样后的参考图像
+	FloatVec alnConv_;	/// 重采样并卷积后的参考图像
+	double sigConv_;	/// alnConv_的卷积核宽度. 负值: 无效
+	/* 差分 */
+	FloatVec work_;		/// 卷积后的当前帧
+	FloatVec tmp_;		/// 卷积中间结果和邻域和
+	FloatVec diff_;		/// 差分图像
+	std::vector<StarPos> stars_;	/// 亮星
+	DiffSrcVec srcs_;	/// 残差源
+	boost::mutex mtx_;	/// 互斥锁: 亮星和残差源
+	/* 统计 */
+	double msElapse_;	/// 最近一帧耗时, 量纲: 毫秒
+	double fwhmImg_, fwhmRef_;	/// 最近一帧及对齐后参考图像的半高全宽
+	double scale_;		/// 最近一帧的流量比例
+	bool reuse_;		/// 最近一帧复用了已对齐的参考图像
+
+public:
+	/*!
+	 * @brief 映射参考图像文件
+	 * @param filepath  文件路径
+	 * @return
+	 * 文件有效性
+	 */
+	bool Open(const char* filepath);
+	/*!
+	 * @brief 解除映射
+	 */
+	void Close();
+	/*!
+	 * @brief 检查是否已映射参考图像
+	 */
+	bool IsOpen() const;
+	/*!
+	 * @brief 参考图像文件头
+	 */
+	const RefImageHeader* Header() const;
+	/*!
+	 * @brief 开始合并参考图像
+	 * @param w    图像宽度
+	 * @param h    图像高度
+	 * @param wcs  参考图像WCS. 其后加入的帧重采样至该像素网格
+	 */
+	void BeginCombine(unsigned w, unsigned h, const WCSTan& wcs);
+	/*!
+	 * @brief 加入一帧扣除背景后的图像
+	 * @return
+	 * 已合并帧数. 尺寸不一致时返回-1
+	 */
+	int AddCombine(const float* data, unsigned w, unsigned h, const WCSTan& wcs);
+	/*!
+	 * @brief 已合并帧数
+	 */
+	int CombineCount() const;
+	/*!
+	 * @brief 完成合并, 写入参考图像文件并映射
+	 * @param filepath  文件路径
+	 * @return
+	 * 写入并映射成功
+	 */
+	bool EndCombine(const char* filepath);
+	/*!
+	 * @brief 与参考图像相减并探测残差源
+	 * @param data  扣除背景后的图像数据
+	 * @param w     图像宽度
+	 * @param h     图像高度
+	 * @param wcs   图像WCS
+	 * @param sig   背景噪声
+	 * @param srcs  残差源, 按信噪比降序排列
+	 * @return
+	 * 残差源数量. 未映射参考图像时返回-1
+	 */
+	int Subtract(const float* data, unsigned w, unsigned h, const WCSTan& wcs, double sig, DiffSrcVec& srcs);
+	/*!
+	 * @brief 最近一帧的差分图像
+	 */
+	const float* Difference() const;
+	/*!
+	 * @brief 查看最近一帧的统计量
+	 * @param fwhm     当前帧半高全宽
+	 * @param fwhmRef  对齐后参考图像半高全宽
+	 * @param scale    流量比例
+	 * @param reuse    是否复用了已对齐的参考图像
+	 * @return
+	 * 耗时, 量纲: 毫秒
+	 */
+	double LastStat(double& fwhm, double& fwhmRef, double& scale, bool& reuse) const;
+
+protected:
+	/*!
+	 * @brief 将[0, n)分段后以多线程执行
+	 */
+	void parallel(int n, const boost::function<void (int, int)>& func);
+	/*!
+	 * @brief 计算像素映射网格
+	 * @param wcs     当前图像WCS
+	 * @param w       当前图像宽度
+	 * @param h       当前图像高度
+	 * @param wcsTo   目标图像WCS
+	 * @param map     映射网格
+	 */
+	static void build_map(const WCSTan& wcs, unsigned w, unsigned h, const WCSTan& wcsTo, PixelMap& map);
+	/*!
+	 * @brief 检查两个映射网格的偏差是否可忽略
+	 */
+	static bool same_map(const PixelMap& map1, const PixelMap& map2);
+	/*!
+	 * @brief 以双三次插值重采样, 处理行[row0, row1)
+	 * @param src   源图像
+	 * @param ws    源图像宽度
+	 * @param hs    源图像高度
+	 * @param map   目标图像至源图像的像素映射
+	 * @param dst   目标图像. 超出源图像范围的像素为NaN
+	 */
+	static void resample(const float* src, unsigned ws, unsigned hs, const PixelMap* map, float* dst,
+			int row0, int row1);
+	/*!
+	 * @brief 合并: 重采样并累加, 处理参考图像行[row0, row1)
+	 */
+	void combine_rows(const float* data, unsigned w, unsigned h, const PixelMap* map, int row0, int row1);
+	/*!
+	 * @brief 高斯卷积
+	 * @param src    源图像
+	 * @param w      宽度
+	 * @param h      高度
+	 * @param sigma  高斯核标准差
+	 * @param dst    卷积结果
+	 */
+	void convolve(const float* src, unsigned w, unsigned h, double sigma, FloatVec& dst);
+	/*!
+	 * @brief 行方向卷积, 处理行[row0, row1)
+	 */
+	static void conv_rows(const float* src, int w, const FloatVec* kernel, float* dst, int row0, int row1);
+	/*!
+	 * @brief 列方向卷积, 处理行[row0, row1)
+	 */
+	static void conv_cols(const float* src, int w, int h, const FloatVec* kernel, float* dst, int row0, int row1);
+	/*!
+	 * @brief 查找亮星, 处理行[row0, row1)
+	 */
+	void find_stars(const float* data, int w, int h, float thresh, int row0, int row1);
+	/*!
+	 * @brief 亮星按峰值排序, 剔除可能饱和的最亮者并限制数量
+	 */
+	void select_stars();
+	/*!
+	 * @brief 以亮星的自适应高斯加权二阶矩估计半高全宽
+	 */
+	double measure_fwhm(const float* data, int w) const;
+	/*!
+	 * @brief 孔径流量
+	 */
+	static double aperture(const float* data, int w, int h, double x, double y, double r, int* npix = NULL);
+	/*!
+	 * @brief 相减, 处理行[row0, row1)
+	 */
+	void subtract_rows(const float* img, const float* ref, float scale, int w, int row0, int row1);
+	/*!
+	 * @brief 差分图像的3*3邻域和, 处理行[row0, row1)
+	 */
+	void box_rows(int w, int h, int row0, int row1);
+	/*!
+	 * @brief 探测残差源, 处理行[row0, row1)
+	 */
+	void detect_rows(const float* ref, float scale, int w, int h, double thresh, double sigBox,
+			double sigRef, double radius, int row0, int row1);
+	/*!
+	 * @brief 以稀疏采样的中值绝对偏差估计噪声
+	 */
+	static double robust_sigma(const float* data, size_t n);
+};
+
+#endif /* AIMAGESUBTRACT_H_ */
@@ -0,0 +1,133 @@
+/*!
+ * @class AInterWriter 中间结果输出: 背景、噪声网格及像素掩模, 写入Rice压缩的FITS文件
+ * @version 0.1
+ * @date 2021-05
+ */
+
+#include <math.h>
+#include <longnam.h>
+#include <fitsio.h>
+#include <boost/bind/bind.hpp>
+#include <boost/filesystem.hpp>
+#include "AInterWriter.h"
+#include "GLog.h"
+
+using namespace boost::filesystem;
+
+#define MASK_TILE_ROWS	32	/// 掩模压缩分块的行数
+
+AInterWriter::AInterWriter(Parameter* param) {
+	param_ = param;
+	nWrite_ = nFail_ = 0;
+	bytes_  = 0;
+}
+
+AInterWriter::~AInterWriter() {
+	Stop();
+}
+
+bool AInterWriter::Start() {
+	if (thrds_.size()) return true;
+	unsigned n = param_->output.interThreads;
+	if (!n) n = 1;
+	if (n > 1 && !fits_is_reentrant()) {// cfitsio未以线程安全方式编译: 多个写线程与读取线程并发不安全
+		_gLog.Write(LOG_WARN, "cfitsio is not reentrant, intermediate products are written by one thread");
+		n = 1;
+	}
+	queue_.Reset(param_->output.interQueue);
+	nWrite_ = nFail_ = 0;
+	bytes_  = 0;
+	for (unsigned i = 0; i < n; ++i) {
+		thrds_.push_back(threadptr(new boost::thread(boost::bind(&AInterWriter::thread_write, this))));
+	}
+	return true;
+}
+
+void AInterWriter::Stop() {
+	if (thrds_.empty()) return;
+	queue_.Stop();
+	for (threadvec::iterator it = thrds_.begin(); it != thrds_.end(); ++it) (*it)->join();
+	thrds_.clear();
+	_gLog.Write("intermediate summary: %d frames written, %d failed, %.1f MB, producer stalled %.1f ms",
+			nWrite_, nFail_, bytes_ / 1048576.0, queue_.StallMs());
+}
+
+void AInterWriter::Push(ProductPtr product) {
+	queue_.Push(product);
+}
+
+void AInterWriter::thread_write() {
+	while (true) {
+		ProductPtr product;
+		if (!queue_.Pop(product)) break;
+		std::string dir = param_->preProc.pathWork;
+		if (dir.empty()) dir = product->pathdir.empty() ? "." : product->pathdir;
+		boost::system::error_code ec;
+		if (!exists(dir, ec)) create_directories(dir, ec);
+		path filepath = path(dir) / (product->filetit + ".inter.fits");
+		int state = write_product(product.get(), filepath.string());
+
+		mutex_lock lck(mtx_);
+		if (state) {
+			++nFail_;
+			_gLog.Write(LOG_FAULT, "failed to write [%s], FITS status = %d", filepath.c_str(), state);
+		}
+		else {
+			uintmax_t bytes = file_size(filepath, ec);
+			++nWrite_;
+			if (!ec) bytes_ += size_t(bytes);
+		}
+	}
+}
+
+/*!
+ * @brief 写入压缩的浮点网格
+ */
+static void write_grid(fitsfile* fits, const char* extname, const std::vector<float>& grid,
+		const AInterWriter::InterProduct* product, float quantize, int& state) {
+	long naxes[2] = { long(product->nbkx), long(product->nbky) };
+	int wGrid(product->wGrid), hGrid(product->hGrid), wImg(product->wImg), hImg(product->hImg);
+	std::vector<float> data(grid);
+	// 无效网格以大负数标记, 写为NaN以免影响量化尺度
+	for (std::vector<float>::iterator it = data.begin(); it != data.end(); ++it) {
+		if (*it <= -1E29) *it = NAN;
+	}
+
+	fits_set_compression_type(fits, RICE_1, &state);
+	fits_set_tile_dim(fits, 2, naxes, &state);
+	fits_set_quantize_level(fits, quantize, &state);
+	fits_set_quantize_method(fits, SUBTRACTIVE_DITHER_1, &state);
+	fits_create_img(fits, FLOAT_IMG, 2, naxes, &state);
+	fits_write_key(fits, TSTRING, "EXTNAME", (void*) extname, "", &state);
+	fits_write_key(fits, TINT, "GRIDW",  &wGrid, "grid width (pixel)", &state);
+	fits_write_key(fits, TINT, "GRIDH",  &hGrid, "grid height (pixel)", &state);
+	fits_write_key(fits, TINT, "IMAGEW", &wImg,  "image width (pixel)", &state);
+	fits_write_key(fits, TINT, "IMAGEH", &hImg,  "image height (pixel)", &state);
+	fits_write_img(fits, TFLOAT, 1, data.size(), data.data(), &state);
+}
+
+int AInterWriter::write_product(InterProduct* product, const std::string& filepath) {
+	fitsfile* fits(NULL);
+	std::string pathNew = "!" + filepath;
+	int state(0);
+
+	fits_create_file(&fits, pathNew.c_str(), &state);
+	if (state) return state;
+	fits_create_img(fits, BYTE_IMG, 0, NULL, &state);
+	write_grid(fits, "BACK", product->back, product, param_->output.interQuantize, state);
+	write_grid(fits, "RMS",  product->rms,  product, param_->output.interQuantize, state);
+	if (product->mask) {// 掩模: 整数无损压缩
+		long naxes[2] = { long(product->wImg), long(product->hImg) };
+		long tile[2]  = { long(product->wImg), MASK_TILE_ROWS };
+		fits_set_compression_type(fits, RICE_1, &state);
+		fits_set_tile_dim(fits, 2, tile, &state);
+		fits_create_img(fits, BYTE_IMG, 2, naxes, &state);
+		fits_write_key(fits, TSTRING, "EXTNAME", (void*) "MASK", "", &state);
+		fits_write_key(fits, TSTRING, "BIT1", (void*) "bad pixel", "", &state);
+		fits_write_key(fits, TSTRING, "BIT2", (void*) "streak", "", &state);
+		fits_write_img(fits, TBYTE, 1, LONGLONG(product->wImg) * product->hImg, product->mask.get(), &state);
+	}
+	int state1(0);
+	fits_close_file(fits, &state1);
+	return state ? state : state1;
+}
@@ -0,0 +1,97 @@
+/*!
+ * @class AInterWriter 中间结果输出: 背景、噪声网格及像素掩模, 写入Rice压缩的FITS文件
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * - 文件: <目录>/<文件名>.inter.fits. 目录: 工作目录; 未配置时与图像同目录
+ * - 扩展: BACK(背景网格)、RMS(噪声网格)、MASK(像素掩模, 按位标记, 见MASK_BADPIX等).
+ *   背景与噪声以网格输出, 全分辨率图像由网格插值恢复. 关键字GRIDW/GRIDH为网格尺寸, IMAGEW/IMAGEH为图像尺寸
+ * - 网格为浮点数, 按噪声量化后Rice压缩; 掩模无损Rice压缩. 无效网格写为NaN
+ * - 待写队列有上限. 队列满时Push阻塞, 限制缓存的内存. 多个写线程并行压缩不同的帧
+ * - cfitsio未以线程安全方式编译(fits_is_reentrant()为0)时仅使用一个写线程
+ */
+
+#ifndef AINTERWRITER_H_
+#define AINTERWRITER_H_
+
+#include <string>
+#include <vector>
+#include <boost/smart_ptr/shared_ptr.hpp>
+#include <boost/smart_ptr/shared_array.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include "Parameter.hpp"
+#include "BoundedQueue.hpp"
+
+class AInterWriter {
+public:
+	AInterWriter(Parameter* param);
+	virtual ~AInterWriter();
+
+public:
+	/*!
+	 * @struct InterProduct 单帧中间结果
+	 */
+	struct InterProduct {
+		std::string filetit;	/// 文件名(不含扩展名)
+		std::string pathdir;	/// 图像所在目录
+		unsigned wImg, hImg;	/// 图像尺寸
+		unsigned wGrid, hGrid;	/// 网格尺寸
+		unsigned nbkx, nbky;	/// 网格数量
+		std::vector<float> back;	/// 背景网格
+		std::vector<float> rms;		/// 噪声网格
+		boost::shared_array<char> mask;	/// 像素掩模. 空: 不输出
+
+	public:
+		InterProduct() {
+			wImg = hImg = 0;
+			wGrid = hGrid = 0;
+			nbkx = nbky = 0;
+		}
+	};
+	typedef boost::shared_ptr<InterProduct> ProductPtr;
+
+protected:
+	typedef boost::unique_lock<boost::mutex> mutex_lock;
+	typedef boost::shared_ptr<boost::thread> threadptr;
+	typedef std::vector<threadptr> threadvec;
+
+protected:
+	Parameter* param_;		/// 配置参数
+	BoundedQueue<ProductPtr> queue_;	/// 待写队列
+	threadvec thrds_;		/// 写线程
+	boost::mutex mtx_;		/// 互斥锁: 统计
+	/* 统计 */
+	int nWrite_;		/// 已写入的帧数
+	int nFail_;			/// 写入失败的帧数
+	size_t bytes_;		/// 写入文件的总字节数
+
+public:
+	/*!
+	 * @brief 启动写线程
+	 */
+	bool Start();
+	/*!
+	 * @brief 写入全部待写帧并停止写线程
+	 */
+	void Stop();
+	/*!
+	 * @brief 加入待写队列. 队列满时阻塞
+	 */
+	void Push(ProductPtr product);
+
+protected:
+	/*!
+	 * @brief 写线程
+	 */
+	void thread_write();
+	/*!
+	 * @brief 写入单帧
+	 * @return
+	 * FITS错误码. 0: 成功
+	 */
+	int write_product(InterProduct* product, const std::string& filepath);
+};
+typedef boost::shared_ptr<AInterWriter> InterWriterPtr;
+
+#endif /* AINTERWRITER_H_ */
@@ -0,0 +1,127 @@
+/*!
+ * @class AKernels 像素运算核: 同一份实现按多个指令集编译, 启动时依据CPUID选择
+ * @version 0.1
+ * @date 2021-05
+ */
+
+#include <atomic>
+#include <boost/algorithm/string.hpp>
+#include "AKernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNEL_X86
+#endif
+
+/* 标量参考实现: 禁止自动向量化 */
+#define KERNEL_NS		kscalar
+#define KERNEL_NAME		"scalar"
+#if defined(__GNUC__) && !defined(__clang__)
+#define KERNEL_ATTR		__attribute__((optimize("no-tree-vectorize")))
+#else
+#define KERNEL_ATTR
+#endif
+#include "AKernelsImpl.hpp"
+#undef KERNEL_NS
+#undef KERNEL_NAME
+#undef KERNEL_ATTR
+
+/* 编译器缺省指令集. x86-64: SSE2 */
+#define KERNEL_NS		kbase
+#ifdef KERNEL_X86
+#define KERNEL_NAME		"sse2"
+#else
+#define KERNEL_NAME		"generic"
+#endif
+#define KERNEL_SIMD
+#define KERNEL_ATTR
+#include "AKernelsImpl.hpp"
+#undef KERNEL_NS
+#undef KERNEL_NAME
+#undef KERNEL_ATTR
+
+#ifdef KERNEL_X86
+#define KERNEL_NS		kavx2
+#define KERNEL_NAME		"avx2"
+#define KERNEL_ATTR		__attribute__((target("avx2,fma")))
+#include "AKernelsImpl.hpp"
+#undef KERNEL_NS
+#undef KERNEL_NAME
+#undef KERNEL_ATTR
+
+#define KERNEL_NS		kavx512
+#define KERNEL_NAME		"avx512"
+#define KERNEL_ATTR		__attribute__((target("avx512f,avx512bw,avx512dq,avx512vl,avx2,fma,prefer-vector-width=512")))
+#include "AKernelsImpl.hpp"
+#undef KERNEL_NS
+#undef KERNEL_NAME
+#undef KERNEL_ATTR
+#endif
+#undef KERNEL_SIMD
+
+/*!
+ * @brief 全部版本, 由低到高排列
+ */
+static const PixelKernels* const variants[] = {
+	&kscalar::table, &kbase::table,
+#ifdef KERNEL_X86
+	&kavx2::table, &kavx512::table,
+#endif
+};
+
+static const int nvariant = int(sizeof(variants) / sizeof(variants[0]));
+
+static std::atomic<const PixelKernels*> current(NULL);
+
+/*!
+ * @brief 检查CPU是否支持指令集
+ */
+static bool cpu_supports(const PixelKernels* kernels) {
+#ifdef KERNEL_X86
+	__builtin_cpu_init();
+	if (kernels == &kavx2::table)
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+	if (kernels == &kavx512::table)
+		return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+				&& __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl");
+#endif
+	return true;
+}
+
+/*!
+ * @brief CPU支持的最高指令集
+ */
+static const PixelKernels* detect() {
+	for (int i = nvariant - 1; i > 0; --i) {
+		if (cpu_supports(variants[i])) return variants[i];
+	}
+	return variants[0];
+}
+
+const PixelKernels& AKernels::Get() {
+	const PixelKernels* kernels = current.load(std::memory_order_acquire);
+	if (!kernels) {
+		kernels = detect();
+		current.store(kernels, std::memory_order_release);
+	}
+	return *kernels;
+}
+
+bool AKernels::Select(const std::string& name) {
+	const PixelKernels* kernels = name.empty() || boost::iequals(name, "auto") ? detect() : Find(name);
+	current.store(kernels ? kernels : detect(), std::memory_order_release);
+	return kernels != NULL;
+}
+
+const PixelKernels* AKernels::Find(const std::string& name) {
+	for (int i = 0; i < nvariant; ++i) {
+		if (boost::iequals(name, variants[i]->name)) return cpu_supports(variants[i]) ? variants[i] : NULL;
+	}
+	return NULL;
+}
+
+void AKernels::Supported(std::vector<std::string>& names) {
+	names.clear();
+	for (int i = 0; i < nvariant; ++i) {
+		if (cpu_supports(variants[i])) names.push_back(variants[i]->name);
+	}
+}
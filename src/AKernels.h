@@ -0,0 +1,110 @@
+/*!
+ * @class AKernels 像素运算核: 同一份实现按多个指令集编译, 启动时依据CPUID选择
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * - x86版本: scalar(标量参考实现), sse2(x86-64基线), avx2(AVX2+FMA), avx512(AVX-512F/BW/DQ/VL)
+ * - 其它平台: scalar, generic(编译器缺省指令集)
+ * - 各版本由AKernelsImpl.hpp以不同的target属性实例化, 循环由编译器自动向量化, 不使用内建函数
+ * - 求和以omp simd归约并行累加(编译选项-fopenmp-simd), 累加顺序随向量宽度变化, 各版本间存在双精度舍入差异
+ * - scalar按像素顺序累加, 不向量化, 与原逐像素实现结果一致, 用于验证和对比
+ * - 启用FMA的版本中乘加运算可能合并, 与其它版本的差异在单精度舍入误差以内
+ */
+
+#ifndef AKERNELS_H_
+#define AKERNELS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+/*!
+ * @struct PixelKernels 像素运算核函数表
+ */
+struct PixelKernels {
+	const char* name;	/// 指令集名称
+
+	/*!
+	 * @brief 逐像素相减: img -= sub
+	 */
+	void (*subtract)(float* img, const float* sub, size_t n);
+	/*!
+	 * @brief 逐像素减去比例项: img -= sub * k
+	 */
+	void (*subtract_scaled)(float* img, const float* sub, float k, size_t n);
+	/*!
+	 * @brief 逐像素相除: img /= div
+	 */
+	void (*divide)(float* img, const float* div, size_t n);
+	/*!
+	 * @brief 乘以常数: img = float(img * k), 乘法以双精度计算
+	 */
+	void (*scale)(float* img, double k, size_t n);
+	/*!
+	 * @brief 逐像素累加: acc += src
+	 */
+	void (*accumulate)(float* acc, const float* src, size_t n);
+	/*!
+	 * @brief 乘加: acc += k * src
+	 */
+	void (*axpy)(float* acc, const float* src, float k, size_t n);
+	/*!
+	 * @brief 三项求和: out = a + b + c
+	 */
+	void (*sum3)(float* out, const float* a, const float* b, const float* c, size_t n);
+	/*!
+	 * @brief 统计矩形区域的一阶和二阶矩
+	 * @param data    区域起始地址
+	 * @param stride  行间距, 量纲: 像素
+	 * @param w       区域宽度
+	 * @param h       区域高度
+	 * @param sum     像素值之和
+	 * @param sumsq   像素值平方之和
+	 */
+	void (*moments)(const float* data, size_t stride, size_t w, size_t h, double* sum, double* sumsq);
+	/*!
+	 * @brief 统计矩形区域内[lo, hi]范围像素的一阶和二阶矩
+	 * @return
+	 * 参与统计的像素数
+	 */
+	size_t (*moments_clip)(const float* data, size_t stride, size_t w, size_t h, float lo, float hi,
+			double* sum, double* sumsq);
+	/*!
+	 * @brief 3*3局部极值候选. 中心值同时严格大于、严格小于邻近值时不是极值, 标记为0; 否则标记为1
+	 * @param above  上一行
+	 * @param row    当前行
+	 * @param below  下一行
+	 * @param n      行长度. 仅处理[1, n-1)
+	 * @param flag   标记, 长度为n
+	 */
+	void (*extrema)(const float* above, const float* row, const float* below, size_t n, uint8_t* flag);
+};
+
+class AKernels {
+public:
+	/*!
+	 * @brief 当前使用的运算核. 未选择时按CPU支持的最高指令集选择
+	 */
+	static const PixelKernels& Get();
+	/*!
+	 * @brief 选择运算核
+	 * @param name  指令集名称. 空或auto: 自动选择
+	 * @return
+	 * 选择结果. 名称无效或CPU不支持时返回false, 保持自动选择
+	 */
+	static bool Select(const std::string& name);
+	/*!
+	 * @brief 查找运算核
+	 * @param name  指令集名称
+	 * @return
+	 * 运算核. 名称无效或CPU不支持时返回NULL
+	 */
+	static const PixelKernels* Find(const std::string& name);
+	/*!
+	 * @brief 当前CPU支持的指令集名称, 由低到高排列
+	 */
+	static void Supported(std::vector<std::string>& names);
+};
+
+#endif /* AKERNELS_H_ */
@@ -0,0 +1,104 @@
+/**
+ * @file AKernelsImpl.hpp 像素运算核实现. 由AKernels.cpp按不同指令集多次包含, 无包含保护
+ * @version 0.1
+ * @note
+ * 包含前定义:
+ * - KERNEL_NS     命名空间
+ * - KERNEL_NAME   指令集名称
+ * - KERNEL_ATTR   函数属性, 如target("avx2,fma")
+ * - KERNEL_SIMD   可选. 定义时求和循环按向量宽度并行累加(omp simd), 否则按像素顺序累加
+ */
+
+namespace KERNEL_NS {
+//////////////////////////////////////////////////////////////////////////////
+KERNEL_ATTR static void subtract(float* __restrict img, const float* __restrict sub, size_t n) {
+	for (size_t i = 0; i < n; ++i) img[i] -= sub[i];
+}
+
+KERNEL_ATTR static void subtract_scaled(float* __restrict img, const float* __restrict sub, float k, size_t n) {
+	for (size_t i = 0; i < n; ++i) img[i] -= sub[i] * k;
+}
+
+KERNEL_ATTR static void divide(float* __restrict img, const float* __restrict div, size_t n) {
+	for (size_t i = 0; i < n; ++i) img[i] /= div[i];
+}
+
+KERNEL_ATTR static void scale(float* __restrict img, double k, size_t n) {
+	for (size_t i = 0; i < n; ++i) img[i] = float(img[i] * k);
+}
+
+KERNEL_ATTR static void accumulate(float* __restrict acc, const float* __restrict src, size_t n) {
+	for (size_t i = 0; i < n; ++i) acc[i] += src[i];
+}
+
+KERNEL_ATTR static void axpy(float* __restrict acc, const float* __restrict src, float k, size_t n) {
+	for (size_t i = 0; i < n; ++i) acc[i] += k * src[i];
+}
+
+KERNEL_ATTR static void sum3(float* __restrict out, const float* __restrict a, const float* __restrict b,
+		const float* __restrict c, size_t n) {
+	for (size_t i = 0; i < n; ++i) out[i] = a[i] + b[i] + c[i];
+}
+
+KERNEL_ATTR static void moments(const float* data, size_t stride, size_t w, size_t h, double* sum, double* sumsq) {
+	double s(0.0), q(0.0);
+
+	for (size_t y = 0; y < h; ++y, data += stride) {
+		const float* __restrict p = data;
+#ifdef KERNEL_SIMD
+#pragma omp simd reduction(+:s, q)
+#endif
+		for (size_t x = 0; x < w; ++x) {
+			float t = p[x];
+			s += t;
+			q += t * t;
+		}
+	}
+	*sum   = s;
+	*sumsq = q;
+}
+
+KERNEL_ATTR static size_t moments_clip(const float* data, size_t stride, size_t w, size_t h, float lo, float hi,
+		double* sum, double* sumsq) {
+	// 范围外的像素以0参与累加, 不影响结果且无分支
+	double s(0.0), q(0.0), c(0.0);
+
+	for (size_t y = 0; y < h; ++y, data += stride) {
+		const float* __restrict p = data;
+#ifdef KERNEL_SIMD
+#pragma omp simd reduction(+:s, q, c)
+#endif
+		for (size_t x = 0; x < w; ++x) {
+			float t = p[x];
+			bool in = t >= lo && t <= hi;
+			t = in ? t : 0.0f;
+			s += t;
+			q += t * t;
+			c += in ? 1.0 : 0.0;
+		}
+	}
+	*sum   = s;
+	*sumsq = q;
+	return size_t(c);
+}
+
+KERNEL_ATTR static void extrema(const float* __restrict above, const float* __restrict row,
+		const float* __restrict below, size_t n, uint8_t* __restrict flag) {
+	// 逐项比较而非取最大/最小值: 与逐像素判定对NaN的处理一致
+	for (size_t x = 1; x + 1 < n; ++x) {
+		float v = row[x];
+		int gt = (v > above[x - 1]) | (v > above[x]) | (v > above[x + 1])
+				| (v > row[x - 1]) | (v > row[x + 1])
+				| (v > below[x - 1]) | (v > below[x]) | (v > below[x + 1]);
+		int lt = (v < above[x - 1]) | (v < above[x]) | (v < above[x + 1])
+				| (v < row[x - 1]) | (v < row[x + 1])
+				| (v < below[x - 1]) | (v < below[x]) | (v < below[x + 1]);
+		flag[x] = uint8_t(!(gt & lt));
+	}
+}
+
+static const PixelKernels table = {
+	KERNEL_NAME, subtract, subtract_scaled, divide, scale, accumulate, axpy, sum3, moments, moments_clip, extrema
+};
+//////////////////////////////////////////////////////////////////////////////
+}
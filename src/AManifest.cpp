@@ -0,0 +1,252 @@
+/*!
+ * @class AManifest 结果清单: 记录各帧的处理结果, 用于中断或修改配置后的续处理
+ * @version 0.1
+ * @date 2021-05
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <sstream>
+#include <boost/filesystem.hpp>
+#include "AManifest.h"
+
+using namespace boost::filesystem;
+
+/*!
+ * @struct ManifestRecord 记录文件头. 其后依次为: 全路径名、曝光起始时间、目标、拖线、残差源
+ */
+struct ManifestRecord {
+	char magic[8];		/// 标识
+	uint32_t version;	/// 版本
+	int32_t stageDone;	/// 已完成的环节
+	int32_t stageFail;	/// 失败的环节
+	uint32_t lenPath;	/// 全路径名长度
+	uint32_t lenDate;	/// 曝光起始时间长度
+	uint32_t nbody;		/// 目标数量
+	uint32_t nstreak;	/// 拖线数量
+	uint32_t ndiff;		/// 残差源数量
+	uint64_t size;		/// 输入文件长度
+	int64_t mtime;		/// 输入文件修改时间
+	uint64_t digest[STAGE_MAX];	/// 各环节的配置摘要. 仅已完成或失败的环节有效
+	/* 处理结果 */
+	uint32_t wImg, hImg;
+	double expdur;
+	double bkMean, bkSigma;
+	double fwhm;
+	point_2f coordCenter;
+	WCSTan wcs;
+	uint8_t succAstro, succPhoto;
+};
+
+/*!
+ * @brief 64位FNV-1a散列
+ */
+static uint64_t fnv1a(const std::string& str) {
+	uint64_t hash(14695981039346656037ULL);
+	for (std::string::const_iterator it = str.begin(); it != str.end(); ++it) {
+		hash ^= uint8_t(*it);
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+AManifest::AManifest(Parameter* param) {
+	param_  = param;
+	pathDir_ = param->output.pathManifest;
+	nSkip_ = nResume_ = 0;
+	make_digest();
+}
+
+AManifest::~AManifest() {
+}
+
+bool AManifest::Open() {
+	boost::system::error_code ec;
+	create_directories(pathDir_, ec);
+	return is_directory(pathDir_, ec);
+}
+
+int AManifest::Resume(ImgFrmPtr frame) {
+	ManifestRecord rec;
+	uint64_t size;
+	int64_t mtime;
+	FILE* fp;
+
+	if (frame->filepath.empty() || !file_identity(frame->filepath, size, mtime)) return STAGE_REDUCE;
+	if (!(fp = fopen(record_path(frame->filepath).c_str(), "rb"))) return STAGE_REDUCE;
+
+	std::string filepath, dateobs;
+	CeleBodyVec bodies;
+	StreakVec streaks;
+	DiffSrcVec diffs;
+	bool rslt = fread(&rec, sizeof(rec), 1, fp) == 1
+			&& !memcmp(rec.magic, MANIFEST_MAGIC, sizeof(rec.magic))
+			&& rec.version == MANIFEST_VERSION
+			&& rec.size == size && rec.mtime == mtime
+			&& rec.lenPath < 4096 && rec.lenDate < 64;
+	if (rslt) {
+		filepath.resize(rec.lenPath);
+		dateobs.resize(rec.lenDate);
+		bodies.resize(rec.nbody);
+		streaks.resize(rec.nstreak);
+		diffs.resize(rec.ndiff);
+		rslt = (!rec.lenPath || fread(&filepath[0], rec.lenPath, 1, fp) == 1)
+				&& (!rec.lenDate || fread(&dateobs[0], rec.lenDate, 1, fp) == 1)
+				&& (!rec.nbody   || fread(bodies.data(),  sizeof(CelestialBody), rec.nbody,   fp) == rec.nbody)
+				&& (!rec.nstreak || fread(streaks.data(), sizeof(StreakSegment), rec.nstreak, fp) == rec.nstreak)
+				&& (!rec.ndiff   || fread(diffs.data(),   sizeof(DiffSource),    rec.ndiff,   fp) == rec.ndiff)
+				&& filepath == frame->filepath;
+	}
+	fclose(fp);
+	if (!rslt) return STAGE_REDUCE;
+
+	// 按处理顺序查找第一个需要重新执行的环节
+	int stage;
+	for (stage = STAGE_REDUCE; stage < STAGE_MAX; ++stage) {
+		if (!enabled_[stage]) continue;
+		if (rec.digest[stage] != digest_[stage]) break;
+		if (stage == rec.stageFail) {// 同一配置下曾失败: 结果不变
+			stage = STAGE_MAX;
+			break;
+		}
+		if (stage > rec.stageDone) break;
+	}
+	// 差分成像需要图像数据
+	if (stage < STAGE_MAX && stage > STAGE_REDUCE && stage <= STAGE_DIFF && enabled_[STAGE_DIFF])
+		stage = STAGE_REDUCE;
+	if (stage == STAGE_REDUCE) return stage;
+
+	// 恢复处理结果
+	frame->stageDone = std::min(int(rec.stageDone), stage - 1);
+	frame->stageFail = stage == STAGE_MAX ? int(rec.stageFail) : STAGE_NONE;
+	frame->dateobs   = dateobs;
+	frame->wImg      = rec.wImg;
+	frame->hImg      = rec.hImg;
+	frame->expdur    = rec.expdur;
+	frame->bkMean    = rec.bkMean;
+	frame->bkSigma   = rec.bkSigma;
+	frame->fwhm      = rec.fwhm;
+	frame->coordCenter = rec.coordCenter;
+	frame->wcs       = rec.wcs;
+	frame->succAstro = rec.succAstro && frame->stageDone >= STAGE_ASTROMETRY;
+	frame->succPhoto = rec.succPhoto && frame->stageDone >= STAGE_PHOTOMETRY;
+	frame->bodies.swap(bodies);
+	frame->streaks.swap(streaks);
+	frame->diffs.swap(diffs);
+
+	mutex_lock lck(mtx_stat_);
+	if (stage == STAGE_MAX) ++nSkip_;
+	else ++nResume_;
+	return stage;
+}
+
+bool AManifest::Save(ImgFrmPtr frame) {
+	ManifestRecord rec;
+	if (frame->filepath.empty() || !file_identity(frame->filepath, rec.size, rec.mtime)) return false;
+
+	memcpy(rec.magic, MANIFEST_MAGIC, sizeof(rec.magic));
+	rec.version   = MANIFEST_VERSION;
+	rec.stageDone = frame->stageDone;
+	rec.stageFail = frame->stageFail;
+	rec.lenPath   = uint32_t(frame->filepath.size());
+	rec.lenDate   = uint32_t(frame->dateobs.size());
+	rec.nbody     = uint32_t(frame->bodies.size());
+	rec.nstreak   = uint32_t(frame->streaks.size());
+	rec.ndiff     = uint32_t(frame->diffs.size());
+	for (int stage = STAGE_NONE; stage < STAGE_MAX; ++stage) {
+		rec.digest[stage] = stage <= rec.stageDone || stage == rec.stageFail ? digest_[stage] : 0;
+	}
+	rec.wImg      = frame->wImg;
+	rec.hImg      = frame->hImg;
+	rec.expdur    = frame->expdur;
+	rec.bkMean    = frame->bkMean;
+	rec.bkSigma   = frame->bkSigma;
+	rec.fwhm      = frame->fwhm;
+	rec.coordCenter = frame->coordCenter;
+	rec.wcs       = frame->wcs;
+	rec.succAstro = frame->succAstro;
+	rec.succPhoto = frame->succPhoto;
+
+	std::string filepath = record_path(frame->filepath);
+	std::string tmppath  = filepath + ".tmp";
+	FILE* fp = fopen(tmppath.c_str(), "wb");
+	if (!fp) return false;
+	fwrite(&rec, sizeof(rec), 1, fp);
+	fwrite(frame->filepath.data(), rec.lenPath, 1, fp);
+	fwrite(frame->dateobs.data(), rec.lenDate, 1, fp);
+	if (rec.nbody)   fwrite(frame->bodies.data(),  sizeof(CelestialBody), rec.nbody,   fp);
+	if (rec.nstreak) fwrite(frame->streaks.data(), sizeof(StreakSegment), rec.nstreak, fp);
+	if (rec.ndiff)   fwrite(frame->diffs.data(),   sizeof(DiffSource),    rec.ndiff,   fp);
+	bool rslt = !ferror(fp);
+	rslt = !fclose(fp) && rslt;
+	// 替换方式写入: 中断时不留下不完整的记录
+	if (rslt) rslt = !rename(tmppath.c_str(), filepath.c_str());
+	if (!rslt) remove(tmppath.c_str());
+	return rslt;
+}
+
+void AManifest::GetStat(int& nskip, int& nresume) {
+	mutex_lock lck(mtx_stat_);
+	nskip   = nSkip_;
+	nresume = nResume_;
+}
+
+const char* AManifest::StageName(int stage) {
+	static const char* names[] = { "none", "reduce", "astrometry", "diff", "photometry", "done" };
+	return stage >= STAGE_NONE && stage <= STAGE_MAX ? names[stage] : "unknown";
+}
+
+void AManifest::make_digest() {
+	const Parameter& p = *param_;
+	std::ostringstream os;
+	os.precision(17);
+
+	// 摘要链: 每个环节包含其上游环节的参数. 线程数等不影响结果的参数不参与计算
+	memset(digest_, 0, sizeof(digest_));
+	os << MANIFEST_VERSION
+		<< '|' << p.preProc.pathZero << '|' << p.preProc.pathDark << '|' << p.preProc.pathFlat
+		<< '|' << p.preProc.badPixRemove << ' ' << p.preProc.bandRows << ' ' << p.preProc.bandMinMPix
+		<< '|' << p.backStat.useGlobal << ' ' << p.backStat.mode << ' ' << p.backStat.gridWidth
+		<< ' ' << p.backStat.gridHeight << ' ' << p.backStat.filterX << ' ' << p.backStat.filterY
+		<< '|' << p.sigExtract.enable << ' ' << p.sigExtract.sigMin
+		<< '|' << p.blobMeasure.pixMin << ' ' << p.blobMeasure.pixMax << ' ' << p.blobMeasure.snrMin
+		<< '|' << p.streak.enable << ' ' << p.streak.binning << ' ' << p.streak.snr << ' ' << p.streak.lenMin
+		<< ' ' << p.streak.gapMax << ' ' << p.streak.maskWidth << ' ' << p.streak.maxCount;
+	digest_[STAGE_REDUCE] = fnv1a(os.str());
+
+	os << '|' << p.catalog.pathCatalog << ' ' << p.catalog.magLimit
+		<< '|' << p.astrometry.pathIndex << ' ' << p.astrometry.scaleLow << ' ' << p.astrometry.scaleHigh
+		<< ' ' << p.astrometry.starSolve << ' ' << p.astrometry.matchMin << ' ' << p.astrometry.matchRadius
+		<< ' ' << p.astrometry.timeLimit << ' ' << p.astrometry.warmStart << ' ' << p.astrometry.warmRadius
+		<< ' ' << p.astrometry.sipOrder;
+	digest_[STAGE_ASTROMETRY] = fnv1a(os.str());
+
+	os << '|' << p.funcs.useDiff << ' ' << p.diff.pathRef << ' ' << p.diff.refFrames << ' ' << p.diff.fieldTol
+		<< ' ' << p.diff.snr << ' ' << p.diff.rMatch << ' ' << p.diff.maxCount;
+	digest_[STAGE_DIFF] = fnv1a(os.str());
+
+	os << '|' << p.funcs.usePhotometry;
+	digest_[STAGE_PHOTOMETRY] = fnv1a(os.str());
+
+	// 与ADIWorkFlow::Start的启动条件一致
+	enabled_[STAGE_NONE]       = false;
+	enabled_[STAGE_REDUCE]     = true;
+	enabled_[STAGE_ASTROMETRY] = p.funcs.useAstrometry || p.funcs.useDiff || p.funcs.usePhotometry || p.funcs.useMotion;
+	enabled_[STAGE_DIFF]       = p.funcs.useDiff;
+	enabled_[STAGE_PHOTOMETRY] = p.funcs.usePhotometry || p.funcs.useMotion;
+}
+
+std::string AManifest::record_path(const std::string& filepath) {
+	char name[32];
+	sprintf(name, "%016llx.rec", (unsigned long long) fnv1a(filepath));
+	return (path(pathDir_) / name).string();
+}
+
+bool AManifest::file_identity(const std::string& filepath, uint64_t& size, int64_t& mtime) {
+	boost::system::error_code ec;
+	size = file_size(filepath, ec);
+	if (ec) return false;
+	mtime = int64_t(last_write_time(filepath, ec));
+	return !ec;
+}
@@ -0,0 +1,102 @@
+/*!
+ * @class AManifest 结果清单: 记录各帧的处理结果, 用于中断或修改配置后的续处理
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * - 每个输入文件对应清单目录下的一个记录文件, 文件名为全路径名的散列值
+ * - 记录内容:
+ *   输入文件标识(长度、修改时间);
+ *   各环节的配置摘要: 对影响该环节及其上游环节结果的参数计算散列值;
+ *   已完成的环节、失败的环节, 及处理结果(目标、拖线、残差源、WCS等)
+ * - 续处理:
+ *   文件标识不符时从头处理;
+ *   否则按处理顺序找到第一个摘要不符的环节, 恢复此前的处理结果并由此环节继续;
+ *   全部有效时不再处理. 同一配置下曾失败的环节视为有效, 不再重复尝试
+ * - 差分成像需要扣除背景后的图像数据, 其需要重新执行时从图像处理开始
+ */
+
+#ifndef AMANIFEST_H_
+#define AMANIFEST_H_
+
+#include <stdint.h>
+#include <string>
+#include <boost/thread/mutex.hpp>
+#include "Parameter.hpp"
+#include "ImageFrame.hpp"
+
+#define MANIFEST_MAGIC		"ADIPSMAN"	/// 记录文件标识
+#define MANIFEST_VERSION	2			/// 记录文件版本. 2: 降噪环节摘要包含信号提取和分带处理参数
+
+enum {// 处理环节, 按处理顺序
+	STAGE_NONE,			/// 未开始
+	STAGE_REDUCE,		/// 图像处理
+	STAGE_ASTROMETRY,	/// 天文定位
+	STAGE_DIFF,			/// 差分成像
+	STAGE_PHOTOMETRY,	/// 测光
+	STAGE_MAX			/// 全部完成
+};
+
+class AManifest {
+public:
+	AManifest(Parameter* param);
+	virtual ~AManifest();
+
+protected:
+	typedef boost::unique_lock<boost::mutex> mutex_lock;
+
+protected:
+	Parameter* param_;		/// 配置参数
+	std::string pathDir_;	/// 清单目录
+	uint64_t digest_[STAGE_MAX];	/// 各环节的配置摘要
+	bool enabled_[STAGE_MAX];		/// 启用的环节
+	boost::mutex mtx_stat_;	/// 互斥锁: 统计
+	int nSkip_;		/// 统计: 跳过的帧数
+	int nResume_;	/// 统计: 从中间环节继续的帧数
+
+public:
+	/*!
+	 * @brief 创建清单目录
+	 */
+	bool Open();
+	/*!
+	 * @brief 查找图像帧的处理记录, 恢复仍然有效的处理结果
+	 * @param frame  图像帧. 仅处理有对应文件的帧
+	 * @return
+	 * 继续处理的环节. STAGE_REDUCE: 从头处理; STAGE_MAX: 全部有效, 无需处理
+	 */
+	int Resume(ImgFrmPtr frame);
+	/*!
+	 * @brief 保存图像帧的处理记录
+	 * @note
+	 * 在输出结果后调用: 写入WCS会改变原始文件的修改时间
+	 */
+	bool Save(ImgFrmPtr frame);
+	/*!
+	 * @brief 查看统计
+	 * @param nskip    跳过的帧数
+	 * @param nresume  从中间环节继续的帧数
+	 */
+	void GetStat(int& nskip, int& nresume);
+
+public:
+	/*!
+	 * @brief 环节名称
+	 */
+	static const char* StageName(int stage);
+
+protected:
+	/*!
+	 * @brief 计算各环节的配置摘要
+	 */
+	void make_digest();
+	/*!
+	 * @brief 记录文件路径
+	 */
+	std::string record_path(const std::string& filepath);
+	/*!
+	 * @brief 输入文件标识
+	 */
+	static bool file_identity(const std::string& filepath, uint64_t& size, int64_t& mtime);
+};
+
+#endif /* AMANIFEST_H_ */
@@ -0,0 +1,295 @@
+/*!
+ * @class APVLinker 在连续帧中关联运动目标
+ * @version 0.1
+ * @date 2021-05
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include "APVLinker.h"
+
+using std::vector;
+typedef std::chrono::steady_clock steady_clock;
+
+APVLinker::APVLinker(const ParamMotion* param) {
+	param_ = param;
+	Reset();
+}
+
+APVLinker::~APVLinker() {
+}
+
+void APVLinker::Reset() {
+	seq_    = 0;
+	idNext_ = 0;
+	frames_.clear();
+	static_.Reset(param_->rStatic * 2.0);
+	active_.clear();
+	finished_.clear();
+	nTransient_ = 0;
+	msElapse_   = 0.0;
+}
+
+int APVLinker::AddFrame(double t, int n, const double* x, const double* y, int* status) {
+	steady_clock::time_point t0 = steady_clock::now();
+	int nnew, i, m;
+
+	frames_.push_back(PVFrame());
+	PVFrame& frame = frames_.back();
+	frame.seq = seq_++;
+	frame.t   = t;
+	remove_static(frame, n, x, y, status);
+	extend(frame);
+	nnew = discover(frame);
+	for (i = 0, m = int(frame.body.size()); i < m; ++i) {
+		if (frame.owner[i] >= 0) status[frame.body[i]] = PV_MOVING;
+	}
+	retire();
+	while (frames_.size() > param_->depth) frames_.pop_front();
+
+	nTransient_ = int(frame.body.size());
+	msElapse_   = std::chrono::duration<double, std::milli>(steady_clock::now() - t0).count();
+	return nnew;
+}
+
+void APVLinker::Flush() {
+	finished_.insert(finished_.end(), active_.begin(), active_.end());
+	active_.clear();
+}
+
+const PVTrackletVec& APVLinker::Active() const {
+	return active_;
+}
+
+void APVLinker::TakeFinished(PVTrackletVec& tracklets) {
+	tracklets.swap(finished_);
+	finished_.clear();
+}
+
+double APVLinker::LastStat(int& ntransient) const {
+	ntransient = nTransient_;
+	return msElapse_;
+}
+
+/*!
+ * @brief 查找半径内最近的空闲暂现源
+ * @return
+ * 暂现源编号. -1: 无
+ */
+static int nearest_free(const GridIndex& grid, const vector<double>& px, const vector<double>& py,
+		const vector<int>& owner, double x, double y, double r, vector<int>& ids) {
+	int best(-1);
+	double r2(r * r), dx, dy, t;
+
+	grid.Within(x, y, r, ids);
+	for (vector<int>::iterator it = ids.begin(); it != ids.end(); ++it) {
+		if (owner[*it] != -1) continue;
+		dx = px[*it] - x;
+		dy = py[*it] - y;
+		if ((t = dx * dx + dy * dy) <= r2) {
+			r2   = t;
+			best = *it;
+		}
+	}
+	return best;
+}
+
+void APVLinker::remove_static(PVFrame& frame, int n, const double* x, const double* y, int* status) {
+	double rs = param_->rStatic;
+	double xmin(1E30), ymin(1E30), xmax(-1E30), ymax(-1E30);
+	int i, id;
+	bool hit;
+
+	for (i = 0; i < n; ++i) {
+		if (static_.Nearest(x[i], y[i], rs) >= 0) {
+			status[i] = PV_STATIC;
+			continue;
+		}
+		// 与窗口内其它帧的空闲暂现源位置重合: 新的静态源
+		hit = false;
+		for (PVFrameQue::iterator it = frames_.begin(); it != frames_.end(); ++it) {
+			if (&(*it) == &frame) continue;
+			if ((id = it->grid.Nearest(x[i], y[i], rs)) >= 0 && it->owner[id] == -1) {
+				it->owner[id] = -2;
+				hit = true;
+			}
+		}
+		if (hit) {
+			static_.Add(x[i], y[i]);
+			status[i] = PV_STATIC;
+			continue;
+		}
+		status[i] = PV_TRANSIENT;
+		frame.x.push_back(x[i]);
+		frame.y.push_back(y[i]);
+		frame.body.push_back(i);
+		frame.owner.push_back(-1);
+		if (x[i] < xmin) xmin = x[i];
+		if (x[i] > xmax) xmax = x[i];
+		if (y[i] < ymin) ymin = y[i];
+		if (y[i] > ymax) ymax = y[i];
+	}
+
+	// 网格尺寸: 平均每个网格约一个暂现源, 且不小于关联容差
+	int m = int(frame.body.size());
+	double cell = m ? sqrt((xmax - xmin) * (ymax - ymin) / m) : 1.0;
+	if (cell < param_->rLink) cell = param_->rLink;
+	if (!m) xmin = ymin = xmax = ymax = 0.0;
+	frame.grid.Reset(xmin, ymin, xmax, ymax, cell);
+	for (i = 0; i < m; ++i) frame.grid.Add(frame.x[i], frame.y[i]);
+}
+
+void APVLinker::extend(PVFrame& frame) {
+	vector<int> order(active_.size()), ids;
+	double px, py;
+	int i, n(int(active_.size())), id;
+
+	// 长轨迹段优先
+	for (i = 0; i < n; ++i) order[i] = i;
+	std::sort(order.begin(), order.end(), [this](int i1, int i2) {
+		return active_[i1].pts.size() > active_[i2].pts.size();
+	});
+	for (i = 0; i < n; ++i) {
+		PVTracklet& tr = active_[order[i]];
+		tr.Predict(frame.t, px, py);
+		id = nearest_free(frame.grid, frame.x, frame.y, frame.owner, px, py, param_->rLink, ids);
+		if (id < 0) continue;
+
+		PVPoint pt;
+		pt.frame = frame.seq;
+		pt.body  = frame.body[id];
+		pt.t     = frame.t;
+		pt.x     = frame.x[id];
+		pt.y     = frame.y[id];
+		tr.pts.push_back(pt);
+		tr.lastFrame = frame.seq;
+		frame.owner[id] = tr.id;
+		fit(tr);
+	}
+}
+
+int APVLinker::discover(PVFrame& frame) {
+	const double rLink(param_->rLink), rateMin(param_->rateMin), rateMax(param_->rateMax);
+	int nfrm = int(frames_.size()) - 1;	// 不含本帧
+	int n = int(frame.body.size()), i, j, k, nnew(0), id;
+	vector<int> cand, ids, supp(nfrm), best(nfrm);
+	double dt, dx, dy, dist, vx, vy, px, py;
+	int nbest, nsupp;
+
+	if (nfrm + 1 < int(param_->minFrames)) return 0;
+	for (i = 0; i < n; ++i) {
+		if (frame.owner[i] != -1) continue;
+		nbest = 0;
+		for (j = nfrm - 1; j >= 0; --j) {
+			PVFrame& fj = frames_[j];
+			if ((dt = frame.t - fj.t) <= 0.0) continue;
+			// 速度空间检索: 位移位于[rateMin * dt, rateMax * dt]的环内
+			fj.grid.Within(frame.x[i], frame.y[i], rateMax * dt + rLink, cand);
+			for (vector<int>::iterator it = cand.begin(); it != cand.end(); ++it) {
+				if (fj.owner[*it] != -1) continue;
+				dx = frame.x[i] - fj.x[*it];
+				dy = frame.y[i] - fj.y[*it];
+				dist = sqrt(dx * dx + dy * dy);
+				if (dist < rateMin * dt - rLink) continue;
+				vx = dx / dt;
+				vy = dy / dt;
+				// 统计其它帧中的支持点
+				for (k = 0, nsupp = 2; k < nfrm; ++k) {
+					supp[k] = -1;
+					if (k == j) {
+						supp[k] = *it;
+						continue;
+					}
+					PVFrame& fk = frames_[k];
+					px = frame.x[i] + vx * (fk.t - frame.t);
+					py = frame.y[i] + vy * (fk.t - frame.t);
+					if ((id = nearest_free(fk.grid, fk.x, fk.y, fk.owner, px, py, rLink, ids)) >= 0) {
+						supp[k] = id;
+						++nsupp;
+					}
+				}
+				if (nsupp > nbest) {
+					nbest = nsupp;
+					best.swap(supp);
+					supp.resize(nfrm);
+				}
+			}
+		}
+		if (nbest < int(param_->minFrames)) continue;
+
+		// 建立轨迹段
+		PVTracklet tr;
+		PVPoint pt;
+		tr.id = idNext_;
+		for (k = 0; k < nfrm; ++k) {
+			if (best[k] < 0) continue;
+			PVFrame& fk = frames_[k];
+			pt.frame = fk.seq;
+			pt.body  = fk.body[best[k]];
+			pt.t     = fk.t;
+			pt.x     = fk.x[best[k]];
+			pt.y     = fk.y[best[k]];
+			tr.pts.push_back(pt);
+		}
+		pt.frame = frame.seq;
+		pt.body  = frame.body[i];
+		pt.t     = frame.t;
+		pt.x     = frame.x[i];
+		pt.y     = frame.y[i];
+		tr.pts.push_back(pt);
+		tr.lastFrame = frame.seq;
+		fit(tr);
+		if (tr.rms > rLink) continue;
+
+		for (k = 0; k < nfrm; ++k) {
+			if (best[k] >= 0) frames_[k].owner[best[k]] = tr.id;
+		}
+		frame.owner[i] = tr.id;
+		active_.push_back(tr);
+		++idNext_;
+		++nnew;
+	}
+	return nnew;
+}
+
+void APVLinker::retire() {
+	int last = seq_ - 1;
+	PVTrackletVec::iterator it;
+
+	for (it = active_.begin(); it != active_.end();) {
+		if (last - it->lastFrame >= int(param_->depth)) {
+			finished_.push_back(*it);
+			it = active_.erase(it);
+		}
+		else ++it;
+	}
+}
+
+void APVLinker::fit(PVTracklet& tracklet) {
+	vector<PVPoint>& pts = tracklet.pts;
+	int n = int(pts.size()), i;
+	double st(0.0), sx(0.0), sy(0.0), stt(0.0), stx(0.0), sty(0.0), dt, dx, dy, sum(0.0);
+
+	for (i = 0; i < n; ++i) st += pts[i].t;
+	tracklet.t0 = st / n;
+	for (i = 0; i < n; ++i) {
+		dt = pts[i].t - tracklet.t0;
+		sx  += pts[i].x;
+		sy  += pts[i].y;
+		stt += dt * dt;
+		stx += dt * pts[i].x;
+		sty += dt * pts[i].y;
+	}
+	tracklet.x0 = sx / n;
+	tracklet.y0 = sy / n;
+	tracklet.vx = stt > 0.0 ? stx / stt : 0.0;
+	tracklet.vy = stt > 0.0 ? sty / stt : 0.0;
+	for (i = 0; i < n; ++i) {
+		tracklet.Predict(pts[i].t, dx, dy);
+		dx -= pts[i].x;
+		dy -= pts[i].y;
+		sum += dx * dx + dy * dy;
+	}
+	tracklet.rms = sqrt(sum / n);
+}
@@ -0,0 +1,159 @@
+/*!
+ * @class APVLinker 在连续帧中关联运动目标
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * 输入为同一天区序列图像中的目标, 坐标为公共切平面坐标(角秒). 关联流程:
+ * - 与累积静态源星表匹配, 剔除静态源. 与窗口内其它帧的暂现源位置重合时加入静态源星表
+ * - 以预测位置延伸已有轨迹段(tracklet)
+ * - 未关联的暂现源与窗口内各帧中速度范围允许的暂现源配对, 由配对速度预测其它帧位置
+ *   并统计支持数, 支持帧数不少于阈值时确认为新轨迹段
+ * - 连续depth帧未延伸的轨迹段结束
+ * 每帧暂现源按网格索引, 查询代价与暂现源密度及速度上限相关, 与帧内目标总数近似线性
+ */
+
+#ifndef APVLINKER_H_
+#define APVLINKER_H_
+
+#include <deque>
+#include <vector>
+#include "GridIndex.hpp"
+#include "SpatialHash.hpp"
+#include "Parameter.hpp"
+
+/*!
+ * @struct PVPoint 轨迹段中的单次检测
+ */
+struct PVPoint {
+	int frame;		/// 帧序号
+	int body;		/// 目标在帧中的编号
+	double t;		/// 时间, 量纲: 秒
+	double x, y;	/// 切平面坐标, 量纲: 角秒
+};
+
+/*!
+ * @struct PVTracklet 轨迹段. 以匀速直线运动描述
+ */
+struct PVTracklet {
+	int id;				/// 编号
+	std::vector<PVPoint> pts;	/// 检测序列
+	double t0;			/// 参考时间, 量纲: 秒
+	double x0, y0;		/// 参考时间的位置, 量纲: 角秒
+	double vx, vy;		/// 速度, 量纲: 角秒/秒
+	double rms;			/// 位置残差, 量纲: 角秒
+	int lastFrame;		/// 最近一次延伸的帧序号
+
+public:
+	/*!
+	 * @brief 预测位置
+	 */
+	void Predict(double t, double& x, double& y) const {
+		x = x0 + vx * (t - t0);
+		y = y0 + vy * (t - t0);
+	}
+};
+typedef std::vector<PVTracklet> PVTrackletVec;
+
+/*!
+ * @brief 帧内目标的分类
+ */
+enum {
+	PV_TRANSIENT,	/// 暂现源, 未关联
+	PV_STATIC,		/// 静态源
+	PV_MOVING		/// 运动目标
+};
+
+class APVLinker {
+public:
+	APVLinker(const ParamMotion* param);
+	virtual ~APVLinker();
+
+protected:
+	/*!
+	 * @struct PVFrame 窗口内的单帧暂现源
+	 */
+	struct PVFrame {
+		int seq;			/// 帧序号
+		double t;			/// 时间, 量纲: 秒
+		std::vector<double> x, y;	/// 切平面坐标
+		std::vector<int> body;		/// 目标在帧中的编号
+		std::vector<int> owner;		/// 所属轨迹段编号. -1: 空闲; -2: 已转为静态源
+		GridIndex grid;		/// 网格索引
+	};
+	typedef std::deque<PVFrame> PVFrameQue;
+
+protected:
+	const ParamMotion* param_;	/// 配置参数
+	int seq_;				/// 下一帧序号
+	int idNext_;			/// 下一个轨迹段编号
+	PVFrameQue frames_;		/// 最近depth帧的暂现源
+	SpatialHash static_;	/// 静态源星表
+	PVTrackletVec active_;	/// 活动轨迹段
+	PVTrackletVec finished_;	/// 已结束的轨迹段
+	/* 统计 */
+	int nTransient_;		/// 最近一帧的暂现源数量
+	double msElapse_;		/// 最近一帧的关联耗时, 量纲: 毫秒
+
+public:
+	/*!
+	 * @brief 清除全部状态, 开始新的序列
+	 */
+	void Reset();
+	/*!
+	 * @brief 加入一帧目标并关联
+	 * @param t       时间, 量纲: 秒
+	 * @param n       目标数量
+	 * @param x       切平面X坐标, 量纲: 角秒
+	 * @param y       切平面Y坐标, 量纲: 角秒
+	 * @param status  目标分类, PV_TRANSIENT/PV_STATIC/PV_MOVING
+	 * @return
+	 * 本帧新确认的轨迹段数量
+	 */
+	int AddFrame(double t, int n, const double* x, const double* y, int* status);
+	/*!
+	 * @brief 结束全部活动轨迹段
+	 */
+	void Flush();
+	/*!
+	 * @brief 活动轨迹段
+	 */
+	const PVTrackletVec& Active() const;
+	/*!
+	 * @brief 取出已结束的轨迹段
+	 * @param tracklets  已结束的轨迹段
+	 */
+	void TakeFinished(PVTrackletVec& tracklets);
+	/*!
+	 * @brief 查看最近一帧的统计量
+	 * @param ntransient  暂现源数量
+	 * @return
+	 * 耗时, 量纲: 毫秒
+	 */
+	double LastStat(int& ntransient) const;
+
+protected:
+	/*!
+	 * @brief 剔除静态源, 构建本帧暂现源
+	 */
+	void remove_static(PVFrame& frame, int n, const double* x, const double* y, int* status);
+	/*!
+	 * @brief 以预测位置延伸活动轨迹段
+	 */
+	void extend(PVFrame& frame);
+	/*!
+	 * @brief 由未关联的暂现源建立新轨迹段
+	 * @return
+	 * 新轨迹段数量
+	 */
+	int discover(PVFrame& frame);
+	/*!
+	 * @brief 结束长期未延伸的轨迹段
+	 */
+	void retire();
+	/*!
+	 * @brief 以最小二乘拟合匀速直线运动
+	 */
+	static void fit(PVTracklet& tracklet);
+};
+
+#endif /* APVLINKER_H_ */
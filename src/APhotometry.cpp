@@ -9,6 +9,7 @@
 APhotometry::APhotometry(Parameter* param)
 	: ADIProcess(param) {
 	nameFunc_ = "photometry";
+	nameStage_ = "photometry";
 }
 
 APhotometry::~APhotometry() {
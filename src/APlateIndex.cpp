@@ -0,0 +1,447 @@
+/*!
+ * @class APlateIndex 盲定位使用的几何散列索引
+ * @version 0.1
+ * @date 2021-05
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <complex>
+#include <algorithm>
+#include "APlateIndex.h"
+#include "ARefCatalog.h"
+#include "WCSTan.hpp"
+#include "GLog.h"
+
+using std::vector;
+typedef std::complex<double> complexd;
+
+APlateIndex::APlateIndex() {
+	fd_     = -1;
+	addr_   = NULL;
+	size_   = 0;
+	header_ = NULL;
+	zones_  = NULL;
+	cells_  = NULL;
+	stars_  = NULL;
+	bins_   = NULL;
+	quads_  = NULL;
+}
+
+APlateIndex::~APlateIndex() {
+	Close();
+}
+
+bool APlateIndex::Open(const char* filepath) {
+	struct stat st;
+
+	Close();
+	if ((fd_ = open(filepath, O_RDONLY)) < 0) return false;
+	if (fstat(fd_, &st) || size_t(st.st_size) < sizeof(PlateIndexHeader)) {
+		Close();
+		return false;
+	}
+	size_ = st.st_size;
+	addr_ = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd_, 0);
+	if (addr_ == MAP_FAILED) {
+		addr_ = NULL;
+		Close();
+		return false;
+	}
+
+	const char* base = (const char*) addr_;
+	header_ = (const PlateIndexHeader*) base;
+	if (memcmp(header_->magic, PLATE_INDEX_MAGIC, 8) || header_->version != PLATE_INDEX_VERSION
+			|| header_->offQuad + uint64_t(header_->nquad) * sizeof(PlateIndexQuad) > size_) {
+		_gLog.Write(LOG_FAULT, "invalid plate index file [%s]", filepath);
+		Close();
+		return false;
+	}
+	zones_ = (const PlateIndexZone*) (base + header_->offZone);
+	cells_ = (const uint32_t*) (base + header_->offCell);
+	stars_ = (const PlateIndexStar*) (base + header_->offStar);
+	bins_  = (const uint32_t*) (base + header_->offBin);
+	quads_ = (const PlateIndexQuad*) (base + header_->offQuad);
+
+	return true;
+}
+
+void APlateIndex::Close() {
+	if (addr_) munmap(addr_, size_);
+	if (fd_ >= 0) close(fd_);
+	fd_     = -1;
+	addr_   = NULL;
+	size_   = 0;
+	header_ = NULL;
+}
+
+bool APlateIndex::IsOpen() const {
+	return header_ != NULL;
+}
+
+const PlateIndexHeader* APlateIndex::Header() const {
+	return header_;
+}
+
+const PlateIndexStar& APlateIndex::Star(uint32_t i) const {
+	return stars_[i];
+}
+
+const PlateIndexQuad& APlateIndex::Quad(uint32_t i) const {
+	return quads_[i];
+}
+
+void APlateIndex::ConeSearch(double ra, double dec, double radius, vector<uint32_t>& ids) const {
+	ids.clear();
+	if (!header_) return;
+
+	double cellDeg = header_->cellDeg;
+	int nzone = int(header_->nzone);
+	int z0 = int(floor((dec - radius + 90.0) / cellDeg));
+	int z1 = int(floor((dec + radius + 90.0) / cellDeg));
+	double cosr = cos(radius * D2R);
+	double sd = sin(dec * D2R), cdc = cos(dec * D2R);
+	double dmax = fabs(dec) + radius;
+	double dra  = dmax >= 89.0 ? 360.0 : radius / cos(dmax * D2R);
+	int z, c, c0, c1, k, n;
+	uint32_t i, i1;
+
+	if (z0 < 0) z0 = 0;
+	if (z1 >= nzone) z1 = nzone - 1;
+	for (z = z0; z <= z1; ++z) {
+		const PlateIndexZone& zone = zones_[z];
+		n = int(zone.ncell);
+		if (dra >= 180.0) {
+			c0 = 0;
+			c1 = n - 1;
+		}
+		else {
+			c0 = int(floor((ra - dra) / 360.0 * n));
+			c1 = int(floor((ra + dra) / 360.0 * n));
+			if (c1 - c0 + 1 >= n) {
+				c0 = 0;
+				c1 = n - 1;
+			}
+		}
+		for (c = c0; c <= c1; ++c) {
+			k = (c % n + n) % n + zone.firstCell;
+			for (i = cells_[k], i1 = cells_[k + 1]; i < i1; ++i) {
+				const PlateIndexStar& star = stars_[i];
+				double d = star.dec * D2R;
+				if (sd * sin(d) + cdc * cos(d) * cos((star.ra - ra) * D2R) >= cosr)
+					ids.push_back(i);
+			}
+		}
+	}
+}
+
+void APlateIndex::FindQuads(const double code[4], double tol, vector<uint32_t>& ids) const {
+	ids.clear();
+	if (!header_) return;
+
+	int nbin = int(header_->nbin);
+	double step = header_->codeStep, cmin = header_->codeMin;
+	int bx0 = int(floor((code[0] - tol - cmin) / step)), bx1 = int(floor((code[0] + tol - cmin) / step));
+	int by0 = int(floor((code[1] - tol - cmin) / step)), by1 = int(floor((code[1] + tol - cmin) / step));
+	int bx, by, j;
+	uint32_t i, i1;
+
+	if (bx0 < 0) bx0 = 0;
+	if (by0 < 0) by0 = 0;
+	if (bx1 >= nbin) bx1 = nbin - 1;
+	if (by1 >= nbin) by1 = nbin - 1;
+	for (bx = bx0; bx <= bx1; ++bx) {
+		for (by = by0; by <= by1; ++by) {
+			for (i = bins_[bx * nbin + by], i1 = bins_[bx * nbin + by + 1]; i < i1; ++i) {
+				const float* c = quads_[i].code;
+				for (j = 0; j < 4 && fabs(c[j] - code[j]) <= tol; ++j);
+				if (j == 4) ids.push_back(i);
+			}
+		}
+	}
+}
+
+bool APlateIndex::QuadCode(const double x[4], const double y[4], double code[4]) {
+	complexd a(x[0], y[0]), b(x[1], y[1]);
+	complexd ab = b - a;
+	if (std::norm(ab) == 0.0) return false;
+
+	complexd f = complexd(1.0, 1.0) / ab;
+	complexd c = (complexd(x[2], y[2]) - a) * f;
+	complexd d = (complexd(x[3], y[3]) - a) * f;
+	code[0] = c.real();
+	code[1] = c.imag();
+	code[2] = d.real();
+	code[3] = d.imag();
+	// 检查C和D是否位于以AB为直径的圆内
+	double r2c = (code[0] - 0.5) * (code[0] - 0.5) + (code[1] - 0.5) * (code[1] - 0.5);
+	double r2d = (code[2] - 0.5) * (code[2] - 0.5) + (code[3] - 0.5) * (code[3] - 0.5);
+	return r2c <= 0.5 && r2d <= 0.5;
+}
+
+/*---------------------------------------------------------------------------*/
+/* 生成索引 */
+/*!
+ * @brief 由4颗星构建规范化的四星组: AB为最远两星, xc <= xd, xc + xd <= 1
+ * @param x      平面X坐标
+ * @param y      平面Y坐标
+ * @param id     星编号, 输出时按A, B, C, D排序
+ * @param code   编码
+ * @param side   AB边长度
+ * @return
+ * 四星组有效性
+ */
+static bool canonical_quad(const double x[4], const double y[4], uint32_t id[4], double code[4], double& side) {
+	int order[4], i, j, ia(0), ib(1);
+	double d2, d2max(-1.0), px[4], py[4];
+
+	for (i = 0; i < 4; ++i) {
+		for (j = i + 1; j < 4; ++j) {
+			d2 = (x[i] - x[j]) * (x[i] - x[j]) + (y[i] - y[j]) * (y[i] - y[j]);
+			if (d2 > d2max) {
+				d2max = d2;
+				ia = i;
+				ib = j;
+			}
+		}
+	}
+	order[0] = ia;
+	order[1] = ib;
+	for (i = 0, j = 2; i < 4; ++i) {
+		if (i != ia && i != ib) order[j++] = i;
+	}
+	for (i = 0; i < 4; ++i) {
+		px[i] = x[order[i]];
+		py[i] = y[order[i]];
+	}
+	if (!APlateIndex::QuadCode(px, py, code)) return false;
+	if (code[0] + code[2] > 1.0) {// 交换A和B
+		std::swap(order[0], order[1]);
+		for (i = 0; i < 4; ++i) code[i] = 1.0 - code[i];
+	}
+	if (code[0] > code[2]) {// 交换C和D
+		std::swap(order[2], order[3]);
+		std::swap(code[0], code[2]);
+		std::swap(code[1], code[3]);
+	}
+
+	uint32_t tmp[4];
+	for (i = 0; i < 4; ++i) tmp[i] = id[order[i]];
+	for (i = 0; i < 4; ++i) id[i] = tmp[i];
+	side = sqrt(d2max);
+	return true;
+}
+
+/*!
+ * @brief 对齐文件偏移量至8字节
+ */
+static uint64_t align8(uint64_t off) {
+	return (off + 7) & ~uint64_t(7);
+}
+
+bool APlateIndex::Build(const char* pathCat, const char* pathIdx, double fieldDeg,
+		int nquadStar, int ncellStar, double magLimit) {
+	FILE* fp;
+	char line[256];
+	vector<PlateIndexStar> all;
+	PlateIndexStar star;
+
+	// 读取参考星表: 优先尝试本地星表格式, 其次为文本格式
+	ARefCatalog refcat;
+	if (refcat.Open(pathCat)) {
+		RefStarBatch batch;
+		refcat.ReadAll(batch);
+		refcat.Close();
+		for (size_t i = 0; i < batch.Size(); ++i) {
+			if (batch.mag[i] > magLimit) continue;
+			star.ra  = batch.ra[i];
+			star.dec = batch.dec[i];
+			star.mag = batch.mag[i];
+			all.push_back(star);
+		}
+	}
+	else if ((fp = fopen(pathCat, "r")) == NULL) {
+		_gLog.Write(LOG_FAULT, "failed to open catalog [%s]", pathCat);
+		return false;
+	}
+	else {
+		while (fgets(line, sizeof(line), fp)) {
+			if (line[0] == '#') continue;
+			for (char* p = line; *p; ++p) if (*p == ',') *p = ' ';
+			if (sscanf(line, "%lf %lf %f", &star.ra, &star.dec, &star.mag) == 3 && star.mag <= magLimit
+					&& star.ra >= 0.0 && star.ra < 360.0 && fabs(star.dec) <= 90.0)
+				all.push_back(star);
+		}
+		fclose(fp);
+	}
+	if (all.size() < 4) {
+		_gLog.Write(LOG_FAULT, "too few stars in catalog [%s]", pathCat);
+		return false;
+	}
+	if (nquadStar > ncellStar) ncellStar = nquadStar;
+
+	// 划分网格
+	PlateIndexHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, PLATE_INDEX_MAGIC, 8);
+	header.version = PLATE_INDEX_VERSION;
+	header.cellDeg = fieldDeg * 0.5;
+	header.nzone   = uint32_t(ceil(180.0 / header.cellDeg));
+	header.sideMin = fieldDeg * 0.05;
+	header.sideMax = fieldDeg;
+	header.nbin    = 128;
+	header.codeMin = -0.25;
+	header.codeStep= 1.5 / header.nbin;
+
+	vector<PlateIndexZone> zones(header.nzone);
+	uint32_t z, ncell(0);
+	for (z = 0; z < header.nzone; ++z) {
+		double decLow = -90.0 + z * header.cellDeg;
+		double decMid = decLow + header.cellDeg * 0.5;
+		if (decMid > 90.0) decMid = 90.0;
+		zones[z].decLow    = decLow;
+		zones[z].ncell     = std::max(1u, uint32_t(ceil(360.0 * cos(decMid * D2R) / header.cellDeg)));
+		zones[z].firstCell = ncell;
+		ncell += zones[z].ncell;
+	}
+	header.ncell = ncell;
+	for (size_t i = 0; i < all.size(); ++i) {
+		PlateIndexStar& s = all[i];
+		int zi = int(floor((s.dec + 90.0) / header.cellDeg));
+		if (zi < 0) zi = 0;
+		if (zi >= int(header.nzone)) zi = header.nzone - 1;
+		int ci = int(s.ra / 360.0 * zones[zi].ncell);
+		if (ci >= int(zones[zi].ncell)) ci = zones[zi].ncell - 1;
+		s.cell = zones[zi].firstCell + ci;
+	}
+	std::sort(all.begin(), all.end(), [](const PlateIndexStar& s1, const PlateIndexStar& s2) {
+		return s1.cell < s2.cell || (s1.cell == s2.cell && s1.mag < s2.mag);
+	});
+
+	// 每个网格保留最亮的星
+	vector<PlateIndexStar> stars;
+	vector<uint32_t> cells(ncell + 1, 0);
+	for (size_t i = 0, n = 0; i < all.size(); ++i) {
+		if (i && all[i].cell != all[i - 1].cell) n = 0;
+		if (int(n++) < ncellStar) {
+			stars.push_back(all[i]);
+			++cells[all[i].cell + 1];
+		}
+	}
+	all.clear();
+	for (uint32_t k = 0; k < ncell; ++k) cells[k + 1] += cells[k];
+	header.nstar = uint32_t(stars.size());
+
+	// 构建四星组
+	vector<PlateIndexQuad> quads;
+	vector<double> px, py;
+	PlateIndexQuad quad;
+	double x[4], y[4], code[4], side;
+	uint32_t id[4], k;
+	int n, i0, i1, i2, i3, j;
+
+	for (z = 0; z < header.nzone; ++z) {
+		double dec0 = std::min(89.999, zones[z].decLow + header.cellDeg * 0.5);
+		for (k = zones[z].firstCell; k < zones[z].firstCell + zones[z].ncell; ++k) {
+			double ra0 = (k - zones[z].firstCell + 0.5) * 360.0 / zones[z].ncell;
+			uint32_t first = cells[k];
+			n = std::min(nquadStar, int(cells[k + 1] - first));
+			if (n < 4) continue;
+			// 投影至网格中心切平面
+			px.resize(n);
+			py.resize(n);
+			for (j = 0; j < n; ++j) {
+				const PlateIndexStar& s = stars[first + j];
+				WCSTan::Project(ra0 * D2R, dec0 * D2R, s.ra * D2R, s.dec * D2R, px[j], py[j]);
+				px[j] *= R2D;
+				py[j] *= R2D;
+			}
+			for (i3 = 3; i3 < n; ++i3) {
+				for (i2 = 2; i2 < i3; ++i2) {
+					for (i1 = 1; i1 < i2; ++i1) {
+						for (i0 = 0; i0 < i1; ++i0) {
+							int ii[4] = { i0, i1, i2, i3 };
+							for (j = 0; j < 4; ++j) {
+								x[j]  = px[ii[j]];
+								y[j]  = py[ii[j]];
+								id[j] = first + ii[j];
+							}
+							if (!canonical_quad(x, y, id, code, side)
+									|| side < header.sideMin || side > header.sideMax)
+								continue;
+							for (j = 0; j < 4; ++j) {
+								quad.star[j] = id[j];
+								quad.code[j] = float(code[j]);
+							}
+							quad.side = float(side);
+							quads.push_back(quad);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// 按编码分箱
+	uint32_t nbin = header.nbin;
+	vector<uint32_t> bins(nbin * nbin + 1, 0);
+	vector<uint32_t> binOf(quads.size());
+	for (size_t i = 0; i < quads.size(); ++i) {
+		int bx = int(floor((quads[i].code[0] - header.codeMin) / header.codeStep));
+		int by = int(floor((quads[i].code[1] - header.codeMin) / header.codeStep));
+		bx = std::max(0, std::min(int(nbin) - 1, bx));
+		by = std::max(0, std::min(int(nbin) - 1, by));
+		binOf[i] = bx * nbin + by;
+		++bins[binOf[i] + 1];
+	}
+	for (k = 0; k < nbin * nbin; ++k) bins[k + 1] += bins[k];
+	vector<PlateIndexQuad> sorted(quads.size());
+	{
+		vector<uint32_t> pos(bins.begin(), bins.end() - 1);
+		for (size_t i = 0; i < quads.size(); ++i) sorted[pos[binOf[i]]++] = quads[i];
+	}
+	quads.clear();
+	header.nquad = uint32_t(sorted.size());
+
+	// 写入文件
+	header.offZone = align8(sizeof(header));
+	header.offCell = align8(header.offZone + sizeof(PlateIndexZone) * zones.size());
+	header.offStar = align8(header.offCell + sizeof(uint32_t) * cells.size());
+	header.offBin  = align8(header.offStar + sizeof(PlateIndexStar) * stars.size());
+	header.offQuad = align8(header.offBin  + sizeof(uint32_t) * bins.size());
+
+	if ((fp = fopen(pathIdx, "wb")) == NULL) {
+		_gLog.Write(LOG_FAULT, "failed to create index file [%s]", pathIdx);
+		return false;
+	}
+	bool rslt = true;
+	char pad[8] = { 0 };
+	struct {
+		const void* ptr;
+		size_t size;
+		uint64_t off;
+	} sections[] = {
+		{ &header,        sizeof(header),                           0 },
+		{ zones.data(),   sizeof(PlateIndexZone) * zones.size(),    header.offZone },
+		{ cells.data(),   sizeof(uint32_t) * cells.size(),          header.offCell },
+		{ stars.data(),   sizeof(PlateIndexStar) * stars.size(),    header.offStar },
+		{ bins.data(),    sizeof(uint32_t) * bins.size(),           header.offBin  },
+		{ sorted.data(),  sizeof(PlateIndexQuad) * sorted.size(),   header.offQuad }
+	};
+	uint64_t off(0);
+	for (size_t i = 0; rslt && i < sizeof(sections) / sizeof(sections[0]); ++i) {
+		if (sections[i].off > off) rslt = fwrite(pad, 1, sections[i].off - off, fp) == sections[i].off - off;
+		if (rslt && sections[i].size) rslt = fwrite(sections[i].ptr, 1, sections[i].size, fp) == sections[i].size;
+		off = sections[i].off + sections[i].size;
+	}
+	fclose(fp);
+
+	_gLog.Write("plate index [%s]: %u cells, %u stars, %u quads",
+			pathIdx, header.ncell, header.nstar, header.nquad);
+	return rslt;
+}
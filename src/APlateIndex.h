@@ -0,0 +1,161 @@
+/*!
+ * @class APlateIndex 盲定位使用的几何散列索引
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * 索引由参考星表离线生成, 以内存映射方式访问:
+ * - 按赤纬带和赤经划分天区网格, 每个网格保留最亮的若干颗星
+ * - 由每个网格中最亮的星构建四星组(quad), 以相似变换不变量作为散列编码
+ * - 四星组编码: 以最远两颗星A, B构建坐标系, A=(0, 0), B=(1, 1), C和D在
+ *   该坐标系中的坐标(xc, yc, xd, yd)即为编码
+ * - 四星组按编码(xc, yc)量化后分箱存储, 查询时在容差范围内遍历分箱
+ */
+
+#ifndef APLATEINDEX_H_
+#define APLATEINDEX_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define PLATE_INDEX_MAGIC	"ADIPSIDX"	/// 索引文件标识
+#define PLATE_INDEX_VERSION	1			/// 索引文件版本
+
+/*!
+ * @struct PlateIndexHeader 索引文件头
+ */
+struct PlateIndexHeader {
+	char magic[8];		/// 文件标识
+	uint32_t version;	/// 版本
+	uint32_t nzone;		/// 赤纬带数量
+	double cellDeg;		/// 网格尺寸, 量纲: 角度
+	double sideMin;		/// 四星组AB边最小长度, 量纲: 角度
+	double sideMax;		/// 四星组AB边最大长度, 量纲: 角度
+	double codeMin;		/// 编码分箱起点
+	double codeStep;	/// 编码分箱步长
+	uint32_t ncell;		/// 网格数量
+	uint32_t nstar;		/// 星数量
+	uint32_t nquad;		/// 四星组数量
+	uint32_t nbin;		/// 单坐标轴编码分箱数量
+	uint64_t offZone;	/// 赤纬带表在文件中的偏移量
+	uint64_t offCell;	/// 网格表在文件中的偏移量
+	uint64_t offStar;	/// 星表在文件中的偏移量
+	uint64_t offBin;	/// 分箱表在文件中的偏移量
+	uint64_t offQuad;	/// 四星组表在文件中的偏移量
+};
+
+/*!
+ * @struct PlateIndexZone 赤纬带
+ */
+struct PlateIndexZone {
+	double decLow;		/// 赤纬下限, 量纲: 角度
+	uint32_t ncell;		/// 赤经方向网格数量
+	uint32_t firstCell;	/// 首个网格的全局编号
+};
+
+/*!
+ * @struct PlateIndexStar 参考星
+ */
+struct PlateIndexStar {
+	double ra, dec;		/// 赤道坐标, 量纲: 角度
+	float mag;			/// 星等
+	uint32_t cell;		/// 所属网格
+};
+
+/*!
+ * @struct PlateIndexQuad 四星组
+ */
+struct PlateIndexQuad {
+	uint32_t star[4];	/// 星编号. 顺序: A, B, C, D
+	float code[4];		/// 编码: xc, yc, xd, yd
+	float side;			/// AB边长度, 量纲: 角度
+};
+
+class APlateIndex {
+public:
+	APlateIndex();
+	virtual ~APlateIndex();
+
+protected:
+	int fd_;			/// 文件描述符
+	void* addr_;		/// 内存映射地址
+	size_t size_;		/// 文件长度
+	const PlateIndexHeader* header_;	/// 文件头
+	const PlateIndexZone* zones_;		/// 赤纬带
+	const uint32_t* cells_;				/// 网格星起始编号, 长度: ncell + 1
+	const PlateIndexStar* stars_;		/// 星
+	const uint32_t* bins_;				/// 分箱四星组起始编号, 长度: nbin * nbin + 1
+	const PlateIndexQuad* quads_;		/// 四星组
+
+public:
+	/*!
+	 * @brief 以内存映射方式打开索引文件
+	 * @param filepath 文件路径
+	 * @return
+	 * 文件打开结果
+	 */
+	bool Open(const char* filepath);
+	/*!
+	 * @brief 关闭索引文件
+	 */
+	void Close();
+	/*!
+	 * @brief 检查索引文件是否已打开
+	 */
+	bool IsOpen() const;
+	/*!
+	 * @brief 查看文件头
+	 */
+	const PlateIndexHeader* Header() const;
+	/*!
+	 * @brief 查看参考星
+	 * @param i 星编号
+	 */
+	const PlateIndexStar& Star(uint32_t i) const;
+	/*!
+	 * @brief 查看四星组
+	 * @param i 四星组编号
+	 */
+	const PlateIndexQuad& Quad(uint32_t i) const;
+	/*!
+	 * @brief 锥形检索参考星
+	 * @param ra      中心赤经, 量纲: 角度
+	 * @param dec     中心赤纬, 量纲: 角度
+	 * @param radius  半径, 量纲: 角度
+	 * @param ids     星编号
+	 */
+	void ConeSearch(double ra, double dec, double radius, std::vector<uint32_t>& ids) const;
+	/*!
+	 * @brief 检索编码在容差范围内的四星组
+	 * @param code  编码
+	 * @param tol   容差
+	 * @param ids   四星组编号
+	 */
+	void FindQuads(const double code[4], double tol, std::vector<uint32_t>& ids) const;
+
+public:
+	/*!
+	 * @brief 由参考星表生成索引文件
+	 * @param pathCat   参考星表. 本地星表(ARefCatalog)或文本格式, 文本每行: 赤经 赤纬 星等
+	 * @param pathIdx   索引文件路径
+	 * @param fieldDeg  适用的视场尺寸, 量纲: 角度
+	 * @param nquadStar 每个网格用于构建四星组的星数量
+	 * @param ncellStar 每个网格保留的星数量
+	 * @param magLimit  极限星等
+	 * @return
+	 * 索引生成结果
+	 */
+	static bool Build(const char* pathCat, const char* pathIdx, double fieldDeg,
+			int nquadStar, int ncellStar, double magLimit);
+	/*!
+	 * @brief 计算四星组编码
+	 * @param x     平面X坐标. 顺序: A, B, C, D
+	 * @param y     平面Y坐标
+	 * @param code  编码
+	 * @return
+	 * C和D是否均位于以AB为直径的圆内
+	 */
+	static bool QuadCode(const double x[4], const double y[4], double code[4]);
+};
+
+#endif /* APLATEINDEX_H_ */
@@ -0,0 +1,289 @@
+/*!
+ * @class APlateSolver 基于四星组几何散列的盲定位
+ * @version 0.1
+ * @date 2021-05
+ */
+
+#include <math.h>
+#include <complex>
+#include <chrono>
+#include <algorithm>
+#include "APlateSolver.h"
+
+using std::vector;
+typedef std::complex<double> complexd;
+typedef std::chrono::steady_clock steady_clock;
+
+#define CODE_TOLERANCE	0.01	/// 四星组编码容差
+
+APlateSolver::APlateSolver(const ParamAstrometry* param) {
+	param_    = param;
+	bodies_   = NULL;
+	wImg_     = hImg_ = 0;
+	rVerify_  = 0.0;
+	sLow_     = sHigh_ = 0.0;
+	nquad_    = nverify_ = 0;
+	msElapse_ = 0.0;
+}
+
+APlateSolver::~APlateSolver() {
+}
+
+bool APlateSolver::LoadIndex(const char* filepath) {
+	return index_.Open(filepath);
+}
+
+bool APlateSolver::IsReady() const {
+	return index_.IsOpen();
+}
+
+const APlateIndex& APlateSolver::Index() const {
+	return index_;
+}
+
+double APlateSolver::LastStat(int& nquad, int& nverify) const {
+	nquad   = nquad_;
+	nverify = nverify_;
+	return msElapse_;
+}
+
+bool APlateSolver::Solve(const CeleBodyVec& bodies, unsigned w, unsigned h, WCSTan& wcs) {
+	steady_clock::time_point t0 = steady_clock::now();
+	int n = int(bodies.size());
+	bool rslt(false);
+
+	nquad_ = nverify_ = 0;
+	msElapse_ = 0.0;
+	if (!index_.IsOpen() || n < 4) return false;
+
+	// 按流量降序排列, 保留参与构建四星组和验证的目标
+	int nsolve  = std::min(n, int(param_->starSolve));
+	int ncheck  = std::min(n, std::max(nsolve * 4, 100));
+	order_.resize(n);
+	for (int i = 0; i < n; ++i) order_[i] = i;
+	std::partial_sort(order_.begin(), order_.begin() + ncheck, order_.end(), [&bodies](int i1, int i2) {
+		return bodies[i1].flux > bodies[i2].flux;
+	});
+	order_.resize(ncheck);
+
+	bodies_  = &bodies;
+	wImg_    = w;
+	hImg_    = h;
+	rVerify_ = std::max(param_->matchRadius * 2.0, sqrt(double(w) * w + double(h) * h) * 0.004);
+	sLow_    = param_->scaleLow  > 0.0 ? param_->scaleLow  : 0.1;
+	sHigh_   = param_->scaleHigh > 0.0 ? param_->scaleHigh : 100.0;
+	grid_.Reset(0.0, 0.0, w, h, rVerify_);
+	for (int i = 0; i < ncheck; ++i)
+		grid_.Add(bodies[order_[i]].ptBary.x, bodies[order_[i]].ptBary.y);
+
+	// 按亮度优先顺序遍历四星组
+	double limit = param_->timeLimit * 1000.0;
+	int ids[4], i0, i1, i2, i3;
+	for (i3 = 3; !rslt && i3 < nsolve; ++i3) {
+		for (i2 = 2; !rslt && i2 < i3; ++i2) {
+			for (i1 = 1; !rslt && i1 < i2; ++i1) {
+				for (i0 = 0; !rslt && i0 < i1; ++i0) {
+					ids[0] = i0;
+					ids[1] = i1;
+					ids[2] = i2;
+					ids[3] = i3;
+					++nquad_;
+					rslt = try_quad(ids, wcs);
+				}
+				msElapse_ = std::chrono::duration<double, std::milli>(steady_clock::now() - t0).count();
+				if (limit > 0.0 && msElapse_ > limit) i3 = nsolve;
+			}
+		}
+	}
+	msElapse_ = std::chrono::duration<double, std::milli>(steady_clock::now() - t0).count();
+	bodies_ = NULL;
+
+	return rslt;
+}
+
+bool APlateSolver::try_quad(const int ids[4], WCSTan& wcs) {
+	const CeleBodyVec& bodies = *bodies_;
+	double x[4], y[4], px[4], py[4], code[4], c[4], d2, d2max(-1.0);
+	int i, j, ia(0), ib(1), ord[4];
+
+	for (i = 0; i < 4; ++i) {
+		x[i] = bodies[order_[ids[i]]].ptBary.x;
+		y[i] = bodies[order_[ids[i]]].ptBary.y;
+	}
+	// AB: 距离最远的两颗星
+	for (i = 0; i < 4; ++i) {
+		for (j = i + 1; j < 4; ++j) {
+			d2 = (x[i] - x[j]) * (x[i] - x[j]) + (y[i] - y[j]) * (y[i] - y[j]);
+			if (d2 > d2max) {
+				d2max = d2;
+				ia = i;
+				ib = j;
+			}
+		}
+	}
+	ord[0] = ia;
+	ord[1] = ib;
+	for (i = 0, j = 2; i < 4; ++i) {
+		if (i != ia && i != ib) ord[j++] = i;
+	}
+	double side = sqrt(d2max);
+	const PlateIndexHeader* header = index_.Header();
+	if (side * sLow_ > header->sideMax * 3600.0 || side * sHigh_ < header->sideMin * 3600.0)
+		return false;
+	for (i = 0; i < 4; ++i) {
+		px[i] = x[ord[i]];
+		py[i] = y[ord[i]];
+	}
+	if (!APlateIndex::QuadCode(px, py, code)) return false;
+
+	// 遍历镜像及AB, CD交换组合
+	vector<uint32_t> cands;
+	double tol = CODE_TOLERANCE, scale;
+	int parity, swapAB, swapCD, k, corr[4];
+	for (parity = 0; parity < 2; ++parity) {
+		for (swapAB = 0; swapAB < 2; ++swapAB) {
+			for (swapCD = 0; swapCD < 2; ++swapCD) {
+				for (k = 0; k < 4; ++k) {
+					// 镜像: 交换编码的X和Y; 交换AB: 1 - code; 交换CD: 交换两组坐标
+					int src = (swapCD ? (k + 2) % 4 : k);
+					if (parity) src ^= 1;
+					c[k] = swapAB ? 1.0 - code[src] : code[src];
+				}
+				if (c[0] > c[2] + tol || c[0] + c[2] > 1.0 + tol) continue;
+
+				corr[0] = ids[ord[swapAB ? 1 : 0]];
+				corr[1] = ids[ord[swapAB ? 0 : 1]];
+				corr[2] = ids[ord[swapCD ? 3 : 2]];
+				corr[3] = ids[ord[swapCD ? 2 : 3]];
+				index_.FindQuads(c, tol, cands);
+				for (vector<uint32_t>::iterator it = cands.begin(); it != cands.end(); ++it) {
+					const PlateIndexQuad& quad = index_.Quad(*it);
+					scale = quad.side * 3600.0 / side;
+					if (scale < sLow_ || scale > sHigh_) continue;
+					if (verify(corr, quad, parity, wcs)) return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+bool APlateSolver::verify(const int ids[4], const PlateIndexQuad& quad, int parity, WCSTan& wcs) {
+	const CeleBodyVec& bodies = *bodies_;
+	double ra0, dc0, sx[4], sy[4];
+	int i;
+
+	++nverify_;
+	// 切点: 四星组中心
+	double vx(0.0), vy(0.0), vz(0.0);
+	for (i = 0; i < 4; ++i) {
+		const PlateIndexStar& star = index_.Star(quad.star[i]);
+		double ra = star.ra * D2R, dc = star.dec * D2R;
+		vx += cos(dc) * cos(ra);
+		vy += cos(dc) * sin(ra);
+		vz += sin(dc);
+	}
+	ra0 = atan2(vy, vx);
+	dc0 = atan2(vz, sqrt(vx * vx + vy * vy));
+	for (i = 0; i < 4; ++i) {
+		const PlateIndexStar& star = index_.Star(quad.star[i]);
+		WCSTan::Project(ra0, dc0, star.ra * D2R, star.dec * D2R, sx[i], sy[i]);
+	}
+
+	// 相似变换: 平面坐标 s = sA + k * (z - zA), 镜像时以共轭替代(z - zA)
+	complexd zA(bodies[order_[ids[0]]].ptBary.x, bodies[order_[ids[0]]].ptBary.y);
+	complexd zB(bodies[order_[ids[1]]].ptBary.x, bodies[order_[ids[1]]].ptBary.y);
+	complexd sA(sx[0], sy[0]), sB(sx[1], sy[1]);
+	complexd dz = parity ? std::conj(zB - zA) : zB - zA;
+	complexd k  = (sB - sA) / dz;
+	complexd z, s;
+	double r2 = rVerify_ * rVerify_;
+
+	// 快速检验: C和D的预测位置
+	for (i = 2; i < 4; ++i) {
+		s = (complexd(sx[i], sy[i]) - sA) / k;
+		z = zA + (parity ? std::conj(s) : s);
+		complexd zi(bodies[order_[ids[i]]].ptBary.x, bodies[order_[ids[i]]].ptBary.y);
+		if (std::norm(z - zi) > r2) return false;
+	}
+
+	// 视场中心及半径
+	double w(wImg_), h(hImg_);
+	complexd dc(w * 0.5, h * 0.5);
+	dc -= zA;
+	s = sA + k * (parity ? std::conj(dc) : dc);
+	double rac, dcc, radius = sqrt(w * w + h * h) * 0.5 * std::abs(k) * R2D * 1.05;
+	WCSTan::Deproject(ra0, dc0, s.real(), s.imag(), rac, dcc);
+
+	// 统计视场内参考星的匹配数量
+	vector<uint32_t> stars;
+	vector<double> x, y, ra, dec;
+	double xi, eta;
+	int id, nmatch(0), nmin(int(param_->matchMin));
+	index_.ConeSearch(rac * R2D, dcc * R2D, radius, stars);
+	if (int(stars.size()) < nmin) return false;
+	for (vector<uint32_t>::iterator it = stars.begin(); it != stars.end(); ++it) {
+		const PlateIndexStar& star = index_.Star(*it);
+		if (!WCSTan::Project(ra0, dc0, star.ra * D2R, star.dec * D2R, xi, eta)) continue;
+		s = (complexd(xi, eta) - sA) / k;
+		z = zA + (parity ? std::conj(s) : s);
+		if (z.real() < 0.0 || z.imag() < 0.0 || z.real() >= w || z.imag() >= h) continue;
+		if ((id = grid_.Nearest(z.real(), z.imag(), rVerify_)) >= 0) {
+			++nmatch;
+			const CelestialBody& body = bodies[order_[id]];
+			x.push_back(body.ptBary.x);
+			y.push_back(body.ptBary.y);
+			ra.push_back(star.ra);
+			dec.push_back(star.dec);
+		}
+	}
+	if (nmatch < nmin) return false;
+
+	// 拟合WCS, 并以拟合结果重新匹配
+	WCSTan trial;
+	if (!trial.Fit(nmatch, x.data(), y.data(), ra.data(), dec.data(), NULL,
+			w * 0.5, h * 0.5, rac * R2D, dcc * R2D))
+		return false;
+	double scale = trial.Scale();
+	if (scale < sLow_ || scale > sHigh_) return false;
+	if (MatchRefine(bodies, order_, grid_, wImg_, hImg_, param_->matchRadius, trial) < nmin)
+		return false;
+	wcs = trial;
+	return true;
+}
+
+int APlateSolver::MatchRefine(const CeleBodyVec& bodies, const vector<int>& ids, const GridIndex& grid,
+		unsigned w, unsigned h, double radius, WCSTan& wcs, int order) {
+	vector<uint32_t> stars;
+	vector<double> x, y, ra, dec;
+	double rac, dcc, px, py;
+	double fovRadius = sqrt(double(w) * w + double(h) * h) * 0.5 * wcs.Scale() / 3600.0 * 1.05;
+	int iter, id, nmatch(0);
+
+	for (iter = 0; iter < 2; ++iter) {
+		x.clear();
+		y.clear();
+		ra.clear();
+		dec.clear();
+		wcs.PixelToSky(w * 0.5, h * 0.5, rac, dcc);
+		index_.ConeSearch(rac, dcc, fovRadius, stars);
+		for (vector<uint32_t>::iterator it = stars.begin(); it != stars.end(); ++it) {
+			const PlateIndexStar& star = index_.Star(*it);
+			if (!wcs.SkyToPixel(star.ra, star.dec, px, py)
+					|| px < 0.0 || py < 0.0 || px >= w || py >= h)
+				continue;
+			if ((id = grid.Nearest(px, py, radius)) >= 0) {
+				const CelestialBody& body = bodies[ids[id]];
+				x.push_back(body.ptBary.x);
+				y.push_back(body.ptBary.y);
+				ra.push_back(star.ra);
+				dec.push_back(star.dec);
+			}
+		}
+		nmatch = int(x.size());
+		if (nmatch < 3 || !wcs.Fit(nmatch, x.data(), y.data(), ra.data(), dec.data(), NULL,
+				w * 0.5, h * 0.5, rac, dcc, order))
+			return nmatch < 3 ? nmatch : 0;
+	}
+	return wcs.nmatch;
+}
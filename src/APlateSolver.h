@@ -0,0 +1,113 @@
+/*!
+ * @class APlateSolver 基于四星组几何散列的盲定位
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * 盲定位流程:
+ * - 按流量排序, 由最亮的若干目标按亮度优先顺序构建四星组
+ * - 计算四星组编码, 在索引中检索编码相近的参考四星组
+ * - 由对应关系建立相似变换假设, 以视场内参考星的匹配数量验证假设
+ * - 验证通过后以全部匹配星对拟合WCS
+ */
+
+#ifndef APLATESOLVER_H_
+#define APLATESOLVER_H_
+
+#include <vector>
+#include "APlateIndex.h"
+#include "GridIndex.hpp"
+#include "WCSTan.hpp"
+#include "ImageFrame.hpp"
+#include "Parameter.hpp"
+
+class APlateSolver {
+public:
+	APlateSolver(const ParamAstrometry* param);
+	virtual ~APlateSolver();
+
+protected:
+	const ParamAstrometry* param_;	/// 配置参数
+	APlateIndex index_;		/// 几何散列索引
+	GridIndex grid_;		/// 参与验证的目标网格索引
+	std::vector<int> order_;	/// 按流量降序排列的目标编号
+	const CeleBodyVec* bodies_;	/// 目标集合
+	unsigned wImg_, hImg_;	/// 图像尺寸
+	double rVerify_;		/// 验证匹配半径, 量纲: 像素
+	double sLow_, sHigh_;	/// 比例尺范围, 量纲: 角秒/像素
+	/* 统计 */
+	int nquad_;			/// 已尝试的图像四星组数量
+	int nverify_;		/// 已验证的假设数量
+	double msElapse_;	/// 耗时, 量纲: 毫秒
+
+public:
+	/*!
+	 * @brief 加载索引文件
+	 * @param filepath 文件路径
+	 * @return
+	 * 加载结果
+	 */
+	bool LoadIndex(const char* filepath);
+	/*!
+	 * @brief 检查索引是否可用
+	 */
+	bool IsReady() const;
+	/*!
+	 * @brief 访问索引
+	 */
+	const APlateIndex& Index() const;
+	/*!
+	 * @brief 盲定位
+	 * @param bodies  从图像中提取的目标
+	 * @param w       图像宽度
+	 * @param h       图像高度
+	 * @param wcs     定位结果
+	 * @return
+	 * 定位结果
+	 */
+	bool Solve(const CeleBodyVec& bodies, unsigned w, unsigned h, WCSTan& wcs);
+	/*!
+	 * @brief 以WCS预测参考星位置并与目标交叉匹配, 由匹配星对重新拟合WCS
+	 * @param bodies  目标集合
+	 * @param ids     参与匹配的目标编号
+	 * @param grid    目标网格索引, 编号与ids一致
+	 * @param w       图像宽度
+	 * @param h       图像高度
+	 * @param radius  匹配半径, 量纲: 像素
+	 * @param wcs     输入: WCS初值; 输出: 拟合结果
+	 * @param order   拟合多项式阶数, 见WCSTan::Fit
+	 * @return
+	 * 匹配星对数量. 小于3时未拟合
+	 */
+	int MatchRefine(const CeleBodyVec& bodies, const std::vector<int>& ids, const GridIndex& grid,
+			unsigned w, unsigned h, double radius, WCSTan& wcs, int order = 1);
+	/*!
+	 * @brief 查看最近一次盲定位的统计量
+	 * @param nquad    尝试的四星组数量
+	 * @param nverify  验证的假设数量
+	 * @return
+	 * 耗时, 量纲: 毫秒
+	 */
+	double LastStat(int& nquad, int& nverify) const;
+
+protected:
+	/*!
+	 * @brief 检索与图像四星组对应的参考四星组并验证
+	 * @param ids  图像四星组中目标的编号
+	 * @param wcs  定位结果
+	 * @return
+	 * 成功建立WCS
+	 */
+	bool try_quad(const int ids[4], WCSTan& wcs);
+	/*!
+	 * @brief 验证对应关系
+	 * @param ids     图像四星组中目标的编号, 顺序与参考四星组一致
+	 * @param quad    参考四星组
+	 * @param parity  镜像标志
+	 * @param wcs     定位结果
+	 * @return
+	 * 验证结果
+	 */
+	bool verify(const int ids[4], const PlateIndexQuad& quad, int parity, WCSTan& wcs);
+};
+
+#endif /* APLATESOLVER_H_ */
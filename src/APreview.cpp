@@ -0,0 +1,221 @@
+/*!
+ * @class APreview 快视预览图: 合并像素, 依据全局背景统计拉伸为8位灰度图像, 输出PNG或PGM
+ * @version 0.1
+ * @date 2021-05
+ */
+
+#include <math.h>
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include "APreview.h"
+#include "AKernels.h"
+
+using std::vector;
+
+APreview::APreview(const ParamPreview* param) {
+	param_   = param;
+	wThumb_  = hThumb_ = 0;
+	lutBeta_ = -1.0;
+	msElapse_ = 0.0;
+}
+
+APreview::~APreview() {
+}
+
+bool APreview::Generate(const float* data, unsigned w, unsigned h, double mean, double sig, const std::string& filepath) {
+	std::chrono::steady_clock::time_point tmStart = std::chrono::steady_clock::now();
+	unsigned b = std::max(1U, param_->binning);
+	if (w < b || h < b) return false;
+
+	bin(data, w, h);
+	// 电平. 背景统计无效时取预览图的中值和灰度范围
+	double lo, hi;
+	if (!(sig > 0.0 && mean > -1E29)) {
+		vector<float> tmp(thumb_);
+		vector<float>::iterator it0 = tmp.begin(), it1 = tmp.end();
+		size_t n = tmp.size();
+		std::nth_element(it0, it0 + n / 2, it1);
+		mean = *(it0 + n / 2);
+		std::nth_element(it0, it0 + n / 100, it0 + n / 2);
+		lo = *(it0 + n / 100);
+		std::nth_element(it0 + n / 2, it0 + n * 999 / 1000, it1);
+		hi = *(it0 + n * 999 / 1000);
+	}
+	else {
+		lo = mean - param_->sigLow * sig;
+		hi = mean + param_->sigHigh * sig;
+	}
+	if (hi <= lo) hi = lo + 1.0;
+	double beta = (mean - lo) / (hi - lo);
+	if (!(beta > 1E-3)) beta = 1E-3;
+	stretch(lo, hi, param_->stretch == STRETCH_ASINH ? beta : 0.0);
+
+	std::string pathTmp = filepath + ".tmp";
+	FILE* fp = fopen(pathTmp.c_str(), "wb");
+	if (!fp) return false;
+	bool rslt = param_->format == PREVIEW_PGM ? write_pgm(fp) : write_png(fp);
+	rslt = fclose(fp) == 0 && rslt;
+	if (rslt) rslt = rename(pathTmp.c_str(), filepath.c_str()) == 0;
+	else remove(pathTmp.c_str());
+	msElapse_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tmStart).count();
+	return rslt;
+}
+
+double APreview::LastStat(unsigned& w, unsigned& h) const {
+	w = wThumb_;
+	h = hThumb_;
+	return msElapse_;
+}
+
+void APreview::bin(const float* data, unsigned w, unsigned h) {
+	unsigned b = std::max(1U, param_->binning);
+	unsigned wb = w / b, hb = h / b, wUse = wb * b, x, y, k;
+	float norm = 1.0f / float(b * b);
+
+	wThumb_ = wb;
+	hThumb_ = hb;
+	acc_.resize(wUse);
+	thumb_.resize(size_t(wb) * hb);
+	float* __restrict acc = acc_.data();
+	const PixelKernels& kernels = AKernels::Get();
+	for (y = 0; y < hb; ++y) {
+		const float* __restrict row = data + size_t(y) * b * w;
+		memcpy(acc, row, wUse * sizeof(float));
+		for (k = 1; k < b; ++k) {// 按列累加: 连续访问
+			row += w;
+			kernels.accumulate(acc, row, wUse);
+		}
+		float* __restrict out = thumb_.data() + size_t(y) * wb;
+		for (x = 0; x < wb; ++x) {
+			const float* p = acc + x * b;
+			float sum(0.0f);
+			for (k = 0; k < b; ++k) sum += p[k];
+			out[x] = sum * norm;
+		}
+	}
+}
+
+void APreview::stretch(double lo, double hi, double beta) {
+	int i;
+	if (beta != lutBeta_) {// 查找表: 归一化灰度 -> 8位灰度
+		double norm = beta > 0.0 ? 1.0 / asinh(1.0 / beta) : 1.0;
+		for (i = 0; i < PREVIEW_LUT_SIZE; ++i) {
+			double t = double(i) / (PREVIEW_LUT_SIZE - 1);
+			double v = beta > 0.0 ? asinh(t / beta) * norm : t;
+			lut_[i] = uint8_t(std::min(255.0, std::max(0.0, v * 255.0 + 0.5)));
+		}
+		lutBeta_ = beta;
+	}
+
+	size_t n = thumb_.size(), j;
+	float off = float(lo), scale = float((PREVIEW_LUT_SIZE - 1) / (hi - lo));
+	const float* __restrict src = thumb_.data();
+	gray_.resize(n);
+	uint8_t* __restrict dst = gray_.data();
+	for (j = 0; j < n; ++j) {
+		float t = (src[j] - off) * scale;
+		t = t < 0.0f ? 0.0f : (t > PREVIEW_LUT_SIZE - 1 ? PREVIEW_LUT_SIZE - 1 : t);
+		dst[j] = lut_[int(t)];
+	}
+}
+
+bool APreview::write_pgm(FILE* fp) {
+	fprintf(fp, "P5\n%u %u\n255\n", wThumb_, hThumb_);
+	return fwrite(gray_.data(), 1, gray_.size(), fp) == gray_.size();
+}
+
+/*!
+ * @struct CrcTable CRC-32查找表, 用于PNG数据块校验
+ */
+struct CrcTable {
+	uint32_t table[256];
+
+public:
+	CrcTable() {
+		for (uint32_t i = 0; i < 256; ++i) {
+			uint32_t c = i;
+			for (int k = 0; k < 8; ++k) c = c & 1 ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
+	}
+
+	uint32_t Update(uint32_t crc, const uint8_t* data, size_t n) const {
+		for (size_t i = 0; i < n; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return crc;
+	}
+};
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t n) {
+	static const CrcTable crcTable;
+	return crcTable.Update(crc, data, n);
+}
+
+static void put_be32(uint8_t* p, uint32_t v) {
+	p[0] = uint8_t(v >> 24);
+	p[1] = uint8_t(v >> 16);
+	p[2] = uint8_t(v >> 8);
+	p[3] = uint8_t(v);
+}
+
+/*!
+ * @brief 写入PNG数据块: 长度、类型、数据、CRC
+ */
+static bool write_chunk(FILE* fp, const char* type, const uint8_t* data, size_t n) {
+	uint8_t head[8], tail[4];
+	put_be32(head, uint32_t(n));
+	memcpy(head + 4, type, 4);
+	uint32_t crc = crc32_update(0xFFFFFFFFU, head + 4, 4);
+	crc = crc32_update(crc, data, n) ^ 0xFFFFFFFFU;
+	put_be32(tail, crc);
+	return fwrite(head, 8, 1, fp) == 1 && (!n || fwrite(data, n, 1, fp) == 1) && fwrite(tail, 4, 1, fp) == 1;
+}
+
+bool APreview::write_png(FILE* fp) {
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	uint8_t ihdr[13];
+	put_be32(ihdr, wThumb_);
+	put_be32(ihdr + 4, hThumb_);
+	ihdr[8]  = 8;	// 位深
+	ihdr[9]  = 0;	// 灰度
+	ihdr[10] = ihdr[11] = ihdr[12] = 0;
+
+	/* IDAT: zlib流, deflate存储块. 每行前置滤波类型0 */
+	size_t line = size_t(wThumb_) + 1, nraw = line * hThumb_, i, n, y;
+	vector<uint8_t> raw(nraw), idat;
+	for (y = 0; y < hThumb_; ++y) {
+		raw[y * line] = 0;
+		memcpy(&raw[y * line + 1], &gray_[y * wThumb_], wThumb_);
+	}
+	uint32_t s1(1), s2(0);
+	for (i = 0; i < nraw; ) {// Adler-32: 每5552字节取模一次不会溢出
+		for (n = std::min(nraw, i + 5552); i < n; ++i) {
+			s1 += raw[i];
+			s2 += s1;
+		}
+		s1 %= 65521;
+		s2 %= 65521;
+	}
+
+	idat.reserve(2 + nraw + (nraw / 65535 + 1) * 5 + 4);
+	idat.push_back(0x78);
+	idat.push_back(0x01);
+	for (i = 0; i < nraw; i += n) {
+		n = std::min(nraw - i, size_t(65535));
+		idat.push_back(i + n == nraw ? 1 : 0);
+		idat.push_back(uint8_t(n));
+		idat.push_back(uint8_t(n >> 8));
+		idat.push_back(uint8_t(~n));
+		idat.push_back(uint8_t(~n >> 8));
+		idat.insert(idat.end(), raw.begin() + i, raw.begin() + i + n);
+	}
+	uint8_t adler[4];
+	put_be32(adler, (s2 << 16) | s1);
+	idat.insert(idat.end(), adler, adler + 4);
+
+	return fwrite(signature, 8, 1, fp) == 1
+			&& write_chunk(fp, "IHDR", ihdr, sizeof(ihdr))
+			&& write_chunk(fp, "IDAT", idat.data(), idat.size())
+			&& write_chunk(fp, "IEND", NULL, 0);
+}
@@ -0,0 +1,78 @@
+/*!
+ * @class APreview 快视预览图: 合并像素, 依据全局背景统计拉伸为8位灰度图像, 输出PNG或PGM
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * - 黑电平为背景以下sigLow倍噪声, 白电平为背景以上sigHigh倍噪声. 反双曲正弦拉伸的软化参数取背景在灰度区间中的位置
+ * - 拉伸以查找表实现. 合并时先按列累加若干行, 再合并相邻列, 内层循环可由编译器向量化
+ * - PNG不压缩(deflate存储块), 无需外部库. 文件先写入临时文件再改名, 读取方不会读到不完整的文件
+ */
+
+#ifndef APREVIEW_H_
+#define APREVIEW_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "Parameter.hpp"
+
+#define PREVIEW_LUT_SIZE	4096	/// 拉伸查找表长度
+
+class APreview {
+public:
+	APreview(const ParamPreview* param);
+	virtual ~APreview();
+
+protected:
+	const ParamPreview* param_;	/// 配置参数
+	unsigned wThumb_, hThumb_;	/// 预览图尺寸
+	std::vector<float> acc_;	/// 行累加缓冲区
+	std::vector<float> thumb_;	/// 合并后的图像
+	std::vector<uint8_t> gray_;	/// 灰度图像
+	uint8_t lut_[PREVIEW_LUT_SIZE];	/// 拉伸查找表
+	double lutBeta_;		/// 查找表对应的软化参数. 参数变化时重新生成
+	double msElapse_;		/// 最近一帧的耗时, 量纲: 毫秒
+
+public:
+	/*!
+	 * @brief 生成预览图
+	 * @param data      图像数据
+	 * @param w         图像宽度
+	 * @param h         图像高度
+	 * @param mean      背景
+	 * @param sig       背景噪声. 无效时由预览图自身的灰度范围确定电平
+	 * @param filepath  文件路径
+	 * @return
+	 * 生成结果
+	 */
+	bool Generate(const float* data, unsigned w, unsigned h, double mean, double sig, const std::string& filepath);
+	/*!
+	 * @brief 查看最近一帧的统计量
+	 * @param w  预览图宽度
+	 * @param h  预览图高度
+	 * @return
+	 * 耗时, 量纲: 毫秒
+	 */
+	double LastStat(unsigned& w, unsigned& h) const;
+
+protected:
+	/*!
+	 * @brief 合并像素
+	 */
+	void bin(const float* data, unsigned w, unsigned h);
+	/*!
+	 * @brief 拉伸为灰度
+	 */
+	void stretch(double lo, double hi, double beta);
+	/*!
+	 * @brief 写入PGM文件
+	 */
+	bool write_pgm(FILE* fp);
+	/*!
+	 * @brief 写入PNG文件
+	 */
+	bool write_png(FILE* fp);
+};
+
+#endif /* APREVIEW_H_ */
@@ -0,0 +1,285 @@
+/*!
+ * @class ARefCatalog 本地参考星表
+ * @version 0.1
+ * @date 2021-05
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "ARefCatalog.h"
+#include "Healpix.hpp"
+#include "GLog.h"
+
+using std::vector;
+
+#define DEG2RAD	0.017453292519943295	/// 角度转换为弧度
+
+ARefCatalog::ARefCatalog() {
+	fd_     = -1;
+	addr_   = NULL;
+	size_   = 0;
+	header_ = NULL;
+	tiles_  = NULL;
+	ra_ = dec_ = NULL;
+	mag_ = pmra_ = pmdec_ = NULL;
+}
+
+ARefCatalog::~ARefCatalog() {
+	Close();
+}
+
+bool ARefCatalog::Open(const char* filepath) {
+	struct stat st;
+
+	Close();
+	if ((fd_ = open(filepath, O_RDONLY)) < 0) return false;
+	if (fstat(fd_, &st) || size_t(st.st_size) < sizeof(RefCatalogHeader)) {
+		Close();
+		return false;
+	}
+	size_ = st.st_size;
+	addr_ = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd_, 0);
+	if (addr_ == MAP_FAILED) {
+		addr_ = NULL;
+		Close();
+		return false;
+	}
+
+	const char* base = (const char*) addr_;
+	header_ = (const RefCatalogHeader*) base;
+	if (memcmp(header_->magic, REF_CATALOG_MAGIC, 8) || header_->version != REF_CATALOG_VERSION
+			|| header_->order > 13 || header_->ntile != Healpix::npix(header_->order)
+			|| header_->offPMDec + header_->nstar * sizeof(float) > size_) {
+		header_ = NULL;
+		Close();
+		return false;
+	}
+	tiles_ = (const uint64_t*) (base + header_->offTile);
+	ra_    = (const double*) (base + header_->offRA);
+	dec_   = (const double*) (base + header_->offDec);
+	mag_   = (const float*) (base + header_->offMag);
+	pmra_  = (const float*) (base + header_->offPMRA);
+	pmdec_ = (const float*) (base + header_->offPMDec);
+	// 天区表常驻内存
+	madvise(addr_, header_->offRA, MADV_WILLNEED);
+
+	pixrad_.resize(header_->order + 1);
+	for (uint32_t i = 0; i <= header_->order; ++i) pixrad_[i] = Healpix::max_pixrad(i);
+
+	return true;
+}
+
+void ARefCatalog::Close() {
+	if (addr_) munmap(addr_, size_);
+	if (fd_ >= 0) close(fd_);
+	fd_     = -1;
+	addr_   = NULL;
+	size_   = 0;
+	header_ = NULL;
+}
+
+bool ARefCatalog::IsOpen() const {
+	return header_ != NULL;
+}
+
+const RefCatalogHeader* ARefCatalog::Header() const {
+	return header_;
+}
+
+size_t ARefCatalog::ConeSearch(double ra, double dec, double radius, double magLimit, RefStarBatch& batch) const {
+	if (!header_) return 0;
+
+	double a = ra * DEG2RAD, d = dec * DEG2RAD;
+	return search(cos(d) * cos(a), cos(d) * sin(a), sin(d), radius * DEG2RAD, NULL, 0, magLimit, batch);
+}
+
+size_t ARefCatalog::PolygonSearch(const double* ra, const double* dec, int n, double magLimit, RefStarBatch& batch) const {
+	if (!header_ || n < 3) return 0;
+
+	vector<double> v(n * 3), normals(n * 3);
+	double cx(0.0), cy(0.0), cz(0.0), norm, radius(0.0), t;
+	int i, j;
+
+	for (i = 0; i < n; ++i) {
+		double a = ra[i] * DEG2RAD, d = dec[i] * DEG2RAD;
+		cx += (v[i * 3]     = cos(d) * cos(a));
+		cy += (v[i * 3 + 1] = cos(d) * sin(a));
+		cz += (v[i * 3 + 2] = sin(d));
+	}
+	if ((norm = sqrt(cx * cx + cy * cy + cz * cz)) < 1E-12) return 0;
+	cx /= norm;
+	cy /= norm;
+	cz /= norm;
+	// 外接圆及各边法向量. 法向量指向多边形内侧
+	for (i = 0; i < n; ++i) {
+		const double* p = &v[i * 3];
+		const double* q = &v[((i + 1) % n) * 3];
+		double* nv = &normals[i * 3];
+		t = acos(std::min(1.0, p[0] * cx + p[1] * cy + p[2] * cz));
+		if (t > radius) radius = t;
+		nv[0] = p[1] * q[2] - p[2] * q[1];
+		nv[1] = p[2] * q[0] - p[0] * q[2];
+		nv[2] = p[0] * q[1] - p[1] * q[0];
+		if (nv[0] * cx + nv[1] * cy + nv[2] * cz < 0.0) {
+			for (j = 0; j < 3; ++j) nv[j] = -nv[j];
+		}
+	}
+
+	return search(cx, cy, cz, radius, normals.data(), n, magLimit, batch);
+}
+
+void ARefCatalog::ReadAll(RefStarBatch& batch) const {
+	batch.Clear();
+	if (!header_) return;
+
+	size_t n = header_->nstar;
+	batch.ra.assign(ra_, ra_ + n);
+	batch.dec.assign(dec_, dec_ + n);
+	batch.mag.assign(mag_, mag_ + n);
+	batch.pmra.assign(pmra_, pmra_ + n);
+	batch.pmdec.assign(pmdec_, pmdec_ + n);
+	batch.row.resize(n);
+	for (size_t i = 0; i < n; ++i) batch.row[i] = i;
+}
+
+size_t ARefCatalog::search(double cx, double cy, double cz, double radius, const double* normals, int n,
+		double magLimit, RefStarBatch& batch) const {
+	struct Node {
+		int order;
+		uint64_t pix;
+	};
+	vector<Node> stack;
+	Node node;
+	int order = int(header_->order), j;
+	double cosr = cos(radius), z, phi, s, dist, sx, sy, sz, cd;
+	size_t n0 = batch.Size();
+	uint64_t i, i1;
+	bool inside;
+
+	for (node.order = 0, node.pix = 0; node.pix < 12; ++node.pix) stack.push_back(node);
+	while (stack.size()) {
+		node = stack.back();
+		stack.pop_back();
+		Healpix::pix2loc(node.order, node.pix, z, phi);
+		s    = sqrt((1.0 - z) * (1.0 + z));
+		dist = acos(std::max(-1.0, std::min(1.0, s * cos(phi) * cx + s * sin(phi) * cy + z * cz)));
+		if (dist > radius + pixrad_[node.order]) continue;
+		if (node.order < order) {// 进入下一阶
+			Node child;
+			child.order = node.order + 1;
+			for (j = 0; j < 4; ++j) {
+				child.pix = (node.pix << 2) + j;
+				stack.push_back(child);
+			}
+			continue;
+		}
+		// 天区完全位于锥形内时无需逐星检查
+		inside = !normals && dist + pixrad_[node.order] <= radius;
+		for (i = tiles_[node.pix], i1 = tiles_[node.pix + 1]; i < i1 && mag_[i] <= magLimit; ++i) {
+			if (!inside) {
+				cd = cos(dec_[i] * DEG2RAD);
+				sx = cd * cos(ra_[i] * DEG2RAD);
+				sy = cd * sin(ra_[i] * DEG2RAD);
+				sz = sin(dec_[i] * DEG2RAD);
+				if (sx * cx + sy * cy + sz * cz < cosr) continue;
+				for (j = 0; j < n; ++j) {
+					const double* nv = normals + j * 3;
+					if (nv[0] * sx + nv[1] * sy + nv[2] * sz < 0.0) break;
+				}
+				if (j < n) continue;
+			}
+			batch.ra.push_back(ra_[i]);
+			batch.dec.push_back(dec_[i]);
+			batch.mag.push_back(mag_[i]);
+			batch.pmra.push_back(pmra_[i]);
+			batch.pmdec.push_back(pmdec_[i]);
+			batch.row.push_back(i);
+		}
+	}
+
+	return batch.Size() - n0;
+}
+
+/*!
+ * @brief 对齐文件偏移量至8字节
+ */
+static uint64_t align8(uint64_t off) {
+	return (off + 7) & ~uint64_t(7);
+}
+
+bool ARefCatalog::Build(const RefStarBatch& stars, int order, double epoch, const char* filepath) {
+	size_t n = stars.Size(), i;
+	if (order < 0 || order > 13) return false;
+
+	// 按天区和星等排序
+	vector<uint64_t> tileOf(n);
+	vector<size_t> idx(n);
+	for (i = 0; i < n; ++i) {
+		double d = stars.dec[i] * DEG2RAD;
+		tileOf[i] = Healpix::loc2pix(order, sin(d), stars.ra[i] * DEG2RAD);
+		idx[i]    = i;
+	}
+	std::sort(idx.begin(), idx.end(), [&tileOf, &stars](size_t i1, size_t i2) {
+		return tileOf[i1] < tileOf[i2] || (tileOf[i1] == tileOf[i2] && stars.mag[i1] < stars.mag[i2]);
+	});
+
+	RefCatalogHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, REF_CATALOG_MAGIC, 8);
+	header.version  = REF_CATALOG_VERSION;
+	header.order    = order;
+	header.ntile    = Healpix::npix(order);
+	header.nstar    = n;
+	header.epoch    = epoch;
+	header.offTile  = align8(sizeof(header));
+	header.offRA    = align8(header.offTile + sizeof(uint64_t) * (header.ntile + 1));
+	header.offDec   = align8(header.offRA   + sizeof(double) * n);
+	header.offMag   = align8(header.offDec  + sizeof(double) * n);
+	header.offPMRA  = align8(header.offMag  + sizeof(float) * n);
+	header.offPMDec = align8(header.offPMRA + sizeof(float) * n);
+
+	vector<uint64_t> tiles(header.ntile + 1, 0);
+	for (i = 0; i < n; ++i) ++tiles[tileOf[i] + 1];
+	for (i = 0; i < header.ntile; ++i) tiles[i + 1] += tiles[i];
+
+	FILE* fp = fopen(filepath, "wb");
+	if (!fp) {
+		_gLog.Write(LOG_FAULT, "failed to create catalog [%s]", filepath);
+		return false;
+	}
+	// 逐列写入
+	vector<double> dcol(n);
+	vector<float> fcol(n);
+	char pad[8] = { 0 };
+	uint64_t off(0);
+	bool rslt(true);
+	auto put = [&](const void* ptr, size_t size, uint64_t pos) {
+		if (rslt && pos > off) rslt = fwrite(pad, 1, pos - off, fp) == pos - off;
+		if (rslt && size) rslt = fwrite(ptr, 1, size, fp) == size;
+		off = pos + size;
+	};
+
+	put(&header, sizeof(header), 0);
+	put(tiles.data(), sizeof(uint64_t) * tiles.size(), header.offTile);
+	for (i = 0; i < n; ++i) dcol[i] = stars.ra[idx[i]];
+	put(dcol.data(), sizeof(double) * n, header.offRA);
+	for (i = 0; i < n; ++i) dcol[i] = stars.dec[idx[i]];
+	put(dcol.data(), sizeof(double) * n, header.offDec);
+	for (i = 0; i < n; ++i) fcol[i] = stars.mag[idx[i]];
+	put(fcol.data(), sizeof(float) * n, header.offMag);
+	for (i = 0; i < n; ++i) fcol[i] = stars.pmra.size() == n ? stars.pmra[idx[i]] : 0.0f;
+	put(fcol.data(), sizeof(float) * n, header.offPMRA);
+	for (i = 0; i < n; ++i) fcol[i] = stars.pmdec.size() == n ? stars.pmdec[idx[i]] : 0.0f;
+	put(fcol.data(), sizeof(float) * n, header.offPMDec);
+	fclose(fp);
+
+	_gLog.Write("catalog [%s]: HEALPix order %d, %lu tiles, %lu stars", filepath, order,
+			(unsigned long) header.ntile, (unsigned long) n);
+	return rslt;
+}
@@ -0,0 +1,167 @@
+/*!
+ * @class ARefCatalog 本地参考星表
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * 星表文件格式:
+ * - 以HEALPix(NESTED)划分天区, 星按天区编号排序, 同一天区内按星等升序排列
+ * - 各列连续存储(赤经, 赤纬, 星等, 自行), 以内存映射方式访问
+ * - 锥形及凸多边形检索按天区层级遍历, 在天区内遇到超出极限星等的星即停止
+ */
+
+#ifndef AREFCATALOG_H_
+#define AREFCATALOG_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#define REF_CATALOG_MAGIC	"ADIPSCAT"	/// 星表文件标识
+#define REF_CATALOG_VERSION	1			/// 星表文件版本
+
+/*!
+ * @struct RefCatalogHeader 星表文件头
+ */
+struct RefCatalogHeader {
+	char magic[8];		/// 文件标识
+	uint32_t version;	/// 版本
+	uint32_t order;		/// HEALPix阶数
+	uint64_t ntile;		/// 天区数量
+	uint64_t nstar;		/// 星数量
+	double epoch;		/// 坐标历元, 量纲: 年
+	uint64_t offTile;	/// 天区起始编号表在文件中的偏移量, 长度: ntile + 1
+	uint64_t offRA;		/// 赤经列
+	uint64_t offDec;	/// 赤纬列
+	uint64_t offMag;	/// 星等列
+	uint64_t offPMRA;	/// 赤经自行列
+	uint64_t offPMDec;	/// 赤纬自行列
+};
+
+/*!
+ * @struct RefStarBatch 检索结果, 按列存储
+ */
+struct RefStarBatch {
+	std::vector<double> ra;		/// 赤经, 量纲: 角度
+	std::vector<double> dec;	/// 赤纬, 量纲: 角度
+	std::vector<float> mag;		/// 星等
+	std::vector<float> pmra;	/// 赤经自行(含cos(dec)), 量纲: 毫角秒/年
+	std::vector<float> pmdec;	/// 赤纬自行, 量纲: 毫角秒/年
+	std::vector<uint64_t> row;	/// 在星表中的行号
+
+public:
+	void Clear() {
+		ra.clear();
+		dec.clear();
+		mag.clear();
+		pmra.clear();
+		pmdec.clear();
+		row.clear();
+	}
+
+	size_t Size() const {
+		return ra.size();
+	}
+
+	void Reserve(size_t n) {
+		ra.reserve(n);
+		dec.reserve(n);
+		mag.reserve(n);
+		pmra.reserve(n);
+		pmdec.reserve(n);
+		row.reserve(n);
+	}
+};
+
+class ARefCatalog {
+public:
+	ARefCatalog();
+	virtual ~ARefCatalog();
+
+protected:
+	int fd_;			/// 文件描述符
+	void* addr_;		/// 内存映射地址
+	size_t size_;		/// 文件长度
+	const RefCatalogHeader* header_;	/// 文件头
+	const uint64_t* tiles_;		/// 天区起始编号
+	const double* ra_;			/// 赤经
+	const double* dec_;			/// 赤纬
+	const float* mag_;			/// 星等
+	const float* pmra_;			/// 赤经自行
+	const float* pmdec_;		/// 赤纬自行
+	std::vector<double> pixrad_;	/// 各阶天区最大半径, 量纲: 弧度
+
+public:
+	/*!
+	 * @brief 以内存映射方式打开星表
+	 * @param filepath 文件路径
+	 * @return
+	 * 打开结果
+	 */
+	bool Open(const char* filepath);
+	/*!
+	 * @brief 关闭星表
+	 */
+	void Close();
+	/*!
+	 * @brief 检查星表是否已打开
+	 */
+	bool IsOpen() const;
+	/*!
+	 * @brief 查看文件头
+	 */
+	const RefCatalogHeader* Header() const;
+	/*!
+	 * @brief 锥形检索
+	 * @param ra        中心赤经, 量纲: 角度
+	 * @param dec       中心赤纬, 量纲: 角度
+	 * @param radius    半径, 量纲: 角度
+	 * @param magLimit  极限星等
+	 * @param batch     检索结果, 追加在已有数据之后
+	 * @return
+	 * 本次检索得到的星数量
+	 */
+	size_t ConeSearch(double ra, double dec, double radius, double magLimit, RefStarBatch& batch) const;
+	/*!
+	 * @brief 凸多边形检索
+	 * @param ra        顶点赤经, 量纲: 角度
+	 * @param dec       顶点赤纬, 量纲: 角度
+	 * @param n         顶点数量, 不少于3
+	 * @param magLimit  极限星等
+	 * @param batch     检索结果, 追加在已有数据之后
+	 * @return
+	 * 本次检索得到的星数量
+	 */
+	size_t PolygonSearch(const double* ra, const double* dec, int n, double magLimit, RefStarBatch& batch) const;
+	/*!
+	 * @brief 遍历全部星, 用于生成索引等离线处理
+	 * @param batch  全部星
+	 */
+	void ReadAll(RefStarBatch& batch) const;
+
+public:
+	/*!
+	 * @brief 生成星表文件
+	 * @param stars     星, 无需排序
+	 * @param order     HEALPix阶数
+	 * @param epoch     坐标历元
+	 * @param filepath  文件路径
+	 * @return
+	 * 生成结果
+	 */
+	static bool Build(const RefStarBatch& stars, int order, double epoch, const char* filepath);
+
+protected:
+	/*!
+	 * @brief 遍历与检索区相交的天区
+	 * @param x, y, z   检索区外接圆中心单位矢量
+	 * @param radius    检索区外接圆半径, 量纲: 弧度
+	 * @param normals   凸多边形各边所在大圆的法向量. NULL: 锥形检索
+	 * @param n         多边形边数
+	 * @param magLimit  极限星等
+	 * @param batch     检索结果
+	 */
+	size_t search(double x, double y, double z, double radius, const double* normals, int n,
+			double magLimit, RefStarBatch& batch) const;
+};
+
+#endif /* AREFCATALOG_H_ */
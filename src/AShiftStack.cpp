@@ -0,0 +1,398 @@
+/*!
+ * @class AShiftStack 合成跟踪: 在候选速度网格上平移叠加序列图像, 探测暗弱运动目标
+ * @version 0.1
+ * @date 2021-05
+ */
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <boost/bind/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include "AShiftStack.h"
+#include "SpatialHash.hpp"
+
+using std::vector;
+typedef std::chrono::steady_clock steady_clock;
+
+AShiftStack::AShiftStack(const ParamSynTrack* param) {
+	param_ = param;
+	wImg_ = hImg_ = 0;
+	x0_ = y0_ = x1_ = y1_ = 0;
+	margin_ = 0;
+	wBuf_ = hBuf_ = 0;
+	next_ = 0;
+	msElapse_ = 0.0;
+	cache_.bytes = cache_.limit = 0;
+	cache_.hit = cache_.miss = 0;
+}
+
+AShiftStack::~AShiftStack() {
+}
+
+void AShiftStack::Reset() {
+	frames_.clear();
+	nodes_.clear();
+	clear_cache();
+}
+
+bool AShiftStack::AddFrame(double t, FloatArray data, unsigned w, unsigned h, double sig, int offx, int offy) {
+	if (frames_.empty()) {
+		wImg_ = w;
+		hImg_ = h;
+	}
+	else if (w != wImg_ || h != hImg_ || Full()) return false;
+
+	SynFrame frame;
+	frame.t    = t;
+	frame.data = data;
+	frame.sig  = sig;
+	frame.offx = offx;
+	frame.offy = offy;
+	frames_.push_back(frame);
+	return true;
+}
+
+int AShiftStack::Count() const {
+	return int(frames_.size());
+}
+
+bool AShiftStack::Full() const {
+	return frames_.size() >= param_->frames;
+}
+
+double AShiftStack::RefTime() const {
+	return frames_.empty() ? 0.0 : frames_[0].t;
+}
+
+int AShiftStack::Search(double vmin, double vmax, SynCandVec& cands) {
+	steady_clock::time_point tmStart = steady_clock::now();
+	int n(int(frames_.size())), i, j, k;
+
+	cands.clear();
+	cands_.clear();
+	cache_.hit = cache_.miss = 0;
+	if (n < 2) return 0;
+	nodes_.clear();
+	build_node(0, n);
+	double dv = nodes_[0].dv, span = frames_[n - 1].t - frames_[0].t;
+	if (dv <= 0.0 || vmax <= 0.0) return 0;
+
+	// 根节点速度网格: 圆环vmin <= |v| <= vmax
+	k = int(vmax / dv);
+	qx_.clear();
+	qy_.clear();
+	for (j = -k; j <= k; ++j) {
+		for (i = -k; i <= k; ++i) {
+			double v = dv * sqrt(double(i * i + j * j));
+			if (v < vmin || v > vmax) continue;
+			qx_.push_back(i);
+			qy_.push_back(j);
+		}
+	}
+	if (qx_.empty()) return 0;
+
+	double sigStack(0.0);
+	for (i = 0; i < n; ++i) sigStack += frames_[i].sig * frames_[i].sig;
+	sigStack = sqrt(sigStack);
+	margin_ = int(ceil(vmax * span)) + 2;
+	cache_.limit = size_t(param_->cacheMB) << 20;
+	unsigned nthread = param_->threads ? param_->threads : boost::thread::hardware_concurrency();
+	if (!nthread) nthread = 1;
+
+	// 逐块搜索. 部分和依赖分块范围, 换块时清空缓存
+	int tile = int(param_->tile);
+	for (y0_ = 0; y0_ < int(hImg_); y0_ += tile) {
+		y1_   = std::min(y0_ + tile, int(hImg_));
+		hBuf_ = y1_ - y0_ + 2 * margin_;
+		for (x0_ = 0; x0_ < int(wImg_); x0_ += tile) {
+			x1_   = std::min(x0_ + tile, int(wImg_));
+			wBuf_ = x1_ - x0_ + 2 * margin_;
+			next_ = 0;
+
+			boost::thread_group thrds;
+			for (unsigned t = 0; t < nthread; ++t)
+				thrds.create_thread(boost::bind(&AShiftStack::thread_search, this, sigStack));
+			thrds.join_all();
+			clear_cache();
+		}
+	}
+
+	merge(cands_);
+	cands.swap(cands_);
+	msElapse_ = std::chrono::duration<double, std::milli>(steady_clock::now() - tmStart).count();
+	return int(qx_.size());
+}
+
+double AShiftStack::LastStat(double& hitRate) const {
+	uint64_t total = cache_.hit + cache_.miss;
+	hitRate = total ? double(cache_.hit) / total : 0.0;
+	return msElapse_;
+}
+
+void AShiftStack::StackDirect(double vx, double vy, FloatVec& stack) const {
+	int w = int(wImg_), h = int(hImg_), x, y, sx, sy, xs, xe, ys;
+	double t0 = RefTime();
+
+	stack.assign(size_t(w) * h, 0.0f);
+	for (vector<SynFrame>::const_iterator it = frames_.begin(); it != frames_.end(); ++it) {
+		sx = int(lround(vx * (it->t - t0))) + it->offx;
+		sy = int(lround(vy * (it->t - t0))) + it->offy;
+		xs = std::max(0, -sx);
+		xe = std::min(w, w - sx);
+		for (y = 0; y < h; ++y) {
+			if ((ys = y + sy) < 0 || ys >= h) continue;
+			float* dst = stack.data() + size_t(y) * w;
+			const float* src = it->data.get() + size_t(ys) * w + sx;
+			for (x = xs; x < xe; ++x) dst[x] += src[x];
+		}
+	}
+}
+
+int AShiftStack::build_node(int first, int last) {
+	int id = int(nodes_.size()), mid, left(-1), right(-1);
+	double span = frames_[last - 1].t - frames_[first].t, dt(0.0);
+
+	nodes_.push_back(SynNode());
+	if (last - first > 1) {
+		mid   = (first + last) / 2;
+		left  = build_node(first, mid);
+		right = build_node(mid, last);
+		dt    = frames_[mid].t - frames_[first].t;
+	}
+	SynNode& node = nodes_[id];
+	node.first = first;
+	node.last  = last;
+	node.left  = left;
+	node.right = right;
+	node.dt    = dt;
+	node.dv    = span > 0.0 ? param_->step / span : 0.0;
+	return id;
+}
+
+void AShiftStack::quantize(const SynNode& node, double vx, double vy, int& qx, int& qy) const {
+	if (node.dv > 0.0) {
+		qx = int(lround(vx / node.dv));
+		qy = int(lround(vy / node.dv));
+	}
+	else qx = qy = 0;
+}
+
+AShiftStack::BuffPtr AShiftStack::partial(int node, int qx, int qy) {
+	uint64_t key = (uint64_t(node) << 32) | (uint64_t(uint16_t(qx)) << 16) | uint16_t(qy);
+	{// 查找缓存
+		mutex_lock lck(mtx_cache_);
+		SynCache::EntryMap::iterator it = cache_.map.find(key);
+		if (it != cache_.map.end()) {
+			cache_.lru.splice(cache_.lru.begin(), cache_.lru, it->second.second);
+			++cache_.hit;
+			return it->second.first;
+		}
+		++cache_.miss;
+	}
+
+	BuffPtr buff = alloc_buffer();
+	compose(node, qx, qy, *buff);
+
+	mutex_lock lck(mtx_cache_);
+	SynCache::EntryMap::iterator it = cache_.map.find(key);
+	if (it != cache_.map.end()) return it->second.first;	// 其它线程已完成计算
+	cache_.lru.push_front(key);
+	cache_.map[key] = SynCache::Entry(buff, cache_.lru.begin());
+	cache_.bytes += buff->size() * sizeof(float);
+	while (cache_.bytes > cache_.limit && cache_.lru.size() > 1) {// 淘汰最久未使用的部分和
+		SynCache::EntryMap::iterator last = cache_.map.find(cache_.lru.back());
+		cache_.bytes -= last->second.first->size() * sizeof(float);
+		if (last->second.first.unique()) cache_.pool.push_back(last->second.first);
+		cache_.map.erase(last);
+		cache_.lru.pop_back();
+	}
+	return buff;
+}
+
+void AShiftStack::compose(int node, int qx, int qy, FloatVec& buff) {
+	const SynNode& nd = nodes_[node];
+	int w = int(wImg_), h = int(hImg_), by, x, y, xs, xe;
+	float* dst;
+
+	if (nd.left < 0) {// 叶节点: 截取参考帧坐标下的分块
+		const SynFrame& frame = frames_[nd.first];
+		int xb = x0_ - margin_ + frame.offx, yb = y0_ - margin_ + frame.offy;
+		xs = std::max(0, -xb);
+		xe = std::min(wBuf_, w - xb);
+		for (by = 0; by < hBuf_; ++by) {
+			dst = buff.data() + size_t(by) * wBuf_;
+			y   = yb + by;
+			if (y < 0 || y >= h || xs >= xe) {
+				memset(dst, 0, wBuf_ * sizeof(float));
+				continue;
+			}
+			if (xs > 0) memset(dst, 0, xs * sizeof(float));
+			memcpy(dst + xs, frame.data.get() + size_t(y) * w + xb + xs, (xe - xs) * sizeof(float));
+			if (xe < wBuf_) memset(dst + xe, 0, (wBuf_ - xe) * sizeof(float));
+		}
+		return;
+	}
+
+	// 父节点 = 左子节点 + 平移后的右子节点
+	double vx(qx * nd.dv), vy(qy * nd.dv);
+	int qlx, qly, qrx, qry, sx, sy;
+	quantize(nodes_[nd.left],  vx, vy, qlx, qly);
+	quantize(nodes_[nd.right], vx, vy, qrx, qry);
+	BuffPtr left  = partial(nd.left,  qlx, qly);
+	BuffPtr right = partial(nd.right, qrx, qry);
+	sx = int(lround(vx * nd.dt));
+	sy = int(lround(vy * nd.dt));
+	xs = std::max(0, -sx);
+	xe = std::min(wBuf_, wBuf_ - sx);
+
+	for (by = 0; by < hBuf_; ++by) {
+		const float* src1 = left->data() + size_t(by) * wBuf_;
+		dst = buff.data() + size_t(by) * wBuf_;
+		y   = by + sy;
+		if (y < 0 || y >= hBuf_ || xs >= xe) {
+			memcpy(dst, src1, wBuf_ * sizeof(float));
+			continue;
+		}
+		const float* src2 = right->data() + size_t(y) * wBuf_ + sx;
+		for (x = 0; x < xs; ++x) dst[x] = src1[x];
+		for (x = xs; x < xe; ++x) dst[x] = src1[x] + src2[x];
+		for (x = xe; x < wBuf_; ++x) dst[x] = src1[x];
+	}
+}
+
+AShiftStack::BuffPtr AShiftStack::alloc_buffer() {
+	BuffPtr buff;
+	{
+		mutex_lock lck(mtx_cache_);
+		if (cache_.pool.size()) {
+			buff = cache_.pool.back();
+			cache_.pool.pop_back();
+		}
+	}
+	if (!buff) buff.reset(new FloatVec);
+	buff->resize(size_t(wBuf_) * hBuf_);
+	return buff;
+}
+
+void AShiftStack::clear_cache() {
+	cache_.lru.clear();
+	cache_.map.clear();
+	cache_.pool.clear();
+	cache_.bytes = 0;
+}
+
+void AShiftStack::thread_search(double sigStack) {
+	FloatVec stack(size_t(wBuf_) * hBuf_), work;
+	SynCandVec cands;
+	double dv = nodes_[0].dv;
+	size_t i;
+
+	while (true) {
+		{
+			mutex_lock lck(mtx_task_);
+			if (next_ >= qx_.size()) break;
+			i = next_++;
+		}
+		// 根节点部分和仅使用一次, 不进入缓存
+		compose(0, qx_[i], qy_[i], stack);
+		detect(stack, qx_[i] * dv, qy_[i] * dv, sigStack, work, cands);
+	}
+
+	mutex_lock lck(mtx_task_);
+	cands_.insert(cands_.end(), cands.begin(), cands.end());
+}
+
+void AShiftStack::detect(const FloatVec& stack, double vx, double vy, double sigStack,
+		FloatVec& work, SynCandVec& cands) const {
+	int tw(x1_ - x0_), th(y1_ - y0_), wb(tw + 2), x, y, i, j;
+	float thresh = float(param_->snr * 3.0 * sigStack);	// 3*3邻域和的噪声为单像素的3倍
+	const float *src, *h0, *h1, *h2;
+	float *dst, b;
+
+	// 3*3邻域和, 先行后列. 计算范围在分块外扩1像素, 用于判定局部极大
+	work.resize(size_t(wb) * (th + 4) + size_t(wb) * (th + 2));
+	float* hsum = work.data();
+	float* box  = hsum + size_t(wb) * (th + 4);
+	for (y = 0; y < th + 4; ++y) {
+		src = stack.data() + size_t(margin_ - 2 + y) * wBuf_ + margin_ - 1;
+		dst = hsum + size_t(y) * wb;
+		for (x = 0; x < wb; ++x) dst[x] = src[x - 1] + src[x] + src[x + 1];
+	}
+	for (y = 0; y < th + 2; ++y) {
+		h0  = hsum + size_t(y) * wb;
+		h1  = h0 + wb;
+		h2  = h1 + wb;
+		dst = box + size_t(y) * wb;
+		for (x = 0; x < wb; ++x) dst[x] = h0[x] + h1[x] + h2[x];
+	}
+
+	for (y = 1; y <= th; ++y) {
+		const float* row = box + size_t(y) * wb;
+		for (x = 1; x <= tw; ++x) {
+			if ((b = row[x]) < thresh) continue;
+			// 局部极大. 相等时取左上
+			if (b <= row[x - wb - 1] || b <= row[x - wb] || b <= row[x - wb + 1] || b <= row[x - 1]
+				|| b < row[x + 1] || b < row[x + wb - 1] || b < row[x + wb] || b < row[x + wb + 1])
+				continue;
+			// 质心
+			double sum(0.0), sx(0.0), sy(0.0), v;
+			for (j = -1; j <= 1; ++j) {
+				src = stack.data() + size_t(margin_ - 1 + y + j) * wBuf_ + margin_ - 1 + x;
+				for (i = -1; i <= 1; ++i) {
+					if ((v = src[i]) <= 0.0) continue;
+					sum += v;
+					sx  += v * i;
+					sy  += v * j;
+				}
+			}
+			SynCandidate cand;
+			cand.x    = x0_ + x - 1 + sx / sum;
+			cand.y    = y0_ + y - 1 + sy / sum;
+			cand.vx   = vx;
+			cand.vy   = vy;
+			cand.flux = b / frames_.size();
+			cand.snr  = b / (3.0 * sigStack);
+			cands.push_back(cand);
+		}
+	}
+}
+
+void AShiftStack::merge(SynCandVec& cands) const {
+	if (cands.empty()) return;
+	std::sort(cands.begin(), cands.end(), [](const SynCandidate& c1, const SynCandidate& c2) {
+		return c1.snr > c2.snr;
+	});
+
+	// 同一目标在其它速度上的部分叠加响应, 其轨迹与真实轨迹在窗口内相交
+	double span = frames_.back().t - frames_.front().t;
+	double r = 2.0 + param_->step, vmax(0.0), v;
+	SynCandVec::iterator it;
+	for (it = cands.begin(); it != cands.end(); ++it) {
+		if ((v = it->vx * it->vx + it->vy * it->vy) > vmax) vmax = v;
+	}
+	double rq = r + 2.0 * sqrt(vmax) * span;
+
+	SpatialHash kept;
+	SynCandVec rslt;
+	vector<int> ids;
+	kept.Reset(std::max(r, rq * 0.5));
+	for (it = cands.begin(); it != cands.end(); ++it) {
+		bool dup(false);
+		kept.Within(it->x, it->y, rq, ids);
+		for (vector<int>::iterator id = ids.begin(); id != ids.end() && !dup; ++id) {
+			const SynCandidate& c = rslt[*id];
+			double dx(it->x - c.x), dy(it->y - c.y), dvx(it->vx - c.vx), dvy(it->vy - c.vy);
+			double dv2 = dvx * dvx + dvy * dvy, t(0.0);
+			if (dv2 > 0.0) t = std::min(span, std::max(0.0, -(dx * dvx + dy * dvy) / dv2));
+			dx += dvx * t;
+			dy += dvy * t;
+			dup = dx * dx + dy * dy <= r * r;
+		}
+		if (dup) continue;
+		kept.Add(it->x, it->y);
+		rslt.push_back(*it);
+	}
+	cands.swap(rslt);
+}
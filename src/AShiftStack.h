@@ -0,0 +1,203 @@
+/*!
+ * @class AShiftStack 合成跟踪: 在候选速度网格上平移叠加序列图像, 探测暗弱运动目标
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * - 输入为扣除背景并屏蔽静态源的图像窗口. 帧间指向变化以整数像素偏移补偿
+ * - 速度网格步长为窗口时长内位移step像素. 以参考帧(首帧)时刻位置和速度描述候体
+ * - 部分和以二叉树分层复用: 节点覆盖连续若干帧, 其速度网格随时长变粗;
+ *   父节点的部分和由左右子节点在最近速度上的部分和平移相加得到.
+ *   每层引入不超过0.5*step像素的位置误差
+ * - 图像按分块处理, 部分和按LRU缓存, 缓存总量受限. 分块内速度网格由多线程并行
+ * - 候体按轨迹在窗口内是否相交合并, 保留信噪比最高者
+ */
+
+#ifndef ASHIFTSTACK_H_
+#define ASHIFTSTACK_H_
+
+#include <stdint.h>
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <boost/smart_ptr/shared_ptr.hpp>
+#include <boost/smart_ptr/shared_array.hpp>
+#include <boost/thread/mutex.hpp>
+#include "Parameter.hpp"
+
+/*!
+ * @struct SynCandidate 合成跟踪候体
+ */
+struct SynCandidate {
+	double x, y;	/// 参考帧时刻的位置, 参考帧像素坐标
+	double vx, vy;	/// 速度, 量纲: 像素/秒
+	double flux;	/// 单帧平均流量
+	double snr;		/// 叠加图像信噪比
+};
+typedef std::vector<SynCandidate> SynCandVec;
+
+class AShiftStack {
+public:
+	AShiftStack(const ParamSynTrack* param);
+	virtual ~AShiftStack();
+
+public:
+	typedef boost::shared_array<float> FloatArray;
+
+protected:
+	typedef std::vector<float> FloatVec;
+	typedef boost::shared_ptr<FloatVec> BuffPtr;
+	typedef boost::unique_lock<boost::mutex> mutex_lock;
+
+	/*!
+	 * @struct SynFrame 窗口内的单帧图像
+	 */
+	struct SynFrame {
+		double t;			/// 时间, 量纲: 秒
+		FloatArray data;	/// 扣除背景后的图像数据
+		double sig;			/// 背景噪声
+		int offx, offy;		/// 参考帧像素在本帧中的偏移
+	};
+
+	/*!
+	 * @struct SynNode 部分和树节点, 覆盖帧[first, last)
+	 */
+	struct SynNode {
+		int first, last;	/// 帧范围
+		int left, right;	/// 子节点. -1: 叶节点
+		double dv;			/// 速度网格步长, 量纲: 像素/秒
+		double dt;			/// 右子节点首帧相对本节点首帧的时间
+	};
+
+	/*!
+	 * @struct SynCache 部分和LRU缓存
+	 */
+	struct SynCache {
+		typedef std::list<uint64_t> KeyList;
+		typedef std::pair<BuffPtr, KeyList::iterator> Entry;
+		typedef std::unordered_map<uint64_t, Entry> EntryMap;
+
+		KeyList lru;	/// 最近使用在前
+		EntryMap map;	/// 键: 节点与速度
+		std::vector<BuffPtr> pool;	/// 已淘汰的缓冲区, 供复用
+		size_t bytes;	/// 已用字节数
+		size_t limit;	/// 字节数上限
+		uint64_t hit, miss;	/// 命中统计
+	};
+
+protected:
+	const ParamSynTrack* param_;	/// 配置参数
+	unsigned wImg_, hImg_;	/// 图像尺寸
+	std::vector<SynFrame> frames_;	/// 图像窗口
+	std::vector<SynNode> nodes_;	/// 部分和树. 0为根节点
+	/* 分块 */
+	int x0_, y0_, x1_, y1_;	/// 分块范围, 不含外扩边界
+	int margin_;		/// 外扩边界, 覆盖窗口内最大位移
+	int wBuf_, hBuf_;	/// 部分和缓冲区尺寸
+	SynCache cache_;	/// 部分和缓存
+	boost::mutex mtx_cache_;	/// 互斥锁: 缓存
+	/* 速度网格 */
+	std::vector<int> qx_, qy_;	/// 根节点速度网格
+	size_t next_;		/// 下一个待处理速度
+	boost::mutex mtx_task_;	/// 互斥锁: 任务与结果
+	SynCandVec cands_;	/// 候体
+	/* 统计 */
+	double msElapse_;	/// 最近一次搜索耗时, 量纲: 毫秒
+
+public:
+	/*!
+	 * @brief 清空图像窗口
+	 */
+	void Reset();
+	/*!
+	 * @brief 加入一帧图像
+	 * @param t     时间, 量纲: 秒
+	 * @param data  扣除背景并屏蔽静态源的图像数据. 窗口持有该数据直至Reset
+	 * @param w     图像宽度
+	 * @param h     图像高度
+	 * @param sig   背景噪声
+	 * @param offx  参考帧像素在本帧中的X偏移
+	 * @param offy  参考帧像素在本帧中的Y偏移
+	 * @return
+	 * 尺寸与窗口不一致或窗口已满时返回false
+	 */
+	bool AddFrame(double t, FloatArray data, unsigned w, unsigned h, double sig, int offx, int offy);
+	/*!
+	 * @brief 窗口内帧数
+	 */
+	int Count() const;
+	/*!
+	 * @brief 窗口是否已满
+	 */
+	bool Full() const;
+	/*!
+	 * @brief 窗口参考时刻
+	 */
+	double RefTime() const;
+	/*!
+	 * @brief 在速度网格上平移叠加并探测候体
+	 * @param vmin   速度下限, 量纲: 像素/秒. 低于下限的速度不参与搜索
+	 * @param vmax   速度上限, 量纲: 像素/秒
+	 * @param cands  候体
+	 * @return
+	 * 参与搜索的速度数量
+	 */
+	int Search(double vmin, double vmax, SynCandVec& cands);
+	/*!
+	 * @brief 查看最近一次搜索的统计量
+	 * @param hitRate  部分和缓存命中率
+	 * @return
+	 * 耗时, 量纲: 毫秒
+	 */
+	double LastStat(double& hitRate) const;
+	/*!
+	 * @brief 逐帧平移叠加, 不复用部分和. 用于评估分层算法
+	 * @param vx     速度, 量纲: 像素/秒
+	 * @param vy     速度, 量纲: 像素/秒
+	 * @param stack  叠加图像, 参考帧全幅
+	 */
+	void StackDirect(double vx, double vy, FloatVec& stack) const;
+
+protected:
+	/*!
+	 * @brief 构建部分和树
+	 * @return
+	 * 节点编号
+	 */
+	int build_node(int first, int last);
+	/*!
+	 * @brief 速度在节点网格上的量化值
+	 */
+	void quantize(const SynNode& node, double vx, double vy, int& qx, int& qy) const;
+	/*!
+	 * @brief 查找或计算节点在速度网格(qx, qy)上的部分和
+	 */
+	BuffPtr partial(int node, int qx, int qy);
+	/*!
+	 * @brief 计算节点在速度网格(qx, qy)上的部分和
+	 */
+	void compose(int node, int qx, int qy, FloatVec& buff);
+	/*!
+	 * @brief 分配部分和缓冲区. 优先复用已淘汰的缓冲区
+	 */
+	BuffPtr alloc_buffer();
+	/*!
+	 * @brief 清空缓存
+	 */
+	void clear_cache();
+	/*!
+	 * @brief 线程: 依次处理分块内的速度
+	 */
+	void thread_search(double sigStack);
+	/*!
+	 * @brief 在叠加图像中探测候体
+	 * @param work  临时缓冲区
+	 */
+	void detect(const FloatVec& stack, double vx, double vy, double sigStack,
+			FloatVec& work, SynCandVec& cands) const;
+	/*!
+	 * @brief 合并同一目标在相邻速度上的候体
+	 */
+	void merge(SynCandVec& cands) const;
+};
+
+#endif /* ASHIFTSTACK_H_ */
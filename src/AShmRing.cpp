@@ -0,0 +1,246 @@
+/*!
+ * @class AShmRing 共享内存环形帧缓存区: 采集进程写入, 处理流程零复制读取
+ * @version 0.1
+ * @date 2021-05
+ */
+
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#include "AShmRing.h"
+
+AShmRing::AShmRing() {
+	owner_  = false;
+	addr_   = NULL;
+	size_   = 0;
+	header_ = NULL;
+	slots_  = NULL;
+	seq_    = 0;
+}
+
+AShmRing::~AShmRing() {
+	Close();
+}
+
+bool AShmRing::Create(const char* name, unsigned nslot, unsigned wMax, unsigned hMax) {
+	if (IsOpen() || !nslot || !wMax || !hMax) return false;
+
+	size_t page = size_t(sysconf(_SC_PAGESIZE));
+	size_t offData = (sizeof(ShmRingHeader) + sizeof(ShmSlot) * nslot + page - 1) / page * page;
+	size_t slotBytes = (size_t(wMax) * hMax * sizeof(float) + page - 1) / page * page;
+	size_t size = offData + slotBytes * nslot;
+	int fd;
+
+	if ((fd = shm_open(name, O_CREAT | O_RDWR, 0600)) < 0) return false;
+	if (ftruncate(fd, off_t(size))) {
+		close(fd);
+		shm_unlink(name);
+		return false;
+	}
+	addr_ = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr_ == MAP_FAILED) {
+		addr_ = NULL;
+		shm_unlink(name);
+		return false;
+	}
+
+	name_   = name;
+	owner_  = true;
+	size_   = size;
+	header_ = (ShmRingHeader*) addr_;
+	slots_  = (ShmSlot*) (header_ + 1);
+	seq_    = 0;
+	memset(addr_, 0, offData);
+	header_->version   = SHM_RING_VERSION;
+	header_->nslot     = nslot;
+	header_->wMax      = wMax;
+	header_->hMax      = hMax;
+	header_->slotBytes = slotBytes;
+	header_->offData   = offData;
+	header_->ready.store(0);
+	header_->released.store(0);
+	header_->closed.store(0);
+	for (unsigned i = 0; i < nslot; ++i) slots_[i].state.store(SLOT_FREE);
+	// 最后写入标识: 消费者以此判断初始化已完成
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(header_->magic, SHM_RING_MAGIC, sizeof(header_->magic));
+
+	return true;
+}
+
+bool AShmRing::Open(const char* name) {
+	if (IsOpen()) return false;
+
+	struct stat st;
+	int fd;
+	if ((fd = shm_open(name, O_RDWR, 0600)) < 0) return false;
+	if (fstat(fd, &st) || size_t(st.st_size) < sizeof(ShmRingHeader)) {
+		close(fd);
+		return false;
+	}
+	addr_ = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr_ == MAP_FAILED) {
+		addr_ = NULL;
+		return false;
+	}
+
+	size_   = st.st_size;
+	header_ = (ShmRingHeader*) addr_;
+	slots_  = (ShmSlot*) (header_ + 1);
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (memcmp(header_->magic, SHM_RING_MAGIC, sizeof(header_->magic))
+			|| header_->version != SHM_RING_VERSION
+			|| header_->offData + header_->slotBytes * header_->nslot > size_) {
+		Close();
+		return false;
+	}
+	name_  = name;
+	owner_ = false;
+
+	// 单消费者: 占用状态的帧槽属于已退出的前一消费者, 归还后唤醒等待中的生产者
+	bool reclaimed(false);
+	for (uint32_t i = 0; i < header_->nslot; ++i) {
+		uint32_t state = SLOT_BUSY;
+		if (slots_[i].state.compare_exchange_strong(state, SLOT_FREE, std::memory_order_acq_rel)) reclaimed = true;
+	}
+	if (reclaimed) wake_all(&header_->released);
+
+	// 从最早的就绪帧开始
+	uint64_t seq(UINT64_MAX);
+	for (uint32_t i = 0; i < header_->nslot; ++i) {
+		if (slots_[i].state.load(std::memory_order_acquire) == SLOT_READY && slots_[i].seq < seq)
+			seq = slots_[i].seq;
+	}
+	if (seq == UINT64_MAX) {// 无就绪帧: 等待序号最大的已发布帧的下一帧
+		seq = 0;
+		for (uint32_t i = 0; i < header_->nslot; ++i) {
+			if (slots_[i].tmReady && slots_[i].seq + 1 > seq) seq = slots_[i].seq + 1;
+		}
+	}
+	seq_ = seq;
+
+	return true;
+}
+
+void AShmRing::Close() {
+	if (!addr_) return;
+	if (owner_ && header_->version) {
+		header_->closed.store(1);
+		wake_all(&header_->ready);
+	}
+	munmap(addr_, size_);
+	if (owner_) shm_unlink(name_.c_str());
+	addr_   = NULL;
+	size_   = 0;
+	header_ = NULL;
+	slots_  = NULL;
+	owner_  = false;
+	name_.clear();
+}
+
+bool AShmRing::IsOpen() const {
+	return addr_ != NULL;
+}
+
+const ShmRingHeader* AShmRing::Header() const {
+	return header_;
+}
+
+ShmSlot* AShmRing::Slot(int i) {
+	return slots_ + i;
+}
+
+float* AShmRing::Data(int i) {
+	return (float*) ((char*) addr_ + header_->offData + header_->slotBytes * i);
+}
+
+int AShmRing::Acquire(int ms) {
+	int i = int(seq_ % header_->nslot);
+	int64_t tmEnd = ms < 0 ? INT64_MAX : Now() + int64_t(ms) * 1000000;
+	int64_t left;
+
+	while (true) {
+		uint32_t old = header_->released.load(std::memory_order_acquire);
+		if (slots_[i].state.load(std::memory_order_acquire) == SLOT_FREE) return i;
+		if (ms >= 0 && (left = tmEnd - Now()) <= 0) return -1;
+		wait_on(&header_->released, old, ms < 0 ? -1 : int(left / 1000000) + 1);
+	}
+}
+
+void AShmRing::Publish(int i, unsigned w, unsigned h, double expdur, const char* dateobs, const char* name) {
+	ShmSlot* slot = slots_ + i;
+	slot->w       = w;
+	slot->h       = h;
+	slot->seq     = seq_++;
+	slot->expdur  = expdur;
+	slot->tmReady = Now();
+	strncpy(slot->dateobs, dateobs ? dateobs : "", sizeof(slot->dateobs) - 1);
+	slot->dateobs[sizeof(slot->dateobs) - 1] = 0;
+	strncpy(slot->name, name ? name : "", sizeof(slot->name) - 1);
+	slot->name[sizeof(slot->name) - 1] = 0;
+	slot->state.store(SLOT_READY, std::memory_order_release);
+	wake_all(&header_->ready);
+}
+
+int AShmRing::Wait(int ms) {
+	int i = int(seq_ % header_->nslot);
+	int64_t tmEnd = ms < 0 ? INT64_MAX : Now() + int64_t(ms) * 1000000;
+	int64_t left;
+
+	while (true) {
+		uint32_t old = header_->ready.load(std::memory_order_acquire);
+		uint32_t expect = SLOT_READY;
+		if (slots_[i].state.compare_exchange_strong(expect, SLOT_BUSY, std::memory_order_acq_rel)) {
+			seq_ = slots_[i].seq + 1;
+			return i;
+		}
+		if (header_->closed.load(std::memory_order_acquire)) return -2;
+		if (ms >= 0 && (left = tmEnd - Now()) <= 0) return -1;
+		wait_on(&header_->ready, old, ms < 0 ? -1 : int(left / 1000000) + 1);
+	}
+}
+
+void AShmRing::Release(int i) {
+	if (!addr_) return;
+	slots_[i].state.store(SLOT_FREE, std::memory_order_release);
+	wake_all(&header_->released);
+}
+
+int64_t AShmRing::Now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+void AShmRing::wait_on(std::atomic<uint32_t>* word, uint32_t old, int ms) {
+#ifdef __linux__
+	// 共享内存中的futex: 不使用FUTEX_PRIVATE_FLAG, 以便跨进程唤醒
+	struct timespec ts, *pts(NULL);
+	if (ms >= 0) {
+		ts.tv_sec  = ms / 1000;
+		ts.tv_nsec = (ms % 1000) * 1000000L;
+		pts = &ts;
+	}
+	syscall(SYS_futex, (uint32_t*) word, FUTEX_WAIT, old, pts, NULL, 0);
+#else
+	struct timespec ts = { 0, 500000 };
+	if (word->load(std::memory_order_acquire) == old) nanosleep(&ts, NULL);
+#endif
+}
+
+void AShmRing::wake_all(std::atomic<uint32_t>* word) {
+	word->fetch_add(1, std::memory_order_acq_rel);
+#ifdef __linux__
+	syscall(SYS_futex, (uint32_t*) word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+}
@@ -0,0 +1,149 @@
+/*!
+ * @class AShmRing 共享内存环形帧缓存区: 采集进程写入, 处理流程零复制读取
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * 结构:
+ * - POSIX共享内存. 文件头、帧槽描述及页对齐的帧数据区
+ * - 帧槽按序号循环使用. 状态: 空闲(生产者可写) -> 就绪(消费者可读) -> 占用(处理中) -> 空闲
+ * - 就绪和归还以文件头中的计数器通知, Linux下以跨进程futex等待和唤醒, 其它平台以短周期轮询替代
+ * 使用:
+ * - 生产者: Create, Acquire获取空闲帧槽并写入数据, Publish发布
+ * - 消费者: Open, Wait获取就绪帧槽, 处理完成后Release归还
+ */
+
+#ifndef ASHMRING_H_
+#define ASHMRING_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <string>
+
+#define SHM_RING_MAGIC		"ADIPSSHM"	/// 共享内存标识
+#define SHM_RING_VERSION	1			/// 共享内存版本
+
+enum {
+	SLOT_FREE,		/// 空闲
+	SLOT_READY,		/// 就绪
+	SLOT_BUSY		/// 占用
+};
+
+/*!
+ * @struct ShmRingHeader 共享内存文件头
+ */
+struct ShmRingHeader {
+	char magic[8];		/// 标识
+	uint32_t version;	/// 版本
+	uint32_t nslot;		/// 帧槽数量
+	uint32_t wMax, hMax;	/// 最大图像尺寸
+	uint64_t slotBytes;	/// 单个帧槽数据区长度, 页对齐
+	uint64_t offData;	/// 数据区在共享内存中的偏移量
+	std::atomic<uint32_t> ready;	/// 计数: 发布的帧. 消费者在其上等待
+	std::atomic<uint32_t> released;	/// 计数: 归还的帧. 生产者在其上等待
+	std::atomic<uint32_t> closed;	/// 生产者已关闭
+};
+
+/*!
+ * @struct ShmSlot 帧槽描述
+ */
+struct ShmSlot {
+	std::atomic<uint32_t> state;	/// 状态
+	uint32_t w, h;		/// 图像尺寸
+	uint64_t seq;		/// 帧序号
+	double expdur;		/// 曝光时间, 量纲: 秒
+	int64_t tmReady;	/// 发布时刻, CLOCK_MONOTONIC, 量纲: 纳秒
+	char dateobs[32];	/// 曝光起始时间, 格式: CCYY-MM-DDThh:mm:ss<.sss<sss>>, UTC
+	char name[64];		/// 帧名称
+};
+
+class AShmRing {
+public:
+	AShmRing();
+	virtual ~AShmRing();
+
+protected:
+	std::string name_;	/// 共享内存名称
+	bool owner_;		/// 生产者: 创建并负责删除共享内存
+	void* addr_;		/// 映射地址
+	size_t size_;		/// 映射长度
+	ShmRingHeader* header_;	/// 文件头
+	ShmSlot* slots_;	/// 帧槽描述
+	uint64_t seq_;		/// 下一帧序号: 生产者写入或消费者读取
+
+public:
+	/*!
+	 * @brief 生产者: 创建共享内存. 同名共享内存已存在时重新初始化
+	 * @param name   名称, 以'/'开头
+	 * @param nslot  帧槽数量
+	 * @param wMax   最大图像宽度
+	 * @param hMax   最大图像高度
+	 */
+	bool Create(const char* name, unsigned nslot, unsigned wMax, unsigned hMax);
+	/*!
+	 * @brief 消费者: 映射已有共享内存, 从最早的就绪帧开始读取.
+	 * 前一消费者退出时仍占用的帧槽被归还
+	 */
+	bool Open(const char* name);
+	/*!
+	 * @brief 解除映射. 生产者同时通知消费者并删除共享内存
+	 */
+	void Close();
+	/*!
+	 * @brief 检查是否已映射
+	 */
+	bool IsOpen() const;
+	/*!
+	 * @brief 文件头
+	 */
+	const ShmRingHeader* Header() const;
+	/*!
+	 * @brief 帧槽描述
+	 */
+	ShmSlot* Slot(int i);
+	/*!
+	 * @brief 帧槽数据区
+	 */
+	float* Data(int i);
+	/*!
+	 * @brief 生产者: 等待下一帧槽空闲
+	 * @param ms  超时, 量纲: 毫秒. 负值: 无限等待
+	 * @return
+	 * 帧槽编号. 超时返回-1
+	 */
+	int Acquire(int ms);
+	/*!
+	 * @brief 生产者: 发布已写入的帧
+	 */
+	void Publish(int i, unsigned w, unsigned h, double expdur, const char* dateobs, const char* name);
+	/*!
+	 * @brief 消费者: 等待下一帧就绪. 返回的帧槽置为占用
+	 * @param ms  超时, 量纲: 毫秒. 负值: 无限等待
+	 * @return
+	 * 帧槽编号. 超时返回-1, 生产者已关闭返回-2
+	 */
+	int Wait(int ms);
+	/*!
+	 * @brief 消费者: 归还帧槽. 可在任意线程中调用
+	 */
+	void Release(int i);
+	/*!
+	 * @brief 单调时钟, 量纲: 纳秒. 与发布时刻比较以计算传输延迟
+	 */
+	static int64_t Now();
+
+protected:
+	/*!
+	 * @brief 在计数器上等待其值变化
+	 * @param word  计数器
+	 * @param old   已知值
+	 * @param ms    超时, 量纲: 毫秒. 负值: 无限等待
+	 */
+	static void wait_on(std::atomic<uint32_t>* word, uint32_t old, int ms);
+	/*!
+	 * @brief 计数器加一并唤醒全部等待者
+	 */
+	static void wake_all(std::atomic<uint32_t>* word);
+};
+
+#endif /* ASHMRING_H_ */
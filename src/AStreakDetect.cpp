@@ -0,0 +1,527 @@
+/*!
+ * @class AStreakDetect 检测并屏蔽卫星/快速运动目标拖线
+ * @version 0.1
+ * @date 2021-05
+ */
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <boost/bind/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include "AStreakDetect.h"
+
+using std::vector;
+using namespace boost::placeholders;
+typedef std::chrono::steady_clock steady_clock;
+
+AStreakDetect::AStreakDetect(const ParamStreak* param) {
+	param_   = param;
+	nthread_ = param->threads ? param->threads : boost::thread::hardware_concurrency();
+	if (!nthread_) nthread_ = 1;
+	wBin_ = hBin_ = 0;
+	nTheta_ = nRho_ = rhoOff_ = 0;
+	nPoint_   = 0;
+	msElapse_ = 0.0;
+}
+
+AStreakDetect::~AStreakDetect() {
+}
+
+int AStreakDetect::Detect(float* data, int w, int h, double back, double sig, StreakVec& streaks, char* mask) {
+	steady_clock::time_point tmStart = steady_clock::now();
+	int bin(int(param_->binning)), i, t, r;
+
+	streaks.clear();
+	nPoint_ = 0;
+	wBin_   = w / bin;
+	hBin_   = h / bin;
+	if (wBin_ < 8 || hBin_ < 8 || sig <= 0.0) return 0;
+
+	// 降采样掩模. 降采样像素均值的噪声为sig / bin
+	mask_.resize(size_t(wBin_) * hBin_);
+	parallel(hBin_, boost::bind(&AStreakDetect::bin_mask, this, data, w,
+			back * bin * bin + param_->snr * sig * bin, _1, _2));
+	filter_compact();
+	if ((nPoint_ = int(px_.size())) < 2) {
+		msElapse_ = std::chrono::duration<double, std::milli>(steady_clock::now() - tmStart).count();
+		return 0;
+	}
+
+	// Hough累加器. 倾角分辨率使对角线长度的直线端点偏差不超过1个降采样像素
+	double diag = sqrt(double(wBin_) * wBin_ + double(hBin_) * hBin_);
+	nTheta_ = std::max(180, int(M_PI * diag * 0.25));
+	rhoOff_ = int(ceil(diag)) + 1;
+	nRho_   = 2 * rhoOff_ + 1;
+	cosT_.resize(nTheta_);
+	sinT_.resize(nTheta_);
+	for (t = 0; t < nTheta_; ++t) {
+		cosT_[t] = cos(M_PI * t / nTheta_);
+		sinT_[t] = sin(M_PI * t / nTheta_);
+	}
+	acc_.assign(size_t(nTheta_) * nRho_, 0);
+	vector<int> ids(nPoint_);
+	for (i = 0; i < nPoint_; ++i) ids[i] = i;
+	used_.assign(nPoint_, 0);
+	parallel(nTheta_, boost::bind(&AStreakDetect::vote, this, boost::cref(ids), 1, _1, _2));
+
+	// 依次取峰值. 各倾角的最大值单独维护, 累加器变化时仅更新受影响的行.
+	// 暗弱拖线可能断为多段, 合并前的段数上限为拖线数上限的4倍
+	int votesMin = std::max(3, int(param_->lenMin / bin * 0.5));
+	int tries(0), triesMax(int(param_->maxCount) * 4 + 16), nseg, j, k;
+	vector<double> segs, lines;
+	rowMax_.resize(nTheta_);
+	rowArg_.resize(nTheta_);
+	parallel(nTheta_, boost::bind(&AStreakDetect::row_peak, this, _1, _2));
+	while (lines.size() / 4 < param_->maxCount * 4 && tries++ < triesMax) {
+		t = int(std::max_element(rowMax_.begin(), rowMax_.end()) - rowMax_.begin());
+		if (rowMax_[t] < votesMin) break;
+		r = rowArg_[t];
+		if (!(nseg = segment(t, r, segs))) {// 非拖线: 清除峰值邻域, 避免重复选取
+			for (j = std::max(0, t - 1); j <= std::min(nTheta_ - 1, t + 1); ++j) {
+				for (k = std::max(0, r - 1); k <= std::min(nRho_ - 1, r + 1); ++k)
+					acc_[size_t(j) * nRho_ + k] = 0;
+			}
+			row_peak(std::max(0, t - 1), std::min(nTheta_, t + 2));
+			continue;
+		}
+		parallel(nTheta_, boost::bind(&AStreakDetect::row_peak, this, _1, _2));
+		lines.insert(lines.end(), segs.begin(), segs.end());
+	}
+
+	// 合并同一拖线的断续段后测量
+	merge(lines);
+	for (i = 0; i < int(lines.size()) / 4 && streaks.size() < param_->maxCount; ++i) {
+		StreakSegment streak;
+		measure(data, w, h, back, sig, &lines[i * 4], streak, mask);
+		streaks.push_back(streak);
+	}
+
+	msElapse_ = std::chrono::duration<double, std::milli>(steady_clock::now() - tmStart).count();
+	return int(streaks.size());
+}
+
+double AStreakDetect::LastStat(int& npoint) const {
+	npoint = nPoint_;
+	return msElapse_;
+}
+
+void AStreakDetect::parallel(int n, const boost::function<void (int, int)>& func) {
+	int nt = std::min(int(nthread_), n), step, i;
+	if (nt <= 1) {
+		func(0, n);
+		return;
+	}
+	boost::thread_group thrds;
+	step = (n + nt - 1) / nt;
+	for (i = 0; i < nt && i * step < n; ++i)
+		thrds.create_thread(boost::bind(func, i * step, std::min(n, (i + 1) * step)));
+	thrds.join_all();
+}
+
+void AStreakDetect::bin_mask(const float* data, int w, double thresh, int row0, int row1) {
+	int bin(int(param_->binning)), by, bx, j, k;
+	vector<float> sum(wBin_);
+	float th = float(thresh);
+
+	for (by = row0; by < row1; ++by) {
+		std::fill(sum.begin(), sum.end(), 0.0f);
+		for (j = 0; j < bin; ++j) {
+			const float* row = data + size_t(by * bin + j) * w;
+			for (bx = 0; bx < wBin_; ++bx, row += bin) {
+				for (k = 0; k < bin; ++k) sum[bx] += row[k];
+			}
+		}
+		uint8_t* dst = mask_.data() + size_t(by) * wBin_;
+		for (bx = 0; bx < wBin_; ++bx) dst[bx] = sum[bx] > th;
+	}
+}
+
+void AStreakDetect::filter_compact() {
+	int n(wBin_ * hBin_), i, j, k, x, y, xx, yy, nlab(0);
+	int extMin = int(param_->lenMin / param_->binning);
+	vector<int> stack, xmin, xmax, ymin, ymax, keep;
+	double sx, sy, sxx, syy, sxy, cnt, mxx, myy, mxy, tr, det, l1, l2;
+
+	// 8连通域标记, 统计外接矩形和二阶矩
+	label_.assign(n, -1);
+	for (i = 0; i < n; ++i) {
+		if (!mask_[i] || label_[i] >= 0) continue;
+		label_[i] = nlab;
+		xmin.push_back(i % wBin_);
+		xmax.push_back(i % wBin_);
+		ymin.push_back(i / wBin_);
+		ymax.push_back(i / wBin_);
+		stack.push_back(i);
+		sx = sy = sxx = syy = sxy = cnt = 0.0;
+		while (stack.size()) {
+			k = stack.back();
+			stack.pop_back();
+			x = k % wBin_;
+			y = k / wBin_;
+			if (x < xmin[nlab]) xmin[nlab] = x;
+			if (x > xmax[nlab]) xmax[nlab] = x;
+			if (y < ymin[nlab]) ymin[nlab] = y;
+			if (y > ymax[nlab]) ymax[nlab] = y;
+			sx  += x;
+			sy  += y;
+			sxx += double(x) * x;
+			syy += double(y) * y;
+			sxy += double(x) * y;
+			cnt += 1.0;
+			for (yy = std::max(0, y - 1); yy <= std::min(hBin_ - 1, y + 1); ++yy) {
+				for (xx = std::max(0, x - 1); xx <= std::min(wBin_ - 1, x + 1); ++xx) {
+					j = yy * wBin_ + xx;
+					if (mask_[j] && label_[j] < 0) {
+						label_[j] = nlab;
+						stack.push_back(j);
+					}
+				}
+			}
+		}
+		/*
+		 * 保留的连通域:
+		 * - 长度不短于最短拖线
+		 * - 或者长度不少于3个降采样像素, 且长短轴之比不小于2. 恒星及噪声近似圆形
+		 */
+		int ext = std::max(xmax[nlab] - xmin[nlab], ymax[nlab] - ymin[nlab]) + 1;
+		bool elong(false);
+		if (ext >= 3) {
+			mxx = sxx / cnt - (sx / cnt) * (sx / cnt);
+			myy = syy / cnt - (sy / cnt) * (sy / cnt);
+			mxy = sxy / cnt - (sx / cnt) * (sy / cnt);
+			tr  = mxx + myy;
+			det = sqrt(std::max(0.0, 0.25 * (mxx - myy) * (mxx - myy) + mxy * mxy));
+			l1  = 0.5 * tr + det;
+			l2  = 0.5 * tr - det;
+			elong = l2 * 4.0 <= l1;
+		}
+		keep.push_back(ext >= extMin || elong);
+		++nlab;
+	}
+
+	px_.clear();
+	py_.clear();
+	for (i = 0; i < n; ++i) {
+		if ((k = label_[i]) < 0 || !keep[k]) continue;
+		px_.push_back(float(i % wBin_ + 0.5));
+		py_.push_back(float(i / wBin_ + 0.5));
+	}
+}
+
+void AStreakDetect::vote(const vector<int>& ids, int vote, int t0, int t1) {
+	int n(int(ids.size())), t, i, r;
+	double c, s;
+
+	for (t = t0; t < t1; ++t) {
+		uint16_t* row = acc_.data() + size_t(t) * nRho_;
+		c = cosT_[t];
+		s = sinT_[t];
+		for (i = 0; i < n; ++i) {
+			r = int(lround(px_[ids[i]] * c + py_[ids[i]] * s)) + rhoOff_;
+			row[r] = uint16_t(row[r] + vote);
+		}
+	}
+}
+
+void AStreakDetect::row_peak(int t0, int t1) {
+	int t, r, v, best, arg;
+
+	for (t = t0; t < t1; ++t) {
+		const uint16_t* row = acc_.data() + size_t(t) * nRho_;
+		for (r = 0, best = 0, arg = 0; r < nRho_; ++r) {
+			if ((v = row[r]) > best) {
+				best = v;
+				arg  = r;
+			}
+		}
+		rowMax_[t] = best;
+		rowArg_[t] = arg;
+	}
+}
+
+int AStreakDetect::segment(int t, int r, vector<double>& segs) {
+	double c(cosT_[t]), s(sinT_[t]), rho(r - rhoOff_), d;
+	double bin(param_->binning), lenMin(param_->lenMin / bin), gapMax(std::max(1.5, param_->gapMax / bin));
+	vector<std::pair<double, int> > pts;
+	vector<int> ids;
+	int i, j, k, n, nseg(0);
+
+	// 直线附近的像素, 按沿直线坐标排序
+	for (i = 0; i < nPoint_; ++i) {
+		if (used_[i]) continue;
+		d = px_[i] * c + py_[i] * s - rho;
+		if (fabs(d) <= 1.5) pts.push_back(std::make_pair(-px_[i] * s + py_[i] * c, i));
+	}
+	std::sort(pts.begin(), pts.end());
+
+	segs.clear();
+	n = int(pts.size());
+	for (i = 0; i < n; i = j) {
+		for (j = i + 1; j < n && pts[j].first - pts[j - 1].first <= gapMax; ++j);
+		double u0(pts[i].first), u1(pts[j - 1].first);
+		// 连续段: 长度不短于阈值, 且平均每个降采样像素长度内至少0.3个像素
+		if (u1 - u0 < lenMin || (j - i) < 0.3 * (u1 - u0)) continue;
+		for (k = i; k < j; ++k) {
+			used_[pts[k].second] = 1;
+			ids.push_back(pts[k].second);
+		}
+		segs.push_back(rho * c - u0 * s);
+		segs.push_back(rho * s + u0 * c);
+		segs.push_back(rho * c - u1 * s);
+		segs.push_back(rho * s + u1 * c);
+		++nseg;
+	}
+	if (nseg) parallel(nTheta_, boost::bind(&AStreakDetect::vote, this, boost::cref(ids), -1, _1, _2));
+	return nseg;
+}
+
+void AStreakDetect::merge(vector<double>& lines) {
+	double gap = std::max(param_->lenMin, param_->gapMax * 4.0) / param_->binning;
+	double cosMax = cos(2.0 * D2R);
+	int n(int(lines.size()) / 4), i, j, k;
+	bool merged(true);
+
+	while (merged) {
+		merged = false;
+		for (i = 0; i < n && !merged; ++i) {
+			double* a = &lines[i * 4];
+			double dxa(a[2] - a[0]), dya(a[3] - a[1]), la = sqrt(dxa * dxa + dya * dya);
+			dxa /= la;
+			dya /= la;
+			for (j = i + 1; j < n && !merged; ++j) {
+				double* b = &lines[j * 4];
+				double dxb(b[2] - b[0]), dyb(b[3] - b[1]), lb = sqrt(dxb * dxb + dyb * dyb);
+				if (fabs(dxa * dxb + dya * dyb) / lb < cosMax) continue;
+				// b的端点到a所在直线的距离, 及沿a方向的间隔
+				double d1 = fabs((b[0] - a[0]) * dya - (b[1] - a[1]) * dxa);
+				double d2 = fabs((b[2] - a[0]) * dya - (b[3] - a[1]) * dxa);
+				if (d1 > 2.0 || d2 > 2.0) continue;
+				double u[4] = { 0.0, la, (b[0] - a[0]) * dxa + (b[1] - a[1]) * dya, (b[2] - a[0]) * dxa + (b[3] - a[1]) * dya };
+				double ub0(std::min(u[2], u[3])), ub1(std::max(u[2], u[3]));
+				// 暗弱拖线断续: 间隔上限随两段长度之和放宽
+				double gapMax = std::max(gap, la + lb);
+				if (ub0 > la + gapMax || ub1 < -gapMax) continue;
+				double u0(std::min(0.0, ub0)), u1(std::max(la, ub1));
+				double x0(a[0]), y0(a[1]);
+				a[0] = x0 + u0 * dxa;
+				a[1] = y0 + u0 * dya;
+				a[2] = x0 + u1 * dxa;
+				a[3] = y0 + u1 * dya;
+				for (k = j * 4; k < int(lines.size()) - 4; ++k) lines[k] = lines[k + 4];
+				lines.resize(lines.size() - 4);
+				--n;
+				merged = true;
+			}
+		}
+	}
+}
+
+void AStreakDetect::measure(float* data, int w, int h, double back, double sig, const double* seg,
+		StreakSegment& streak, char* mask) {
+	double bin(param_->binning);
+	// 降采样坐标转换为像素坐标: 像素中心位于整数
+	double x1(seg[0] * bin - 0.5), y1(seg[1] * bin - 0.5), x2(seg[2] * bin - 0.5), y2(seg[3] * bin - 0.5);
+	double len = sqrt((x2 - x1) * (x2 - x1) + (y2 - y1) * (y2 - y1));
+	StreakBand band;
+
+	// 拟合横向偏移 d = a + b * u: 分段统计横向轮廓, 以各段峰值质心做加权线性拟合.
+	// 先以降采样精度的宽带定位, 再以窄带精化
+	int nchunk = std::min(32, std::max(2, int(len / 64.0)));
+	for (int pass = 0; pass < 2; ++pass) {
+		band.x0 = x1;
+		band.y0 = y1;
+		band.nx = (y2 - y1) / len;
+		band.ny = -(x2 - x1) / len;
+		band.u0 = 0.0;
+		band.u1 = len;
+		band.hw = pass ? bin + 2.0 : 2.0 * bin;
+
+		int nbin = int(band.hw * 4.0) + 1, k, j;
+		vector<double> prof(size_t(nchunk) * nbin, 0.0), cnt(size_t(nchunk) * nbin, 0.0);
+		for_band(band, w, h, [&](int pos, double d, double u) {
+			int c = std::min(nchunk - 1, std::max(0, int(u * nchunk / len)));
+			int k = std::min(nbin - 1, std::max(0, int((d + band.hw) * 2.0)));
+			prof[size_t(c) * nbin + k] += data[pos] - back;
+			cnt[size_t(c) * nbin + k]  += 1.0;
+		});
+
+		vector<double> cu, cd;
+		for (k = 0; k < nchunk; ++k) {
+			double* pf = prof.data() + size_t(k) * nbin;
+			double* pc = cnt.data() + size_t(k) * nbin;
+			int jpk(0), n(0);
+			for (j = 0; j < nbin; ++j) {
+				if (pc[j] > 0.0) {
+					pf[j] /= pc[j];
+					n += int(pc[j]);
+				}
+				if (pf[j] > pf[jpk]) jpk = j;
+			}
+			// 峰值附近的质心. 平均每个轮廓点的信噪比不足时跳过该段
+			if (!n || pf[jpk] / sig * sqrt(n / double(nbin)) < 3.0) continue;
+			double vw(0.0), vd(0.0), v;
+			for (j = std::max(0, jpk - 2); j <= std::min(nbin - 1, jpk + 2); ++j) {
+				if ((v = pf[j]) <= 0.0) continue;
+				vw += v;
+				vd += v * ((j + 0.5) * 0.5 - band.hw);
+			}
+			cu.push_back((k + 0.5) * len / nchunk);
+			cd.push_back(vd / vw);
+		}
+		// 恒星使部分段的质心偏离拖线: 以残差的中值绝对偏差剔除离群段后重新拟合
+		int nc(int(cu.size())), iter;
+		vector<uint8_t> good(nc, 1);
+		double a(0.0), b(0.0), sw, su, sd, suu, sud, det(0.0);
+		for (iter = 0; iter < 3; ++iter) {
+			sw = su = sd = suu = sud = 0.0;
+			for (k = 0; k < nc; ++k) {
+				if (!good[k]) continue;
+				sw  += 1.0;
+				su  += cu[k];
+				sd  += cd[k];
+				suu += cu[k] * cu[k];
+				sud += cu[k] * cd[k];
+			}
+			if (sw < 2.0 || (det = sw * suu - su * su) <= 1E-6 * sw * suu) break;
+			b = (sw * sud - su * sd) / det;
+			a = (sd - b * su) / sw;
+			vector<double> res(nc);
+			for (k = 0; k < nc; ++k) res[k] = fabs(cd[k] - a - b * cu[k]);
+			vector<double> tmp(res);
+			std::nth_element(tmp.begin(), tmp.begin() + nc / 2, tmp.end());
+			double clip = std::max(1.0, 4.0 * tmp[nc / 2]);
+			for (k = 0; k < nc; ++k) good[k] = res[k] <= clip;
+		}
+		if (iter) {
+			double xs = x1 + a * band.nx, ys = y1 + a * band.ny;
+			double xe = x2 + (a + b * len) * band.nx, ye = y2 + (a + b * len) * band.ny;
+			x1 = xs;
+			y1 = ys;
+			x2 = xe;
+			y2 = ye;
+			len = sqrt((x2 - x1) * (x2 - x1) + (y2 - y1) * (y2 - y1));
+		}
+	}
+
+	// 宽度: 横向轮廓的半高全宽. 轮廓间隔0.5像素, 取各段轮廓的中值以抑制恒星
+	band.x0 = x1;
+	band.y0 = y1;
+	band.nx = (y2 - y1) / len;
+	band.ny = -(x2 - x1) / len;
+	band.u1 = len;
+	int nprof = int(band.hw * 4.0) + 1, i, k, ipk(0);
+	vector<double> cprof(size_t(nchunk) * nprof, 0.0), ccnt(size_t(nchunk) * nprof, 0.0);
+	vector<double> prof(nprof), col(nchunk);
+	for_band(band, w, h, [&](int pos, double d, double u) {
+		int c = std::min(nchunk - 1, std::max(0, int(u * nchunk / len)));
+		int k = std::min(nprof - 1, std::max(0, int((d + band.hw) * 2.0)));
+		cprof[size_t(c) * nprof + k] += data[pos] - back;
+		ccnt[size_t(c) * nprof + k]  += 1.0;
+	});
+	for (i = 0; i < nprof; ++i) {
+		for (k = 0; k < nchunk; ++k) {
+			size_t j = size_t(k) * nprof + i;
+			col[k] = ccnt[j] > 0.0 ? cprof[j] / ccnt[j] : 0.0;
+		}
+		std::nth_element(col.begin(), col.begin() + nchunk / 2, col.end());
+		prof[i] = col[nchunk / 2];
+		if (prof[i] > prof[ipk]) ipk = i;
+	}
+	double half = prof[ipk] * 0.5, xl(0.0), xr(nprof - 1.0);
+	for (i = ipk; i > 0; --i) {
+		if (prof[i - 1] <= half) {
+			xl = i - (half - prof[i - 1]) / (prof[i] - prof[i - 1]);
+			break;
+		}
+	}
+	for (i = ipk; i < nprof - 1; ++i) {
+		if (prof[i + 1] <= half) {
+			xr = i + (prof[i] - half) / (prof[i] - prof[i + 1]);
+			break;
+		}
+	}
+	streak.width = std::max(1.0, (xr - xl) * 0.5);
+
+	streak.pt1.x  = x1;
+	streak.pt1.y  = y1;
+	streak.pt2.x  = x2;
+	streak.pt2.y  = y2;
+	streak.length = len;
+	streak.tilt   = atan2(y2 - y1, x2 - x1) * R2D;
+	if (streak.tilt < 0.0)    streak.tilt += 180.0;
+	if (streak.tilt >= 180.0) streak.tilt -= 180.0;
+
+	// 测光: 半宽为1.2倍半高全宽的矩形
+	band.x0 = x1;
+	band.y0 = y1;
+	band.nx = (y2 - y1) / len;
+	band.ny = -(x2 - x1) / len;
+	band.hw = std::max(2.0, 1.2 * streak.width);
+	band.u0 = -band.hw;
+	band.u1 = len + band.hw;
+	double flux(0.0);
+	int npix(0);
+	for_band(band, w, h, [&](int pos, double, double) {
+		flux += data[pos] - back;
+		++npix;
+	});
+	streak.flux = flux;
+	streak.npix = npix;
+	streak.snr  = npix ? flux / (sig * sqrt(double(npix))) : 0.0;
+
+	// 屏蔽
+	float fill = float(back);
+	band.hw += param_->maskWidth;
+	band.u0 -= param_->maskWidth;
+	band.u1 += param_->maskWidth;
+	for_band(band, w, h, [&](int pos, double, double) {
+		data[pos] = fill;
+		if (mask) mask[pos] |= MASK_STREAK;
+	});
+}
+
+/*!
+ * @brief 求解 lo <= a * x + b <= hi 的区间
+ * @return
+ * 区间是否非空
+ */
+static bool solve_range(double a, double b, double lo, double hi, double& xl, double& xh) {
+	if (fabs(a) < 1E-12) {
+		xl = -1E30;
+		xh = 1E30;
+		return b >= lo && b <= hi;
+	}
+	xl = (lo - b) / a;
+	xh = (hi - b) / a;
+	if (xl > xh) std::swap(xl, xh);
+	return true;
+}
+
+void AStreakDetect::for_band(const StreakBand& band, int w, int h,
+		const boost::function<void (int, double, double)>& func) {
+	double dx(-band.ny), dy(band.nx);	// 沿拖线方向
+	double ymin(1E30), ymax(-1E30), yc, xl1, xh1, xl2, xh2, d, u;
+	int i, x, y, xs, xe;
+
+	for (i = 0; i < 4; ++i) {
+		yc = band.y0 + ((i & 1) ? band.u1 : band.u0) * dy + ((i & 2) ? band.hw : -band.hw) * band.ny;
+		if (yc < ymin) ymin = yc;
+		if (yc > ymax) ymax = yc;
+	}
+	int y0 = std::max(0, int(ceil(ymin))), y1 = std::min(h - 1, int(floor(ymax)));
+	for (y = y0; y <= y1; ++y) {
+		double ry = y - band.y0;
+		// 横向距离 d = (x - x0) * nx + ry * ny; 沿拖线坐标 u = (x - x0) * dx + ry * dy
+		if (!solve_range(band.nx, -band.x0 * band.nx + ry * band.ny, -band.hw, band.hw, xl1, xh1)) continue;
+		if (!solve_range(dx, -band.x0 * dx + ry * dy, band.u0, band.u1, xl2, xh2)) continue;
+		xs = std::max(0, int(ceil(std::max(xl1, xl2))));
+		xe = std::min(w - 1, int(floor(std::min(xh1, xh2))));
+		for (x = xs; x <= xe; ++x) {
+			d = (x - band.x0) * band.nx + ry * band.ny;
+			u = (x - band.x0) * dx + ry * dy;
+			func(y * w + x, d, u);
+		}
+	}
+}
@@ -0,0 +1,130 @@
+/*!
+ * @class AStreakDetect 检测并屏蔽卫星/快速运动目标拖线
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * 在扣除背景后、提取信号前执行:
+ * - 按binning*binning降采样, 均值超过阈值的降采样像素构成掩模
+ * - 剔除近似圆形或不足3个降采样像素的连通域(恒星、噪声)
+ * - 对剩余像素做Hough变换. 累加器按倾角分段, 由多线程并行投票和统计各倾角的峰值
+ * - 依次取累加器峰值, 沿直线切分连续段. 满足最短长度的段确认为拖线, 其像素退出投票.
+ *   共线且间隔较近的段合并为一条拖线
+ * - 以全分辨率像素拟合拖线位置和倾角, 测量宽度和流量, 并以背景值屏蔽拖线像素
+ */
+
+#ifndef ASTREAKDETECT_H_
+#define ASTREAKDETECT_H_
+
+#include <stdint.h>
+#include <vector>
+#include <boost/function.hpp>
+#include "ImageFrame.hpp"
+#include "Parameter.hpp"
+
+class AStreakDetect {
+public:
+	AStreakDetect(const ParamStreak* param);
+	virtual ~AStreakDetect();
+
+protected:
+	/*!
+	 * @struct StreakBand 全分辨率图像上沿拖线的矩形区域
+	 */
+	struct StreakBand {
+		double x0, y0;	/// 起点
+		double nx, ny;	/// 法向. 沿拖线方向为(-ny, nx)
+		double u0, u1;	/// 沿拖线方向的范围
+		double hw;		/// 半宽
+	};
+
+protected:
+	const ParamStreak* param_;	/// 配置参数
+	unsigned nthread_;	/// 线程数
+	/* 降采样掩模 */
+	int wBin_, hBin_;	/// 降采样图像尺寸
+	std::vector<uint8_t> mask_;	/// 掩模
+	std::vector<int> label_;	/// 连通域标记
+	std::vector<float> px_, py_;	/// 参与投票的像素, 降采样坐标
+	std::vector<uint8_t> used_;	/// 已归入拖线的像素
+	/* Hough累加器 */
+	int nTheta_, nRho_;	/// 倾角和距离的分段数
+	int rhoOff_;		/// 距离零点的索引
+	std::vector<double> cosT_, sinT_;	/// 各倾角的三角函数
+	std::vector<uint16_t> acc_;	/// 累加器, 按倾角逐行存储
+	std::vector<int> rowMax_;	/// 各倾角的最大票数
+	std::vector<int> rowArg_;	/// 各倾角最大票数的距离索引
+	/* 统计 */
+	int nPoint_;		/// 参与投票的像素数
+	double msElapse_;	/// 最近一帧的检测耗时, 量纲: 毫秒
+
+public:
+	/*!
+	 * @brief 检测拖线并在图像中屏蔽
+	 * @param data     图像数据. 拖线像素被替换为背景
+	 * @param w        图像宽度
+	 * @param h        图像高度
+	 * @param back     背景
+	 * @param sig      背景噪声
+	 * @param streaks  拖线
+	 * @param mask     像素掩模. 非空时屏蔽的像素标记MASK_STREAK
+	 * @return
+	 * 拖线数量
+	 */
+	int Detect(float* data, int w, int h, double back, double sig, StreakVec& streaks, char* mask = NULL);
+	/*!
+	 * @brief 查看最近一帧的统计量
+	 * @param npoint  参与投票的降采样像素数
+	 * @return
+	 * 耗时, 量纲: 毫秒
+	 */
+	double LastStat(int& npoint) const;
+
+protected:
+	/*!
+	 * @brief 将[0, n)分段后以多线程执行
+	 */
+	void parallel(int n, const boost::function<void (int, int)>& func);
+	/*!
+	 * @brief 生成降采样掩模, 处理降采样行[row0, row1)
+	 */
+	void bin_mask(const float* data, int w, double thresh, int row0, int row1);
+	/*!
+	 * @brief 剔除紧凑的连通域, 生成投票像素
+	 */
+	void filter_compact();
+	/*!
+	 * @brief 投票, 处理倾角[t0, t1). vote = 1: 加票; -1: 撤票
+	 */
+	void vote(const std::vector<int>& ids, int vote, int t0, int t1);
+	/*!
+	 * @brief 更新倾角[t0, t1)的最大票数
+	 */
+	void row_peak(int t0, int t1);
+	/*!
+	 * @brief 沿直线切分连续段并确认拖线
+	 * @param t     倾角索引
+	 * @param r     距离索引
+	 * @param segs  拖线端点, 降采样坐标. 每4个数构成一条
+	 * @return
+	 * 拖线数量
+	 */
+	int segment(int t, int r, std::vector<double>& segs);
+	/*!
+	 * @brief 合并共线且间隔较近的段
+	 * @param lines  拖线端点, 降采样坐标. 每4个数构成一条
+	 */
+	void merge(std::vector<double>& lines);
+	/*!
+	 * @brief 全分辨率测量并屏蔽拖线
+	 */
+	void measure(float* data, int w, int h, double back, double sig, const double* seg, StreakSegment& streak,
+			char* mask);
+	/*!
+	 * @brief 遍历矩形区域内的像素
+	 * @param func  回调函数, 参数: 像素索引, 横向距离, 沿拖线坐标
+	 */
+	static void for_band(const StreakBand& band, int w, int h,
+			const boost::function<void (int, double, double)>& func);
+};
+
+#endif /* ASTREAKDETECT_H_ */
@@ -0,0 +1,179 @@
+/*!
+ * @class ATrace 处理流程性能跟踪: 记录各环节及子步骤的耗时, 导出指标和事件
+ * @version 0.1
+ * @date 2021-05
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <algorithm>
+#include "ATrace.h"
+
+#define TRACE_MAX_EVENTS	(1 << 20)	/// 事件记录上限. 超出后仅更新统计
+#define TRACE_MAX_SAMPLES	(1 << 16)	/// 每个区间保留的样本上限. 超出后以蓄水池抽样替换
+#define TRACE_EXPORT_SEC	10			/// 指标文件刷新周期, 量纲: 秒
+
+/* 直方图边界, 量纲: 秒 */
+static const double bucket_bounds[] = {
+	0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0
+};
+static const int bucket_count = int(sizeof(bucket_bounds) / sizeof(double));
+
+std::atomic<bool> ATrace::enabled_(false);
+
+ATrace::ATrace() {
+	nextTid_ = 1;
+	seed_    = 1;
+	tmOrigin_ = tmExport_ = std::chrono::steady_clock::now();
+}
+
+ATrace::~ATrace() {
+}
+
+ATrace& ATrace::Instance() {
+	static ATrace* trace = new ATrace;
+	return *trace;
+}
+
+void ATrace::Start(const std::string& pathMetrics, const std::string& pathEvents) {
+	mutex_lock lck(mtx_);
+	pathMetrics_ = pathMetrics;
+	pathEvents_  = pathEvents;
+	events_.clear();
+	metrics_.clear();
+	tmOrigin_ = tmExport_ = std::chrono::steady_clock::now();
+	enabled_.store(true);
+}
+
+void ATrace::Stop() {
+	if (!enabled_.exchange(false)) return;
+	mutex_lock lck(mtx_);
+	if (!pathMetrics_.empty()) export_metrics();
+	if (!pathEvents_.empty())  export_events();
+}
+
+void ATrace::Record(const char* name, const std::string& frame, const time_point& t0, const time_point& t1, int64_t cpu) {
+	if (!Enabled()) return;
+	int tid = ThreadID();
+	mutex_lock lck(mtx_);
+	int64_t ts  = std::chrono::duration_cast<std::chrono::microseconds>(t0 - tmOrigin_).count();
+	int64_t dur = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+	if (events_.size() < TRACE_MAX_EVENTS) {
+		TraceEvent evt;
+		evt.name  = name;
+		evt.frame = frame;
+		evt.tid   = tid;
+		evt.ts    = ts;
+		evt.dur   = dur;
+		evt.cpu   = cpu;
+		events_.push_back(evt);
+	}
+
+	TraceMetric& metric = metrics_[name];
+	double sec = dur * 1E-6;
+	if (metric.buckets.empty()) metric.buckets.resize(bucket_count + 1, 0);
+	++metric.buckets[std::lower_bound(bucket_bounds, bucket_bounds + bucket_count, sec) - bucket_bounds];
+	++metric.count;
+	metric.sum += sec;
+	if (cpu >= 0) metric.cpu += cpu * 1E-6;
+	if (metric.samples.size() < TRACE_MAX_SAMPLES) metric.samples.push_back(float(sec));
+	else {// 蓄水池抽样
+		seed_ = seed_ * 6364136223846793005ULL + 1442695040888963407ULL;
+		uint64_t k = (seed_ >> 11) % metric.count;
+		if (k < TRACE_MAX_SAMPLES) metric.samples[k] = float(sec);
+	}
+}
+
+void ATrace::Tick() {
+	if (!Enabled()) return;
+	mutex_lock lck(mtx_);
+	time_point now = std::chrono::steady_clock::now();
+	if (pathMetrics_.empty() || now - tmExport_ < std::chrono::seconds(TRACE_EXPORT_SEC)) return;
+	tmExport_ = now;
+	export_metrics();
+}
+
+int64_t ATrace::ThreadCPU() {
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return int64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+int ATrace::ThreadID() {
+	static thread_local int tid = 0;
+	if (!tid) tid = nextTid_++;
+	return tid;
+}
+
+bool ATrace::export_metrics() {
+	std::string tmppath = pathMetrics_ + ".tmp";
+	FILE* fp = fopen(tmppath.c_str(), "w");
+	if (!fp) return false;
+
+	MetricMap::iterator it;
+	fprintf(fp, "# HELP adips_stage_seconds Wall time of pipeline stages, sub-steps and queue waits\n");
+	fprintf(fp, "# TYPE adips_stage_seconds histogram\n");
+	for (it = metrics_.begin(); it != metrics_.end(); ++it) {
+		const char* name = it->first.c_str();
+		const TraceMetric& metric = it->second;
+		uint64_t cum(0);
+		for (int i = 0; i < bucket_count; ++i) {
+			cum += metric.buckets[i];
+			fprintf(fp, "adips_stage_seconds_bucket{stage=\"%s\",le=\"%g\"} %llu\n", name, bucket_bounds[i],
+					(unsigned long long) cum);
+		}
+		fprintf(fp, "adips_stage_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n", name, (unsigned long long) metric.count);
+		fprintf(fp, "adips_stage_seconds_sum{stage=\"%s\"} %.6f\n", name, metric.sum);
+		fprintf(fp, "adips_stage_seconds_count{stage=\"%s\"} %llu\n", name, (unsigned long long) metric.count);
+	}
+
+	static const double quantiles[] = { 0.5, 0.9, 0.99 };
+	fprintf(fp, "# HELP adips_stage_quantile_seconds Wall time percentiles of pipeline stages\n");
+	fprintf(fp, "# TYPE adips_stage_quantile_seconds summary\n");
+	for (it = metrics_.begin(); it != metrics_.end(); ++it) {
+		std::vector<float> samples(it->second.samples);
+		int n = int(samples.size());
+		std::sort(samples.begin(), samples.end());
+		for (int i = 0; i < 3; ++i) {
+			fprintf(fp, "adips_stage_quantile_seconds{stage=\"%s\",quantile=\"%g\"} %.6f\n", it->first.c_str(),
+					quantiles[i], samples[std::min(n - 1, int(n * quantiles[i]))]);
+		}
+	}
+
+	fprintf(fp, "# HELP adips_stage_cpu_seconds_total Thread CPU time of pipeline stages and sub-steps\n");
+	fprintf(fp, "# TYPE adips_stage_cpu_seconds_total counter\n");
+	for (it = metrics_.begin(); it != metrics_.end(); ++it) {
+		fprintf(fp, "adips_stage_cpu_seconds_total{stage=\"%s\"} %.6f\n", it->first.c_str(), it->second.cpu);
+	}
+
+	bool rslt = !ferror(fp);
+	rslt = !fclose(fp) && rslt;
+	// 替换方式写入: 采集器不会读到不完整的文件
+	if (rslt) rslt = !rename(tmppath.c_str(), pathMetrics_.c_str());
+	if (!rslt) remove(tmppath.c_str());
+	return rslt;
+}
+
+bool ATrace::export_events() {
+	FILE* fp = fopen(pathEvents_.c_str(), "w");
+	if (!fp) return false;
+
+	fprintf(fp, "{\"traceEvents\":[\n");
+	for (EventVec::iterator it = events_.begin(); it != events_.end(); ++it) {
+		// 帧名称来自文件名, 转义JSON特殊字符
+		std::string frame;
+		for (std::string::iterator ch = it->frame.begin(); ch != it->frame.end(); ++ch) {
+			if (*ch == '"' || *ch == '\\') frame += '\\';
+			if (uint8_t(*ch) >= 0x20) frame += *ch;
+		}
+		fprintf(fp, "%s{\"name\":\"%s\",\"cat\":\"adips\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld,"
+				"\"args\":{\"frame\":\"%s\"", it == events_.begin() ? "" : ",\n", it->name, it->tid,
+				(long long) it->ts, (long long) it->dur, frame.c_str());
+		if (it->cpu >= 0) fprintf(fp, ",\"cpu_us\":%lld", (long long) it->cpu);
+		fprintf(fp, "}}");
+	}
+	fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	bool rslt = !ferror(fp);
+	return !fclose(fp) && rslt;
+}
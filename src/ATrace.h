@@ -0,0 +1,166 @@
+/*!
+ * @class ATrace 处理流程性能跟踪: 记录各环节及子步骤的耗时, 导出指标和事件
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * - 跟踪区间: 墙钟时间和线程CPU时间. 以ATraceScope在作用域内自动记录, 或以Record记录已知起止时刻的区间(如队列等待)
+ * - 导出:
+ *   指标文件: Prometheus文本格式. 各区间的直方图、分位数和CPU时间累计. 运行中定期刷新, 可由node_exporter文本采集器读取
+ *   事件文件: Chrome trace-event JSON, 可在chrome://tracing或Perfetto中查看各帧在各线程上的时间线
+ * - 未启用时ATraceScope仅检查一次标志, 不读取时钟
+ * - 进程内唯一实例, 线程安全
+ */
+
+#ifndef ATRACE_H_
+#define ATRACE_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <boost/thread/mutex.hpp>
+
+class ATrace {
+protected:
+	ATrace();
+	virtual ~ATrace();
+
+public:
+	typedef std::chrono::steady_clock::time_point time_point;
+
+protected:
+	typedef boost::unique_lock<boost::mutex> mutex_lock;
+
+	/*!
+	 * @struct TraceEvent 单个区间
+	 */
+	struct TraceEvent {
+		const char* name;	/// 区间名称. 静态字符串
+		std::string frame;	/// 图像帧名称
+		int tid;			/// 线程编号
+		int64_t ts;			/// 起始时刻, 相对跟踪起点, 量纲: 微秒
+		int64_t dur;		/// 墙钟时间, 量纲: 微秒
+		int64_t cpu;		/// 线程CPU时间, 量纲: 微秒. 负值: 未测量
+	};
+	typedef std::vector<TraceEvent> EventVec;
+
+	/*!
+	 * @struct TraceMetric 同名区间的统计
+	 */
+	struct TraceMetric {
+		std::vector<uint32_t> buckets;	/// 直方图计数, 与边界一一对应, 末项为+Inf
+		std::vector<float> samples;		/// 墙钟时间样本, 量纲: 秒. 用于计算分位数
+		double sum;		/// 墙钟时间累计, 量纲: 秒
+		double cpu;		/// CPU时间累计, 量纲: 秒
+		uint64_t count;	/// 区间数量
+
+	public:
+		TraceMetric() {
+			sum = cpu = 0.0;
+			count = 0;
+		}
+	};
+	typedef std::map<std::string, TraceMetric> MetricMap;
+
+protected:
+	static std::atomic<bool> enabled_;	/// 启用标志
+	boost::mutex mtx_;		/// 互斥锁
+	time_point tmOrigin_;	/// 跟踪起点
+	time_point tmExport_;	/// 最近一次导出指标的时刻
+	std::string pathMetrics_;	/// 指标文件路径. 空: 不导出
+	std::string pathEvents_;	/// 事件文件路径. 空: 不导出
+	EventVec events_;		/// 区间记录
+	MetricMap metrics_;		/// 区间统计
+	std::atomic<int> nextTid_;	/// 下一个线程编号
+	uint64_t seed_;			/// 蓄水池抽样的随机数状态
+
+public:
+	/*!
+	 * @brief 进程内唯一实例
+	 */
+	static ATrace& Instance();
+	/*!
+	 * @brief 检查是否已启用
+	 */
+	static bool Enabled() {
+		return enabled_.load(std::memory_order_relaxed);
+	}
+	/*!
+	 * @brief 清除已有记录并启用
+	 * @param pathMetrics  指标文件路径. 空: 不导出
+	 * @param pathEvents   事件文件路径. 空: 不导出
+	 */
+	void Start(const std::string& pathMetrics, const std::string& pathEvents);
+	/*!
+	 * @brief 停用并导出指标和事件
+	 */
+	void Stop();
+	/*!
+	 * @brief 记录区间
+	 * @param name   区间名称. 静态字符串
+	 * @param frame  图像帧名称
+	 * @param t0     起始时刻
+	 * @param t1     结束时刻
+	 * @param cpu    线程CPU时间, 量纲: 微秒. 负值: 未测量
+	 */
+	void Record(const char* name, const std::string& frame, const time_point& t0, const time_point& t1, int64_t cpu = -1);
+	/*!
+	 * @brief 距上次导出超过刷新周期时导出指标文件
+	 */
+	void Tick();
+	/*!
+	 * @brief 当前线程的CPU时间, 量纲: 微秒
+	 */
+	static int64_t ThreadCPU();
+	/*!
+	 * @brief 当前线程编号, 按首次记录顺序从1开始
+	 */
+	int ThreadID();
+
+protected:
+	/*!
+	 * @brief 导出Prometheus文本格式的指标文件
+	 */
+	bool export_metrics();
+	/*!
+	 * @brief 导出Chrome trace-event JSON格式的事件文件
+	 */
+	bool export_events();
+};
+
+/*!
+ * @class ATraceScope 在作用域内记录跟踪区间
+ */
+class ATraceScope {
+public:
+	/*!
+	 * @param name   区间名称. 静态字符串
+	 * @param frame  图像帧名称. 在作用域内须保持有效
+	 */
+	ATraceScope(const char* name, const std::string& frame)
+		: frame_(frame) {
+		if ((on_ = ATrace::Enabled())) {
+			name_ = name;
+			cpu0_ = ATrace::ThreadCPU();
+			t0_   = std::chrono::steady_clock::now();
+		}
+	}
+
+	virtual ~ATraceScope() {
+		if (on_) {
+			ATrace::time_point t1 = std::chrono::steady_clock::now();
+			ATrace::Instance().Record(name_, frame_, t0_, t1, ATrace::ThreadCPU() - cpu0_);
+		}
+	}
+
+protected:
+	bool on_;			/// 启用
+	const char* name_;	/// 区间名称
+	const std::string& frame_;	/// 图像帧名称
+	ATrace::time_point t0_;		/// 起始时刻
+	int64_t cpu0_;		/// 起始线程CPU时间
+};
+
+#endif /* ATRACE_H_ */
@@ -0,0 +1,234 @@
+/*!
+ * @class AWatchFolder 监视目录, 通知新写入完成的FITS文件
+ * @version 0.1
+ * @date 2021-05
+ */
+
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
+#include <boost/bind/bind.hpp>
+#include <boost/filesystem.hpp>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include "AWatchFolder.h"
+#include "GLog.h"
+
+using namespace boost::filesystem;
+
+AWatchFolder::AWatchFolder() {
+	recursive_ = true;
+	fd_        = -1;
+}
+
+AWatchFolder::~AWatchFolder() {
+	Stop();
+}
+
+void AWatchFolder::RegisterFile(const CBFileSlot& slot) {
+	if (!cbFile_.empty()) cbFile_.disconnect_all_slots();
+	cbFile_.connect(slot);
+}
+
+bool AWatchFolder::Start(const strvec& dirs, bool recursive) {
+	if (thrd_watch_.unique()) return true;
+	recursive_ = recursive;
+	int n(0);
+
+#ifdef __linux__
+	if ((fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+		_gLog.Write(LOG_FAULT, "failed to initialize inotify: %s", strerror(errno));
+		return false;
+	}
+	for (strvec::const_iterator it = dirs.begin(); it != dirs.end(); ++it) {
+		int nadd = add_watch(*it);
+		if (!nadd) continue;
+		n += nadd;
+		dirs_.push_back(*it);
+		poll_directory(*it, false);	// 登记已存在的文件, 重新扫描时不通知
+	}
+	if (!n) {
+		close(fd_);
+		fd_ = -1;
+		return false;
+	}
+	thrd_watch_.reset(new boost::thread(boost::bind(&AWatchFolder::thread_inotify, this)));
+#else
+	for (strvec::const_iterator it = dirs.begin(); it != dirs.end(); ++it) {
+		if (!is_directory(*it)) {
+			_gLog.Write(LOG_WARN, "[%s] is not a directory", it->c_str());
+			continue;
+		}
+		dirs_.push_back(*it);
+		poll_directory(*it, false);
+		++n;
+	}
+	if (!n) return false;
+	thrd_watch_.reset(new boost::thread(boost::bind(&AWatchFolder::thread_poll, this)));
+#endif
+	_gLog.Write("watching %d directories for new FITS files", n);
+	return true;
+}
+
+void AWatchFolder::Stop() {
+	if (thrd_watch_.unique()) {
+		thrd_watch_->interrupt();
+		thrd_watch_->join();
+		thrd_watch_.reset();
+	}
+	if (fd_ >= 0) {// 关闭描述符时自动移除全部监视
+		close(fd_);
+		fd_ = -1;
+	}
+	watches_.clear();
+	dirs_.clear();
+	polls_.clear();
+}
+
+bool AWatchFolder::is_fits(const std::string& filepath) {
+	return path(filepath).extension().string().rfind(".fit") != std::string::npos;
+}
+
+int AWatchFolder::add_watch(const std::string& dir) {
+	int n(0);
+#ifdef __linux__
+	uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE_SELF | IN_MOVE_SELF;
+	int wd = inotify_add_watch(fd_, dir.c_str(), mask | IN_ONLYDIR);
+	if (wd < 0) {
+		_gLog.Write(LOG_WARN, "failed to watch [%s]: %s", dir.c_str(), strerror(errno));
+		return 0;
+	}
+	watches_[wd] = dir;
+	n = 1;
+	if (recursive_) {
+		boost::system::error_code ec;
+		for (directory_iterator x = directory_iterator(dir, ec); !ec && x != directory_iterator(); ++x) {
+			if (is_directory(x->path())) n += add_watch(x->path().string());
+		}
+	}
+#endif
+	return n;
+}
+
+void AWatchFolder::thread_inotify() {
+#ifdef __linux__
+	// inotify_event按int对齐
+	alignas(struct inotify_event) char buff[64 * 1024];
+	struct pollfd pfd;
+	ssize_t len;
+	boost::chrono::seconds period(1);
+	boost::chrono::steady_clock::time_point tcheck = boost::chrono::steady_clock::now();
+
+	pfd.fd     = fd_;
+	pfd.events = POLLIN;
+	while (true) {
+		boost::this_thread::interruption_point();
+		if (boost::chrono::steady_clock::now() - tcheck >= period) {
+			check_pending();
+			tcheck = boost::chrono::steady_clock::now();
+		}
+		// 以有限超时等待事件, 以便响应线程中断. 事件到达时立即返回
+		if (poll(&pfd, 1, 200) <= 0) continue;
+		if ((len = read(fd_, buff, sizeof(buff))) <= 0) continue;
+
+		for (char* ptr = buff; ptr < buff + len; ) {
+			const struct inotify_event* ev = (const struct inotify_event*) ptr;
+			ptr += sizeof(struct inotify_event) + ev->len;
+
+			if (ev->mask & IN_Q_OVERFLOW) {// 事件已丢失: 重新扫描, 已登记的文件不再通知
+				_gLog.Write(LOG_WARN, "inotify queue overflowed, rescan watched directories");
+				for (strvec::iterator x = dirs_.begin(); x != dirs_.end(); ++x) poll_directory(*x, true);
+				continue;
+			}
+			WatchMap::iterator it = watches_.find(ev->wd);
+			if (it == watches_.end()) continue;
+			if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+				if (ev->mask & IN_IGNORED) watches_.erase(it);
+				else _gLog.Write(LOG_WARN, "watched directory [%s] removed", it->second.c_str());
+				continue;
+			}
+			if (!ev->len) continue;
+
+			std::string filepath = (path(it->second) / ev->name).string();
+			if (ev->mask & IN_ISDIR) {// 新建或移入的子目录: 加入监视前写入的文件没有事件, 扫描一次
+				if (recursive_ && (ev->mask & (IN_CREATE | IN_MOVED_TO)) && add_watch(filepath)) {
+					poll_directory(filepath, true);
+				}
+			}
+			else if ((ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) && is_fits(filepath)) {
+				PollFile& pf = polls_[filepath];	// 登记, 扫描时不再通知
+				pf.size = 0;
+				pf.done = true;
+				cbFile_(filepath);
+			}
+		}
+	}
+#endif
+}
+
+void AWatchFolder::check_pending() {
+	boost::system::error_code ec;
+
+	for (PollMap::iterator it = polls_.begin(); it != polls_.end(); ) {
+		if (it->second.done) {
+			++it;
+			continue;
+		}
+		uintmax_t size = file_size(it->first, ec);
+		if (ec) {// 已删除或改名
+			ec.clear();
+			polls_.erase(it++);
+			continue;
+		}
+		if (it->second.size == size && size) {
+			it->second.done = true;
+			cbFile_(it->first);
+		}
+		else it->second.size = size;
+		++it;
+	}
+}
+
+void AWatchFolder::thread_poll() {
+	boost::chrono::seconds period(1);
+
+	while (true) {
+		boost::this_thread::sleep_for(period);
+		for (strvec::iterator it = dirs_.begin(); it != dirs_.end(); ++it) poll_directory(*it, true);
+	}
+}
+
+void AWatchFolder::poll_directory(const std::string& dir, bool notify) {
+	boost::system::error_code ec;
+
+	for (directory_iterator x = directory_iterator(dir, ec); !ec && x != directory_iterator(); ++x) {
+		std::string filepath = x->path().string();
+		if (is_directory(x->path())) {
+			if (recursive_) poll_directory(filepath, notify);
+			continue;
+		}
+		if (!is_fits(filepath)) continue;
+
+		uintmax_t size = file_size(x->path(), ec);
+		if (ec) {
+			ec.clear();
+			continue;
+		}
+		PollMap::iterator it = polls_.find(filepath);
+		if (it == polls_.end()) {// 新文件: 记录长度, 下次扫描时确认
+			PollFile pf;
+			pf.size = size;
+			pf.done = !notify;
+			polls_[filepath] = pf;
+		}
+		else if (!it->second.done) {
+			if (it->second.size == size && size) {
+				it->second.done = true;
+				cbFile_(filepath);
+			}
+			else it->second.size = size;
+		}
+	}
+}
@@ -0,0 +1,108 @@
+/*!
+ * @class AWatchFolder 监视目录, 通知新写入完成的FITS文件
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * - Linux下使用inotify: 文件关闭写(IN_CLOSE_WRITE)或移入目录(IN_MOVED_TO)时视为写入完成.
+ *   移入事件对应"先写临时文件再改名"的写入方式
+ * - 递归监视时, 新建的子目录自动加入监视并扫描一次, 通知加入监视前已写入的文件
+ * - 事件队列溢出时重新扫描全部目录. 扫描发现的新文件长度在两次检查之间不变时视为写入完成.
+ *   已通知或开始监视时已存在的文件不再通知
+ * - 其它平台以轮询方式替代: 文件长度在两次扫描之间不变时视为写入完成
+ */
+
+#ifndef AWATCHFOLDER_H_
+#define AWATCHFOLDER_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <boost/thread/thread.hpp>
+#include <boost/smart_ptr/shared_ptr.hpp>
+#include <boost/signals2.hpp>
+
+class AWatchFolder {
+public:
+	AWatchFolder();
+	virtual ~AWatchFolder();
+
+public:
+	typedef boost::signals2::signal<void (const std::string&)> CBFile;	///< 新文件回调函数
+	typedef CBFile::slot_type CBFileSlot;	///< 新文件回调函数插槽
+	typedef std::vector<std::string> strvec;
+
+protected:
+	typedef boost::shared_ptr<boost::thread> threadptr;
+	typedef std::map<int, std::string> WatchMap;	///< 监视描述符与目录的映射
+
+	/*!
+	 * @struct PollFile 已登记的文件状态
+	 */
+	struct PollFile {
+		uintmax_t size;	/// 文件长度
+		bool done;		/// 已通知
+	};
+	typedef std::map<std::string, PollFile> PollMap;
+
+protected:
+	bool recursive_;	/// 递归监视子目录
+	int fd_;			/// inotify描述符
+	WatchMap watches_;	/// 已监视目录
+	strvec dirs_;		/// 监视的目录
+	PollMap polls_;		/// 已登记的文件状态. inotify方式下用于重新扫描
+	threadptr thrd_watch_;	/// 监视线程
+	CBFile cbFile_;		/// 回调函数
+
+public:
+	/*!
+	 * @brief 注册新文件回调函数. 回调函数在监视线程中执行
+	 * @param slot 函数插槽
+	 */
+	void RegisterFile(const CBFileSlot& slot);
+	/*!
+	 * @brief 开始监视目录
+	 * @param dirs       目录列表
+	 * @param recursive  是否递归监视子目录
+	 * @return
+	 * 至少一个目录加入监视时返回true
+	 */
+	bool Start(const strvec& dirs, bool recursive = true);
+	/*!
+	 * @brief 停止监视
+	 */
+	void Stop();
+
+protected:
+	/*!
+	 * @brief 检查文件是否为FITS文件
+	 */
+	static bool is_fits(const std::string& filepath);
+	/*!
+	 * @brief 将目录加入监视
+	 * @param dir  目录
+	 * @return
+	 * 加入的目录数量, 包括递归加入的子目录
+	 */
+	int add_watch(const std::string& dir);
+	/*!
+	 * @brief 线程: 读取并处理inotify事件
+	 */
+	void thread_inotify();
+	/*!
+	 * @brief 检查扫描发现、尚未通知的文件, 通知长度已稳定的文件
+	 */
+	void check_pending();
+	/*!
+	 * @brief 线程: 轮询目录
+	 */
+	void thread_poll();
+	/*!
+	 * @brief 扫描一个目录, 通知长度已稳定的新文件
+	 * @param dir     目录
+	 * @param notify  是否通知. 开始监视时已存在的文件仅登记, 不通知
+	 */
+	void poll_directory(const std::string& dir, bool notify);
+};
+
+#endif /* AWATCHFOLDER_H_ */
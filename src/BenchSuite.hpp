@@ -0,0 +1,221 @@
+/*!
+ * @file BenchSuite.hpp 性能评估工具的公共部分: 命令行选项、计时和结果输出
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * - 选项表同时生成getopt_long参数和使用说明. -h/--help和-o/--output为各工具共有
+ * - 结果以JSON Lines格式输出, 每行一项评估. 指定-o时追加写入文件, 否则写入标准输出.
+ *   make bench汇总各工具的结果行, 便于比较不同版本
+ */
+
+#ifndef BENCHSUITE_HPP_
+#define BENCHSUITE_HPP_
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+typedef std::chrono::steady_clock steady_clock;
+
+/*!
+ * @brief 自t0起经过的时间, 量纲: 毫秒
+ */
+inline double elapsed_ms(const steady_clock::time_point& t0) {
+	return std::chrono::duration<double, std::milli>(steady_clock::now() - t0).count();
+}
+
+/*!
+ * @brief 重复执行并计时
+ * @return
+ * 单次平均耗时, 量纲: 毫秒
+ */
+template <class Func>
+double time_ms(Func func, int repeat) {
+	steady_clock::time_point t0 = steady_clock::now();
+	for (int i = 0; i < repeat; ++i) func();
+	return elapsed_ms(t0) / repeat;
+}
+
+/*!
+ * @brief 排序后取分位数. 空序列返回0
+ */
+inline double quantile(std::vector<double>& vals, double q) {
+	if (vals.empty()) return 0.0;
+	std::sort(vals.begin(), vals.end());
+	size_t i = size_t(q * vals.size());
+	return vals[std::min(i, vals.size() - 1)];
+}
+
+/*!
+ * @class BenchArgs 命令行选项
+ */
+class BenchArgs {
+protected:
+	struct OptionDef {
+		int ch;				/// 短选项
+		std::string name;	/// 长选项
+		bool hasArg;		/// 是否带参数
+		std::string help;	/// 说明
+	};
+
+protected:
+	std::string program_;	/// 程序名
+	std::string operand_;	/// 操作数说明
+	std::vector<OptionDef> opts_;
+
+public:
+	std::string pathOutput;	/// 结果输出文件
+
+public:
+	/*!
+	 * @param program  程序名
+	 * @param operand  选项之后的操作数说明, 如"<index file>"
+	 */
+	BenchArgs(const char* program, const char* operand = NULL)
+		: program_(program), operand_(operand ? operand : "") {
+		Flag('h', "help", "print this help message");
+		Option('o', "output", "append results to file as JSON lines, default: stdout");
+	}
+
+	/*!
+	 * @brief 添加带参数的选项
+	 */
+	void Option(int ch, const char* name, const char* help) {
+		opts_.push_back({ ch, name, true, help });
+	}
+
+	/*!
+	 * @brief 添加无参数的选项
+	 */
+	void Flag(int ch, const char* name, const char* help) {
+		opts_.push_back({ ch, name, false, help });
+	}
+
+	/*!
+	 * @brief 解析命令行
+	 * @param handler  选项处理函数. 参数: 短选项, 选项参数. 返回false表示参数无效
+	 * @return
+	 * 第一个操作数在argv中的位置. -1: -h或选项无效, 已显示使用说明
+	 */
+	int Parse(int argc, char** argv, const std::function<bool (int, const char*)>& handler) {
+		std::vector<struct option> longopts;
+		std::string optstr;
+		for (size_t i = 0; i < opts_.size(); ++i) {
+			struct option opt = { opts_[i].name.c_str(), opts_[i].hasArg ? required_argument : no_argument, NULL, opts_[i].ch };
+			longopts.push_back(opt);
+			optstr += char(opts_[i].ch);
+			if (opts_[i].hasArg) optstr += ':';
+		}
+		longopts.push_back({ NULL, 0, NULL, 0 });
+
+		int ch, optndx;
+		while ((ch = getopt_long(argc, argv, optstr.c_str(), longopts.data(), &optndx)) != -1) {
+			if (ch == 'o') pathOutput = optarg;
+			else if (ch == 'h' || ch == '?' || !handler(ch, optarg)) {
+				Usage();
+				return -1;
+			}
+		}
+		return optind;
+	}
+
+	/*!
+	 * @brief 显示使用说明
+	 */
+	void Usage() const {
+		size_t width(0), i;
+		for (i = 0; i < opts_.size(); ++i) width = std::max(width, opts_[i].name.size());
+		printf("Usage:\n");
+		printf(" %s [options]%s%s\n", program_.c_str(), operand_.empty() ? "" : " ", operand_.c_str());
+		printf("\nOptions\n");
+		for (i = 0; i < opts_.size(); ++i) {
+			printf(" -%c / --%-*s : %s\n", opts_[i].ch, int(width), opts_[i].name.c_str(), opts_[i].help.c_str());
+		}
+	}
+};
+
+/*!
+ * @class BenchJson JSON Lines结果输出
+ * @note
+ * 每行包含评估项目名称和UTC时间. 用法: Begin(...).Int(...).Num(...).End()
+ */
+class BenchJson {
+protected:
+	FILE* fp_;			/// 输出文件
+	std::string date_;	/// 启动时间
+	std::string line_;	/// 当前行
+
+public:
+	BenchJson() {
+		fp_ = stdout;
+		time_t now = time(NULL);
+		char buff[40];
+		strftime(buff, sizeof(buff), "%Y-%m-%dT%H:%M:%S", gmtime(&now));
+		date_ = buff;
+	}
+
+	virtual ~BenchJson() {
+		if (fp_ != stdout) fclose(fp_);
+	}
+
+	/*!
+	 * @brief 打开输出文件. 路径为空时使用标准输出
+	 */
+	bool Open(const std::string& filepath) {
+		if (filepath.empty()) return true;
+		if (!(fp_ = fopen(filepath.c_str(), "a"))) {
+			fp_ = stdout;
+			printf("failed to open output file [%s]\n", filepath.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	BenchJson& Begin(const char* bench) {
+		line_ = "{";
+		return Str("bench", bench).Str("date", date_.c_str());
+	}
+
+	BenchJson& Str(const char* key, const char* val) {
+		return append(key, std::string("\"") + val + "\"");
+	}
+
+	BenchJson& Int(const char* key, long val) {
+		char buff[32];
+		snprintf(buff, sizeof(buff), "%ld", val);
+		return append(key, buff);
+	}
+
+	/*!
+	 * @brief 浮点数
+	 * @param fmt  printf格式, 如"%.3f"或"%.3g"
+	 */
+	BenchJson& Num(const char* key, double val, const char* fmt = "%.3f") {
+		char buff[64];
+		snprintf(buff, sizeof(buff), fmt, val);
+		return append(key, buff);
+	}
+
+	void End() {
+		fprintf(fp_, "%s}\n", line_.c_str());
+		fflush(fp_);
+	}
+
+protected:
+	BenchJson& append(const char* key, const std::string& val) {
+		if (line_.size() > 1) line_ += ',';
+		line_ += '"';
+		line_ += key;
+		line_ += "\":";
+		line_ += val;
+		return *this;
+	}
+};
+
+#endif /* BENCHSUITE_HPP_ */
@@ -0,0 +1,137 @@
+/*!
+ * @file BoundedQueue.hpp 有上限的生产者/消费者队列
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * - 队列满时Push阻塞(背压), 限制缓存的内存. 统计阻塞的累计时间和队列最大深度
+ * - Stop后Push不再阻塞, 消费者取完剩余元素后返回false
+ * - 用于结果输出: 中间结果(AInterWriter)和星表(ACatalogWriter)
+ */
+
+#ifndef BOUNDEDQUEUE_HPP_
+#define BOUNDEDQUEUE_HPP_
+
+#include <deque>
+#include <chrono>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+template <class T>
+class BoundedQueue {
+public:
+	typedef std::deque<T> ItemDeque;
+
+protected:
+	typedef boost::unique_lock<boost::mutex> mutex_lock;
+
+protected:
+	boost::mutex mtx_;		/// 互斥锁
+	boost::condition_variable cv_push_;	/// 事件: 新的元素或停止
+	boost::condition_variable cv_pop_;	/// 事件: 队列空出位置
+	ItemDeque items_;		/// 队列
+	size_t depth_;			/// 队列上限
+	bool stop_;				/// 停止标志
+	/* 统计 */
+	int depthMax_;			/// 队列最大深度
+	double msStall_;		/// Push因队列满而阻塞的累计时间, 量纲: 毫秒
+
+public:
+	BoundedQueue() {
+		depth_ = 1;
+		stop_  = false;
+		depthMax_ = 0;
+		msStall_  = 0.0;
+	}
+
+public:
+	/*!
+	 * @brief 清除停止标志和统计
+	 * @param depth  队列上限. 0: 视为1
+	 */
+	void Reset(size_t depth) {
+		mutex_lock lck(mtx_);
+		depth_ = depth ? depth : 1;
+		stop_  = false;
+		depthMax_ = 0;
+		msStall_  = 0.0;
+	}
+
+	/*!
+	 * @brief 停止: 唤醒全部等待的生产者和消费者
+	 */
+	void Stop() {
+		{
+			mutex_lock lck(mtx_);
+			stop_ = true;
+		}
+		cv_push_.notify_all();
+		cv_pop_.notify_all();
+	}
+
+	/*!
+	 * @brief 加入队列. 队列满时阻塞, 直至消费者取走或停止
+	 */
+	void Push(const T& item) {
+		mutex_lock lck(mtx_);
+		if (items_.size() >= depth_) {// 背压: 等待消费者取走
+			std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+			while (items_.size() >= depth_ && !stop_) cv_pop_.wait(lck);
+			msStall_ += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+		}
+		items_.push_back(item);
+		if (int(items_.size()) > depthMax_) depthMax_ = int(items_.size());
+		cv_push_.notify_one();
+	}
+
+	/*!
+	 * @brief 取出队首元素. 队列空时等待
+	 * @return
+	 * false: 已停止且队列为空
+	 */
+	bool Pop(T& item) {
+		{
+			mutex_lock lck(mtx_);
+			while (!stop_ && items_.empty()) cv_push_.wait(lck);
+			if (items_.empty()) return false;
+			item = items_.front();
+			items_.pop_front();
+		}
+		cv_pop_.notify_one();
+		return true;
+	}
+
+	/*!
+	 * @brief 取出全部元素. 队列空时等待
+	 * @return
+	 * false: 已停止且队列为空
+	 */
+	bool PopAll(ItemDeque& items) {
+		{
+			mutex_lock lck(mtx_);
+			while (!stop_ && items_.empty()) cv_push_.wait(lck);
+			if (items_.empty()) return false;
+			items.clear();
+			items.swap(items_);
+		}
+		cv_pop_.notify_all();
+		return true;
+	}
+
+	/*!
+	 * @brief 队列最大深度
+	 */
+	int DepthMax() {
+		mutex_lock lck(mtx_);
+		return depthMax_;
+	}
+
+	/*!
+	 * @brief Push阻塞的累计时间, 量纲: 毫秒
+	 */
+	double StallMs() {
+		mutex_lock lck(mtx_);
+		return msStall_;
+	}
+};
+
+#endif /* BOUNDEDQUEUE_HPP_ */
@@ -7,7 +7,11 @@
  * - 读取关键头信息: 曝光时间, 曝光起始时间
  *   曝光时间特征字: EXPTIME/EXPOSURE//EXPDUR
  *   曝光起始时间特征字: DATE-OBS/TIME-OBS
+ *   可选特征字: XBINNING/YBINNING, INSTRUME
  * - 以float类型将数据读入内存
+ * - 或关联外部提供的数据存储区, 不复制数据. 外部存储区由调用者管理
+ * - 自有数据存储区从AFramePool租用, 尺寸变化或关联外部存储区时归还
+ * - 或保持文件打开, 按行读取: 用于超出内存的大幅面图像. 文件句柄在关闭或打开其它文件前持续有效
  */
 
 #ifndef FITSHANDLER_IMAGE_H_
@@ -16,6 +20,7 @@
 #include <longnam.h>
 #include <fitsio.h>
 #include <string>
+#include "AFramePool.h"
 
 struct FITSHandlerImage {
 public:
@@ -25,8 +30,16 @@ public:
 	unsigned xBin, yBin;		/// ROI区合并因子
 	std::string dateobs;		/// 曝光起始时间, 格式: CCYY-MM-DDThh:mm:ss<.sss<sss>>, UTC
 	float expdur;				/// 曝光时间, 量纲: 秒
+	std::string camera;			/// 相机. 关键字INSTRUME, 可缺省
 	float* data;				/// 图像数据存储区
 
+protected:
+	bool owner;					/// 数据存储区由本对象分配
+	boost::shared_array<float> buff;	/// 自有数据存储区
+	size_t pixBuff;				/// 自有数据存储区的像素数
+	fitsfile* hFile;			/// 持续打开的文件句柄
+	std::string pathFile;		/// 持续打开的文件路径
+
 public:
 	/* 构造与析构函数 */
 	FITSHandlerImage() {
@@ -35,10 +48,13 @@ public:
 		xBin   = yBin   = 1;
 		expdur = 0.0;
 		data   = NULL;
+		owner  = true;
+		pixBuff = 0;
+		hFile  = NULL;
 	}
 
 	virtual ~FITSHandlerImage() {
-		if (data) delete []data;
+		CloseImage();
 	}
 
 public:
@@ -56,36 +72,16 @@ public:
 	int LoadImage(const char* filepath) {
 		fitsfile *hFits;
 		int state(0);
-		unsigned w, h;
-		char obsdate[30], obstime[30], tmfull[40];
-		bool datefull;
 
 		// 尝试打开文件
 		fits_open_image(&hFits, filepath, 0, &state);
 		if (state) return 1;
 		// 读取关键文件头信息
-		fits_read_key(hFits, TUINT, "NAXIS1", &w, NULL, &state);
-		fits_read_key(hFits, TUINT, "NAXIS2", &h, NULL, &state);
-		fits_read_key(hFits, TSTRING, "DATE-OBS", obsdate,  NULL, &state);
-		if (!(datefull = NULL != strstr(obsdate, "T")))
-			fits_read_key(hFits, TSTRING, "TIME-OBS", obstime,  NULL, &state);
-		if (state) {
+		unsigned w, h;
+		if (read_header(hFits, w, h)) {
 			close_file(hFits);
 			return 2;
 		}
-		if (!datefull) sprintf(tmfull, "%sT%s", obsdate, obstime);
-		dateobs = tmfull;
-		// 尝试不同关键字表征的曝光时间
-		fits_read_key(hFits, TFLOAT, "EXPOSURE",  &expdur, NULL, &state);
-		if (state) {
-			state = 0;
-			fits_read_key(hFits, TFLOAT, "EXPTIME",  &expdur, NULL, &state);
-		}
-		if (state) {
-			state = 0;
-			fits_read_key(hFits, TFLOAT, "EXPDUR",  &expdur, NULL, &state);
-		}
-		dateobs = tmfull;
 		// 尝试加载ROI参数
 
 		// 数据读入内存
@@ -96,6 +92,31 @@ public:
 		return state ? 3 : 0;
 	}
 
+	/*!
+	 * @brief 关联外部提供的图像数据, 替代从文件加载
+	 * @param ext      数据存储区. 在下次加载或关联前须保持有效
+	 * @param w        图像宽度
+	 * @param h        图像高度
+	 * @param t        曝光时间, 量纲: 秒
+	 * @param tmobs    曝光起始时间, 格式: CCYY-MM-DDThh:mm:ss<.sss<sss>>, UTC
+	 */
+	void Attach(float* ext, unsigned w, unsigned h, float t, const std::string& tmobs) {
+		buff.reset();
+		pixBuff = 0;
+		data    = ext;
+		owner   = false;
+		wImg    = w;
+		hImg    = h;
+		expdur  = t;
+		dateobs = tmobs;
+	}
+
+	/*!
+	 * @brief 仅读取文件头: 图像尺寸、合并因子、曝光时间、曝光起始时间和相机
+	 * @param filepath 文件路径
+	 * @return
+	 * 文件可打开且包含关键信息
+	 */
 	bool LookImage(const char* filepath) {
 		fitsfile *hFits;
 		int state(0);
@@ -105,11 +126,11 @@ public:
 		fits_open_image(&hFits, filepath, 0, &state);
 		if (state) return false;
 		// 读取关键文件头信息
-		fits_read_key(hFits, TUINT, "NAXIS1", &w, NULL, &state);
-		fits_read_key(hFits, TUINT, "NAXIS2", &h, NULL, &state);
+		state = read_header(hFits, w, h);
+		close_file(hFits);
+		if (state) return false;
 		alloc_buff(w, 1);
 		hImg = h;
-		close_file(hFits);
 
 		return true;
 	}
@@ -128,18 +149,84 @@ public:
 	}
 
 	/*!
-	 * @brief 读取第line行数据
+	 * @brief 读取第line行数据. 文件保持打开, 连续读取时不重复打开
 	 * @param line 行编号, 起始地址: 0
 	 * @return
-	 * 数据存储区地址
+	 * 数据存储区地址. 读取失败时返回NULL
 	 */
 	float *GetLine(const char* filepath, unsigned line) {
-		fitsfile *hFits;
+		if ((!hFile || pathFile != filepath) && !OpenImage(filepath)) return NULL;
+		if (!owner || pixBuff < wImg) {
+			unsigned h = hImg;
+			alloc_buff(wImg, 1);
+			hImg = h;
+		}
+		return ReadRows(line, 1, data) ? data : NULL;
+	}
+
+	/*!
+	 * @brief 打开文件并读取文件头, 不读取数据. 文件保持打开, 由ReadRows按行读取
+	 * @param filepath 文件路径
+	 * @return
+	 * 文件可打开且包含关键信息
+	 * @note
+	 * 归还自有数据存储区
+	 */
+	bool OpenImage(const char* filepath) {
 		int state(0);
-		fits_open_image(&hFits, filepath, 0, &state);
-		fits_read_img(hFits, TFLOAT, 1 + line * wImg, wImg, NULL, data, NULL, &state);
-		close_file(hFits);
-		return data;
+		unsigned w, h;
+
+		CloseImage();
+		fits_open_image(&hFile, filepath, 0, &state);
+		if (state) {
+			hFile = NULL;
+			return false;
+		}
+		if (read_header(hFile, w, h)) {
+			CloseImage();
+			return false;
+		}
+		buff.reset();
+		pixBuff  = 0;
+		data     = NULL;
+		owner    = true;
+		wImg     = w;
+		hImg     = h;
+		pathFile = filepath;
+		return true;
+	}
+
+	/*!
+	 * @brief 从打开的文件读取连续若干行
+	 * @param row0  起始行, 起始地址: 0
+	 * @param nrow  行数
+	 * @param dst   存储区, 容量不少于nrow * wImg
+	 * @return
+	 * 读取结果
+	 */
+	bool ReadRows(unsigned row0, unsigned nrow, float* dst) {
+		int state(0);
+		if (!hFile || row0 + nrow > hImg) return false;
+		fits_read_img(hFile, TFLOAT, 1 + LONGLONG(row0) * wImg, LONGLONG(nrow) * wImg, NULL, dst, NULL, &state);
+		return state == 0;
+	}
+
+	/*!
+	 * @brief 关闭持续打开的文件
+	 */
+	void CloseImage() {
+		if (hFile) {
+			close_file(hFile);
+			hFile = NULL;
+			pathFile.clear();
+		}
+	}
+
+	/*!
+	 * @brief 检查文件是否保持打开
+	 */
+	bool IsOpen() const {
+		return hFile != NULL;
 	}
 
 	/*!
@@ -156,15 +243,62 @@ public:
 protected:
 	/* 功能 */
 	void alloc_buff(unsigned w, unsigned h) {
-		unsigned pixNew = w * h;
-		unsigned pixOld = wImg * hImg;
-		if (pixNew != pixOld && data != NULL) {
-			delete []data;
-			data = NULL;
+		size_t pixNew = size_t(w) * h;
+		if (pixNew != pixBuff) {// 先归还再租用, 使同尺寸缓存区可被复用
+			buff.reset();
+			buff    = AFramePool::Instance().Lease<float>(w, h);
+			pixBuff = pixNew;
 		}
-		if (data == NULL) data = new float[pixNew];
-		wImg = w;
-		hImg = h;
+		data  = buff.get();
+		owner = true;
+		wImg  = w;
+		hImg  = h;
+	}
+
+	/*!
+	 * @brief 读取关键文件头信息
+	 * @param w  图像宽度
+	 * @param h  图像高度
+	 * @return
+	 * 0: 成功; 2: 缺少关键信息
+	 */
+	int read_header(fitsfile *hFits, unsigned& w, unsigned& h) {
+		int state(0);
+		char obsdate[30], obstime[30], tmfull[64], name[72];
+		bool datefull;
+
+		fits_read_key(hFits, TUINT, "NAXIS1", &w, NULL, &state);
+		fits_read_key(hFits, TUINT, "NAXIS2", &h, NULL, &state);
+		fits_read_key(hFits, TSTRING, "DATE-OBS", obsdate,  NULL, &state);
+		if (!(datefull = NULL != strstr(obsdate, "T")))
+			fits_read_key(hFits, TSTRING, "TIME-OBS", obstime,  NULL, &state);
+		if (state) return 2;
+		if (!datefull) sprintf(tmfull, "%sT%s", obsdate, obstime);
+		dateobs = datefull ? obsdate : tmfull;
+		// 尝试不同关键字表征的曝光时间
+		fits_read_key(hFits, TFLOAT, "EXPOSURE",  &expdur, NULL, &state);
+		if (state) {
+			state = 0;
+			fits_read_key(hFits, TFLOAT, "EXPTIME",  &expdur, NULL, &state);
+		}
+		if (state) {
+			state = 0;
+			fits_read_key(hFits, TFLOAT, "EXPDUR",  &expdur, NULL, &state);
+		}
+		// 可选: 合并因子和相机
+		state = 0;
+		if (fits_read_key(hFits, TUINT, "XBINNING", &xBin, NULL, &state)) {
+			state = 0;
+			xBin  = 1;
+		}
+		if (fits_read_key(hFits, TUINT, "YBINNING", &yBin, NULL, &state)) {
+			state = 0;
+			yBin  = 1;
+		}
+		if (fits_read_key(hFits, TSTRING, "INSTRUME", name, NULL, &state)) name[0] = 0;
+		camera = name;
+
+		return 0;
 	}
 
 	void close_file(fitsfile *h) {
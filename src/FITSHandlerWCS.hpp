@@ -0,0 +1,159 @@
+/*!
+ * @class FITSHandlerWCS  将WCS写入FITS文件头
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * - 写入原始图像文件头, 或生成仅含文件头的独立WCS文件(扩展名.wcs)
+ * - 关键字遵循FITS WCS Paper II及SIP约定. CRPIX起始于1
+ * - 更新原始文件头时删除旧的SIP关键字
+ */
+
+#ifndef FITSHANDLER_WCS_H_
+#define FITSHANDLER_WCS_H_
+
+#include <longnam.h>
+#include <fitsio.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "WCSTan.hpp"
+
+struct FITSHandlerWCS {
+public:
+	/* 接口 */
+	/*!
+	 * @brief 将WCS写入图像文件头
+	 * @param filepath 图像文件路径
+	 * @param wcs      WCS
+	 * @return
+	 * 0: 成功
+	 * 1: 文件打开错误
+	 * 2: 写入错误
+	 */
+	int UpdateImage(const char* filepath, const WCSTan& wcs) {
+		fitsfile *hFits;
+		int state(0);
+
+		fits_open_image(&hFits, filepath, READWRITE, &state);
+		if (state) return 1;
+		remove_sip(hFits);
+		write_keys(hFits, wcs, &state);
+		// 关闭时写入文件头: 失败同样视为写入错误
+		int closeState = close_file(hFits);
+		return state || closeState ? 2 : 0;
+	}
+
+	/*!
+	 * @brief 生成独立的WCS文件
+	 * @param filepath WCS文件路径. 已存在时覆盖
+	 * @param wcs      WCS
+	 * @param w        图像宽度
+	 * @param h        图像高度
+	 * @return
+	 * 0: 成功
+	 * 1: 文件创建错误
+	 * 2: 写入错误
+	 */
+	int SaveAlone(const char* filepath, const WCSTan& wcs, unsigned w, unsigned h) {
+		fitsfile *hFits;
+		int state(0);
+
+		fits_create_file(&hFits, (std::string("!") + filepath).c_str(), &state);
+		if (state) return 1;
+		fits_create_img(hFits, BYTE_IMG, 0, NULL, &state);
+		fits_write_key(hFits, TUINT, "IMAGEW", &w, "image width",  &state);
+		fits_write_key(hFits, TUINT, "IMAGEH", &h, "image height", &state);
+		write_keys(hFits, wcs, &state);
+		int closeState = close_file(hFits);
+		return state || closeState ? 2 : 0;
+	}
+
+protected:
+	/* 功能 */
+	void write_keys(fitsfile *h, const WCSTan& wcs, int *state) {
+		bool sip = wcs.sipOrder >= 2;
+		char ctype1[20], ctype2[20], key[FLEN_KEYWORD];
+		double crpix1(wcs.crpix[0] + 1.0), crpix2(wcs.crpix[1] + 1.0);
+		double equinox(2000.0), rms(wcs.rms);
+		char radesys[] = "ICRS";
+		int p, q, deg;
+
+		strcpy(ctype1, sip ? "RA---TAN-SIP" : "RA---TAN");
+		strcpy(ctype2, sip ? "DEC--TAN-SIP" : "DEC--TAN");
+		fits_update_key(h, TSTRING, "CTYPE1",  ctype1, "TAN (gnomonic) projection", state);
+		fits_update_key(h, TSTRING, "CTYPE2",  ctype2, "TAN (gnomonic) projection", state);
+		fits_update_key(h, TDOUBLE, "EQUINOX", &equinox, "equatorial coordinates definition (yr)", state);
+		fits_update_key(h, TSTRING, "RADESYS", radesys, NULL, state);
+		fits_update_key(h, TDOUBLE, "CRVAL1",  (void*) &wcs.crval[0], "RA  of reference point", state);
+		fits_update_key(h, TDOUBLE, "CRVAL2",  (void*) &wcs.crval[1], "DEC of reference point", state);
+		fits_update_key(h, TDOUBLE, "CRPIX1",  &crpix1, "X reference pixel", state);
+		fits_update_key(h, TDOUBLE, "CRPIX2",  &crpix2, "Y reference pixel", state);
+		fits_update_key(h, TDOUBLE, "CD1_1",   (void*) &wcs.cd[0][0], "transformation matrix", state);
+		fits_update_key(h, TDOUBLE, "CD1_2",   (void*) &wcs.cd[0][1], NULL, state);
+		fits_update_key(h, TDOUBLE, "CD2_1",   (void*) &wcs.cd[1][0], NULL, state);
+		fits_update_key(h, TDOUBLE, "CD2_2",   (void*) &wcs.cd[1][1], NULL, state);
+		fits_update_key(h, TINT,    "WCSNMAT", (void*) &wcs.nmatch, "number of matched stars", state);
+		fits_update_key(h, TDOUBLE, "WCSRMS",  &rms, "fit residual (arcsec)", state);
+		if (!sip) return;
+
+		fits_update_key(h, TINT, "A_ORDER",  (void*) &wcs.sipOrder,    "SIP polynomial order, axis 1", state);
+		fits_update_key(h, TINT, "B_ORDER",  (void*) &wcs.sipOrder,    "SIP polynomial order, axis 2", state);
+		fits_update_key(h, TINT, "AP_ORDER", (void*) &wcs.sipInvOrder, "SIP inverse polynomial order", state);
+		fits_update_key(h, TINT, "BP_ORDER", (void*) &wcs.sipInvOrder, "SIP inverse polynomial order", state);
+		for (deg = 2; deg <= wcs.sipOrder; ++deg) {
+			for (q = 0; q <= deg; ++q) {
+				p = deg - q;
+				snprintf(key, sizeof(key), "A_%d_%d", p, q);
+				fits_update_key(h, TDOUBLE, key, (void*) &wcs.a[p][q], NULL, state);
+				snprintf(key, sizeof(key), "B_%d_%d", p, q);
+				fits_update_key(h, TDOUBLE, key, (void*) &wcs.b[p][q], NULL, state);
+			}
+		}
+		for (deg = 1; deg <= wcs.sipInvOrder; ++deg) {
+			for (q = 0; q <= deg; ++q) {
+				p = deg - q;
+				snprintf(key, sizeof(key), "AP_%d_%d", p, q);
+				fits_update_key(h, TDOUBLE, key, (void*) &wcs.ap[p][q], NULL, state);
+				snprintf(key, sizeof(key), "BP_%d_%d", p, q);
+				fits_update_key(h, TDOUBLE, key, (void*) &wcs.bp[p][q], NULL, state);
+			}
+		}
+	}
+
+	/*!
+	 * @brief 删除旧的SIP关键字
+	 */
+	void remove_sip(fitsfile *h) {
+		static const char* prefix[] = { "A", "B", "AP", "BP" };
+		char key[FLEN_KEYWORD];
+		int order, p, q, i, state;
+
+		for (i = 0; i < 4; ++i) {
+			state = 0;
+			snprintf(key, sizeof(key), "%s_ORDER", prefix[i]);
+			fits_read_key(h, TINT, key, &order, NULL, &state);
+			if (state) continue;
+			fits_delete_key(h, key, &state);
+			for (p = 0; p <= order; ++p) {
+				for (q = 0; p + q <= order; ++q) {
+					state = 0;
+					snprintf(key, sizeof(key), "%s_%d_%d", prefix[i], p, q);
+					fits_delete_key(h, key, &state);
+				}
+			}
+		}
+	}
+
+	/*!
+	 * @brief 关闭文件
+	 * @return
+	 * cfitsio状态. 非0表示文件头未能完整写入
+	 */
+	int close_file(fitsfile *h) {
+		int state(0);
+		fits_close_file(h, &state);
+		return state;
+	}
+};
+
+#endif
@@ -10,6 +10,7 @@
 #define SRC_FILTERMEAN_HPP_
 
 #include <string.h>
+#include "AFramePool.h"
 
 namespace Filter {
 //////////////////////////////////////////////////////////////////////////////
@@ -44,9 +45,12 @@ public:
 		unsigned x, y, x1, y1, x2, y2;
 		double sum;
 		double scale = 1.0 / (wk * hk);
-		double *cols = new double[w];
-		T *back = new T[w * h];
-		T *bkptr, *dptr, *cptr;
+		boost::shared_array<double> leaseCols = AFramePool::Instance().Lease<double>(w, 1);
+		boost::shared_array<T> leaseBack = AFramePool::Instance().Lease<T>(w, h);
+		double *cols = leaseCols.get();
+		T *back = leaseBack.get();
+		T *bkptr, *dptr;
+		double *cptr;
 
 		memcpy (back, data, sizeof(T) * w * h);
 		memset (cols, 0, sizeof(double) * w);
@@ -62,9 +66,6 @@ public:
 
 			}
 		}
-
-		delete []back;
-		delete []cols;
 	}
 };
 
@@ -7,10 +7,75 @@
 #include <unistd.h>
 #include <stdarg.h>
 #include <string.h>
+#include <algorithm>
+#include <chrono>
 #include "GLog.h"
 
+#define LOG_RING_SIZE	1024	/// 线程缓存区容量, 量纲: 条. 须为2的幂
+#define LOG_TEXT_MAX	480		/// 单条日志最大长度. 超出部分截断
+#define LOG_RATE_SLOTS	64		/// 频率限制的格式串槽位. 须为2的幂
+#define LOG_DRAIN_MS	50		/// 后台线程输出周期, 量纲: 毫秒
+
+/*!
+ * @struct LogRecord 已格式化的单条日志
+ */
+struct LogRecord {
+	std::time_t sec;	/// 提交时刻
+	uint64_t seq;		/// 提交序号. 用于恢复跨线程顺序
+	int type;			/// 日志类型
+	char text[LOG_TEXT_MAX];	/// 日志内容
+};
+
+/*!
+ * @struct LogThread 线程缓存区: 单生产者单消费者环形缓存区及频率限制状态
+ */
+struct GLog::LogThread {
+	/*!
+	 * @struct RateSlot 同一格式串在当前周期的输出计数
+	 */
+	struct RateSlot {
+		const char *format;	/// 格式串地址
+		std::time_t sec;	/// 周期起始时刻
+		unsigned count;		/// 周期内提交条数
+		unsigned suppressed;/// 周期内被抑制条数
+	};
+
+	std::atomic<uint32_t> head;		/// 写入位置. 仅生产者修改
+	std::atomic<uint32_t> tail;		/// 读出位置. 仅消费者修改
+	std::unique_ptr<LogRecord[]> recs;	/// 日志存储区. 首次异步写入时分配
+	std::atomic<uint32_t> dropped;	/// 缓存区满时丢弃的条数
+	std::atomic<bool> orphan;		/// 线程已退出
+	RateSlot rates[LOG_RATE_SLOTS];	/// 频率限制状态. 线程退出后由消费者汇总
+
+public:
+	LogThread() : head(0), tail(0), dropped(0), orphan(false) {
+		memset(rates, 0, sizeof(rates));
+	}
+};
+
+/*!
+ * @struct LogLocal 线程局部存储: 本线程在各GLog实例中的缓存区. 线程退出时标记缓存区, 由后台线程回收
+ */
+struct GLog::LogLocal {
+	std::vector<std::pair<int, LogThreadPtr> > bufs;
+
+public:
+	~LogLocal() {
+		for (std::vector<std::pair<int, LogThreadPtr> >::iterator it = bufs.begin(); it != bufs.end(); ++it)
+			it->second->orphan.store(true);
+	}
+};
+
+static std::atomic<int> log_instances(0);	/// GLog实例计数
+
 GLog::GLog(FILE *out) {
 	dayOld_    = 0;
+	id_        = ++log_instances;
+	level_     = LOG_NORMAL;
+	rateLimit_ = 0;
+	async_     = false;
+	seq_       = 0;
+	stopDrain_ = false;
 	if ((fd_ = out) == NULL) {
 		char cwd[MAXPATHLEN];
 		dirName_ = getcwd(cwd, MAXPATHLEN);
@@ -25,6 +90,12 @@ GLog::GLog(FILE *out) {
 GLog::GLog(const char* dirName, const char* fileNamePrefix) {
 	dayOld_    = 0;
 	fd_        = NULL;
+	id_        = ++log_instances;
+	level_     = LOG_NORMAL;
+	rateLimit_ = 0;
+	async_     = false;
+	seq_       = 0;
+	stopDrain_ = false;
 	if (dirName)
 		dirName_ = dirName;
 	if (fileNamePrefix)
@@ -43,72 +114,249 @@ GLog::GLog(const char* dirName, const char* fileNamePrefix) {
 }
 
 GLog::~GLog() {
+	SetAsync(false);
 	if (fd_ && fd_ != stdout && fd_ != stderr)
 		fclose(fd_);
 }
 
 void GLog::Write(const char *format, ...) {
-	if (format) {
-		mutex_lock lck(mtx_);
-		std::tm utc;
+	va_list vl;
+	va_start(vl, format);
+	write_log(NULL, LOG_NORMAL, format, vl);
+	va_end(vl);
+}
 
-		if (valid_file(utc)) {
-			va_list vl;
+void GLog::Write(LOG_TYPE type, const char *format, ...) {
+	va_list vl;
+	va_start(vl, format);
+	write_log(NULL, type, format, vl);
+	va_end(vl);
+}
 
-			fprintf (fd_, "%02d:%02d:%02d >> ", utc.tm_hour, utc.tm_min, utc.tm_sec);
-			va_start(vl, format);
-			vfprintf(fd_, format, vl);
-			va_end(vl);
-			fprintf(fd_, "\n");
-			fflush(fd_);
+void GLog::Write(const char *where, LOG_TYPE type, const char *format, ...) {
+	va_list vl;
+	va_start(vl, format);
+	write_log(where, type, format, vl);
+	va_end(vl);
+}
+
+void GLog::SetLevel(LOG_TYPE level) {
+	level_.store(level);
+}
+
+void GLog::SetRateLimit(unsigned count) {
+	rateLimit_.store(count);
+}
+
+void GLog::SetAsync(bool async) {
+	if (async) {
+		if (async_.load()) return;
+		stopDrain_ = false;
+		thrdDrain_ = std::thread(&GLog::thread_drain, this);
+		async_.store(true, std::memory_order_release);
+	}
+	else if (async_.exchange(false)) {
+		{
+			std::unique_lock<std::mutex> lck(mtxWake_);
+			stopDrain_ = true;
 		}
+		cvWake_.notify_one();
+		thrdDrain_.join();
+		drain();
 	}
 }
 
-void GLog::Write(LOG_TYPE type, const char *format, ...) {
-	if (format) {
-		mutex_lock lck(mtx_);
-		std::tm utc;
+void GLog::Flush() {
+	drain();
+}
 
-		if (valid_file(utc)) {
-			va_list vl;
-
-			fprintf (fd_, "%02d:%02d:%02d >> ", utc.tm_hour, utc.tm_min, utc.tm_sec);
-			if (type > LOG_MIN && type < LOG_MAX)
-				fprintf (fd_, "%s", LOG_TYPE_STR[type]);
-			va_start(vl, format);
-			vfprintf(fd_, format, vl);
-			va_end(vl);
-			fprintf(fd_, "\n");
-			fflush(fd_);
+void GLog::write_log(const char *where, LOG_TYPE type, const char *format, va_list vl) {
+	if (!format || type < level_.load(std::memory_order_relaxed)) return;
+
+	bool async = async_.load(std::memory_order_acquire);
+	unsigned limit = rateLimit_.load(std::memory_order_relaxed);
+	LogThread* thrd = async || limit ? thread_local_buffer() : NULL;
+	if (limit) {
+		unsigned suppressed;
+		bool pass = rate_pass(thrd, format, suppressed);
+		if (suppressed) write_note(thrd, type, "%u similar messages suppressed: %.64s", suppressed, format);
+		if (!pass) return;
+	}
+	if (async) write_async(thrd, where, type, format, vl);
+	else       write_sync(where, type, format, vl);
+}
+
+void GLog::write_note(LogThread* thrd, LOG_TYPE type, const char *format, ...) {
+	va_list vl;
+	va_start(vl, format);
+	if (thrd && async_.load(std::memory_order_acquire)) write_async(thrd, NULL, type, format, vl);
+	else write_sync(NULL, type, format, vl);
+	va_end(vl);
+}
+
+void GLog::write_sync(const char *where, LOG_TYPE type, const char *format, va_list vl) {
+	mutex_lock lck(mtx_);
+	std::tm utc;
+
+	if (valid_file(utc)) {
+		fprintf (fd_, "%02d:%02d:%02d >> ", utc.tm_hour, utc.tm_min, utc.tm_sec);
+		if (type > LOG_MIN && type < LOG_MAX)
+			fprintf (fd_, "%s", LOG_TYPE_STR[type]);
+		if (where) fprintf (fd_, "%s, ", where);
+		vfprintf(fd_, format, vl);
+		fprintf(fd_, "\n");
+		fflush(fd_);
+	}
+}
+
+void GLog::write_async(LogThread* thrd, const char *where, LOG_TYPE type, const char *format, va_list vl) {
+	if (!thrd->recs) thrd->recs.reset(new LogRecord[LOG_RING_SIZE]);
+	uint32_t head = thrd->head.load(std::memory_order_relaxed);
+	uint32_t tail = thrd->tail.load(std::memory_order_acquire);
+	while (head - tail >= LOG_RING_SIZE) {// 缓存区满: 普通日志丢弃并计数; 警告及错误等待后台线程输出
+		cvWake_.notify_one();
+		if (type == LOG_NORMAL) {
+			thrd->dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
 		}
+		if (!async_.load(std::memory_order_acquire)) {
+			write_sync(where, type, format, vl);
+			return;
+		}
+		std::this_thread::yield();
+		tail = thrd->tail.load(std::memory_order_acquire);
 	}
+
+	LogRecord& rec = thrd->recs[head & (LOG_RING_SIZE - 1)];
+	int n(0);
+	rec.sec  = std::time(nullptr);
+	rec.seq  = seq_.fetch_add(1, std::memory_order_relaxed);
+	rec.type = type;
+	if (where && ((n = snprintf(rec.text, LOG_TEXT_MAX, "%s, ", where)) < 0 || n >= LOG_TEXT_MAX)) n = 0;
+	vsnprintf(rec.text + n, LOG_TEXT_MAX - n, format, vl);
+	thrd->head.store(head + 1, std::memory_order_release);
+	if (head + 1 - tail >= LOG_RING_SIZE / 2) cvWake_.notify_one();
 }
 
-void GLog::Write(const char *where, LOG_TYPE type, const char *format, ...) {
-	if (format) {
-		mutex_lock lck(mtx_);
-		std::tm utc;
+GLog::LogThread* GLog::thread_local_buffer() {
+	static thread_local LogLocal local;
+	for (std::vector<std::pair<int, LogThreadPtr> >::iterator it = local.bufs.begin(); it != local.bufs.end(); ++it) {
+		if (it->first == id_) return it->second.get();
+	}
+
+	LogThreadPtr thrd(new LogThread);
+	bool orphans(false);
+	{
+		mutex_lock lck(mtxThreads_);
+		for (LogThreadVec::iterator it = threads_.begin(); it != threads_.end() && !orphans; ++it)
+			orphans = (*it)->orphan.load();
+		threads_.push_back(thrd);
+	}
+	local.bufs.push_back(std::make_pair(id_, thrd));
+	// 同步模式没有后台线程: 注册时汇总并回收已退出线程的缓存区, 避免逐帧创建线程时集合持续增长
+	if (orphans && !async_.load(std::memory_order_acquire)) drain();
+	return thrd.get();
+}
 
+bool GLog::rate_pass(LogThread* thrd, const char *format, unsigned& suppressed) {
+	// 以格式串地址区分消息. 槽位冲突时被替换格式串的抑制计数丢失
+	LogThread::RateSlot& slot = thrd->rates[(uintptr_t(format) >> 3) & (LOG_RATE_SLOTS - 1)];
+	std::time_t now = std::time(nullptr);
+	suppressed = 0;
+	if (slot.format != format || slot.sec != now) {
+		if (slot.format == format) suppressed = slot.suppressed;
+		slot.format = format;
+		slot.sec    = now;
+		slot.count  = slot.suppressed = 0;
+	}
+	if (++slot.count <= rateLimit_.load(std::memory_order_relaxed)) return true;
+	++slot.suppressed;
+	return false;
+}
+
+void GLog::thread_drain() {
+	std::unique_lock<std::mutex> lck(mtxWake_);
+	while (!stopDrain_) {
+		cvWake_.wait_for(lck, std::chrono::milliseconds(LOG_DRAIN_MS));
+		lck.unlock();
+		drain();
+		lck.lock();
+	}
+}
+
+void GLog::drain() {
+	mutex_lock lckDrain(mtxDrain_);
+	LogThreadVec thrds;
+	{
+		mutex_lock lck(mtxThreads_);
+		thrds = threads_;
+	}
+
+	typedef std::pair<uint64_t, const LogRecord*> SeqRecord;
+	std::vector<SeqRecord> batch;
+	std::vector<uint32_t> heads(thrds.size());
+	std::vector<std::pair<unsigned, const char*> > notes;
+	uint32_t dropped(0), i;
+	size_t k;
+	for (k = 0; k < thrds.size(); ++k) {
+		LogThread* thrd = thrds[k].get();
+		uint32_t tail = thrd->tail.load(std::memory_order_relaxed);
+		heads[k] = thrd->head.load(std::memory_order_acquire);
+		for (i = tail; i != heads[k]; ++i) {
+			const LogRecord* rec = &thrd->recs[i & (LOG_RING_SIZE - 1)];
+			batch.push_back(SeqRecord(rec->seq, rec));
+		}
+		dropped += thrd->dropped.exchange(0);
+		if (thrd->orphan.load()) {// 线程已退出: 汇总其未输出的抑制计数
+			for (int j = 0; j < LOG_RATE_SLOTS; ++j) {
+				LogThread::RateSlot& slot = thrd->rates[j];
+				if (slot.suppressed) notes.push_back(std::make_pair(slot.suppressed, slot.format));
+				slot.suppressed = 0;
+			}
+		}
+	}
+
+	if (batch.size() || dropped || notes.size()) {
+		std::sort(batch.begin(), batch.end(),
+				[](const SeqRecord& a, const SeqRecord& b) { return a.first < b.first; });
+		mutex_lock lck(mtx_);
+		std::tm utc, loc;
+		std::time_t secLast(-1);
 		if (valid_file(utc)) {
-			va_list vl;
-
-			fprintf (fd_, "%02d:%02d:%02d >> ", utc.tm_hour, utc.tm_min, utc.tm_sec);
-			if (type > LOG_MIN && type < LOG_MAX)
-				fprintf (fd_, "%s", LOG_TYPE_STR[type]);
-			if (where) fprintf (fd_, "%s, ", where);
-			va_start(vl, format);
-			vfprintf(fd_, format, vl);
-			va_end(vl);
-			fprintf(fd_, "\n");
+			for (std::vector<SeqRecord>::iterator it = batch.begin(); it != batch.end(); ++it) {
+				const LogRecord* rec = it->second;
+				if (rec->sec != secLast) {
+					secLast = rec->sec;
+					localtime_r(&secLast, &loc);
+				}
+				fprintf(fd_, "%02d:%02d:%02d >> %s%s\n", loc.tm_hour, loc.tm_min, loc.tm_sec,
+						rec->type > LOG_MIN && rec->type < LOG_MAX ? LOG_TYPE_STR[rec->type] : "", rec->text);
+			}
+			for (size_t j = 0; j < notes.size(); ++j) {
+				fprintf(fd_, "%02d:%02d:%02d >> %u similar messages suppressed: %.64s\n",
+						utc.tm_hour, utc.tm_min, utc.tm_sec, notes[j].first, notes[j].second);
+			}
+			if (dropped) {
+				fprintf(fd_, "%02d:%02d:%02d >> %s%u log records dropped, thread buffer full\n",
+						utc.tm_hour, utc.tm_min, utc.tm_sec, LOG_TYPE_STR[LOG_WARN], dropped);
+			}
 			fflush(fd_);
 		}
 	}
+	for (k = 0; k < thrds.size(); ++k) thrds[k]->tail.store(heads[k], std::memory_order_release);
+
+	// 回收已退出且已输出完毕的线程缓存区
+	mutex_lock lck(mtxThreads_);
+	for (LogThreadVec::iterator it = threads_.begin(); it != threads_.end();) {
+		LogThread* thrd = it->get();
+		if (thrd->orphan.load() && thrd->tail.load() == thrd->head.load()) it = threads_.erase(it);
+		else ++it;
+	}
 }
 
 bool GLog::valid_file(std::tm &tmLoc) {
 	std::time_t now = std::time(nullptr);
-	memcpy(&tmLoc, std::localtime(&now), sizeof(std::tm));	// Local Time
+	localtime_r(&now, &tmLoc);	// Local Time
 
 	if (fd_ == stdout || fd_ == stderr)
 		return true;
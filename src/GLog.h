@@ -3,18 +3,29 @@
  * @author       卢晓猛
  * @description  日志文件访问接口
  * 使用互斥锁管理文件写入操作, 将并行操作转换为串性操作, 避免日志混淆
- * @version      2.0
+ * @version      2.1
  * @date         2020年9月30日
  * - 使用标准c/c++库替代boost库
+ * @date         2021年5月
+ * - 异步模式: 调用线程将日志格式化后写入线程独立的无锁环形缓存区, 由后台线程批量加时间戳、写入文件并刷新
+ * - 按级别过滤: 低于设定级别的日志在调用线程直接丢弃
+ * - 频率限制: 同一线程同一格式串每秒输出条数受限, 被抑制的条数在该格式串再次输出时汇总
  */
 
 #ifndef SRC_GLOG_H_
 #define SRC_GLOG_H_
 
 #include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
 #include <string>
 #include <ctime>
 #include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <memory>
+#include <vector>
 
 enum LOG_TYPE {// 日志类型
 	LOG_MIN = -1,
@@ -46,8 +57,66 @@ public:
 	void Write(const char *format, ...);
 	void Write(LOG_TYPE type, const char *format, ...);
 	void Write(const char *where, LOG_TYPE type, const char *format, ...);
+	/*!
+	 * @brief 设置输出级别. 低于该级别的日志被丢弃
+	 */
+	void SetLevel(LOG_TYPE level);
+	/*!
+	 * @brief 设置频率限制
+	 * @param count  同一线程同一格式串每秒最多输出条数. 0: 不限制
+	 */
+	void SetRateLimit(unsigned count);
+	/*!
+	 * @brief 启用或停用异步模式. 停用前输出所有已缓存日志
+	 */
+	void SetAsync(bool async);
+	/*!
+	 * @brief 输出所有已缓存日志
+	 */
+	void Flush();
 
 protected:
+	struct LogThread;
+	struct LogLocal;
+	typedef std::shared_ptr<LogThread> LogThreadPtr;
+	typedef std::vector<LogThreadPtr> LogThreadVec;
+
+	/*!
+	 * @brief 按级别和频率限制检查后写入日志
+	 */
+	void write_log(const char *where, LOG_TYPE type, const char *format, va_list vl);
+	/*!
+	 * @brief 同步模式: 在调用线程写入文件
+	 */
+	void write_sync(const char *where, LOG_TYPE type, const char *format, va_list vl);
+	/*!
+	 * @brief 异步模式: 写入调用线程的环形缓存区
+	 */
+	void write_async(LogThread* thrd, const char *where, LOG_TYPE type, const char *format, va_list vl);
+	/*!
+	 * @brief 查找或创建调用线程的缓存区
+	 */
+	LogThread* thread_local_buffer();
+	/*!
+	 * @brief 写入由本类生成的提示, 不受级别和频率限制
+	 */
+	void write_note(LogThread* thrd, LOG_TYPE type, const char *format, ...);
+	/*!
+	 * @brief 频率限制检查
+	 * @param suppressed  该格式串在上一周期被抑制的条数
+	 * @return
+	 * 允许输出
+	 */
+	bool rate_pass(LogThread* thrd, const char *format, unsigned& suppressed);
+	/*!
+	 * @brief 后台线程: 周期性输出各线程缓存区中的日志
+	 */
+	void thread_drain();
+	/*!
+	 * @brief 按提交顺序输出各线程缓存区中的日志
+	 */
+	void drain();
+
 	/*!
 	 * @brief 依据时间检查是否需要创建新的日志文件
 	 * @return
@@ -63,6 +132,20 @@ protected:
 	std::string	dirName_;	//< 日志目录
 	std::string prefix_;	//< 日志文件名前缀
 	int			dayOld_;	//< UTC日期
+
+	/* 异步模式 */
+	int id_;					//< 实例编号. 用于区分线程缓存区归属
+	std::atomic<int> level_;		//< 输出级别
+	std::atomic<unsigned> rateLimit_;	//< 频率限制
+	std::atomic<bool> async_;	//< 异步模式
+	std::atomic<uint64_t> seq_;	//< 日志提交序号
+	std::mutex mtxThreads_;		//< 互斥锁: 线程缓存区集合
+	LogThreadVec threads_;		//< 各线程缓存区
+	std::mutex mtxDrain_;		//< 互斥锁: 输出缓存区. 同一时刻仅一个消费者
+	std::mutex mtxWake_;		//< 互斥锁: 唤醒后台线程
+	std::condition_variable cvWake_;	//< 事件: 缓存区将满或停用异步模式
+	std::thread thrdDrain_;		//< 后台线程
+	bool stopDrain_;			//< 后台线程退出标志
 };
 
 extern GLog _gLog;		//< 工作日志
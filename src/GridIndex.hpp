@@ -0,0 +1,151 @@
+/*!
+ * @file GridIndex.hpp 二维平面均匀网格索引
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * - 以链表方式将点归入网格, 构建和查询代价均与点数量线性相关
+ * - 用于像素坐标或切平面坐标的近邻匹配
+ */
+
+#ifndef GRIDINDEX_HPP_
+#define GRIDINDEX_HPP_
+
+#include <math.h>
+#include <vector>
+
+struct GridIndex {
+protected:
+	double x0, y0;		/// 网格起点
+	double cell;		/// 网格尺寸
+	int nx, ny;			/// 网格数量
+	std::vector<int> head;	/// 网格中首个点的索引. -1: 空
+	std::vector<int> next;	/// 同一网格中下一个点的索引
+	std::vector<double> px, py;	/// 点坐标
+
+public:
+	GridIndex() {
+		x0 = y0 = 0.0;
+		cell = 1.0;
+		nx = ny = 0;
+	}
+
+public:
+	/*!
+	 * @brief 初始化网格
+	 * @param xmin   X方向最小值
+	 * @param ymin   Y方向最小值
+	 * @param xmax   X方向最大值
+	 * @param ymax   Y方向最大值
+	 * @param size   网格尺寸. 通常等于匹配半径
+	 */
+	void Reset(double xmin, double ymin, double xmax, double ymax, double size) {
+		x0   = xmin;
+		y0   = ymin;
+		cell = size > 0.0 ? size : 1.0;
+		nx   = int((xmax - xmin) / cell) + 1;
+		ny   = int((ymax - ymin) / cell) + 1;
+		head.assign(nx * ny, -1);
+		next.clear();
+		px.clear();
+		py.clear();
+	}
+
+	/*!
+	 * @brief 加入点. 点的索引与加入顺序一致
+	 * @return
+	 * 点索引
+	 */
+	int Add(double x, double y) {
+		int id = int(px.size());
+		int k  = locate(x, y);
+		px.push_back(x);
+		py.push_back(y);
+		next.push_back(-1);
+		if (k >= 0) {
+			next[id] = head[k];
+			head[k]  = id;
+		}
+		return id;
+	}
+
+	/*!
+	 * @brief 查找与(x, y)最近的点
+	 * @param x   X坐标
+	 * @param y   Y坐标
+	 * @param r   搜索半径
+	 * @param d2  最近点的距离平方
+	 * @return
+	 * 最近点索引. -1: 半径内无点
+	 */
+	int Nearest(double x, double y, double r, double* d2 = NULL) const {
+		int best(-1), i, j, k, id;
+		int i0 = int(floor((x - r - x0) / cell)), i1 = int(floor((x + r - x0) / cell));
+		int j0 = int(floor((y - r - y0) / cell)), j1 = int(floor((y + r - y0) / cell));
+		double r2 = r * r, dx, dy, t;
+
+		if (i0 < 0) i0 = 0;
+		if (j0 < 0) j0 = 0;
+		if (i1 >= nx) i1 = nx - 1;
+		if (j1 >= ny) j1 = ny - 1;
+		for (j = j0; j <= j1; ++j) {
+			for (i = i0, k = j * nx + i0; i <= i1; ++i, ++k) {
+				for (id = head[k]; id >= 0; id = next[id]) {
+					dx = px[id] - x;
+					dy = py[id] - y;
+					if ((t = dx * dx + dy * dy) <= r2) {
+						r2   = t;
+						best = id;
+					}
+				}
+			}
+		}
+		if (d2) *d2 = r2;
+		return best;
+	}
+
+	/*!
+	 * @brief 查找半径内的所有点
+	 * @param x    X坐标
+	 * @param y    Y坐标
+	 * @param r    搜索半径
+	 * @param ids  点索引
+	 */
+	void Within(double x, double y, double r, std::vector<int>& ids) const {
+		int i, j, k, id;
+		int i0 = int(floor((x - r - x0) / cell)), i1 = int(floor((x + r - x0) / cell));
+		int j0 = int(floor((y - r - y0) / cell)), j1 = int(floor((y + r - y0) / cell));
+		double r2 = r * r, dx, dy;
+
+		ids.clear();
+		if (i0 < 0) i0 = 0;
+		if (j0 < 0) j0 = 0;
+		if (i1 >= nx) i1 = nx - 1;
+		if (j1 >= ny) j1 = ny - 1;
+		for (j = j0; j <= j1; ++j) {
+			for (i = i0, k = j * nx + i0; i <= i1; ++i, ++k) {
+				for (id = head[k]; id >= 0; id = next[id]) {
+					dx = px[id] - x;
+					dy = py[id] - y;
+					if (dx * dx + dy * dy <= r2) ids.push_back(id);
+				}
+			}
+		}
+	}
+
+	/*!
+	 * @brief 点数量
+	 */
+	int Size() const {
+		return int(px.size());
+	}
+
+protected:
+	int locate(double x, double y) const {
+		int i = int(floor((x - x0) / cell));
+		int j = int(floor((y - y0) / cell));
+		if (i < 0 || j < 0 || i >= nx || j >= ny) return -1;
+		return j * nx + i;
+	}
+};
+
+#endif /* GRIDINDEX_HPP_ */
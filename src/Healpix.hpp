@@ -0,0 +1,163 @@
+/**
+ * @file Healpix.hpp HEALPix天区划分, NESTED编号
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * - 算法参照HEALPix C++库(Gorski et al. 2005)
+ * - 阶数order对应nside = 2^order, 天区数量 = 12 * nside^2
+ * - 坐标以(z, phi)表示: z = sin(dec), phi = ra, 量纲: 弧度
+ */
+
+#ifndef SRC_HEALPIX_HPP_
+#define SRC_HEALPIX_HPP_
+
+#include <stdint.h>
+#include <math.h>
+
+namespace Healpix {
+//////////////////////////////////////////////////////////////////////////////
+static const int jrll[12] = { 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4 };
+static const int jpll[12] = { 1, 3, 5, 7, 0, 2, 4, 6, 1, 3, 5, 7 };
+
+/*!
+ * @brief 将整数的低32位按位展开至偶数位
+ */
+inline uint64_t spread_bits(uint64_t v) {
+	v &= 0xFFFFFFFFULL;
+	v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+	v = (v | (v <<  8)) & 0x00FF00FF00FF00FFULL;
+	v = (v | (v <<  4)) & 0x0F0F0F0F0F0F0F0FULL;
+	v = (v | (v <<  2)) & 0x3333333333333333ULL;
+	v = (v | (v <<  1)) & 0x5555555555555555ULL;
+	return v;
+}
+
+/*!
+ * @brief spread_bits的逆运算
+ */
+inline uint64_t compress_bits(uint64_t v) {
+	v &= 0x5555555555555555ULL;
+	v = (v | (v >>  1)) & 0x3333333333333333ULL;
+	v = (v | (v >>  2)) & 0x0F0F0F0F0F0F0F0FULL;
+	v = (v | (v >>  4)) & 0x00FF00FF00FF00FFULL;
+	v = (v | (v >>  8)) & 0x0000FFFF0000FFFFULL;
+	v = (v | (v >> 16)) & 0x00000000FFFFFFFFULL;
+	return v;
+}
+
+/*!
+ * @brief 天区数量
+ */
+inline uint64_t npix(int order) {
+	return 12ULL << (2 * order);
+}
+
+/*!
+ * @brief 由坐标计算天区编号
+ * @param order  阶数
+ * @param z      sin(dec)
+ * @param phi    赤经, 量纲: 弧度
+ * @return
+ * NESTED天区编号
+ */
+inline uint64_t loc2pix(int order, double z, double phi) {
+	int64_t nside = int64_t(1) << order;
+	double za = fabs(z);
+	double tt = fmod(phi * M_2_PI, 4.0);	// [0, 4)
+	int64_t ix, iy;
+	int face;
+
+	if (tt < 0.0) tt += 4.0;
+	if (za <= 2.0 / 3.0) {// 赤道区
+		double temp1 = nside * (0.5 + tt);
+		double temp2 = nside * (z * 0.75);
+		int64_t jp = int64_t(temp1 - temp2);
+		int64_t jm = int64_t(temp1 + temp2);
+		int64_t ifp = jp >> order;
+		int64_t ifm = jm >> order;
+		face = int(ifp == ifm ? (ifp | 4) : (ifp < ifm ? ifp : ifm + 8));
+		ix = jm & (nside - 1);
+		iy = nside - (jp & (nside - 1)) - 1;
+	}
+	else {// 极区
+		int ntt = tt < 3.0 ? int(tt) : 3;
+		double tp = tt - ntt;
+		double tmp = nside * sqrt(3.0 * (1.0 - za));
+		int64_t jp = int64_t(tp * tmp);
+		int64_t jm = int64_t((1.0 - tp) * tmp);
+		if (jp >= nside) jp = nside - 1;
+		if (jm >= nside) jm = nside - 1;
+		if (z >= 0.0) {
+			face = ntt;
+			ix = nside - jm - 1;
+			iy = nside - jp - 1;
+		}
+		else {
+			face = ntt + 8;
+			ix = jp;
+			iy = jm;
+		}
+	}
+	return (uint64_t(face) << (2 * order)) + spread_bits(ix) + (spread_bits(iy) << 1);
+}
+
+/*!
+ * @brief 天区中心坐标
+ * @param order  阶数
+ * @param pix    NESTED天区编号
+ * @param z      sin(dec)
+ * @param phi    赤经, 量纲: 弧度
+ */
+inline void pix2loc(int order, uint64_t pix, double& z, double& phi) {
+	int64_t nside  = int64_t(1) << order;
+	int64_t npface = nside * nside;
+	int face = int(pix >> (2 * order));
+	uint64_t ipf = pix & (npface - 1);
+	int64_t ix = compress_bits(ipf);
+	int64_t iy = compress_bits(ipf >> 1);
+	int64_t jr = int64_t(jrll[face]) * nside - ix - iy - 1;
+	int64_t nr, kshift;
+	double fact2 = 1.0 / (3.0 * npface);
+	double fact1 = 2.0 / (3.0 * nside);
+
+	if (jr < nside) {
+		nr = jr;
+		z  = 1.0 - nr * nr * fact2;
+		kshift = 0;
+	}
+	else if (jr > 3 * nside) {
+		nr = 4 * nside - jr;
+		z  = nr * nr * fact2 - 1.0;
+		kshift = 0;
+	}
+	else {
+		nr = nside;
+		z  = (2 * nside - jr) * fact1;
+		kshift = (jr - nside) & 1;
+	}
+	int64_t jp = (jpll[face] * nr + ix - iy + 1 + kshift) / 2;
+	if (jp > 4 * nr) jp -= 4 * nr;
+	if (jp < 1) jp += 4 * nr;
+	phi = (jp - (kshift + 1) * 0.5) * (M_PI_2 / nr);
+}
+
+/*!
+ * @brief 天区中心至天区边界的最大角距离
+ * @param order  阶数
+ * @return
+ * 角距离, 量纲: 弧度
+ */
+inline double max_pixrad(int order) {
+	double nside = double(int64_t(1) << order);
+	double phia = M_PI / (4.0 * nside), za = 2.0 / 3.0;
+	double t1 = 1.0 - 1.0 / nside;
+	double zb = 1.0 - t1 * t1 / 3.0;
+	double sa = sqrt((1.0 - za) * (1.0 + za)), sb = sqrt((1.0 - zb) * (1.0 + zb));
+	double dot = sa * sb * cos(phia) + za * zb;
+	return acos(dot > 1.0 ? 1.0 : dot);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+};
+
+#endif /* SRC_HEALPIX_HPP_ */
@@ -10,8 +10,11 @@
 #include <string>
 #include <vector>
 #include <deque>
+#include <chrono>
 #include <strings.h>
 #include <boost/smart_ptr/shared_ptr.hpp>
+#include <boost/smart_ptr/shared_array.hpp>
+#include "WCSTan.hpp"
 
 /*!
  * @brief 定义2维坐标, 坐标以实数表示
@@ -43,7 +46,7 @@ struct CelestialBody {
 	double noise;		/// 质心噪声
 	double flux;		/// 积分流量
 	double snr;			/// 信噪比
-	int type;			/// 匹配类型. 0: 未匹配; 1: 恒星/星系/星团
+	int type;			/// 匹配类型. 0: 未匹配; 1: 恒星/星系/星团; 2: 运动目标
 
 public:
 	CelestialBody() {
@@ -52,15 +55,52 @@ public:
 };
 typedef std::vector<CelestialBody> CeleBodyVec;
 
+/*!
+ * @struct StreakSegment 卫星/快速运动目标拖线
+ */
+struct StreakSegment {
+	point_2f pt1, pt2;	/// 端点
+	double length;		/// 长度
+	double width;		/// 宽度: 横向轮廓的半高全宽
+	double tilt;		/// 倾角. 与X轴正向的夹角, 量纲: 角度
+	double flux;		/// 积分流量
+	double snr;			/// 信噪比
+	int npix;			/// 参与测光的像素数
+};
+typedef std::vector<StreakSegment> StreakVec;
+
+/*!
+ * @struct DiffSource 差分图像中的残差源
+ */
+struct DiffSource {
+	point_2f ptCenter;	/// 质心, 像素坐标
+	point_2f ptEquator;	/// 质心对应的赤道坐标, 量纲: 角度
+	double flux;		/// 差分流量. 负值: 变暗
+	double fluxRef;		/// 参考图像中同一位置的流量
+	double snr;			/// 信噪比
+	int type;			/// 分类. 1: 新出现(暂现源); 2: 变亮; 3: 变暗
+};
+typedef std::vector<DiffSource> DiffSrcVec;
+
+enum {// 像素掩模标记位
+	MASK_BADPIX = 0x01,	/// 坏像素
+	MASK_STREAK = 0x02,	/// 拖线
+	MASK_DETECT = 0x04	/// 目标像素: 信号提取后保留的目标
+};
+
 struct ImageFrame {
 	/* 处理流程成功标志, 控制输出项 */
 	bool succAstro;			/// 成功: 天文定位
 	bool succPhoto;			/// 成功: 测光
+	int stageDone;			/// 已完成的处理环节, 见AManifest
+	int stageFail;			/// 失败的处理环节. 0: 无
 	/* 文件原始信息 */
 	std::string filepath;	/// 全路径名
 	std::string pathdir;	/// 目录名
 	std::string filename;	/// 文件名
 	std::string filetit;	/// 文件名(不含扩展名)
+	std::chrono::steady_clock::time_point tmArrive;	/// 进入处理流程的时刻, 用于统计处理延迟
+	std::chrono::steady_clock::time_point tmQueue;	/// 进入当前处理队列的时刻, 用于跟踪队列等待. 仅启用性能跟踪时记录
 	std::string dateobs;	/// 曝光起始时间, 格式: CCYY-MM-DDThh:mm:ss.sss<sss>. UTC
 	unsigned wImg, hImg;	/// 图像像素数
 	double expdur;			/// 曝光时间, 量纲: 秒
@@ -71,9 +111,42 @@ struct ImageFrame {
 	double fwhm;			/// 统计半高全宽
 	/* 天文定位结果 */
 	point_2f coordCenter;	/// 视场中心赤道坐标, 量纲: 角度, 坐标系: J2000
-	//...WCS信息
+	WCSTan wcs;				/// WCS
 	/* 天文测光结果 */
 	CeleBodyVec bodies;		/// 从图像中提取的天体集合
+	StreakVec streaks;		/// 拖线. 其像素已在图像中屏蔽
+	DiffSrcVec diffs;		/// 差分成像残差源
+	/* 内存数据 */
+	boost::shared_array<float> dataRaw;	/// 外部提供的原始图像数据. 非空时不读取图像文件, 作为处理缓存区被就地修改
+	/* 合成跟踪 */
+	boost::shared_array<float> dataSub;	/// 扣除背景后的图像数据. 仅启用合成跟踪或差分成像时保留
+	/* 资源预算 */
+	size_t memCharged;		/// 计入处理流程预算的内存. 0: 未计入
+
+public:
+	ImageFrame() {
+		succAstro = succPhoto = false;
+		stageDone = stageFail = 0;
+		wImg = hImg = 0;
+		expdur = 0.0;
+		bkMean = bkSigma = 0.0;
+		fwhm = 0.0;
+		memCharged = 0;
+	}
+
+	/*!
+	 * @brief 估算帧占用的内存, 量纲: 字节
+	 */
+	size_t MemoryBytes() const {
+		size_t pixels = size_t(wImg) * hImg;
+		size_t bytes = sizeof(ImageFrame)
+				+ bodies.capacity() * sizeof(CelestialBody)
+				+ streaks.capacity() * sizeof(StreakSegment)
+				+ diffs.capacity() * sizeof(DiffSource);
+		if (dataRaw) bytes += pixels * sizeof(float);
+		if (dataSub) bytes += pixels * sizeof(float);
+		return bytes;
+	}
 };
 typedef boost::shared_ptr<ImageFrame> ImgFrmPtr;
 typedef std::deque<ImgFrmPtr> ImgFrmDeque;
@@ -25,6 +25,7 @@ struct ParamFunction {
 	bool useAstrometry;	/// 天文定位
 	bool usePhotometry;	/// 测光
 	bool useMotion;		/// 运动关联
+	bool useDiff;		/// 差分成像
 };
 
 struct ParamPreProcess {
@@ -33,6 +34,15 @@ struct ParamPreProcess {
 	string pathDark;	/// 合并后暗场路径
 	string pathFlat;	/// 合并后平场路径
 	bool badPixRemove;	/// 剔除坏像素
+	unsigned bandRows;	/// 分带处理时每带行数, 向上取整为背景网格高度的整数倍. 0: 不分带, 整帧读入内存
+	unsigned bandMinMPix;	/// 图像像素数不少于该值时分带处理, 量纲: 百万像素
+
+public:
+	ParamPreProcess() {
+		badPixRemove = true;
+		bandRows     = 0;
+		bandMinMPix  = 256;
+	}
 };
 
 // 背景算法
@@ -46,20 +56,293 @@ struct ParamBackground {
 };
 
 struct ParamExtractSignal {
-	int modeFilter;		/// 检测信号前应用滤波算法
-	float sigMin;		/// 最小信噪比
+	bool enable;		/// 提取信号并聚合为目标
+	float sigMin;		/// 信号像素的最小信噪比, 量纲: 背景噪声
+	int modeFilter;		/// 已废弃: 旧版配置的检测前滤波模式. 仅读取, 非零时启动流程给出警告
+
+public:
+	ParamExtractSignal() {
+		enable = false;
+		sigMin = 3.0;
+		modeFilter = 0;
+	}
 };
 
 // 目标测量参数
 struct ParamMeasureBlob {
 	unsigned pixMin;	/// 构成目标的最小像素数
 	unsigned pixMax;	/// 构成目标的最大像素数. 0: 无限制
+	float snrMin;		/// 目标的最小积分信噪比
+
+public:
+	ParamMeasureBlob() {
+		pixMin = 5;
+		pixMax = 0;
+		snrMin = 5.0;
+	}
+};
+
+// 卫星/快速运动目标拖线检测参数
+struct ParamStreak {
+	bool enable;		/// 启用拖线检测
+	unsigned binning;	/// 降采样因子
+	double snr;			/// 降采样像素阈值, 量纲: 降采样噪声
+	double lenMin;		/// 最短拖线, 量纲: 像素
+	double gapMax;		/// 拖线内最大间断, 量纲: 像素
+	double maskWidth;	/// 屏蔽区在拖线宽度外扩展的像素数
+	unsigned maxCount;	/// 单帧最多拖线数量
+	unsigned threads;	/// 线程数. 0: 与CPU核数相同
+
+public:
+	ParamStreak() {
+		enable    = false;
+		binning   = 4;
+		snr       = 3.0;
+		lenMin    = 100.0;
+		gapMax    = 16.0;
+		maskWidth = 3.0;
+		maxCount  = 16;
+		threads   = 0;
+	}
+};
+
+// 本地参考星表
+struct ParamCatalog {
+	string pathCatalog;	/// 星表文件路径. 空: 不使用星表
+	double magLimit;	/// 检索极限星等
+
+public:
+	ParamCatalog() {
+		magLimit = 16.0;
+	}
+};
+
+// 天文定位参数
+struct ParamAstrometry {
+	string pathIndex;	/// 盲定位索引文件路径
+	double scaleLow;	/// 像元比例尺下限, 量纲: 角秒/像素. 0: 不限制
+	double scaleHigh;	/// 像元比例尺上限, 量纲: 角秒/像素. 0: 不限制
+	unsigned starSolve;	/// 用于构建四星组的最亮目标数量
+	unsigned matchMin;	/// 定位成功需要的最少匹配星数量
+	double matchRadius;	/// 匹配半径, 量纲: 像素
+	double timeLimit;	/// 单帧盲定位时间上限, 量纲: 秒
+	bool warmStart;		/// 以同一相机前一帧的WCS作为初值尝试快速定位
+	double warmRadius;	/// 快速定位的初始匹配半径, 量纲: 像素
+	int sipOrder;		/// SIP畸变多项式阶数. 小于2: 仅拟合线性TAN模型
+
+public:
+	ParamAstrometry() {
+		scaleLow  = scaleHigh = 0.0;
+		starSolve = 30;
+		matchMin  = 10;
+		matchRadius = 3.0;
+		timeLimit = 1.0;
+		warmStart = true;
+		warmRadius = 20.0;
+		sipOrder  = 3;
+	}
+};
+
+// 运动目标关联参数
+struct ParamMotion {
+	unsigned depth;		/// 参与关联的最近帧数
+	unsigned minFrames;	/// 确认运动目标需要的最少帧数
+	double rateMin;		/// 运动速度下限, 量纲: 角秒/秒
+	double rateMax;		/// 运动速度上限, 量纲: 角秒/秒
+	double rStatic;		/// 静态源匹配半径, 量纲: 角秒
+	double rLink;		/// 运动目标关联容差, 量纲: 角秒
+
+public:
+	ParamMotion() {
+		depth     = 5;
+		minFrames = 3;
+		rateMin   = 0.002;
+		rateMax   = 0.5;
+		rStatic   = 1.5;
+		rLink     = 2.0;
+	}
+};
+
+/*!
+ * @struct ParamSynTrack 合成跟踪: 在候选速度网格上平移叠加序列图像, 探测单帧不可见的暗弱运动目标
+ */
+struct ParamSynTrack {
+	bool enable;		/// 启用合成跟踪
+	unsigned frames;	/// 参与叠加的帧数
+	double rateMax;		/// 运动速度上限, 量纲: 角秒/秒
+	double step;		/// 速度网格步长: 窗口时长内的位移, 量纲: 像素
+	double snr;			/// 叠加图像探测阈值
+	double rMask;		/// 静态源屏蔽半径, 量纲: 像素
+	unsigned tile;		/// 分块尺寸, 量纲: 像素
+	unsigned cacheMB;	/// 部分和缓存上限, 量纲: MB
+	unsigned threads;	/// 线程数. 0: 与CPU核数相同
+
+public:
+	ParamSynTrack() {
+		enable  = false;
+		frames  = 16;
+		rateMax = 0.05;
+		step    = 1.0;
+		snr     = 6.0;
+		rMask   = 4.0;
+		tile    = 512;
+		cacheMB = 1024;
+		threads = 0;
+	}
+};
+
+/*!
+ * @struct ParamDiff 差分成像: 扣除同一视场的参考图像, 探测暂现源和变源
+ */
+struct ParamDiff {
+	string pathRef;		/// 参考图像目录
+	unsigned refFrames;	/// 合并为参考图像的帧数
+	double fieldTol;	/// 视场匹配容差: 中心偏差与视场半径之比
+	double snr;			/// 残差源探测阈值
+	double rMatch;		/// 残差源在参考图像中的测光半径, 量纲: FWHM
+	unsigned maxCount;	/// 单帧最多残差源数量
+	unsigned threads;	/// 线程数. 0: 与CPU核数相同
+
+public:
+	ParamDiff() {
+		refFrames = 5;
+		fieldTol  = 0.1;
+		snr       = 5.0;
+		rMatch    = 1.0;
+		maxCount  = 1000;
+		threads   = 0;
+	}
+};
+
+/*!
+ * @struct ParamBudget 处理流程资源预算: 超出预算时阻塞新帧进入处理流程
+ */
+struct ParamBudget {
+	unsigned frames;	/// 处理流程中的最大帧数. 0: 无限制
+	unsigned memoryMB;	/// 处理流程中各帧占用内存的上限, 量纲: MB. 0: 无限制
+	bool hugePage;		/// 帧缓存区使用大页
+
+public:
+	ParamBudget() {
+		frames   = 16;
+		memoryMB = 0;
+		hugePage = false;
+	}
+};
+
+/*!
+ * @struct ParamTrace 性能跟踪: 记录各环节耗时, 导出指标和事件
+ */
+struct ParamTrace {
+	bool enable;		/// 启用性能跟踪
+	string pathMetrics;	/// 指标文件路径, Prometheus文本格式. 空: 不导出
+	string pathEvents;	/// 事件文件路径, Chrome trace-event JSON格式. 空: 不导出
+
+public:
+	ParamTrace() {
+		enable = false;
+	}
+};
+
+/*!
+ * @struct ParamLog 工作日志: 输出方式、级别和频率限制
+ */
+struct ParamLog {
+	bool async;			/// 异步输出: 由后台线程批量写入文件
+	int level;			/// 输出级别. 0: 全部; 1: 警告及错误; 2: 仅错误
+	unsigned rateLimit;	/// 同一线程同一消息每秒最多输出条数. 0: 不限制
+
+public:
+	ParamLog() {
+		async     = false;
+		level     = 0;
+		rateLimit = 0;
+	}
+};
+
+enum {// 预览图拉伸方式
+	STRETCH_LINEAR = 1,	/// 线性
+	STRETCH_ASINH		/// 反双曲正弦
+};
+
+enum {// 预览图文件格式
+	PREVIEW_PGM = 1,	/// PGM
+	PREVIEW_PNG			/// PNG
+};
+
+/*!
+ * @struct ParamPreview 快视预览图: 合并像素后拉伸为8位灰度图像
+ */
+struct ParamPreview {
+	bool enable;		/// 生成预览图
+	unsigned binning;	/// 合并因子
+	int stretch;		/// 拉伸方式
+	double sigLow;		/// 黑电平: 背景以下的噪声倍数
+	double sigHigh;		/// 白电平: 背景以上的噪声倍数
+	int format;			/// 文件格式
+	string pathDir;		/// 输出目录. 空: 工作目录; 未配置工作目录时与图像同目录
+	bool latest;		/// 覆盖写入固定文件名latest.<格式>. 否则以图像文件名命名
+
+public:
+	ParamPreview() {
+		enable   = false;
+		binning  = 8;
+		stretch  = STRETCH_ASINH;
+		sigLow   = 2.0;
+		sigHigh  = 50.0;
+		format   = PREVIEW_PNG;
+		latest   = false;
+	}
+};
+
+/*!
+ * @struct ParamKernels 像素运算核的指令集
+ */
+struct ParamKernels {
+	string isa;		/// 指令集: auto, scalar, sse2, avx2, avx512. auto: 按CPU支持的最高指令集选择
+
+public:
+	ParamKernels() {
+		isa = "auto";
+	}
 };
 
 struct ParamOutput {
 	bool rsltInter;	/// 输出中间结果, 包括滤波后背景、噪声等
 	bool rsltFinal;	/// 输出处理结果, 包括所有被识别目标
 	bool wcsAlone;	/// 输出单独的WCS文件. 否则写入原始FITS头
+	string pathManifest;	/// 结果清单目录. 非空时记录各帧处理结果, 重新处理时跳过仍然有效的环节
+	/* 目标星表 */
+	string catDir;			/// 星表目录. 空: 工作目录
+	bool catFits;			/// 输出FITS二进制表
+	bool catColumnar;		/// 输出列存储文件
+	bool catNight;			/// 同一观测夜的结果追加到一个文件. 否则每帧一个文件
+	unsigned catSyncFrames;	/// 每写入该帧数调用一次fsync. 0: 不调用, 由系统决定写盘时机
+	unsigned catQueue;		/// 待写队列上限, 量纲: 帧
+	/* 中间结果 */
+	float interQuantize;	/// 浮点网格量化级别: 正值为噪声的分数, 负值为绝对步长
+	unsigned interThreads;	/// 写线程数
+	unsigned interQueue;	/// 待写队列上限, 量纲: 帧
+	/* 检测库 */
+	bool detStore;			/// 将天文定位后的目标追加到整夜检测库
+	unsigned detOrder;		/// 检测库天区划分的HEALPix阶数
+
+public:
+	ParamOutput() {
+		rsltInter     = false;
+		rsltFinal     = false;
+		wcsAlone      = false;
+		catFits       = true;
+		catColumnar   = false;
+		catNight      = false;
+		catSyncFrames = 0;
+		catQueue      = 16;
+		interQuantize = 16.0;
+		interThreads  = 2;
+		interQueue    = 4;
+		detStore      = false;
+		detOrder      = 9;
+	}
 };
 
 struct ParamCorrectClock {
@@ -77,6 +360,17 @@ struct Parameter {
 	ParamBackground backStat;		// 统计背景
 	ParamExtractSignal sigExtract;	// 信号提取参数
 	ParamMeasureBlob blobMeasure;	// 测量目标
+	ParamStreak streak;				// 拖线检测
+	ParamCatalog catalog;			// 参考星表
+	ParamAstrometry astrometry;		// 天文定位
+	ParamMotion motion;				// 运动目标关联
+	ParamSynTrack synTrack;			// 合成跟踪
+	ParamDiff diff;					// 差分成像
+	ParamBudget budget;				// 资源预算
+	ParamTrace trace;				// 性能跟踪
+	ParamLog log;					// 工作日志
+	ParamPreview preview;			// 快视预览图
+	ParamKernels kernels;			// 像素运算核
 	ParamOutput output;				// 目标输出参数
 
 	/* CMOS相机时间修正参数 */
@@ -100,6 +394,7 @@ public:
 		node1.add("Astrometry.<xmlattr>.Enable",  false);
 		node1.add("Photometry.<xmlattr>.Enable",  false);
 		node1.add("Motion.<xmlattr>.Enable",      false);
+		node1.add("Difference.<xmlattr>.Enable",  false);
 
 		ptree& node2 = nodes.add("PreProcess", "");
 		node2.add("Work.<xmlattr>.Dir",  "");
@@ -107,6 +402,8 @@ public:
 		node2.add("DARK.<xmlattr>.Path", "");
 		node2.add("FLAT.<xmlattr>.Path", "");
 		node2.add("RemoveBadPixel.<xmlattr>.Enable", true);
+		node2.add("Band.<xmlattr>.Rows",           0);
+		node2.add("Band.<xmlattr>.MinMegaPixels",  256);
 
 		ptree& node3 = nodes.add("BackGround",   "");
 		node3.add("Global.<xmlattr>.Enable",     false);
@@ -117,17 +414,112 @@ public:
 		node3.add("Filter.<xmlattr>.Y",          3);
 
 		ptree& node4 = nodes.add("ResolveSignal",    "");
-		node4.add("Filter.<xmlattr>.Mode",     0);
-		node4.add("SNR.<xmlattr>.Minimum",     1.5);
+		node4.add("<xmlattr>.Enable",          false);
+		node4.add("SNR.<xmlattr>.Minimum",     3.0);
 
 		ptree& node5 = nodes.add("BlobMesurement", "");
-		node5.add("PixelNumber.<xmlattr>.Minimum", 1);
-		node5.add("PixelNumber.<xmlattr>.Maximum", 4);
+		node5.add("PixelNumber.<xmlattr>.Minimum", 5);
+		node5.add("PixelNumber.<xmlattr>.Maximum", 0);
+		node5.add("SNR.<xmlattr>.Minimum",         5.0);
+
+		ptree& node12 = nodes.add("Streak", "");
+		node12.add("<xmlattr>.Enable",             false);
+		node12.add("Hough.<xmlattr>.Binning",      4);
+		node12.add("Hough.<xmlattr>.SNR",          3.0);
+		node12.add("Hough.<xmlattr>.Threads",      0);
+		node12.add("Length.<xmlattr>.Minimum",     100.0);
+		node12.add("Length.<xmlattr>.MaxGap",      16.0);
+		node12.add("Mask.<xmlattr>.Extend",        3.0);
+		node12.add("Count.<xmlattr>.Maximum",      16);
+
+		ptree& node8 = nodes.add("Catalog", "");
+		node8.add("<xmlattr>.Path",     "");
+		node8.add("<xmlattr>.MagLimit", 16.0);
+
+		ptree& node9 = nodes.add("Astrometry", "");
+		node9.add("Index.<xmlattr>.Path",          "");
+		node9.add("Scale.<xmlattr>.Low",           0.0);
+		node9.add("Scale.<xmlattr>.High",          0.0);
+		node9.add("Stars.<xmlattr>.Solve",         30);
+		node9.add("Match.<xmlattr>.Minimum",       10);
+		node9.add("Match.<xmlattr>.Radius",        3.0);
+		node9.add("Time.<xmlattr>.Limit",          1.0);
+		node9.add("Warm.<xmlattr>.Enable",         true);
+		node9.add("Warm.<xmlattr>.Radius",         20.0);
+		node9.add("SIP.<xmlattr>.Order",           3);
+
+		ptree& node10 = nodes.add("Motion", "");
+		node10.add("Frames.<xmlattr>.Depth",       5);
+		node10.add("Frames.<xmlattr>.Minimum",     3);
+		node10.add("Rate.<xmlattr>.Min",           0.002);
+		node10.add("Rate.<xmlattr>.Max",           0.5);
+		node10.add("Radius.<xmlattr>.Static",      1.5);
+		node10.add("Radius.<xmlattr>.Link",        2.0);
+
+		ptree& node11 = nodes.add("SyntheticTracking", "");
+		node11.add("<xmlattr>.Enable",             false);
+		node11.add("Frames.<xmlattr>.Count",       16);
+		node11.add("Rate.<xmlattr>.Max",           0.05);
+		node11.add("Rate.<xmlattr>.Step",          1.0);
+		node11.add("Detect.<xmlattr>.SNR",         6.0);
+		node11.add("Detect.<xmlattr>.MaskRadius",  4.0);
+		node11.add("Compute.<xmlattr>.Tile",       512);
+		node11.add("Compute.<xmlattr>.CacheMB",    1024);
+		node11.add("Compute.<xmlattr>.Threads",    0);
+
+		ptree& node13 = nodes.add("DifferenceImaging", "");
+		node13.add("Reference.<xmlattr>.Dir",      "");
+		node13.add("Reference.<xmlattr>.Frames",   5);
+		node13.add("Field.<xmlattr>.Tolerance",    0.1);
+		node13.add("Detect.<xmlattr>.SNR",         5.0);
+		node13.add("Detect.<xmlattr>.Radius",      1.0);
+		node13.add("Detect.<xmlattr>.MaxCount",    1000);
+		node13.add("Compute.<xmlattr>.Threads",    0);
+
+		ptree& node14 = nodes.add("Budget", "");
+		node14.add("Frames.<xmlattr>.InFlight",    16);
+		node14.add("Memory.<xmlattr>.MB",          0);
+		node14.add("Memory.<xmlattr>.HugePage",    false);
+
+		ptree& node15 = nodes.add("Trace", "");
+		node15.add("<xmlattr>.Enable",             false);
+		node15.add("Metrics.<xmlattr>.Path",       "");
+		node15.add("Events.<xmlattr>.Path",        "");
+
+		ptree& node16 = nodes.add("Log", "");
+		node16.add("<xmlattr>.Async",              false);
+		node16.add("<xmlattr>.Level",              0);
+		node16.add("<xmlattr>.RateLimit",          0);
+
+		ptree& node17 = nodes.add("Preview", "");
+		node17.add("<xmlattr>.Enable",             false);
+		node17.add("Binning.<xmlattr>.Factor",     8);
+		node17.add("Stretch.<xmlattr>.Mode",       2);
+		node17.add("Stretch.<xmlattr>.Low",        2.0);
+		node17.add("Stretch.<xmlattr>.High",       50.0);
+		node17.add("File.<xmlattr>.Format",        2);
+		node17.add("File.<xmlattr>.Dir",           "");
+		node17.add("File.<xmlattr>.Latest",        false);
+
+		ptree& node18 = nodes.add("Kernels", "");
+		node18.add("<xmlattr>.ISA",                "auto");
 
 		ptree& node6 = nodes.add("Output", "");
 		node6.add("Result.<xmlattr>.Final",        true);
 		node6.add("Result.<xmlattr>.Intermediate", true);
 		node6.add("WCS.<xmlattr>.Alone",           true);
+		node6.add("Manifest.<xmlattr>.Dir",        "");
+		node6.add("Catalog.<xmlattr>.Dir",         "");
+		node6.add("Catalog.<xmlattr>.FITS",        true);
+		node6.add("Catalog.<xmlattr>.Columnar",    false);
+		node6.add("Catalog.<xmlattr>.Night",       false);
+		node6.add("Catalog.<xmlattr>.SyncFrames",  0);
+		node6.add("Catalog.<xmlattr>.Queue",       16);
+		node6.add("Intermediate.<xmlattr>.Quantize", 16.0);
+		node6.add("Intermediate.<xmlattr>.Threads",  2);
+		node6.add("Intermediate.<xmlattr>.Queue",    4);
+		node6.add("DetectionStore.<xmlattr>.Enable", false);
+		node6.add("DetectionStore.<xmlattr>.Order",  9);
 
 		ptree& node7 = nodes.add("ClockCorrect-for-CMOS",  "");
 		node7.add("<xmlattr>.Enable",     false);
@@ -158,6 +550,7 @@ public:
 					funcs.useAstrometry = child.second.get("Astrometry.<xmlattr>.Enable",  false);
 					funcs.usePhotometry = child.second.get("Photometry.<xmlattr>.Enable",  false);
 					funcs.useMotion     = child.second.get("Motion.<xmlattr>.Enable",      false);
+					funcs.useDiff       = child.second.get("Difference.<xmlattr>.Enable",  false);
 				}
 				else if (boost::iequals(child.first, "PreProcess")) {
 					preProc.pathWork = child.second.get("Work.<xmlattr>.Dir",  "");
@@ -165,6 +558,8 @@ public:
 					preProc.pathDark = child.second.get("DARK.<xmlattr>.Path", "");
 					preProc.pathFlat = child.second.get("FLAT.<xmlattr>.Path", "");
 					preProc.badPixRemove = child.second.get("RemoveBadPixel.<xmlattr>.Enable", false);
+					preProc.bandRows     = child.second.get("Band.<xmlattr>.Rows",          0);
+					preProc.bandMinMPix  = child.second.get("Band.<xmlattr>.MinMegaPixels", 256);
 				}
 				else if (boost::iequals(child.first, "BackGround")) {
 					backStat.useGlobal   = child.second.get("Global.<xmlattr>.Enable",     false);
@@ -180,20 +575,143 @@ public:
 					if (backStat.filterY < 1)      backStat.filterY = 1;
 				}
 				else if (boost::iequals(child.first, "ResolveSignal")) {
-					sigExtract.modeFilter = child.second.get("Filter.<xmlattr>.Mode",     0);
-					sigExtract.sigMin     = child.second.get("SNR.<xmlattr>.Minimum",     1.5);
+					sigExtract.enable     = child.second.get("<xmlattr>.Enable",          false);
+					sigExtract.sigMin     = child.second.get("SNR.<xmlattr>.Minimum",     3.0);
 					if (sigExtract.sigMin < 1.0) sigExtract.sigMin = 1.0;
+					sigExtract.modeFilter = child.second.get("Filter.<xmlattr>.Mode", 0);
 				}
 				else if (boost::iequals(child.first, "BlobMesurement")) {
-					blobMeasure.pixMin = child.second.get("PixelNumber.<xmlattr>.Minimum",  1);
+					blobMeasure.pixMin = child.second.get("PixelNumber.<xmlattr>.Minimum",  5);
 					blobMeasure.pixMax = child.second.get("PixelNumber.<xmlattr>.Maximum",  0);
+					blobMeasure.snrMin = child.second.get("SNR.<xmlattr>.Minimum",          5.0);
 
 					if (blobMeasure.pixMin == 0) blobMeasure.pixMin = 1;
 				}
+				else if (boost::iequals(child.first, "Streak")) {
+					streak.enable    = child.second.get("<xmlattr>.Enable",         false);
+					streak.binning   = child.second.get("Hough.<xmlattr>.Binning",  4);
+					streak.snr       = child.second.get("Hough.<xmlattr>.SNR",      3.0);
+					streak.threads   = child.second.get("Hough.<xmlattr>.Threads",  0);
+					streak.lenMin    = child.second.get("Length.<xmlattr>.Minimum", 100.0);
+					streak.gapMax    = child.second.get("Length.<xmlattr>.MaxGap",  16.0);
+					streak.maskWidth = child.second.get("Mask.<xmlattr>.Extend",    3.0);
+					streak.maxCount  = child.second.get("Count.<xmlattr>.Maximum",  16);
+
+					if (streak.binning < 1)   streak.binning = 1;
+					if (streak.binning > 16)  streak.binning = 16;
+					if (streak.lenMin < streak.binning * 8.0) streak.lenMin = streak.binning * 8.0;
+				}
+				else if (boost::iequals(child.first, "Catalog")) {
+					catalog.pathCatalog = child.second.get("<xmlattr>.Path",     "");
+					catalog.magLimit    = child.second.get("<xmlattr>.MagLimit", 16.0);
+				}
+				else if (boost::iequals(child.first, "Astrometry")) {
+					astrometry.pathIndex   = child.second.get("Index.<xmlattr>.Path",    "");
+					astrometry.scaleLow    = child.second.get("Scale.<xmlattr>.Low",     0.0);
+					astrometry.scaleHigh   = child.second.get("Scale.<xmlattr>.High",    0.0);
+					astrometry.starSolve   = child.second.get("Stars.<xmlattr>.Solve",   30);
+					astrometry.matchMin    = child.second.get("Match.<xmlattr>.Minimum", 10);
+					astrometry.matchRadius = child.second.get("Match.<xmlattr>.Radius",  3.0);
+					astrometry.timeLimit   = child.second.get("Time.<xmlattr>.Limit",    1.0);
+					astrometry.warmStart   = child.second.get("Warm.<xmlattr>.Enable",   true);
+					astrometry.warmRadius  = child.second.get("Warm.<xmlattr>.Radius",   20.0);
+					astrometry.sipOrder    = child.second.get("SIP.<xmlattr>.Order",     3);
+
+					if (astrometry.starSolve < 5)     astrometry.starSolve = 5;
+					if (astrometry.starSolve > 50)    astrometry.starSolve = 50;
+					if (astrometry.matchMin < 5)      astrometry.matchMin = 5;
+					if (astrometry.matchRadius <= 0.0) astrometry.matchRadius = 3.0;
+					if (astrometry.warmRadius < astrometry.matchRadius) astrometry.warmRadius = astrometry.matchRadius;
+					if (astrometry.sipOrder > 5)      astrometry.sipOrder = 5;
+				}
+				else if (boost::iequals(child.first, "Motion")) {
+					motion.depth     = child.second.get("Frames.<xmlattr>.Depth",   5);
+					motion.minFrames = child.second.get("Frames.<xmlattr>.Minimum", 3);
+					motion.rateMin   = child.second.get("Rate.<xmlattr>.Min",       0.002);
+					motion.rateMax   = child.second.get("Rate.<xmlattr>.Max",       0.5);
+					motion.rStatic   = child.second.get("Radius.<xmlattr>.Static",  1.5);
+					motion.rLink     = child.second.get("Radius.<xmlattr>.Link",    2.0);
+
+					if (motion.minFrames < 3)            motion.minFrames = 3;
+					if (motion.depth < motion.minFrames) motion.depth = motion.minFrames;
+					if (motion.rateMax <= motion.rateMin) motion.rateMax = motion.rateMin * 10.0 + 0.1;
+					if (motion.rLink <= 0.0)             motion.rLink = 2.0;
+				}
+				else if (boost::iequals(child.first, "SyntheticTracking")) {
+					synTrack.enable  = child.second.get("<xmlattr>.Enable",            false);
+					synTrack.frames  = child.second.get("Frames.<xmlattr>.Count",      16);
+					synTrack.rateMax = child.second.get("Rate.<xmlattr>.Max",          0.05);
+					synTrack.step    = child.second.get("Rate.<xmlattr>.Step",         1.0);
+					synTrack.snr     = child.second.get("Detect.<xmlattr>.SNR",        6.0);
+					synTrack.rMask   = child.second.get("Detect.<xmlattr>.MaskRadius", 4.0);
+					synTrack.tile    = child.second.get("Compute.<xmlattr>.Tile",      512);
+					synTrack.cacheMB = child.second.get("Compute.<xmlattr>.CacheMB",   1024);
+					synTrack.threads = child.second.get("Compute.<xmlattr>.Threads",   0);
+
+					if (synTrack.frames < 2)    synTrack.frames = 2;
+					if (synTrack.step <= 0.0)   synTrack.step = 1.0;
+					if (synTrack.tile < 64)     synTrack.tile = 64;
+				}
+				else if (boost::iequals(child.first, "DifferenceImaging")) {
+					diff.pathRef   = child.second.get("Reference.<xmlattr>.Dir",    "");
+					diff.refFrames = child.second.get("Reference.<xmlattr>.Frames", 5);
+					diff.fieldTol  = child.second.get("Field.<xmlattr>.Tolerance",  0.1);
+					diff.snr       = child.second.get("Detect.<xmlattr>.SNR",       5.0);
+					diff.rMatch    = child.second.get("Detect.<xmlattr>.Radius",    1.0);
+					diff.maxCount  = child.second.get("Detect.<xmlattr>.MaxCount",  1000);
+					diff.threads   = child.second.get("Compute.<xmlattr>.Threads",  0);
+
+					if (diff.refFrames < 1)    diff.refFrames = 1;
+					if (diff.fieldTol <= 0.0)  diff.fieldTol = 0.1;
+					if (diff.rMatch <= 0.0)    diff.rMatch = 1.0;
+				}
+				else if (boost::iequals(child.first, "Budget")) {
+					budget.frames   = child.second.get("Frames.<xmlattr>.InFlight",   16);
+					budget.memoryMB = child.second.get("Memory.<xmlattr>.MB",         0);
+					budget.hugePage = child.second.get("Memory.<xmlattr>.HugePage",   false);
+				}
+				else if (boost::iequals(child.first, "Trace")) {
+					trace.enable      = child.second.get("<xmlattr>.Enable",          false);
+					trace.pathMetrics = child.second.get("Metrics.<xmlattr>.Path",    "");
+					trace.pathEvents  = child.second.get("Events.<xmlattr>.Path",     "");
+				}
+				else if (boost::iequals(child.first, "Log")) {
+					log.async     = child.second.get("<xmlattr>.Async",      false);
+					log.level     = child.second.get("<xmlattr>.Level",      0);
+					log.rateLimit = child.second.get("<xmlattr>.RateLimit",  0);
+					if (log.level < 0) log.level = 0;
+					if (log.level > 2) log.level = 2;
+				}
+				else if (boost::iequals(child.first, "Preview")) {
+					preview.enable  = child.second.get("<xmlattr>.Enable",         false);
+					preview.binning = child.second.get("Binning.<xmlattr>.Factor", 8);
+					preview.stretch = child.second.get("Stretch.<xmlattr>.Mode",   2);
+					preview.sigLow  = child.second.get("Stretch.<xmlattr>.Low",    2.0);
+					preview.sigHigh = child.second.get("Stretch.<xmlattr>.High",   50.0);
+					preview.format  = child.second.get("File.<xmlattr>.Format",    2);
+					preview.pathDir = child.second.get("File.<xmlattr>.Dir",       "");
+					preview.latest  = child.second.get("File.<xmlattr>.Latest",    false);
+					if (!preview.binning) preview.binning = 1;
+				}
+				else if (boost::iequals(child.first, "Kernels")) {
+					kernels.isa = child.second.get("<xmlattr>.ISA", "auto");
+				}
 				else if (boost::iequals(child.first, "Output")) {
 					output.rsltFinal = child.second.get("Result.<xmlattr>.Final",         false);
 					output.rsltInter = child.second.get("Result.<xmlattr>.Intermediate",  false);
 					output.wcsAlone  = child.second.get("WCS.<xmlattr>.Alone",            false);
+					output.pathManifest = child.second.get("Manifest.<xmlattr>.Dir",      "");
+					output.catDir      = child.second.get("Catalog.<xmlattr>.Dir",        "");
+					output.catFits     = child.second.get("Catalog.<xmlattr>.FITS",       true);
+					output.catColumnar = child.second.get("Catalog.<xmlattr>.Columnar",   false);
+					output.catNight    = child.second.get("Catalog.<xmlattr>.Night",      false);
+					output.catSyncFrames = child.second.get("Catalog.<xmlattr>.SyncFrames", 0);
+					output.catQueue      = child.second.get("Catalog.<xmlattr>.Queue",      16);
+					output.interQuantize = child.second.get("Intermediate.<xmlattr>.Quantize", 16.0);
+					output.interThreads  = child.second.get("Intermediate.<xmlattr>.Threads",  2);
+					output.interQueue    = child.second.get("Intermediate.<xmlattr>.Queue",    4);
+					output.detStore      = child.second.get("DetectionStore.<xmlattr>.Enable", false);
+					output.detOrder      = child.second.get("DetectionStore.<xmlattr>.Order",  9);
 				}
 				else if (boost::iequals(child.first, "Clock-Correct-For-CMOS")) {
 					clockCorrect.correct = child.second.get("<xmlattr>.Enable",     false);
@@ -0,0 +1,150 @@
+/*!
+ * @file SpatialHash.hpp 二维平面散列网格索引
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * - 与GridIndex相同的链表结构, 但网格以散列表存储, 无需预先确定坐标范围
+ * - 用于切平面坐标上持续增长的点集, 如静态源星表和运动目标候体
+ */
+
+#ifndef SPATIALHASH_HPP_
+#define SPATIALHASH_HPP_
+
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+#include <unordered_map>
+
+struct SpatialHash {
+protected:
+	typedef std::unordered_map<uint64_t, int> CellMap;
+
+protected:
+	double cell;		/// 网格尺寸
+	CellMap head;		/// 网格中首个点的索引
+	std::vector<int> next;	/// 同一网格中下一个点的索引. -1: 末尾
+	std::vector<double> px, py;	/// 点坐标
+
+public:
+	SpatialHash() {
+		cell = 1.0;
+	}
+
+public:
+	/*!
+	 * @brief 清除所有点并设置网格尺寸
+	 * @param size  网格尺寸. 通常等于查询半径
+	 */
+	void Reset(double size) {
+		cell = size > 0.0 ? size : 1.0;
+		head.clear();
+		next.clear();
+		px.clear();
+		py.clear();
+	}
+
+	/*!
+	 * @brief 加入点. 点的索引与加入顺序一致
+	 * @return
+	 * 点索引
+	 */
+	int Add(double x, double y) {
+		int id = int(px.size());
+		uint64_t k = key(cell_of(x), cell_of(y));
+		std::pair<CellMap::iterator, bool> rslt = head.insert(CellMap::value_type(k, id));
+		px.push_back(x);
+		py.push_back(y);
+		next.push_back(rslt.second ? -1 : rslt.first->second);
+		rslt.first->second = id;
+		return id;
+	}
+
+	/*!
+	 * @brief 查找与(x, y)最近的点
+	 * @param x    X坐标
+	 * @param y    Y坐标
+	 * @param r    搜索半径
+	 * @param d2   最近点的距离平方
+	 * @return
+	 * 最近点索引. -1: 半径内无点
+	 */
+	int Nearest(double x, double y, double r, double* d2 = NULL) const {
+		int best(-1), i, j, id;
+		int i0 = cell_of(x - r), i1 = cell_of(x + r);
+		int j0 = cell_of(y - r), j1 = cell_of(y + r);
+		double r2 = r * r, dx, dy, t;
+
+		for (j = j0; j <= j1; ++j) {
+			for (i = i0; i <= i1; ++i) {
+				CellMap::const_iterator it = head.find(key(i, j));
+				if (it == head.end()) continue;
+				for (id = it->second; id >= 0; id = next[id]) {
+					dx = px[id] - x;
+					dy = py[id] - y;
+					if ((t = dx * dx + dy * dy) <= r2) {
+						r2   = t;
+						best = id;
+					}
+				}
+			}
+		}
+		if (d2) *d2 = r2;
+		return best;
+	}
+
+	/*!
+	 * @brief 查找半径内的所有点
+	 * @param x    X坐标
+	 * @param y    Y坐标
+	 * @param r    搜索半径
+	 * @param ids  点索引
+	 */
+	void Within(double x, double y, double r, std::vector<int>& ids) const {
+		int i, j, id;
+		int i0 = cell_of(x - r), i1 = cell_of(x + r);
+		int j0 = cell_of(y - r), j1 = cell_of(y + r);
+		double r2 = r * r, dx, dy;
+
+		ids.clear();
+		for (j = j0; j <= j1; ++j) {
+			for (i = i0; i <= i1; ++i) {
+				CellMap::const_iterator it = head.find(key(i, j));
+				if (it == head.end()) continue;
+				for (id = it->second; id >= 0; id = next[id]) {
+					dx = px[id] - x;
+					dy = py[id] - y;
+					if (dx * dx + dy * dy <= r2) ids.push_back(id);
+				}
+			}
+		}
+	}
+
+	/*!
+	 * @brief 点坐标
+	 */
+	double X(int id) const {
+		return px[id];
+	}
+
+	double Y(int id) const {
+		return py[id];
+	}
+
+	/*!
+	 * @brief 点数量
+	 */
+	int Size() const {
+		return int(px.size());
+	}
+
+protected:
+	int cell_of(double v) const {
+		return int(floor(v / cell));
+	}
+
+	static uint64_t key(int i, int j) {
+		return (uint64_t(uint32_t(i)) << 32) | uint32_t(j);
+	}
+};
+
+#endif /* SPATIALHASH_HPP_ */
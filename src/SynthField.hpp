@@ -0,0 +1,244 @@
+/*!
+ * @file SynthField.hpp 合成星场图像: 用于性能评估和回归测试
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * - 确定性: 相同参数和帧序号生成相同图像. 星表由种子决定, 噪声和宇宙线由种子和帧序号决定
+ * - 成分: 天空背景及线性梯度、高斯轮廓恒星、热像素、宇宙线、卫星拖线、匀速运动目标、读出和泊松噪声
+ * - 运动目标的位置随帧序号线性变化, 可用于运动关联和合成跟踪
+ * - 静态函数FillNoise、AddPSF和AddLine供各评估工具按自身的真值生成图像
+ */
+
+#ifndef SYNTHFIELD_HPP_
+#define SYNTHFIELD_HPP_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <random>
+#include <vector>
+
+/*!
+ * @struct SynthParam 合成参数
+ */
+struct SynthParam {
+	unsigned width, height;	/// 图像尺寸
+	uint32_t seed;		/// 随机种子
+	double density;		/// 恒星密度, 量纲: 颗/百万像素
+	double fwhm;		/// 点扩散函数半高全宽, 量纲: 像素
+	double sky;			/// 天空背景, 量纲: ADU
+	double gradX, gradY;/// 背景梯度: 全幅变化量与天空背景之比
+	double gain;		/// 增益, 量纲: e-/ADU. 用于泊松噪声
+	double readNoise;	/// 读出噪声, 量纲: ADU
+	double magBright;	/// 最亮恒星的峰值信噪比
+	unsigned hot;		/// 热像素数量, 量纲: 个/百万像素
+	unsigned cosmic;	/// 每帧宇宙线数量, 量纲: 个/百万像素
+	unsigned streaks;	/// 每帧卫星拖线数量
+	unsigned movers;	/// 运动目标数量
+	double moverRate;	/// 运动目标速度, 量纲: 像素/帧
+
+public:
+	SynthParam() {
+		width = height = 4096;
+		seed      = 1;
+		density   = 1000.0;
+		fwhm      = 2.5;
+		sky       = 1000.0;
+		gradX     = 0.05;
+		gradY     = 0.02;
+		gain      = 1.5;
+		readNoise = 5.0;
+		magBright = 2000.0;
+		hot       = 10;
+		cosmic    = 2;
+		streaks   = 1;
+		movers    = 20;
+		moverRate = 2.0;
+	}
+};
+
+struct SynthField {
+protected:
+	/*!
+	 * @struct SynthStar 恒星或运动目标
+	 */
+	struct SynthStar {
+		double x, y;	/// 位置. 运动目标: 首帧位置
+		double vx, vy;	/// 速度, 量纲: 像素/帧
+		double peak;	/// 峰值, 量纲: ADU
+	};
+	typedef std::vector<SynthStar> StarVec;
+
+protected:
+	SynthParam param;	/// 合成参数
+	StarVec stars;		/// 恒星
+	StarVec movers;		/// 运动目标
+	std::vector<uint32_t> hots;	/// 热像素位置
+	double sigma;		/// 高斯轮廓标准差
+
+public:
+	SynthField() {
+		sigma = 1.0;
+	}
+
+public:
+	/*!
+	 * @brief 设置参数并生成星表
+	 */
+	void Reset(const SynthParam& par) {
+		param = par;
+		sigma = param.fwhm / 2.3548;
+		stars.clear();
+		movers.clear();
+		hots.clear();
+
+		std::mt19937 rng(param.seed);
+		std::uniform_real_distribution<double> ux(0.0, param.width), uy(0.0, param.height), u01(0.0, 1.0);
+		double mpix = double(param.width) * param.height * 1E-6;
+		double noise = sky_noise();
+		unsigned n = unsigned(param.density * mpix), i;
+		// 亮度按幂律分布: 暗星多于亮星
+		for (i = 0; i < n; ++i) {
+			SynthStar star;
+			star.x  = ux(rng);
+			star.y  = uy(rng);
+			star.vx = star.vy = 0.0;
+			star.peak = noise * param.magBright * pow(10.0, -3.0 * u01(rng));
+			stars.push_back(star);
+		}
+		for (i = 0; i < param.movers; ++i) {
+			SynthStar star;
+			double theta = u01(rng) * 2.0 * M_PI;
+			star.x  = ux(rng);
+			star.y  = uy(rng);
+			star.vx = param.moverRate * cos(theta);
+			star.vy = param.moverRate * sin(theta);
+			star.peak = noise * (5.0 + 45.0 * u01(rng));
+			movers.push_back(star);
+		}
+		n = unsigned(param.hot * mpix);
+		std::uniform_int_distribution<uint32_t> upix(0, param.width * param.height - 1);
+		for (i = 0; i < n; ++i) hots.push_back(upix(rng));
+	}
+
+	/*!
+	 * @brief 生成单帧图像
+	 * @param frame  帧序号
+	 * @param data   图像存储区, 尺寸为width×height
+	 */
+	void Generate(unsigned frame, float* data) {
+		unsigned w(param.width), h(param.height), x, y;
+		std::mt19937 rng(param.seed * 1000003U + frame);
+		std::normal_distribution<float> gauss(0.0f, 1.0f);
+		std::uniform_real_distribution<double> u01(0.0, 1.0);
+
+		// 背景、梯度和噪声. 泊松噪声以天空背景处的高斯近似
+		float noise = float(sky_noise());
+		for (y = 0; y < h; ++y) {
+			float* row = data + size_t(y) * w;
+			float by = float(param.sky * (1.0 + param.gradY * (double(y) / h - 0.5)));
+			float dx = float(param.sky * param.gradX / w);
+			for (x = 0; x < w; ++x) row[x] = by + dx * (float(x) - 0.5f * w) + noise * gauss(rng);
+		}
+		for (StarVec::iterator it = stars.begin(); it != stars.end(); ++it)
+			add_psf(data, it->x, it->y, it->peak);
+		for (StarVec::iterator it = movers.begin(); it != movers.end(); ++it)
+			add_psf(data, it->x + it->vx * frame, it->y + it->vy * frame, it->peak);
+		for (std::vector<uint32_t>::iterator it = hots.begin(); it != hots.end(); ++it)
+			data[*it] += float(param.sky * 20.0);
+
+		// 宇宙线: 1-3像素的尖锐事件
+		double mpix = double(w) * h * 1E-6;
+		unsigned n = unsigned(param.cosmic * mpix + 0.5), i;
+		for (i = 0; i < n; ++i) {
+			unsigned cx = unsigned(u01(rng) * (w - 2)), cy = unsigned(u01(rng) * (h - 2));
+			unsigned len = 1 + unsigned(u01(rng) * 3.0);
+			float amp = float(noise * (50.0 + 200.0 * u01(rng)));
+			for (unsigned k = 0; k < len; ++k) data[size_t(cy) * w + cx + k] += amp;
+		}
+		// 卫星拖线: 贯穿视场的直线
+		for (i = 0; i < param.streaks; ++i) {
+			double x1 = u01(rng) * w, y1 = 0.0, x2 = u01(rng) * w, y2 = h - 1.0;
+			double len = sqrt((x2 - x1) * (x2 - x1) + (y2 - y1) * (y2 - y1));
+			double amp = noise * (3.0 + 7.0 * u01(rng));
+			for (double t = 0.0; t < len; t += 0.5) {
+				double px = x1 + (x2 - x1) * t / len, py = y1 + (y2 - y1) * t / len;
+				for (int d = -1; d <= 1; ++d) {
+					int ix = int(px) + d, iy = int(py);
+					if (ix >= 0 && ix < int(w) && iy >= 0 && iy < int(h))
+						data[size_t(iy) * w + ix] += float(amp * 0.5 * exp(-0.5 * d * d));
+				}
+			}
+		}
+	}
+
+	/*!
+	 * @brief 曝光起始时间: 首帧为2021-05-01T12:00:00, 帧间隔10秒
+	 */
+	static void DateObs(unsigned frame, char* buff) {
+		unsigned sec = 43200 + frame * 10;
+		sprintf(buff, "2021-05-%02uT%02u:%02u:%02u.000", 1 + sec / 86400, (sec / 3600) % 24, (sec / 60) % 60, sec % 60);
+	}
+
+	/*!
+	 * @brief 天空背景处的噪声, 量纲: ADU
+	 */
+	double sky_noise() const {
+		return sqrt(param.sky / param.gain + param.readNoise * param.readNoise);
+	}
+
+	/*!
+	 * @brief 以背景和高斯噪声填充图像
+	 * @param back   背景
+	 * @param noise  噪声标准差
+	 */
+	static void FillNoise(float* data, size_t pixels, double back, double noise, std::mt19937& rng) {
+		std::normal_distribution<double> gauss(0.0, 1.0);
+		for (size_t k = 0; k < pixels; ++k) data[k] = float(back + noise * gauss(rng));
+	}
+
+	/*!
+	 * @brief 叠加高斯轮廓点源. 轮廓截断于4倍标准差
+	 * @param peak   峰值
+	 * @param sigma  高斯轮廓标准差, 量纲: 像素
+	 */
+	static void AddPSF(float* data, int w, int h, double cx, double cy, double peak, double sigma) {
+		int r = int(sigma * 4.0) + 1, x, y;
+		int x0 = int(cx) - r, x1 = int(cx) + r, y0 = int(cy) - r, y1 = int(cy) + r;
+		double k = -0.5 / (sigma * sigma);
+		if (x0 < 0) x0 = 0;
+		if (y0 < 0) y0 = 0;
+		if (x1 >= w) x1 = w - 1;
+		if (y1 >= h) y1 = h - 1;
+		for (y = y0; y <= y1; ++y) {
+			double dy2 = (y - cy) * (y - cy);
+			float* row = data + size_t(y) * w;
+			for (x = x0; x <= x1; ++x) row[x] += float(peak * exp(k * ((x - cx) * (x - cx) + dy2)));
+		}
+	}
+
+	/*!
+	 * @brief 叠加线状目标, 如卫星拖线. 以0.5像素间隔的点源近似
+	 * @param peak   截面峰值
+	 * @param sigma  截面高斯轮廓标准差, 量纲: 像素
+	 */
+	static void AddLine(float* data, int w, int h, double x1, double y1, double x2, double y2,
+			double peak, double sigma) {
+		double dx(x2 - x1), dy(y2 - y1), len = sqrt(dx * dx + dy * dy);
+		// 高斯轮廓的线积分使峰值放大sqrt(2pi)*sigma/0.5倍
+		double amp = peak * 0.5 / (sqrt(2.0 * M_PI) * sigma);
+		for (double u = 0.0; u <= len; u += 0.5)
+			AddPSF(data, w, h, x1 + dx * u / len, y1 + dy * u / len, amp, sigma);
+	}
+
+protected:
+	/*!
+	 * @brief 叠加本星场的高斯轮廓点源
+	 */
+	void add_psf(float* data, double cx, double cy, double peak) {
+		AddPSF(data, param.width, param.height, cx, cy, peak, sigma);
+	}
+};
+
+#endif /* SYNTHFIELD_HPP_ */
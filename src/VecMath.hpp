@@ -0,0 +1,112 @@
+/**
+ * @file VecMath.hpp 可向量化的三角函数
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * - 多项式系数取自Cephes数学库, 双精度误差约1E-16
+ * - 函数不含分支和库函数调用, 在循环中内联后可由编译器自动向量化.
+ *   GCC需要-O3 -fno-trapping-math -fno-math-errno
+ * - 定义域: sincos适用于|x| < 1E6, 超出后精度下降
+ */
+
+#ifndef VECMATH_HPP_
+#define VECMATH_HPP_
+
+#include <math.h>
+#include <float.h>
+
+namespace VecMath {
+//////////////////////////////////////////////////////////////////////////////
+/*!
+ * @brief 就近取整, 适用于|x| < 2^51
+ */
+inline double round_near(double x) {
+	const double magic = 6755399441055744.0;	// 1.5 * 2^52
+	return (x + magic) - magic;
+}
+
+/*!
+ * @brief 多项式求值: c[0] * x^n + ... + c[n]
+ */
+template <int N>
+inline double polevl(double x, const double* c) {
+	double y = c[0];
+	for (int i = 1; i <= N; ++i) y = y * x + c[i];
+	return y;
+}
+
+/*!
+ * @brief 同时计算正弦和余弦
+ * @param x  角度, 量纲: 弧度
+ * @param s  sin(x)
+ * @param c  cos(x)
+ */
+inline void sincos(double x, double& s, double& c) {
+	static const double sincof[] = {
+		 1.58962301576546568060E-10, -2.50507477628578072866E-8,
+		 2.75573136213857245213E-6,  -1.98412698295895385996E-4,
+		 8.33333333332211858878E-3,  -1.66666666666666307295E-1
+	};
+	static const double coscof[] = {
+		-1.13585365213876817300E-11,  2.08757008419747316778E-9,
+		-2.75573141792967388112E-7,   2.48015872888517045348E-5,
+		-1.38888888888730564116E-3,   4.16666666666665929218E-2
+	};
+	// 以π/2为周期约化至[-π/4, π/4]. Cody-Waite三段常数
+	const double PIO2_1 = 1.57079632673412561417E0;
+	const double PIO2_2 = 6.07710050650619224932E-11;
+	const double PIO2_3 = 2.02226624879595063154E-21;
+	double q = round_near(x * M_2_PI);
+	double r = ((x - q * PIO2_1) - q * PIO2_2) - q * PIO2_3;
+	double z = r * r;
+	double sr = r + r * z * polevl<5>(z, sincof);
+	double cr = 1.0 - 0.5 * z + z * z * polevl<5>(z, coscof);
+	// 象限: j = q mod 4, 以h = floor(j / 2)和奇偶性odd选择符号和函数
+	double j   = q - 4.0 * round_near(q * 0.25 - 0.375);
+	double h   = round_near(j * 0.5 - 0.25);
+	double odd = j - 2.0 * h;
+	double ss  = odd > 0.5 ? cr : sr;
+	double cc  = odd > 0.5 ? sr : cr;
+	s = h > 0.5 ? -ss : ss;
+	c = h + odd == 1.0 ? -cc : cc;
+}
+
+/*!
+ * @brief 四象限反正切
+ * @return
+ * atan2(y, x), 量纲: 弧度. (-π, π]
+ */
+inline double atan2(double y, double x) {
+	static const double P[] = {
+		-8.750608600031904122785E-1, -1.615753718733365076637E1,
+		-7.500855792314704667340E1,  -1.228866684490136173410E2,
+		-6.485021904942025371773E1
+	};
+	static const double Q[] = {
+		 1.0,
+		 2.485846490142306297962E1,   1.650270098316988542046E2,
+		 4.328810604912902668951E2,   4.853903996359136964868E2,
+		 1.945506571482613964425E2
+	};
+	const double MOREBITS = 6.123233995736765886130E-17;
+	double ax = fabs(x), ay = fabs(y);
+	double mn = ax < ay ? ax : ay;
+	double mx = ax < ay ? ay : ax;
+	double t  = mn / (mx > DBL_MIN ? mx : DBL_MIN);	// [0, 1]
+	// t > 0.66时以atan(t) = π/4 + atan((t - 1) / (t + 1))约化
+	// 以0/1系数代替条件选择
+	double k  = double(t > 0.66);
+	double tr = (t - k) / (1.0 + k * t);
+	double z  = tr * tr;
+	double a  = tr + tr * z * polevl<4>(z, P) / polevl<5>(z, Q);
+	// 仅以选择和取反组合各象限结果, 避免条件运算
+	a = a + k * (M_PI_4 + 0.5 * MOREBITS);
+	a = (ay > ax ? M_PI_2 : 0.0) + (ay > ax ? -a : a);
+	a = (x < 0.0 ? M_PI : 0.0) + (x < 0.0 ? -a : a);
+	return y < 0.0 ? -a : a;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+};
+
+#endif /* VECMATH_HPP_ */
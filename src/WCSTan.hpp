@@ -0,0 +1,602 @@
+/*!
+ * @file WCSTan.hpp 切平面(TAN, gnomonic)投影WCS模型, 含SIP畸变改正
+ * @version 0.2
+ * @date 2021-05
+ * @note
+ * - 像素坐标起始于0, 写入FITS头时转换为起始于1
+ * - 赤道坐标量纲: 角度
+ * - 由匹配星对以加权最小二乘拟合CD矩阵及SIP多项式
+ * - SIP约定(Shupe et al. 2005):
+ *   正向: u' = u + Σ A[p][q] u^p v^q, v' = v + Σ B[p][q] u^p v^q, 2 <= p + q <= sipOrder
+ *   逆向: u = U + Σ AP[p][q] U^p V^q, v = V + Σ BP[p][q] U^p V^q, 1 <= p + q <= sipInvOrder
+ *   其中(u, v)为相对参考点的像素坐标, (U, V)为CD矩阵逆变换得到的中间坐标
+ * - 批量转换以WCS_BATCH为块长度, 按列处理, 循环体可由编译器自动向量化
+ */
+
+#ifndef WCSTAN_HPP_
+#define WCSTAN_HPP_
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include "VecMath.hpp"
+
+#ifndef D2R
+#define D2R		0.017453292519943295	/// 角度转换为弧度
+#define R2D		57.295779513082323		/// 弧度转换为角度
+#endif
+
+#define SIP_ORDER_MAX	5		/// SIP正向多项式最高阶数
+#define SIP_DIM			(SIP_ORDER_MAX + 2)	/// SIP系数数组维度, 容纳逆向多项式
+#define WCS_BATCH		256		/// 批量转换的分块长度
+
+/*!
+ * @struct WCSTan 切平面投影
+ */
+struct WCSTan {
+	bool valid;			/// 有效性标志
+	double crval[2];	/// 参考点赤道坐标, 量纲: 角度
+	double crpix[2];	/// 参考点像素坐标
+	double cd[2][2];	/// 像素坐标至切平面坐标的转换矩阵, 量纲: 角度/像素
+	int sipOrder;		/// SIP正向多项式阶数. 小于2: 无畸变改正
+	int sipInvOrder;	/// SIP逆向多项式阶数
+	double a[SIP_DIM][SIP_DIM];		/// SIP正向系数A[p][q]
+	double b[SIP_DIM][SIP_DIM];		/// SIP正向系数B[p][q]
+	double ap[SIP_DIM][SIP_DIM];	/// SIP逆向系数AP[p][q]
+	double bp[SIP_DIM][SIP_DIM];	/// SIP逆向系数BP[p][q]
+	double rms;			/// 拟合残差, 量纲: 角秒
+	int nmatch;			/// 参与拟合的星对数量
+
+public:
+	WCSTan() {
+		valid = false;
+		crval[0] = crval[1] = 0.0;
+		crpix[0] = crpix[1] = 0.0;
+		cd[0][0] = cd[0][1] = cd[1][0] = cd[1][1] = 0.0;
+		clear_sip();
+		rms    = 0.0;
+		nmatch = 0;
+	}
+
+public:
+	/*!
+	 * @brief 计算赤道坐标在切平面上的投影
+	 * @param ra0   切点赤经, 量纲: 弧度
+	 * @param dc0   切点赤纬, 量纲: 弧度
+	 * @param ra    赤经, 量纲: 弧度
+	 * @param dc    赤纬, 量纲: 弧度
+	 * @param xi    切平面X坐标, 量纲: 弧度
+	 * @param eta   切平面Y坐标, 量纲: 弧度
+	 * @return
+	 * 坐标位于切点所在半球
+	 */
+	static bool Project(double ra0, double dc0, double ra, double dc, double& xi, double& eta) {
+		double sd0 = sin(dc0), cd0 = cos(dc0);
+		double sd  = sin(dc),  cdc = cos(dc);
+		double dra = ra - ra0;
+		double cdra = cos(dra);
+		double cosc = sd0 * sd + cd0 * cdc * cdra;
+		if (cosc <= 1E-6) return false;
+		xi  = cdc * sin(dra) / cosc;
+		eta = (cd0 * sd - sd0 * cdc * cdra) / cosc;
+		return true;
+	}
+
+	/*!
+	 * @brief 由切平面坐标计算赤道坐标
+	 * @param ra0   切点赤经, 量纲: 弧度
+	 * @param dc0   切点赤纬, 量纲: 弧度
+	 * @param xi    切平面X坐标, 量纲: 弧度
+	 * @param eta   切平面Y坐标, 量纲: 弧度
+	 * @param ra    赤经, 量纲: 弧度. [0, 2π)
+	 * @param dc    赤纬, 量纲: 弧度
+	 */
+	static void Deproject(double ra0, double dc0, double xi, double eta, double& ra, double& dc) {
+		double sd0 = sin(dc0), cd0 = cos(dc0);
+		double t = cd0 - eta * sd0;
+		ra = ra0 + atan2(xi, t);
+		dc = atan2(sd0 + eta * cd0, sqrt(xi * xi + t * t));
+		if (ra < 0.0) ra += 2.0 * M_PI;
+		else if (ra >= 2.0 * M_PI) ra -= 2.0 * M_PI;
+	}
+
+	/*!
+	 * @brief 像素坐标转换为赤道坐标
+	 * @param x   X坐标
+	 * @param y   Y坐标
+	 * @param ra  赤经, 量纲: 角度
+	 * @param dc  赤纬, 量纲: 角度
+	 */
+	void PixelToSky(double x, double y, double& ra, double& dc) const {
+		double u = x - crpix[0], v = y - crpix[1];
+		double du(0.0), dv(0.0);
+		if (sipOrder >= 2) {
+			poly(a, u, v, 2, sipOrder, du);
+			poly(b, u, v, 2, sipOrder, dv);
+		}
+		u += du;
+		v += dv;
+		double xi  = (cd[0][0] * u + cd[0][1] * v) * D2R;
+		double eta = (cd[1][0] * u + cd[1][1] * v) * D2R;
+		Deproject(crval[0] * D2R, crval[1] * D2R, xi, eta, ra, dc);
+		ra *= R2D;
+		dc *= R2D;
+	}
+
+	/*!
+	 * @brief 赤道坐标转换为像素坐标
+	 * @param ra  赤经, 量纲: 角度
+	 * @param dc  赤纬, 量纲: 角度
+	 * @param x   X坐标
+	 * @param y   Y坐标
+	 * @return
+	 * 坐标可投影至图像平面
+	 */
+	bool SkyToPixel(double ra, double dc, double& x, double& y) const {
+		double xi, eta;
+		if (!Project(crval[0] * D2R, crval[1] * D2R, ra * D2R, dc * D2R, xi, eta)) return false;
+		double det = cd[0][0] * cd[1][1] - cd[0][1] * cd[1][0];
+		if (det == 0.0) return false;
+		xi  *= R2D;
+		eta *= R2D;
+		double u = ( cd[1][1] * xi - cd[0][1] * eta) / det;
+		double v = (-cd[1][0] * xi + cd[0][0] * eta) / det;
+		double du(0.0), dv(0.0);
+		if (sipOrder >= 2) {
+			poly(ap, u, v, 1, sipInvOrder, du);
+			poly(bp, u, v, 1, sipInvOrder, dv);
+		}
+		x = crpix[0] + u + du;
+		y = crpix[1] + v + dv;
+		return true;
+	}
+
+	/*!
+	 * @brief 批量转换像素坐标为赤道坐标
+	 * @param n   坐标数量
+	 * @param x   X坐标
+	 * @param y   Y坐标
+	 * @param ra  赤经, 量纲: 角度. [0, 360)
+	 * @param dc  赤纬, 量纲: 角度
+	 */
+	void PixelToSky(int n, const double* x, const double* y, double* ra, double* dc) const {
+		double e[3][3];
+		double u[WCS_BATCH], v[WCS_BATCH], du[WCS_BATCH], dv[WCS_BATCH];
+		double pu[SIP_DIM][WCS_BATCH], pv[SIP_DIM][WCS_BATCH];
+		double c00(cd[0][0] * D2R), c01(cd[0][1] * D2R), c10(cd[1][0] * D2R), c11(cd[1][1] * D2R);
+		int i, i0, m;
+
+		tangent_basis(e);
+		for (i0 = 0; i0 < n; i0 += WCS_BATCH) {
+			m = std::min(n - i0, WCS_BATCH);
+			const double* xb = x + i0;
+			const double* yb = y + i0;
+			double* rab = ra + i0;
+			double* dcb = dc + i0;
+
+			for (i = 0; i < m; ++i) {
+				u[i] = xb[i] - crpix[0];
+				v[i] = yb[i] - crpix[1];
+			}
+			if (sipOrder >= 2) {
+				powers(m, u, sipOrder, pu);
+				powers(m, v, sipOrder, pv);
+				poly_block(m, a, pu, pv, 2, sipOrder, du);
+				poly_block(m, b, pu, pv, 2, sipOrder, dv);
+				for (i = 0; i < m; ++i) {
+					u[i] += du[i];
+					v[i] += dv[i];
+				}
+			}
+			// 切平面坐标 -> 单位矢量(未归一化) -> 赤道坐标
+			for (i = 0; i < m; ++i) {
+				double xi  = c00 * u[i] + c01 * v[i];
+				double eta = c10 * u[i] + c11 * v[i];
+				double vx  = e[0][0] + xi * e[1][0] + eta * e[2][0];
+				double vy  = e[0][1] + xi * e[1][1] + eta * e[2][1];
+				double vz  = e[0][2] + xi * e[1][2] + eta * e[2][2];
+				double t   = VecMath::atan2(vy, vx);
+				rab[i] = (t + (t < 0.0 ? 2.0 * M_PI : 0.0)) * R2D;
+				dcb[i] = VecMath::atan2(vz, sqrt(vx * vx + vy * vy)) * R2D;
+			}
+		}
+	}
+
+	/*!
+	 * @brief 批量转换赤道坐标为像素坐标
+	 * @param n   坐标数量
+	 * @param ra  赤经, 量纲: 角度
+	 * @param dc  赤纬, 量纲: 角度
+	 * @param x   X坐标. 无法投影时为NAN
+	 * @param y   Y坐标. 无法投影时为NAN
+	 */
+	void SkyToPixel(int n, const double* ra, const double* dc, double* x, double* y) const {
+		double e[3][3];
+		double u[WCS_BATCH], v[WCS_BATCH], w[WCS_BATCH], du[WCS_BATCH], dv[WCS_BATCH];
+		double pu[SIP_DIM][WCS_BATCH], pv[SIP_DIM][WCS_BATCH];
+		double det = cd[0][0] * cd[1][1] - cd[0][1] * cd[1][0];
+		double i00, i01, i10, i11;
+		int i, i0, m;
+
+		if (det == 0.0) {
+			for (i = 0; i < n; ++i) x[i] = y[i] = NAN;
+			return;
+		}
+		i00 =  cd[1][1] / det * R2D;
+		i01 = -cd[0][1] / det * R2D;
+		i10 = -cd[1][0] / det * R2D;
+		i11 =  cd[0][0] / det * R2D;
+		tangent_basis(e);
+		for (i0 = 0; i0 < n; i0 += WCS_BATCH) {
+			m = std::min(n - i0, WCS_BATCH);
+			const double* rab = ra + i0;
+			const double* dcb = dc + i0;
+			double* xb = x + i0;
+			double* yb = y + i0;
+
+			// 赤道坐标 -> 单位矢量 -> 切平面坐标 -> 中间坐标
+			for (i = 0; i < m; ++i) {
+				double sa, ca, sd, cdc;
+				VecMath::sincos(rab[i] * D2R, sa, ca);
+				VecMath::sincos(dcb[i] * D2R, sd, cdc);
+				double vx  = cdc * ca, vy = cdc * sa, vz = sd;
+				double r   = vx * e[0][0] + vy * e[0][1] + vz * e[0][2];
+				double rr  = 1.0 / (r > 1E-6 ? r : 1.0);
+				double xi  = (vx * e[1][0] + vy * e[1][1] + vz * e[1][2]) * rr;
+				double eta = (vx * e[2][0] + vy * e[2][1] + vz * e[2][2]) * rr;
+				u[i] = i00 * xi + i01 * eta;
+				v[i] = i10 * xi + i11 * eta;
+				w[i] = r > 1E-6 ? 0.0 : NAN;
+			}
+			if (sipOrder >= 2) {
+				powers(m, u, sipInvOrder, pu);
+				powers(m, v, sipInvOrder, pv);
+				poly_block(m, ap, pu, pv, 1, sipInvOrder, du);
+				poly_block(m, bp, pu, pv, 1, sipInvOrder, dv);
+				for (i = 0; i < m; ++i) {
+					u[i] += du[i];
+					v[i] += dv[i];
+				}
+			}
+			for (i = 0; i < m; ++i) {
+				xb[i] = crpix[0] + u[i] + w[i];
+				yb[i] = crpix[1] + v[i] + w[i];
+			}
+		}
+	}
+
+	/*!
+	 * @brief 像元比例尺
+	 * @return
+	 * 比例尺, 量纲: 角秒/像素
+	 */
+	double Scale() const {
+		return sqrt(fabs(cd[0][0] * cd[1][1] - cd[0][1] * cd[1][0])) * 3600.0;
+	}
+
+	/*!
+	 * @brief 由匹配星对拟合WCS
+	 * @param n      星对数量
+	 * @param x      像素X坐标
+	 * @param y      像素Y坐标
+	 * @param ra     赤经, 量纲: 角度
+	 * @param dc     赤纬, 量纲: 角度
+	 * @param wt     权重. NULL: 等权
+	 * @param xref   参考点X坐标
+	 * @param yref   参考点Y坐标
+	 * @param raGuess  参考点赤经初值, 量纲: 角度
+	 * @param dcGuess  参考点赤纬初值, 量纲: 角度
+	 * @param order    多项式阶数. 1: 线性; 2及以上: 拟合SIP畸变. 星对数量不足时自动降阶
+	 * @return
+	 * 拟合结果
+	 * @note
+	 * - 以参考点作为切点迭代: 投影 -> 拟合多项式 -> 由常数项更新切点
+	 * - 剔除残差超过3倍RMS且大于1像素的星对后重新拟合一次
+	 * - SIP逆向系数在星对覆盖范围内的网格上拟合, 阶数比正向高1阶
+	 */
+	bool Fit(int n, const double* x, const double* y, const double* ra, const double* dc,
+			const double* wt, double xref, double yref, double raGuess, double dcGuess, int order = 1) {
+		if (n < 3) return false;
+		if (order < 1) order = 1;
+		else if (order > SIP_ORDER_MAX) order = SIP_ORDER_MAX;
+		while (order > 1 && n < 3 * nterm(0, order)) --order;
+
+		int nt = nterm(0, order);
+		std::vector<double> f(n * nt), xi(n), eta(n), w(n), cx(nt), cy(nt);
+		double ra0(raGuess * D2R), dc0(dcGuess * D2R);
+		double s(1.0), px, py, dx, dy, sum, thresh;
+		int i, iter, pass, nuse, nout;
+
+		crpix[0] = xref;
+		crpix[1] = yref;
+		// 以归一化坐标构建多项式基, 改善法方程条件数
+		for (i = 0; i < n; ++i) s = std::max(s, std::max(fabs(x[i] - xref), fabs(y[i] - yref)));
+		for (i = 0; i < n; ++i) {
+			basis((x[i] - xref) / s, (y[i] - yref) / s, 0, order, &f[i * nt]);
+			w[i] = wt ? wt[i] : 1.0;
+		}
+
+		for (pass = 0; pass < 2; ++pass) {
+			for (iter = 0; iter < 3; ++iter) {
+				for (i = 0; i < n; ++i) {
+					if (!Project(ra0, dc0, ra[i] * D2R, dc[i] * D2R, xi[i], eta[i])) return false;
+				}
+				if (!lsq(n, nt, f.data(), xi.data(), eta.data(), w.data(), cx.data(), cy.data()))
+					return false;
+				// 新切点: 参考像素对应的赤道坐标
+				Deproject(ra0, dc0, cx[0], cy[0], ra0, dc0);
+			}
+			crval[0] = ra0 * R2D;
+			crval[1] = dc0 * R2D;
+			if (!set_coefs(order, s, cx.data(), cy.data())) return false;
+			if (order >= 2) fit_inverse(n, x, y);
+
+			// 残差
+			std::vector<double> r2(n, 0.0);
+			for (i = 0, sum = 0.0, nuse = 0; i < n; ++i) {
+				if (!SkyToPixel(ra[i], dc[i], px, py)) r2[i] = 1E30;
+				else {
+					dx = px - x[i];
+					dy = py - y[i];
+					r2[i] = dx * dx + dy * dy;
+				}
+				if (w[i] > 0.0) {
+					sum += r2[i];
+					++nuse;
+				}
+			}
+			if (!nuse) return false;
+			rms    = sqrt(sum / nuse) * Scale();
+			nmatch = nuse;
+			if (pass) break;
+			// 剔除离群星对
+			thresh = std::max(9.0 * sum / nuse, 1.0);
+			for (i = 0, nout = 0; i < n; ++i) {
+				if (w[i] > 0.0 && r2[i] > thresh) ++nout;
+			}
+			if (!nout || nuse - nout < 3 * nt) break;
+			for (i = 0; i < n; ++i) {
+				if (r2[i] > thresh) w[i] = 0.0;
+			}
+		}
+		valid = true;
+		return true;
+	}
+
+protected:
+	/*!
+	 * @brief 清除SIP系数
+	 */
+	void clear_sip() {
+		sipOrder = sipInvOrder = 0;
+		memset(a,  0, sizeof(a));
+		memset(b,  0, sizeof(b));
+		memset(ap, 0, sizeof(ap));
+		memset(bp, 0, sizeof(bp));
+	}
+
+	/*!
+	 * @brief 切平面局部坐标系在赤道坐标系中的基矢量
+	 * @param e  e[0]: 指向切点; e[1]: 赤经增加方向; e[2]: 赤纬增加方向
+	 */
+	void tangent_basis(double e[3][3]) const {
+		double sa = sin(crval[0] * D2R), ca = cos(crval[0] * D2R);
+		double sd = sin(crval[1] * D2R), cdc = cos(crval[1] * D2R);
+		e[0][0] = cdc * ca;
+		e[0][1] = cdc * sa;
+		e[0][2] = sd;
+		e[1][0] = -sa;
+		e[1][1] = ca;
+		e[1][2] = 0.0;
+		e[2][0] = -sd * ca;
+		e[2][1] = -sd * sa;
+		e[2][2] = cdc;
+	}
+
+	/*!
+	 * @brief 阶数在[degMin, degMax]内的二元单项式数量
+	 */
+	static int nterm(int degMin, int degMax) {
+		return (degMax + 1) * (degMax + 2) / 2 - degMin * (degMin + 1) / 2;
+	}
+
+	/*!
+	 * @brief 计算二元单项式u^p v^q, 阶数p + q在[degMin, degMax]内. 顺序: 按阶数升序, 同阶按q升序
+	 */
+	static void basis(double u, double v, int degMin, int degMax, double* f) {
+		double pu[SIP_DIM], pv[SIP_DIM];
+		int deg, q, k(0);
+
+		pu[0] = pv[0] = 1.0;
+		for (deg = 1; deg <= degMax; ++deg) {
+			pu[deg] = pu[deg - 1] * u;
+			pv[deg] = pv[deg - 1] * v;
+		}
+		for (deg = degMin; deg <= degMax; ++deg) {
+			for (q = 0; q <= deg; ++q) f[k++] = pu[deg - q] * pv[q];
+		}
+	}
+
+	/*!
+	 * @brief 单点多项式求值: Σ c[p][q] u^p v^q, degMin <= p + q <= degMax
+	 */
+	static void poly(const double c[SIP_DIM][SIP_DIM], double u, double v, int degMin, int degMax, double& val) {
+		double f[SIP_DIM * (SIP_DIM + 1) / 2];
+		int deg, q, k(0);
+
+		basis(u, v, degMin, degMax, f);
+		for (deg = degMin, val = 0.0; deg <= degMax; ++deg) {
+			for (q = 0; q <= deg; ++q, ++k) val += c[deg - q][q] * f[k];
+		}
+	}
+
+	/*!
+	 * @brief 计算一组坐标的0至order次幂
+	 */
+	static void powers(int m, const double* u, int order, double pu[SIP_DIM][WCS_BATCH]) {
+		int i, k;
+		for (i = 0; i < m; ++i) {
+			pu[0][i] = 1.0;
+			pu[1][i] = u[i];
+		}
+		for (k = 2; k <= order; ++k) {
+			const double* src = pu[k - 1];
+			double* dst = pu[k];
+			for (i = 0; i < m; ++i) dst[i] = src[i] * u[i];
+		}
+	}
+
+	/*!
+	 * @brief 一组坐标的多项式求值. 逐项累加, 内层循环遍历坐标
+	 */
+	static void poly_block(int m, const double c[SIP_DIM][SIP_DIM], const double pu[SIP_DIM][WCS_BATCH],
+			const double pv[SIP_DIM][WCS_BATCH], int degMin, int degMax, double* val) {
+		int i, deg, q;
+		for (i = 0; i < m; ++i) val[i] = 0.0;
+		for (deg = degMin; deg <= degMax; ++deg) {
+			for (q = 0; q <= deg; ++q) {
+				double coef = c[deg - q][q];
+				if (coef == 0.0) continue;
+				const double* su = pu[deg - q];
+				const double* sv = pv[q];
+				for (i = 0; i < m; ++i) val[i] += coef * su[i] * sv[i];
+			}
+		}
+	}
+
+	/*!
+	 * @brief 由拟合系数设置CD矩阵和SIP正向系数
+	 * @param order  多项式阶数
+	 * @param s      归一化尺度
+	 * @param cx     xi的多项式系数, 量纲: 弧度
+	 * @param cy     eta的多项式系数, 量纲: 弧度
+	 */
+	bool set_coefs(int order, double s, const double* cx, const double* cy) {
+		cd[0][0] = cx[1] / s * R2D;
+		cd[0][1] = cx[2] / s * R2D;
+		cd[1][0] = cy[1] / s * R2D;
+		cd[1][1] = cy[2] / s * R2D;
+		clear_sip();
+		if (order < 2) return true;
+
+		double det = cd[0][0] * cd[1][1] - cd[0][1] * cd[1][0];
+		if (det == 0.0) return false;
+		// 高阶项: CD * (A, B) = (cx, cy)
+		double sn(s * s), gx, gy;
+		int deg, q, k(3);
+		for (deg = 2; deg <= order; ++deg, sn *= s) {
+			for (q = 0; q <= deg; ++q, ++k) {
+				gx = cx[k] / sn * R2D;
+				gy = cy[k] / sn * R2D;
+				a[deg - q][q] = ( cd[1][1] * gx - cd[0][1] * gy) / det;
+				b[deg - q][q] = (-cd[1][0] * gx + cd[0][0] * gy) / det;
+			}
+		}
+		sipOrder = order;
+		return true;
+	}
+
+	/*!
+	 * @brief 在星对覆盖范围内拟合SIP逆向系数
+	 */
+	void fit_inverse(int n, const double* x, const double* y) {
+		const int ngrid = 16;
+		int order = sipOrder + 1, nt = nterm(1, order), ns = ngrid * ngrid;
+		std::vector<double> f(ns * nt), U(ns), V(ns), du(ns), dv(ns), w(ns, 1.0), cx(nt), cy(nt);
+		double umin(1E30), umax(-1E30), vmin(1E30), vmax(-1E30), u, v, fu, fv, s(1.0);
+		int i, j, k, deg, q;
+
+		for (i = 0; i < n; ++i) {
+			u = x[i] - crpix[0];
+			v = y[i] - crpix[1];
+			if (u < umin) umin = u;
+			if (u > umax) umax = u;
+			if (v < vmin) vmin = v;
+			if (v > vmax) vmax = v;
+		}
+		for (j = 0, k = 0; j < ngrid; ++j) {
+			v = vmin + (vmax - vmin) * j / (ngrid - 1);
+			for (i = 0; i < ngrid; ++i, ++k) {
+				u = umin + (umax - umin) * i / (ngrid - 1);
+				poly(a, u, v, 2, sipOrder, fu);
+				poly(b, u, v, 2, sipOrder, fv);
+				U[k]  = u + fu;
+				V[k]  = v + fv;
+				du[k] = -fu;
+				dv[k] = -fv;
+				s = std::max(s, std::max(fabs(U[k]), fabs(V[k])));
+			}
+		}
+		for (k = 0; k < ns; ++k) basis(U[k] / s, V[k] / s, 1, order, &f[k * nt]);
+		if (!lsq(ns, nt, f.data(), du.data(), dv.data(), w.data(), cx.data(), cy.data())) return;
+
+		double sn(s);
+		for (deg = 1, k = 0; deg <= order; ++deg, sn *= s) {
+			for (q = 0; q <= deg; ++q, ++k) {
+				ap[deg - q][q] = cx[k] / sn;
+				bp[deg - q][q] = cy[k] / sn;
+			}
+		}
+		sipInvOrder = order;
+	}
+
+	/*!
+	 * @brief 加权线性最小二乘, 两组观测量共用设计矩阵
+	 * @param n    观测数量
+	 * @param nt   参数数量
+	 * @param f    设计矩阵, 按行存储
+	 * @param v1   观测量1
+	 * @param v2   观测量2
+	 * @param w    权重
+	 * @param c1   参数1
+	 * @param c2   参数2
+	 */
+	static bool lsq(int n, int nt, const double* f, const double* v1, const double* v2, const double* w,
+			double* c1, double* c2) {
+		std::vector<double> m(nt * (nt + 2), 0.0);
+		int cols = nt + 2, i, j, k, piv;
+		double t;
+
+		for (i = 0; i < n; ++i) {
+			if (w[i] <= 0.0) continue;
+			const double* fi = f + i * nt;
+			for (j = 0; j < nt; ++j) {
+				double* row = &m[j * cols];
+				t = w[i] * fi[j];
+				for (k = j; k < nt; ++k) row[k] += t * fi[k];
+				row[nt]     += t * v1[i];
+				row[nt + 1] += t * v2[i];
+			}
+		}
+		for (j = 1; j < nt; ++j) {
+			for (k = 0; k < j; ++k) m[j * cols + k] = m[k * cols + j];
+		}
+		// 高斯消元, 列主元
+		for (j = 0; j < nt; ++j) {
+			for (piv = j, k = j + 1; k < nt; ++k) {
+				if (fabs(m[k * cols + j]) > fabs(m[piv * cols + j])) piv = k;
+			}
+			if (fabs(m[piv * cols + j]) < 1E-30) return false;
+			if (piv != j) {
+				for (k = 0; k < cols; ++k) std::swap(m[j * cols + k], m[piv * cols + k]);
+			}
+			for (i = j + 1; i < nt; ++i) {
+				t = m[i * cols + j] / m[j * cols + j];
+				for (k = j; k < cols; ++k) m[i * cols + k] -= t * m[j * cols + k];
+			}
+		}
+		for (j = nt - 1; j >= 0; --j) {
+			double s1 = m[j * cols + nt], s2 = m[j * cols + nt + 1];
+			for (k = j + 1; k < nt; ++k) {
+				s1 -= m[j * cols + k] * c1[k];
+				s2 -= m[j * cols + k] * c2[k];
+			}
+			c1[j] = s1 / m[j * cols + j];
+			c2[j] = s2 / m[j * cols + j];
+		}
+		return true;
+	}
+};
+
+#endif /* WCSTAN_HPP_ */
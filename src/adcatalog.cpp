@@ -0,0 +1,225 @@
+/*!
+ Name        : adips-catalog. 将CSV或FITS二进制表格式的星表转换为本地参考星表
+ Author      : Xiaomeng Lu
+ Version     : 0.1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <getopt.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <longnam.h>
+#include <fitsio.h>
+#include "ARefCatalog.h"
+#include "GLog.h"
+
+using std::string;
+using std::vector;
+
+GLog _gLog(stdout);
+
+/*!
+ * @struct ColumnName 输入星表的列名
+ */
+struct ColumnName {
+	string ra, dec, mag, pmra, pmdec;
+};
+
+void Usage() {
+	printf("Usage:\n");
+	printf(" adips-catalog [options] <output> <input 1> [<input 2> ...]\n");
+	printf("\nOptions\n");
+	printf(" -h / --help    : print this help message\n");
+	printf(" -o / --order   : HEALPix order of tiles, default: 6\n");
+	printf(" -e / --epoch   : epoch of coordinates, default: 2000.0\n");
+	printf(" -m / --mag     : limit magnitude, default: 99\n");
+	printf(" --ra <name>    : column of RA in degree, default: ra\n");
+	printf(" --dec <name>   : column of DEC in degree, default: dec\n");
+	printf(" --band <name>  : column of magnitude, default: mag\n");
+	printf(" --pmra <name>  : column of proper motion in RA*cos(DEC), mas/yr, optional\n");
+	printf(" --pmdec <name> : column of proper motion in DEC, mas/yr, optional\n");
+	printf("\nInput\n");
+	printf(" *.fit/*.fits: FITS binary table. otherwise CSV with header line\n");
+}
+
+/*!
+ * @brief 以逗号分隔文本行
+ */
+static void split_csv(char* line, vector<char*>& fields) {
+	char* p;
+	fields.clear();
+	for (p = line; *p && *p != '\r' && *p != '\n'; ) {
+		fields.push_back(p);
+		while (*p && *p != ',' && *p != '\r' && *p != '\n') ++p;
+		if (*p == ',') *p++ = 0;
+	}
+	*p = 0;
+}
+
+static int find_column(const vector<char*>& fields, const string& name) {
+	if (name.empty()) return -1;
+	for (size_t i = 0; i < fields.size(); ++i) {
+		char* p = fields[i];
+		while (*p == ' ' || *p == '"') ++p;
+		size_t n = strlen(p);
+		while (n && (p[n - 1] == ' ' || p[n - 1] == '"')) --n;
+		if (n == name.size() && !strncasecmp(p, name.c_str(), n)) return int(i);
+	}
+	return -1;
+}
+
+bool load_csv(const char* filepath, const ColumnName& cols, double magLimit, RefStarBatch& stars) {
+	FILE* fp = fopen(filepath, "r");
+	if (!fp) {
+		_gLog.Write(LOG_FAULT, "failed to open [%s]", filepath);
+		return false;
+	}
+
+	vector<char> buff(65536);
+	vector<char*> fields;
+	int ira, idec, imag, ipmra, ipmdec, nmin;
+	bool rslt(false);
+
+	if (fgets(buff.data(), buff.size(), fp)) {
+		split_csv(buff.data(), fields);
+		ira    = find_column(fields, cols.ra);
+		idec   = find_column(fields, cols.dec);
+		imag   = find_column(fields, cols.mag);
+		ipmra  = find_column(fields, cols.pmra);
+		ipmdec = find_column(fields, cols.pmdec);
+		if (ira < 0 || idec < 0 || imag < 0)
+			_gLog.Write(LOG_FAULT, "[%s]: missing column of RA, DEC or magnitude", filepath);
+		else {
+			rslt = true;
+			nmin = std::max(std::max(ira, idec), std::max(imag, std::max(ipmra, ipmdec))) + 1;
+			while (fgets(buff.data(), buff.size(), fp)) {
+				split_csv(buff.data(), fields);
+				if (int(fields.size()) < nmin || !*fields[ira] || !*fields[idec] || !*fields[imag]) continue;
+				double mag = atof(fields[imag]);
+				if (mag > magLimit) continue;
+				stars.ra.push_back(atof(fields[ira]));
+				stars.dec.push_back(atof(fields[idec]));
+				stars.mag.push_back(float(mag));
+				stars.pmra.push_back(ipmra >= 0 ? float(atof(fields[ipmra])) : 0.0f);
+				stars.pmdec.push_back(ipmdec >= 0 ? float(atof(fields[ipmdec])) : 0.0f);
+			}
+		}
+	}
+	fclose(fp);
+	return rslt;
+}
+
+bool load_fits(const char* filepath, const ColumnName& cols, double magLimit, RefStarBatch& stars) {
+	fitsfile* hFits;
+	int state(0), colnum[5], i;
+	long nrows(0), first, n, chunk(100000), j;
+	const string* names[] = { &cols.ra, &cols.dec, &cols.mag, &cols.pmra, &cols.pmdec };
+	char name[FLEN_VALUE];
+	double nulval(NAN);
+
+	fits_open_table(&hFits, filepath, READONLY, &state);
+	if (state) {
+		_gLog.Write(LOG_FAULT, "failed to open FITS table [%s]", filepath);
+		return false;
+	}
+	fits_get_num_rows(hFits, &nrows, &state);
+	for (i = 0; i < 5 && !state; ++i) {
+		colnum[i] = 0;
+		if (names[i]->empty()) continue;
+		strncpy(name, names[i]->c_str(), FLEN_VALUE - 1);
+		name[FLEN_VALUE - 1] = 0;
+		fits_get_colnum(hFits, CASEINSEN, name, &colnum[i], &state);
+		if (state && i >= 3) {// 自行为可选列
+			state = 0;
+			colnum[i] = 0;
+		}
+	}
+	if (state) {
+		_gLog.Write(LOG_FAULT, "[%s]: missing column of RA, DEC or magnitude", filepath);
+		fits_close_file(hFits, &state);
+		return false;
+	}
+
+	vector<double> buff[5];
+	for (i = 0; i < 5; ++i) buff[i].resize(chunk);
+	for (first = 1; first <= nrows && !state; first += chunk) {
+		n = std::min(chunk, nrows - first + 1);
+		for (i = 0; i < 5 && !state; ++i) {
+			if (colnum[i]) fits_read_col(hFits, TDOUBLE, colnum[i], first, 1, n, &nulval, buff[i].data(), NULL, &state);
+			else memset(buff[i].data(), 0, sizeof(double) * n);
+		}
+		for (j = 0; j < n && !state; ++j) {
+			if (buff[2][j] > magLimit || isnan(buff[0][j]) || isnan(buff[1][j]) || isnan(buff[2][j])) continue;
+			stars.ra.push_back(buff[0][j]);
+			stars.dec.push_back(buff[1][j]);
+			stars.mag.push_back(float(buff[2][j]));
+			stars.pmra.push_back(isnan(buff[3][j]) ? 0.0f : float(buff[3][j]));
+			stars.pmdec.push_back(isnan(buff[4][j]) ? 0.0f : float(buff[4][j]));
+		}
+	}
+	bool rslt = state == 0;
+	state = 0;
+	fits_close_file(hFits, &state);
+	if (!rslt) _gLog.Write(LOG_FAULT, "[%s]: failed to read table", filepath);
+	return rslt;
+}
+
+int main(int argc, char** argv) {
+	struct option longopts[] = {
+		{ "help",  no_argument,       NULL, 'h' },
+		{ "order", required_argument, NULL, 'o' },
+		{ "epoch", required_argument, NULL, 'e' },
+		{ "mag",   required_argument, NULL, 'm' },
+		{ "ra",    required_argument, NULL,  1  },
+		{ "dec",   required_argument, NULL,  2  },
+		{ "band",  required_argument, NULL,  3  },
+		{ "pmra",  required_argument, NULL,  4  },
+		{ "pmdec", required_argument, NULL,  5  },
+		{ NULL,    0,                 NULL,  0  }
+	};
+	char optstr[] = "ho:e:m:";
+	int ch, optndx, order(6);
+	double epoch(2000.0), magLimit(99.0);
+	ColumnName cols;
+
+	cols.ra  = "ra";
+	cols.dec = "dec";
+	cols.mag = "mag";
+	while ((ch = getopt_long(argc, argv, optstr, longopts, &optndx)) != -1) {
+		switch(ch) {
+		case 'o': order = atoi(optarg);    break;
+		case 'e': epoch = atof(optarg);    break;
+		case 'm': magLimit = atof(optarg); break;
+		case 1:   cols.ra = optarg;        break;
+		case 2:   cols.dec = optarg;       break;
+		case 3:   cols.mag = optarg;       break;
+		case 4:   cols.pmra = optarg;      break;
+		case 5:   cols.pmdec = optarg;     break;
+		default:
+			Usage();
+			return -1;
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc < 2 || order < 0 || order > 13) {
+		Usage();
+		return -2;
+	}
+
+	RefStarBatch stars;
+	for (int i = 1; i < argc; ++i) {
+		const char* ext = strrchr(argv[i], '.');
+		bool isFits = ext && (!strcasecmp(ext, ".fit") || !strcasecmp(ext, ".fits"));
+		if (!(isFits ? load_fits(argv[i], cols, magLimit, stars) : load_csv(argv[i], cols, magLimit, stars)))
+			return -3;
+		_gLog.Write("[%s] loaded, %lu stars in total", argv[i], (unsigned long) stars.Size());
+	}
+
+	return ARefCatalog::Build(stars, order, epoch, argv[0]) ? 0 : -4;
+}
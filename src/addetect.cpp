@@ -0,0 +1,118 @@
+/*!
+ Name        : adips-detect. 检索整夜检测库
+ Author      : Xiaomeng Lu
+ Version     : 0.1
+ Note        :
+ - 未指定检索条件时输出检测库概况
+ - 检索结果以CSV格式输出到标准输出, 统计信息输出到标准错误
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <chrono>
+#include <vector>
+#include "ADetectStore.h"
+#include "GLog.h"
+
+using std::vector;
+
+GLog _gLog(stderr);
+
+void Usage() {
+	printf("Usage:\n");
+	printf(" adips-detect [options] <detection store>\n");
+	printf("\nOptions\n");
+	printf(" -h / --help    : print this help message\n");
+	printf(" -c / --cone    : cone search, <ra>,<dec>,<radius>. ra and dec in degree, radius in arcsec\n");
+	printf(" -t / --time    : time range, <mjd start>,<mjd end>. combined with cone search if both given\n");
+	printf(" -n / --limit   : maximum rows to print, default: all\n");
+	printf(" -q / --quiet   : print statistics only\n");
+}
+
+int main(int argc, char** argv) {
+	struct option longopts[] = {
+		{ "help",  no_argument,       NULL, 'h' },
+		{ "cone",  required_argument, NULL, 'c' },
+		{ "time",  required_argument, NULL, 't' },
+		{ "limit", required_argument, NULL, 'n' },
+		{ "quiet", no_argument,       NULL, 'q' },
+		{ NULL,    0,                 NULL,  0  }
+	};
+	char optstr[] = "hc:t:n:q";
+	int ch, optndx;
+	double ra(0.0), dec(0.0), radius(-1.0), mjd0(-1E30), mjd1(1E30);
+	long limit(-1);
+	bool cone(false), timed(false), quiet(false);
+
+	while ((ch = getopt_long(argc, argv, optstr, longopts, &optndx)) != -1) {
+		switch(ch) {
+		case 'c':
+			cone = sscanf(optarg, "%lf,%lf,%lf", &ra, &dec, &radius) == 3 && radius > 0.0;
+			if (!cone) {
+				Usage();
+				return -1;
+			}
+			break;
+		case 't':
+			timed = sscanf(optarg, "%lf,%lf", &mjd0, &mjd1) == 2 && mjd0 <= mjd1;
+			if (!timed) {
+				Usage();
+				return -1;
+			}
+			break;
+		case 'n': limit = atol(optarg); break;
+		case 'q': quiet = true;         break;
+		default:
+			Usage();
+			return -1;
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 1) {
+		Usage();
+		return -2;
+	}
+
+	ADetectStore store;
+	if (!store.Open(argv[0])) {
+		_gLog.Write(LOG_FAULT, "failed to open detection store [%s]", argv[0]);
+		return -3;
+	}
+	size_t nframe = store.FrameCount(), i;
+	if (!cone && !timed) {// 概况
+		double t0(1E30), t1(-1E30);
+		for (i = 0; i < nframe; ++i) {
+			double mjd = store.Frame(i)->mjd;
+			if (mjd < t0) t0 = mjd;
+			if (mjd > t1) t1 = mjd;
+		}
+		printf("%lu frames, %lu detections", (unsigned long) nframe, (unsigned long) store.RowCount());
+		if (nframe) printf(", MJD %.6f - %.6f", t0, t1);
+		printf("\n");
+		return 0;
+	}
+
+	vector<DetRecord> rows;
+	std::chrono::steady_clock::time_point tmStart = std::chrono::steady_clock::now();
+	if (cone) store.ConeSearch(ra, dec, radius / 3600.0, mjd0, mjd1, rows);
+	else      store.TimeSearch(mjd0, mjd1, rows);
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tmStart).count();
+
+	if (!quiet) {
+		size_t n = limit >= 0 && size_t(limit) < rows.size() ? size_t(limit) : rows.size();
+		printf("frame,name,mjd,ra,dec,x,y,flux,snr,type\n");
+		for (i = 0; i < n; ++i) {
+			const DetRecord& row = rows[i];
+			const DetSegmentHeader* frame = store.Frame(row.frame - 1);
+			printf("%u,%s,%.6f,%.7f,%.7f,%.2f,%.2f,%.1f,%.1f,%d\n", row.frame,
+					frame && frame->frame == row.frame ? frame->name : "",
+					row.mjd, row.ra, row.dec, row.x, row.y, row.flux, row.snr, row.type);
+		}
+	}
+	fprintf(stderr, "%lu rows from %lu frames / %lu detections, %.2f ms\n", (unsigned long) rows.size(),
+			(unsigned long) nframe, (unsigned long) store.RowCount(), ms);
+
+	return 0;
+}
@@ -0,0 +1,73 @@
+/*!
+ Name        : adips-index. 由参考星表生成盲定位索引
+ Author      : Xiaomeng Lu
+ Version     : 0.1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include "APlateIndex.h"
+#include "GLog.h"
+
+GLog _gLog(stdout);
+
+void Usage() {
+	printf("Usage:\n");
+	printf(" adips-index [options] <catalog> <index file>\n");
+	printf("\nOptions\n");
+	printf(" -h / --help    : print this help message\n");
+	printf(" -f / --field   : field of view in degree, default: 2.0\n");
+	printf(" -q / --quad    : brightest stars per cell used to build quads, default: 10\n");
+	printf(" -n / --stars   : brightest stars kept per cell, default: 50\n");
+	printf(" -m / --mag     : limit magnitude, default: 16.0\n");
+	printf("\nCatalog\n");
+	printf(" local catalog built by adips-catalog, or\n");
+	printf(" text file, one star per line: <RA> <DEC> <MAG>, in degree\n");
+}
+
+int main(int argc, char** argv) {
+	struct option longopts[] = {
+		{ "help",  no_argument,       NULL, 'h' },
+		{ "field", required_argument, NULL, 'f' },
+		{ "quad",  required_argument, NULL, 'q' },
+		{ "stars", required_argument, NULL, 'n' },
+		{ "mag",   required_argument, NULL, 'm' },
+		{ NULL,    0,                 NULL,  0  }
+	};
+	char optstr[] = "hf:q:n:m:";
+	int ch, optndx;
+	double fieldDeg(2.0), magLimit(16.0);
+	int nquad(10), nstar(50);
+
+	while ((ch = getopt_long(argc, argv, optstr, longopts, &optndx)) != -1) {
+		switch(ch) {
+		case 'h':
+			Usage();
+			return -1;
+		case 'f':
+			fieldDeg = atof(optarg);
+			break;
+		case 'q':
+			nquad = atoi(optarg);
+			break;
+		case 'n':
+			nstar = atoi(optarg);
+			break;
+		case 'm':
+			magLimit = atof(optarg);
+			break;
+		default:
+			Usage();
+			return -1;
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 2 || fieldDeg <= 0.0 || nquad < 4) {
+		Usage();
+		return -2;
+	}
+
+	return APlateIndex::Build(argv[0], argv[1], fieldDeg, nquad, nstar, magLimit) ? 0 : -3;
+}
@@ -10,11 +10,15 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <chrono>
 #include <boost/filesystem.hpp>
 #include <boost/asio.hpp>
 #include "Parameter.hpp"
 #include "GLog.h"
 #include "ADIWorkFlow.h"
+#include "AWatchFolder.h"
+#include "AShmRing.h"
+#include "AFitsIndex.h"
 
 ///////////////////////////////////////////////////////////////////////
 using namespace std;
@@ -30,6 +34,8 @@ GLog _gLog(stdout);
 void Usage() {
 	printf("Usage:\n");
 	printf(" adips [options] [<image file 1> <image file 2> ...]\n");
+	printf(" adips [options] -w <directory 1> <directory 2> ...\n");
+	printf(" adips [options] -s <shared memory name>\n");
 	printf("\nOptions\n");
 	printf(" -h / --help    : print this help message\n");
 	printf(" -d / --default : generate default configuration file here\n");
@@ -37,6 +43,8 @@ void Usage() {
 	printf(" -Z / --zero    : combine bias images, result to be saved as ZERO.fits in WD\n");
 	printf(" -D / --dark    : combine dark images, result to be saved as DARK.fits in WD\n");
 	printf(" -F / --flat    : combine flat images, result to be saved as FLAT.fits in WD\n");
+	printf(" -w / --watch   : daemon mode, process new FITS files written into the directories\n");
+	printf(" -s / --shm     : daemon mode, process frames published into the shared memory ring\n");
 }
 
 void process_sequence(strvec& imgFiles, Parameter* param) {
@@ -48,27 +56,153 @@ void process_sequence(strvec& imgFiles, Parameter* param) {
 	printf ("*                                   *\n");
 	printf ("*************************************\n");
 
-	signals.async_wait(boost::bind(&boost::asio::io_service::stop, &ios));
-
 	ADIWorkFlow workFlow(&ios);
+	signals.async_wait([&ios, &workFlow](const boost::system::error_code&, int) {
+		workFlow.Interrupt();	// 唤醒因超出预算而阻塞的输入线程
+		ios.stop();
+	});
+
 	if (!workFlow.Start(param)) {
 		_gLog.Write(LOG_FAULT, "failed to start process procedure");
 	}
 	else {
-		int i, n;
-		if ((n = imgFiles.size()) > 2) {
-			sort(imgFiles.begin(), imgFiles.end(), [](const string &name1, const string &name2) {
-				return name1 < name2;
-			});
+		// 由文件头索引分组排序: 同一相机和尺寸的帧按曝光时间连续进入处理流程
+		AFitsIndex index;
+		FitsIdxVec entries;
+		int n, ngroup, nlook, ncache;
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		index.Scan(imgFiles, entries);
+		ngroup = AFitsIndex::Sort(entries);
+		index.LastStat(nlook, ncache);
+		_gLog.Write("%d frames in %d groups queued. %d headers read, %d indexed, %.1f ms", int(entries.size()),
+				ngroup, nlook, ncache,
+				std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+		n = int(entries.size());
+		// 在独立线程中输入: 超出预算阻塞时主线程仍可响应中断信号
+		workFlow.BeginInput();
+		boost::thread thrd([&workFlow, &entries, n]() {
+			for (int i = 0; i < n && workFlow.ProcessImage(entries[i].filepath.c_str()); ++i);
+			workFlow.EndInput();
+		});
+		ios.run();
+		workFlow.Interrupt();
+		thrd.join();
+		workFlow.Stop();
+	}
+}
+
+/*!
+ * @brief 守护模式: 监视目录, 文件写入完成后立即进入处理流程, 直至收到中断信号
+ */
+void process_watch(strvec& dirs, Parameter* param) {
+	boost::asio::io_service ios;
+	boost::asio::signal_set signals(ios, SIGINT, SIGTERM);  // interrupt signal
+	printf ("*************************************\n");
+	printf ("*                                   *\n");
+	printf ("* press Ctrl+C to terminate program *\n");
+	printf ("*                                   *\n");
+	printf ("*************************************\n");
+
+	ADIWorkFlow workFlow;	// 不关联ios: 处理队列清空后继续等待新文件
+	AWatchFolder watcher;
+	signals.async_wait([&ios, &workFlow](const boost::system::error_code&, int) {
+		workFlow.Interrupt();	// 唤醒因超出预算而阻塞的监视线程
+		ios.stop();
+	});
+	if (!workFlow.Start(param)) {
+		_gLog.Write(LOG_FAULT, "failed to start process procedure");
+	}
+	else {
+		// 回调在监视线程中执行并直接提交处理: 超出预算时阻塞监视线程, 主线程仍可响应中断信号
+		const AWatchFolder::CBFileSlot& slot = [&workFlow](const string& filepath) {
+			workFlow.ProcessImage(filepath.c_str());
+		};
+		watcher.RegisterFile(slot);
+		if (!watcher.Start(dirs)) {
+			_gLog.Write(LOG_FAULT, "no directory to be watched");
 		}
-		for (i = 0; i < n; ++i) {
-			workFlow.ProcessImage(imgFiles[i].c_str());
+		else {
+			ios.run();
+			workFlow.Interrupt();
+			watcher.Stop();
 		}
-		ios.run();
 		workFlow.Stop();
 	}
 }
 
+/*!
+ * @brief 守护模式: 从共享内存环形缓存区读取帧, 零复制进入处理流程, 直至收到中断信号
+ * @note
+ * 生产者关闭后停止读取, 已读取的帧继续完成处理
+ */
+void process_shm(const string& name, Parameter* param) {
+	boost::asio::io_service ios;
+	boost::asio::signal_set signals(ios, SIGINT, SIGTERM);  // interrupt signal
+	printf ("*************************************\n");
+	printf ("*                                   *\n");
+	printf ("* press Ctrl+C to terminate program *\n");
+	printf ("*                                   *\n");
+	printf ("*************************************\n");
+
+	AShmRing ring;	// 先于处理流程构造: 析构处理流程时归还其持有的帧槽
+	if (!ring.Open(name.c_str())) {
+		_gLog.Write(LOG_FAULT, "failed to open shared memory ring [%s]", name.c_str());
+		return;
+	}
+	_gLog.Write("shared memory ring [%s] mapped, %u slots of %ux%u", name.c_str(),
+			ring.Header()->nslot, ring.Header()->wMax, ring.Header()->hMax);
+
+	ADIWorkFlow workFlow;
+	signals.async_wait([&ios, &workFlow](const boost::system::error_code&, int) {
+		workFlow.Interrupt();	// 唤醒因超出预算而阻塞的读取线程
+		ios.stop();
+	});
+	if (!workFlow.Start(param)) {
+		_gLog.Write(LOG_FAULT, "failed to start process procedure");
+		return;
+	}
+
+	// 在读取线程中直接提交处理: 超出预算时阻塞读取线程, 主线程仍可响应中断信号
+	boost::thread thrd([&ring, &workFlow]() {
+		const ShmRingHeader* header = ring.Header();
+		int i;
+		while ((i = ring.Wait(200)) != -2) {
+			boost::this_thread::interruption_point();
+			if (i < 0) continue;
+			ShmSlot* slot = ring.Slot(i);
+			if (slot->w * slot->h > header->wMax * header->hMax) {
+				_gLog.Write(LOG_WARN, "invalid frame dimension [%u, %u] in shared memory", slot->w, slot->h);
+				ring.Release(i);
+				continue;
+			}
+
+			// 帧槽所有权转移至图像帧, 图像处理完成后归还
+			ImgFrmPtr frame(new ImageFrame);
+			char name[80];
+			if (slot->name[0]) snprintf(name, sizeof(name), "%s", slot->name);
+			else snprintf(name, sizeof(name), "shm%06lu", (unsigned long) slot->seq);
+			frame->filename = name;
+			frame->filetit  = name;
+			frame->dateobs  = slot->dateobs;
+			frame->wImg     = slot->w;
+			frame->hImg     = slot->h;
+			frame->expdur   = slot->expdur;
+			frame->dataRaw  = boost::shared_array<float>(ring.Data(i), [&ring, i](float*) {
+				ring.Release(i);
+			});
+			_gLog.Write("[%s]: received from shared memory, %.2f ms after publish", frame->filename.c_str(),
+					(AShmRing::Now() - slot->tmReady) * 1E-6);
+			if (!workFlow.ProcessImage(frame)) return;	// 处理流程已中断
+		}
+		_gLog.Write("shared memory ring closed by producer");
+	});
+	ios.run();
+	workFlow.Interrupt();
+	thrd.interrupt();
+	thrd.join();
+	workFlow.Stop();
+}
+
 void combine_images(strvec& imgFiles, Parameter* param, int combine) {
 	int i, n;
 
@@ -85,20 +219,27 @@ void combine_images(strvec& imgFiles, Parameter* param, int combine) {
 	}
 }
 
-void process_directory(const string& dirname, Parameter* param, int combine) {
-	strvec imgFiles;
+/*!
+ * @brief 扫描目录树
+ * @param dirname   目录
+ * @param param     配置参数
+ * @param combine   合并模式. 合并时逐目录执行; 否则仅收集文件
+ * @param imgFiles  收集的图像文件, 由调用者以单一处理流程处理
+ */
+void process_directory(const string& dirname, Parameter* param, int combine, strvec& imgFiles) {
+	strvec dirFiles;
 
 	for (directory_iterator x = directory_iterator(dirname); x != directory_iterator(); ++x) {
-		if (is_directory(x->path().string())) process_directory(x->path().string(), param, combine);
+		if (is_directory(x->path().string())) process_directory(x->path().string(), param, combine, imgFiles);
 		else if (x->path().extension().string().rfind(".fit") != string::npos) {
-			imgFiles.push_back(x->path().string());
+			dirFiles.push_back(x->path().string());
 		}
 	}
-	if (imgFiles.size()) {
+	if (dirFiles.size()) {
 		if (!combine)
-			process_sequence(imgFiles, param);
+			imgFiles.insert(imgFiles.end(), dirFiles.begin(), dirFiles.end());
 		else
-			combine_images(imgFiles, param, combine);
+			combine_images(dirFiles, param, combine);
 	}
 }
 
@@ -111,12 +252,16 @@ int main(int argc, char** argv) {
 		{ "zero",    no_argument,       NULL, 'Z' },
 		{ "dark",    no_argument,       NULL, 'D' },
 		{ "flat",    no_argument,       NULL, 'F' },
+		{ "watch",   no_argument,       NULL, 'w' },
+		{ "shm",     required_argument, NULL, 's' },
 		{ NULL,      0,                 NULL,  0  }
 	};
-	char optstr[] = "hdc:ZDF";
+	char optstr[] = "hdc:ZDFws:";
 	int ch, optndx;
 	int combine(0);
 	bool loadParam(false);
+	bool watch(false);
+	string shmName;
 	Parameter param;
 
 	while ((ch = getopt_long(argc, argv, optstr, longopts, &optndx)) != -1) {
@@ -144,6 +289,12 @@ int main(int argc, char** argv) {
 		case 'F':
 			combine = 3;
 			break;
+		case 'w':
+			watch = true;
+			break;
+		case 's':
+			shmName = optarg;
+			break;
 		default:
 			Usage();
 			break;
@@ -151,8 +302,8 @@ int main(int argc, char** argv) {
 	}
 	argc -= optind;
 	argv += optind;
-	if (!argc) {
-		_gLog.Write(LOG_WARN, "require FITS file(s) which to be processed");
+	if (!argc && shmName.empty()) {
+		_gLog.Write(LOG_WARN, "require FITS file(s) or directories which to be processed");
 		return -4;
 	}
 	if (!loadParam) {
@@ -166,12 +317,30 @@ int main(int argc, char** argv) {
 	/////////////////////////////////////////////////////////////////////////
 	strvec imgFiles;
 
+	if (shmName.size()) {
+		if (combine) {
+			_gLog.Write(LOG_FAULT, "shared memory mode does not support combination");
+			return -6;
+		}
+		process_shm(shmName, &param);
+		return 0;
+	}
+	if (watch) {
+		if (combine) {
+			_gLog.Write(LOG_FAULT, "watch mode does not support combination");
+			return -6;
+		}
+		for (int i = 0; i < argc; ++i) imgFiles.push_back(argv[i]);
+		process_watch(imgFiles, &param);
+		return 0;
+	}
+
 	for (int i = 0; i < argc; ++i) {
 		path filename = argv[i];
 		if (is_regular_file(filename) && filename.extension().string().rfind(".fit") != string::npos)
 			imgFiles.push_back(argv[i]);
 		else if (is_directory(filename))
-			process_directory(filename.string(), &param, combine);
+			process_directory(filename.string(), &param, combine, imgFiles);
 	}
 	if (imgFiles.size()) {
 		if (!combine)
@@ -0,0 +1,92 @@
+/*!
+ Name        : adips-bench-catalog. 评估本地参考星表的检索耗时
+ Author      : Xiaomeng Lu
+ Version     : 0.1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include "ARefCatalog.h"
+#include "BenchSuite.hpp"
+#include "GLog.h"
+
+using std::vector;
+
+GLog _gLog(stdout);
+
+int main(int argc, char** argv) {
+	BenchArgs args("adips-bench-catalog", "<catalog>");
+	args.Option('n', "queries", "number of random queries, default: 1000");
+	args.Option('d', "field",   "field of view in degree, default: 2.0");
+	args.Option('m', "mag",     "limit magnitude, default: 16.0");
+	args.Flag  ('p', "polygon", "query with square field instead of cone");
+	args.Option('r', "seed",    "random seed, default: 1");
+	int nquery(1000), seed(1), optndx;
+	double field(2.0), magLimit(16.0);
+	bool polygon(false);
+
+	if ((optndx = args.Parse(argc, argv, [&](int ch, const char* arg) {
+		switch(ch) {
+		case 'n': nquery = atoi(arg);   break;
+		case 'd': field = atof(arg);    break;
+		case 'm': magLimit = atof(arg); break;
+		case 'p': polygon = true;       break;
+		case 'r': seed = atoi(arg);     break;
+		default: return false;
+		}
+		return true;
+	})) < 0) return -1;
+	argc -= optndx;
+	argv += optndx;
+	if (argc != 1 || nquery <= 0) {
+		args.Usage();
+		return -2;
+	}
+	BenchJson output;
+	if (!output.Open(args.pathOutput)) return -4;
+
+	ARefCatalog refcat;
+	if (!refcat.Open(argv[0])) {
+		_gLog.Write(LOG_FAULT, "failed to open catalog [%s]", argv[0]);
+		return -3;
+	}
+
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<double> uni(0.0, 1.0);
+	vector<double> latency(nquery);
+	RefStarBatch batch;
+	double nstar(0.0), mean(0.0), h = field * 0.5;
+	int i;
+
+	for (i = 0; i < nquery; ++i) {
+		double ra  = uni(rng) * 360.0;
+		double dec = asin(uni(rng) * 2.0 - 1.0) * 57.295779513082323;
+		steady_clock::time_point t0 = steady_clock::now();
+		batch.Clear();
+		if (!polygon) refcat.ConeSearch(ra, dec, h, magLimit, batch);
+		else {
+			double cosd = std::max(0.05, cos(dec / 57.295779513082323));
+			double vra[4]  = { ra - h / cosd, ra + h / cosd, ra + h / cosd, ra - h / cosd };
+			double vdec[4] = { dec - h, dec - h, dec + h, dec + h };
+			for (int j = 0; j < 4; ++j) vdec[j] = std::max(-89.9, std::min(89.9, vdec[j]));
+			refcat.PolygonSearch(vra, vdec, 4, magLimit, batch);
+		}
+		latency[i] = elapsed_ms(t0);
+		nstar += batch.Size();
+		mean  += latency[i];
+	}
+	double median = quantile(latency, 0.5), p95 = quantile(latency, 0.95), maxms = quantile(latency, 1.0);
+	printf("catalog    : %lu stars, HEALPix order %u\n", (unsigned long) refcat.Header()->nstar, refcat.Header()->order);
+	printf("query      : %s, %.2f deg, mag <= %.1f, %.1f stars per query\n", polygon ? "polygon" : "cone",
+			field, magLimit, nstar / nquery);
+	printf("latency(ms): mean %.3f, median %.3f, p95 %.3f, max %.3f\n", mean / nquery, median, p95, maxms);
+	output.Begin("catalog").Str("query", polygon ? "polygon" : "cone").Num("field_deg", field, "%.2f")
+		.Num("mag_limit", magLimit, "%.1f").Int("queries", nquery).Num("stars_per_query", nstar / nquery, "%.1f")
+		.Num("mean_ms", mean / nquery).Num("median_ms", median).Num("p95_ms", p95).Num("max_ms", maxms).End();
+
+	return 0;
+}
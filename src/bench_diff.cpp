@@ -0,0 +1,201 @@
+/*!
+ Name        : adips-bench-diff. 以合成图像评估差分成像的完整性和耗时
+ Author      : Xiaomeng Lu
+ Version     : 0.1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include "AImageSubtract.h"
+#include "SynthField.hpp"
+#include "BenchSuite.hpp"
+
+using std::vector;
+
+/*!
+ * @brief 合成星
+ */
+struct SynStar {
+	double ra, dc;	/// 赤道坐标
+	double snr;		/// 峰值信噪比, FWHM = 3像素时
+};
+
+/*!
+ * @brief 生成一帧图像. 流量守恒: 峰值随FWHM变化
+ */
+static void render(vector<float>& img, int side, const WCSTan& wcs, const vector<SynStar>& stars,
+		const vector<double>& gain, double fwhm, double sig, std::mt19937& rng) {
+	double psf = fwhm / 2.3548200450309493, psf0 = 3.0 / 2.3548200450309493, x, y;
+
+	img.resize(size_t(side) * side);
+	SynthField::FillNoise(img.data(), img.size(), 0.0, sig, rng);
+	for (size_t i = 0; i < stars.size(); ++i) {
+		if (gain[i] <= 0.0 || !wcs.SkyToPixel(stars[i].ra, stars[i].dc, x, y)) continue;
+		SynthField::AddPSF(img.data(), side, side, x, y, stars[i].snr * sig * gain[i] * psf0 * psf0 / (psf * psf), psf);
+	}
+}
+
+int main(int argc, char** argv) {
+	BenchArgs args("adips-bench-diff");
+	args.Option('w', "width",      "image width and height, default: 4096");
+	args.Option('s', "stars",      "number of stars, default: 20000");
+	args.Option('n', "transients", "number of injected transients, default: 50");
+	args.Option('v', "variables",  "number of variable stars, default: 50");
+	args.Option('c', "combine",    "number of frames combined into reference, default: 5");
+	args.Option('t', "threads",    "number of threads, 0 for all cores, default: 0");
+	args.Option('f', "frames",     "number of repeated subtractions for timing, default: 3");
+	args.Option('r', "seed",       "random seed, default: 1");
+	int side(4096), nstar(20000), ntran(50), nvar(50), ncomb(5), nthread(0), nframe(3), seed(1);
+
+	if (args.Parse(argc, argv, [&](int ch, const char* arg) {
+		switch(ch) {
+		case 'w': side = atoi(arg);    break;
+		case 's': nstar = atoi(arg);   break;
+		case 'n': ntran = atoi(arg);   break;
+		case 'v': nvar = atoi(arg);    break;
+		case 'c': ncomb = atoi(arg);   break;
+		case 't': nthread = atoi(arg); break;
+		case 'f': nframe = atoi(arg);  break;
+		case 'r': seed = atoi(arg);    break;
+		default: return false;
+		}
+		return true;
+	}) < 0) return -1;
+	if (side < 256 || nstar < 0 || ntran < 0 || nvar < 0 || nvar > nstar || ncomb < 1 || nthread < 0 || nframe < 1) {
+		args.Usage();
+		return -2;
+	}
+	BenchJson output;
+	if (!output.Open(args.pathOutput)) return -4;
+
+	ParamDiff param;
+	param.threads = nthread;
+	AImageSubtract subtract(&param);
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<double> uni(0.0, 1.0);
+	const double sig(10.0);
+	int i, f;
+
+	// 参考WCS: 1角秒/像素. 各帧指向偏移数个像素并有微小旋转
+	WCSTan wcs0;
+	wcs0.valid    = true;
+	wcs0.crval[0] = 150.0;
+	wcs0.crval[1] = 30.0;
+	wcs0.crpix[0] = wcs0.crpix[1] = side * 0.5;
+	wcs0.cd[0][0] = -1.0 / 3600.0;
+	wcs0.cd[1][1] = 1.0 / 3600.0;
+	auto pointing = [&]() {
+		WCSTan wcs(wcs0);
+		double rot = (uni(rng) - 0.5) * 0.02 * D2R, c(cos(rot)), s(sin(rot));
+		wcs.crpix[0] += (uni(rng) - 0.5) * 10.0;
+		wcs.crpix[1] += (uni(rng) - 0.5) * 10.0;
+		wcs.cd[0][0] = wcs0.cd[0][0] * c;
+		wcs.cd[0][1] = -wcs0.cd[1][1] * s;
+		wcs.cd[1][0] = wcs0.cd[0][0] * s;
+		wcs.cd[1][1] = wcs0.cd[1][1] * c;
+		return wcs;
+	};
+
+	// 恒星: 峰值信噪比在[5, 500]内对数均匀分布. 末尾为暂现源, 仅出现于科学帧
+	vector<SynStar> stars(nstar + ntran);
+	for (i = 0; i < nstar + ntran; ++i) {
+		wcs0.PixelToSky(uni(rng) * side, uni(rng) * side, stars[i].ra, stars[i].dc);
+		stars[i].snr = i < nstar ? 5.0 * pow(100.0, uni(rng)) : 10.0 + 20.0 * uni(rng);
+	}
+	vector<double> gain(nstar + ntran, 1.0);
+	for (i = nstar; i < nstar + ntran; ++i) gain[i] = 0.0;
+
+	// 参考图像
+	char pathRef[] = "/tmp/adips-bench-diff.ref";
+	vector<float> image;
+	double msRender(0.0), msComb(0.0);
+	for (f = 0; f < ncomb; ++f) {
+		WCSTan wcs = pointing();
+		steady_clock::time_point tm1 = steady_clock::now();
+		render(image, side, wcs, stars, gain, 2.4 + 0.4 * uni(rng), sig, rng);
+		msRender += elapsed_ms(tm1);
+		steady_clock::time_point tm2 = steady_clock::now();
+		if (!f) subtract.BeginCombine(side, side, wcs);
+		subtract.AddCombine(image.data(), side, side, wcs);
+		msComb += elapsed_ms(tm2);
+	}
+	steady_clock::time_point tm3 = steady_clock::now();
+	if (!subtract.EndCombine(pathRef)) {
+		printf("failed to write reference image\n");
+		return -3;
+	}
+	msComb += elapsed_ms(tm3);
+	printf("reference  : %d frames, FWHM = %.2f, noise = %.2f, %.1f ms (+%.1f ms rendering)\n",
+			ncomb, subtract.Header()->fwhm, subtract.Header()->sig, msComb, msRender);
+
+	// 科学帧: 暂现源出现, 变源流量变化 x1.5 或 x0.5
+	vector<int> vars;
+	for (i = 0; i < nstar && int(vars.size()) < nvar; ++i) {
+		if (stars[i].snr >= 20.0 && stars[i].snr <= 200.0) vars.push_back(i);
+	}
+	for (i = 0; i < int(vars.size()); ++i) gain[vars[i]] = (i & 1) ? 0.5 : 1.5;
+	for (i = nstar; i < nstar + ntran; ++i) gain[i] = 1.0;
+	WCSTan wcs = pointing();
+	render(image, side, wcs, stars, gain, 3.0, sig, rng);
+
+	DiffSrcVec srcs;
+	vector<double> ms(nframe);
+	double fwhm, fwhmRef, scale;
+	bool reuse;
+	for (f = 0; f < nframe; ++f) {
+		subtract.Subtract(image.data(), side, side, wcs, sig, srcs);
+		ms[f] = subtract.LastStat(fwhm, fwhmRef, scale, reuse);
+	}
+
+	// 评估: 位置偏差不超过1.5像素, 分类一致
+	vector<int> found(nstar + ntran, 0);
+	int nfalse(0), nwrong(0), ntr(0), nvr(0);
+	double x, y;
+	vector<double> px(nstar + ntran), py(nstar + ntran);
+	for (i = 0; i < nstar + ntran; ++i) wcs.SkyToPixel(stars[i].ra, stars[i].dc, px[i], py[i]);
+	for (DiffSrcVec::iterator it = srcs.begin(); it != srcs.end(); ++it) {
+		int best(-1);
+		double d2, d2min(2.25);
+		for (i = 0; i < nstar + ntran; ++i) {
+			if (i < nstar && gain[i] == 1.0) continue;
+			x = px[i] - it->ptCenter.x;
+			y = py[i] - it->ptCenter.y;
+			if ((d2 = x * x + y * y) < d2min) {
+				d2min = d2;
+				best  = i;
+			}
+		}
+		if (best < 0) ++nfalse;
+		else {
+			int type = best >= nstar ? 1 : (gain[best] > 1.0 ? 2 : 3);
+			if (type == it->type) found[best] = 1;
+			else ++nwrong;
+		}
+	}
+	for (i = 0; i < nstar; ++i) nvr += found[i];
+	for (i = nstar; i < nstar + ntran; ++i) ntr += found[i];
+
+	double msFirst(ms[0]), msReuse(ms[0]);
+	if (nframe > 1) {
+		vector<double> reuse(ms.begin() + 1, ms.end());
+		msReuse = quantile(reuse, 0.5);
+	}
+	printf("sources    : %d detected, %d false, %d misclassified\n", int(srcs.size()), nfalse, nwrong);
+	printf("transients : %d / %d recovered\n", ntr, ntran);
+	printf("variables  : %d / %d recovered\n", nvr, int(vars.size()));
+	printf("PSF match  : FWHM = %.2f, reference = %.2f, scale = %.3f\n", fwhm, fwhmRef, scale);
+	printf("latency(ms): first %.1f, aligned reference reused: median %.1f\n", msFirst, msReuse);
+	output.Begin("diff").Int("width", side).Int("height", side).Int("stars", nstar).Int("combine", ncomb)
+		.Int("detected", int(srcs.size())).Int("false", nfalse).Int("misclassified", nwrong)
+		.Int("transients", ntran).Int("transients_recovered", ntr)
+		.Int("variables", int(vars.size())).Int("variables_recovered", nvr)
+		.Num("combine_ms", msComb, "%.1f").Num("first_ms", msFirst, "%.1f").Num("median_ms", msReuse, "%.1f").End();
+	unlink(pathRef);
+
+	return 0;
+}
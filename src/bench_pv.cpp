@@ -0,0 +1,176 @@
+/*!
+ Name        : adips-bench-pv. 以合成小行星序列评估运动目标关联的召回率和耗时
+ Author      : Xiaomeng Lu
+ Version     : 0.1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include "APVLinker.h"
+#include "BenchSuite.hpp"
+
+using std::vector;
+
+/*!
+ * @brief 合成目标
+ */
+struct SynObject {
+	double x, y;	/// 初始位置, 量纲: 角秒
+	double vx, vy;	/// 速度, 量纲: 角秒/秒
+};
+
+int main(int argc, char** argv) {
+	BenchArgs args("adips-bench-pv");
+	args.Option('f', "frames",    "number of frames, default: 10");
+	args.Option('c', "cadence",   "cadence in seconds, default: 60");
+	args.Option('d', "field",     "field of view in degree, default: 2.0");
+	args.Option('s', "stars",     "number of static stars, default: 20000");
+	args.Option('a', "asteroids", "number of asteroids, default: 200");
+	args.Option('t', "transient", "number of false transients per frame, default: 1000");
+	args.Option('p', "prob",      "detection probability of asteroids, default: 0.9");
+	args.Option('r', "seed",      "random seed, default: 1");
+	int nframe(10), nstar(20000), nast(200), ntrans(1000), seed(1);
+	double cadence(60.0), field(2.0), prob(0.9);
+
+	if (args.Parse(argc, argv, [&](int ch, const char* arg) {
+		switch(ch) {
+		case 'f': nframe = atoi(arg);  break;
+		case 'c': cadence = atof(arg); break;
+		case 'd': field = atof(arg);   break;
+		case 's': nstar = atoi(arg);   break;
+		case 'a': nast = atoi(arg);    break;
+		case 't': ntrans = atoi(arg);  break;
+		case 'p': prob = atof(arg);    break;
+		case 'r': seed = atoi(arg);    break;
+		default: return false;
+		}
+		return true;
+	}) < 0) return -1;
+	if (nframe < 3 || cadence <= 0.0 || field <= 0.0 || nast < 0 || nstar < 0 || ntrans < 0) {
+		args.Usage();
+		return -2;
+	}
+	BenchJson output;
+	if (!output.Open(args.pathOutput)) return -4;
+
+	ParamMotion param;
+	APVLinker linker(&param);
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<double> uni(0.0, 1.0);
+	std::normal_distribution<double> gauss(0.0, 0.3);
+	double side = field * 3600.0;
+	int i, f;
+
+	// 静态源和小行星. 速度在速度范围内均匀分布
+	vector<SynObject> stars(nstar), asteroids(nast);
+	for (i = 0; i < nstar; ++i) {
+		stars[i].x = uni(rng) * side;
+		stars[i].y = uni(rng) * side;
+	}
+	double rmin = std::max(param.rateMin, param.rStatic * 2.0 / cadence);
+	for (i = 0; i < nast; ++i) {
+		double rate = rmin + (param.rateMax * 0.9 - rmin) * uni(rng);
+		double pa   = uni(rng) * 2.0 * M_PI;
+		asteroids[i].x  = uni(rng) * side;
+		asteroids[i].y  = uni(rng) * side;
+		asteroids[i].vx = rate * cos(pa);
+		asteroids[i].vy = rate * sin(pa);
+	}
+
+	// 逐帧关联. truth: 目标来源, >= 0: 小行星编号; -1: 静态源; -2: 假暂现源
+	vector<vector<int> > truth(nframe);
+	vector<double> x, y, ms(nframe);
+	vector<int> status;
+	PVTrackletVec tracklets, finished;
+	double nTransient(0.0);
+
+	for (f = 0; f < nframe; ++f) {
+		double t = f * cadence;
+		vector<int>& src = truth[f];
+		x.clear();
+		y.clear();
+		src.clear();
+		for (i = 0; i < nstar; ++i) {
+			x.push_back(stars[i].x + gauss(rng));
+			y.push_back(stars[i].y + gauss(rng));
+			src.push_back(-1);
+		}
+		for (i = 0; i < nast; ++i) {
+			double ax = asteroids[i].x + asteroids[i].vx * t, ay = asteroids[i].y + asteroids[i].vy * t;
+			if (uni(rng) > prob || ax < 0.0 || ay < 0.0 || ax >= side || ay >= side) continue;
+			x.push_back(ax + gauss(rng));
+			y.push_back(ay + gauss(rng));
+			src.push_back(i);
+		}
+		for (i = 0; i < ntrans; ++i) {
+			x.push_back(uni(rng) * side);
+			y.push_back(uni(rng) * side);
+			src.push_back(-2);
+		}
+		status.resize(x.size());
+		linker.AddFrame(t, int(x.size()), x.data(), y.data(), status.data());
+		int ntr;
+		ms[f] = linker.LastStat(ntr);
+		nTransient += ntr;
+		linker.TakeFinished(finished);
+		tracklets.insert(tracklets.end(), finished.begin(), finished.end());
+	}
+	linker.Flush();
+	linker.TakeFinished(finished);
+	tracklets.insert(tracklets.end(), finished.begin(), finished.end());
+
+	// 评估: 轨迹段内多数点来自同一小行星且该小行星检测数不少于3时计为召回
+	vector<int> found(nast, 0), ndet(nast, 0);
+	int nfalse(0), npure(0);
+	for (f = 0; f < nframe; ++f) {
+		for (vector<int>::iterator it = truth[f].begin(); it != truth[f].end(); ++it) {
+			if (*it >= 0) ++ndet[*it];
+		}
+	}
+	for (PVTrackletVec::iterator it = tracklets.begin(); it != tracklets.end(); ++it) {
+		vector<int> votes;
+		for (vector<PVPoint>::iterator pt = it->pts.begin(); pt != it->pts.end(); ++pt)
+			votes.push_back(truth[pt->frame][pt->body]);
+		std::sort(votes.begin(), votes.end());
+		int best(-3), nbest(0), j, k;
+		for (j = 0; j < int(votes.size()); j = k) {
+			for (k = j; k < int(votes.size()) && votes[k] == votes[j]; ++k);
+			if (k - j > nbest) {
+				nbest = k - j;
+				best  = votes[j];
+			}
+		}
+		if (best < 0 || nbest * 2 <= int(votes.size())) ++nfalse;
+		else {
+			found[best] = 1;
+			if (nbest == int(votes.size())) ++npure;
+		}
+	}
+	int nlinkable(0), nrecall(0);
+	for (i = 0; i < nast; ++i) {
+		if (ndet[i] >= int(param.minFrames)) {
+			++nlinkable;
+			nrecall += found[i];
+		}
+	}
+	double mean(0.0);
+	for (f = 0; f < nframe; ++f) mean += ms[f];
+	mean /= nframe;
+	printf("sequence   : %d frames, cadence %.0f s, %d stars, %d asteroids, %d false transients per frame\n",
+			nframe, cadence, nstar, nast, ntrans);
+	printf("transient  : %.1f per frame after static removal\n", nTransient / nframe);
+	printf("recall     : %.1f%% (%d / %d linkable asteroids)\n",
+			nlinkable ? nrecall * 100.0 / nlinkable : 0.0, nrecall, nlinkable);
+	printf("tracklets  : %d, pure %d, false %d\n", int(tracklets.size()), npure, nfalse);
+	printf("latency(ms): mean %.2f, median %.2f, max %.2f per frame\n", mean, quantile(ms, 0.5), quantile(ms, 1.0));
+	output.Begin("pv").Int("frames", nframe).Num("cadence_s", cadence, "%.0f").Int("stars", nstar)
+		.Int("asteroids", nast).Int("transients_per_frame", ntrans).Int("linkable", nlinkable).Int("recovered", nrecall)
+		.Int("tracklets", int(tracklets.size())).Int("pure", npure).Int("false", nfalse)
+		.Num("mean_ms", mean, "%.2f").Num("median_ms", quantile(ms, 0.5), "%.2f").Num("max_ms", quantile(ms, 1.0), "%.2f").End();
+
+	return 0;
+}
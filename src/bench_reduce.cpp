@@ -0,0 +1,523 @@
+/*!
+ Name        : adips-bench-reduce. 以合成星场评估预处理各步骤及完整处理流程的耗时
+ Author      : Xiaomeng Lu
+ Version     : 0.1
+ Note        :
+ - 步骤评估: 本底/暗场/平场改正, 全局背景, 网格背景, 坏像素. 各步骤重复执行, 输出耗时中值与最小值
+ - 流程评估: 以内存数据逐帧送入ADIWorkFlow, 输出吞吐率和单帧延迟
+ - 一致性验证: 各指令集版本的像素运算核处理同一帧, 与标量参考实现比较结果; 同一帧分带处理与整帧处理比较结果
+ - 结果以JSON Lines格式输出, 每行一项评估, 便于比较不同版本
+ - 日志写入标准错误
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+#include <deque>
+#include <string>
+#include <algorithm>
+#include <boost/bind/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <longnam.h>
+#include <fitsio.h>
+#include "ADIReduce.h"
+#include "ADIWorkFlow.h"
+#include "AKernels.h"
+#include "SynthField.hpp"
+#include "BenchSuite.hpp"
+#include "GLog.h"
+
+using std::vector;
+using namespace boost::placeholders;
+typedef boost::unique_lock<boost::mutex> mutex_lock;
+
+GLog _gLog(stderr);
+
+/*!
+ * @brief 开放ADIReduce的处理步骤, 用于逐项计时
+ */
+class BenchReduce : public ADIReduce {
+public:
+	BenchReduce(Parameter* param)
+		: ADIReduce(param) {
+	}
+
+public:
+	/*!
+	 * @brief 关联科学图像和预处理图像
+	 */
+	void Attach(float* data, float* zero, float* dark, float* flat, unsigned w, unsigned h, float expdur) {
+		frame_.reset(new ImageFrame);
+		frame_->filename = "bench";
+		frame_->wImg = w;
+		frame_->hImg = h;
+		fitsImg_.Attach(data, w, h, expdur, "2021-05-01T12:00:00");
+		fitsZero_.Attach(zero, w, h, 0.0f, "");
+		fitsDark_.Attach(dark, w, h, 0.0f, "");
+		fitsFlat_.Attach(flat, w, h, 0.0f, "");
+		loadPreprocZero_ = loadPreprocDark_ = loadPreprocFlat_ = 1;
+	}
+
+	void Calibrate() {
+		preprocess_zero();
+		preprocess_dark();
+		preprocess_flat();
+	}
+
+	void BackGlobal() {
+		back_stat_global();
+	}
+
+	void BackGrid() {
+		back_stat_grid();
+	}
+
+	void BadPixel() {
+		bad_pixels_remove();
+	}
+
+	void Background(double& mean, double& sig) {
+		mean = frame_->bkMean;
+		sig  = frame_->bkSigma;
+	}
+
+	/*!
+	 * @brief 在当前线程处理一帧
+	 */
+	bool Process(ImgFrmPtr frame) {
+		frame_ = frame;
+		return do_real_process();
+	}
+
+	/*!
+	 * @brief 背景网格
+	 */
+	void Grid(vector<float>& mean, vector<float>& sig) {
+		size_t n = size_t(buffPtr_->nbkx) * buffPtr_->nbky;
+		mean.assign(buffPtr_->mean, buffPtr_->mean + n);
+		sig.assign(buffPtr_->sig, buffPtr_->sig + n);
+	}
+};
+
+/*!
+ * @brief 评估结果输出
+ */
+struct BenchOutput : public BenchJson {
+	/*!
+	 * @brief 单项步骤: 耗时中值、最小值和像素吞吐率
+	 */
+	void Kernel(const char* name, unsigned w, unsigned h, vector<double>& ms) {
+		double med = quantile(ms, 0.5);
+		Begin(name).Str("kernels", AKernels::Get().name).Int("width", w).Int("height", h).Int("runs", int(ms.size()))
+			.Num("median_ms", med).Num("min_ms", ms[0]).Num("mpix_per_s", double(w) * h * 1E-3 / med, "%.1f").End();
+	}
+
+	/*!
+	 * @brief 完整流程: 吞吐率和单帧延迟
+	 */
+	void Pipeline(unsigned w, unsigned h, int frames, double sec, vector<double>& latency) {
+		Begin("pipeline").Str("kernels", AKernels::Get().name).Int("width", w).Int("height", h).Int("frames", frames)
+			.Num("seconds", sec).Num("frames_per_s", frames / sec).Num("mpix_per_s", double(w) * h * 1E-6 * frames / sec, "%.1f")
+			.Num("latency_median_ms", quantile(latency, 0.5), "%.1f").Num("latency_max_ms", quantile(latency, 1.0), "%.1f").End();
+	}
+
+	/*!
+	 * @brief 一致性验证: 与标量参考实现的最大差异和背景统计差异
+	 */
+	void Verify(unsigned w, unsigned h, double maxDiff, size_t ndiff, double dMean, double dSig) {
+		Begin("verify").Str("kernels", AKernels::Get().name).Int("width", w).Int("height", h)
+			.Num("max_abs_diff", maxDiff, "%.3g").Int("diff_pixels", long(ndiff))
+			.Num("bk_mean_diff", dMean, "%.3g").Num("bk_sigma_diff", dSig, "%.3g").End();
+	}
+
+	/*!
+	 * @brief 分带处理与整帧处理比较
+	 */
+	void VerifyBand(unsigned w, unsigned h, unsigned rows, size_t nbody, size_t ndiffBody, size_t ndiffGrid,
+			double dMean, double dSig) {
+		Begin("verify.band").Str("kernels", AKernels::Get().name).Int("width", w).Int("height", h)
+			.Int("band_rows", rows).Int("bodies", long(nbody)).Int("body_diffs", long(ndiffBody)).Int("grid_diffs", long(ndiffGrid))
+			.Num("bk_mean_diff", dMean, "%.3g").Num("bk_sigma_diff", dSig, "%.3g").End();
+	}
+};
+
+/*!
+ * @brief 以固定数量的缓存区循环送入处理流程. 缓存区在降噪环节完成后归还
+ */
+struct BenchSlots {
+	boost::mutex mtx;
+	boost::condition_variable cv;
+	vector<vector<float> > buffs;
+	std::deque<int> idle;
+	vector<double> latency;
+	int done;
+
+public:
+	BenchSlots(int n, size_t pixels) {
+		buffs.resize(n);
+		for (int i = 0; i < n; ++i) {
+			buffs[i].resize(pixels);
+			idle.push_back(i);
+		}
+		done = 0;
+	}
+
+	int Acquire() {
+		mutex_lock lck(mtx);
+		while (idle.empty()) cv.wait(lck);
+		int i = idle.front();
+		idle.pop_front();
+		return i;
+	}
+
+	void Release(int i) {
+		mutex_lock lck(mtx);
+		idle.push_back(i);
+		cv.notify_all();
+	}
+
+	void FrameResult(ImgFrmPtr frame) {
+		double ms = std::chrono::duration<double, std::milli>(steady_clock::now() - frame->tmArrive).count();
+		mutex_lock lck(mtx);
+		latency.push_back(ms);
+		++done;
+		cv.notify_all();
+	}
+
+	void Wait(int n) {
+		mutex_lock lck(mtx);
+		while (done < n) cv.wait(lck);
+	}
+};
+
+/*!
+ * @brief 生成预处理图像: 本底100ADU; 暗流0.1ADU/秒; 平场沿X方向变化±2%
+ */
+static void make_calib(unsigned w, size_t pixels, vector<float>& zero, vector<float>& dark, vector<float>& flat) {
+	zero.resize(pixels);
+	dark.resize(pixels);
+	flat.resize(pixels);
+	for (size_t i = 0; i < pixels; ++i) {
+		zero[i] = 100.0f;
+		dark[i] = 0.1f;
+		flat[i] = 1.0f + 0.02f * (float(i % w) / w - 0.5f);
+	}
+}
+
+/*!
+ * @brief 逐项评估预处理步骤
+ */
+static void bench_kernels(Parameter* param, const vector<float>& raw, unsigned w, unsigned h, int runs, BenchOutput& output) {
+	size_t pixels = size_t(w) * h;
+	vector<float> data(pixels), zero, dark, flat;
+	make_calib(w, pixels, zero, dark, flat);
+
+	BenchReduce reduce(param);
+	reduce.Attach(data.data(), zero.data(), dark.data(), flat.data(), w, h, 10.0f);
+	vector<double> tCalib, tGlobal, tGrid, tBad;
+	steady_clock::time_point t0;
+
+	for (int k = 0; k < runs; ++k) {
+		// 各步骤均从原始数据开始, 复制不计时
+		memcpy(data.data(), raw.data(), pixels * sizeof(float));
+		t0 = steady_clock::now();
+		reduce.Calibrate();
+		tCalib.push_back(elapsed_ms(t0));
+
+		t0 = steady_clock::now();
+		reduce.BackGlobal();
+		tGlobal.push_back(elapsed_ms(t0));
+
+		t0 = steady_clock::now();
+		reduce.BackGrid();
+		tGrid.push_back(elapsed_ms(t0));
+
+		memcpy(data.data(), raw.data(), pixels * sizeof(float));
+		t0 = steady_clock::now();
+		reduce.BadPixel();
+		tBad.push_back(elapsed_ms(t0));
+	}
+	output.Kernel("calibrate",         w, h, tCalib);
+	output.Kernel("background.global", w, h, tGlobal);
+	output.Kernel("background.grid",   w, h, tGrid);
+	output.Kernel("badpixel",          w, h, tBad);
+}
+
+/*!
+ * @brief 以当前运算核处理一帧: 预处理、全局背景、坏像素
+ */
+static void verify_run(Parameter* param, const vector<float>& raw, unsigned w, unsigned h,
+		vector<float>& data, double& mean, double& sig) {
+	size_t pixels = size_t(w) * h;
+	vector<float> zero, dark, flat;
+	make_calib(w, pixels, zero, dark, flat);
+	data = raw;
+
+	BenchReduce reduce(param);
+	reduce.Attach(data.data(), zero.data(), dark.data(), flat.data(), w, h, 10.0f);
+	reduce.Calibrate();
+	reduce.BackGlobal();
+	reduce.BadPixel();
+	reduce.Background(mean, sig);
+}
+
+/*!
+ * @brief 各指令集版本与标量参考实现比较
+ */
+static void verify_kernels(Parameter* param, const vector<float>& raw, unsigned w, unsigned h, BenchOutput& output) {
+	vector<std::string> names;
+	vector<float> ref, data;
+	double meanRef, sigRef, mean, sig;
+	AKernels::Supported(names);
+	AKernels::Select("scalar");
+	verify_run(param, raw, w, h, ref, meanRef, sigRef);
+
+	for (size_t j = 0; j < names.size(); ++j) {
+		AKernels::Select(names[j]);
+		verify_run(param, raw, w, h, data, mean, sig);
+		double maxDiff(0.0), d;
+		size_t ndiff(0);
+		for (size_t i = 0; i < data.size(); ++i) {
+			if (data[i] != ref[i]) {
+				++ndiff;
+				if ((d = fabs(double(data[i]) - ref[i])) > maxDiff) maxDiff = d;
+			}
+		}
+		output.Verify(w, h, maxDiff, ndiff, mean - meanRef, sig - sigRef);
+	}
+}
+
+/*!
+ * @brief 写入FITS文件
+ */
+static bool write_fits(const std::string& filepath, const float* data, unsigned w, unsigned h, float expdur) {
+	fitsfile* hFits;
+	long naxes[2] = { long(w), long(h) };
+	int state(0);
+
+	fits_create_file(&hFits, (std::string("!") + filepath).c_str(), &state);
+	if (state) return false;
+	fits_create_img(hFits, FLOAT_IMG, 2, naxes, &state);
+	fits_write_key(hFits, TSTRING, "DATE-OBS", (void*) "2021-05-01T12:00:00", "exposure start time (UTC)", &state);
+	fits_write_key(hFits, TFLOAT,  "EXPTIME",  &expdur, "exposure time (s)", &state);
+	fits_write_img(hFits, TFLOAT, 1, size_t(w) * h, (void*) data, &state);
+	int closeState(0);
+	fits_close_file(hFits, &closeState);
+	return !(state || closeState);
+}
+
+/*!
+ * @brief 以文件处理一帧: 预处理、背景、坏像素和信号提取
+ * @param rows  分带处理时每带行数. 0: 整帧处理
+ */
+static bool verify_file(const Parameter* param, const std::string& filepath, unsigned rows,
+		CeleBodyVec& bodies, vector<float>& gridMean, vector<float>& gridSig, double& mean, double& sig) {
+	Parameter p = *param;
+	p.preProc.bandRows    = rows;
+	p.preProc.bandMinMPix = 0;
+
+	BenchReduce reduce(&p);
+	ImgFrmPtr frame(new ImageFrame);
+	frame->filepath = filepath;
+	frame->filename = "bench.band";
+	if (!reduce.Process(frame)) return false;
+	bodies = frame->bodies;
+	reduce.Background(mean, sig);
+	reduce.Grid(gridMean, gridSig);
+	return true;
+}
+
+/*!
+ * @brief 分带处理与整帧处理比较. 全局背景由网格合并, 允许存在差异; 网格和目标应完全一致
+ */
+static void verify_band(const Parameter* param, const vector<float>& raw, unsigned w, unsigned h, BenchOutput& output) {
+	char pathDir[] = "/tmp/adips-bench-band.XXXXXX";
+	if (!mkdtemp(pathDir)) return;
+	std::string dir(pathDir), pathImg(dir + "/image.fit"), pathZero(dir + "/zero.fit");
+	std::string pathDark(dir + "/dark.fit"), pathFlat(dir + "/flat.fit");
+	size_t pixels = size_t(w) * h;
+	vector<float> zero, dark, flat;
+	make_calib(w, pixels, zero, dark, flat);
+
+	Parameter p = *param;
+	p.preProc.pathZero     = pathZero;
+	p.preProc.pathDark     = pathDark;
+	p.preProc.pathFlat     = pathFlat;
+	p.preProc.badPixRemove = true;
+	p.sigExtract.enable    = true;
+	p.streak.enable        = false;
+	p.preview.enable       = false;
+	// 带高不取网格高度的整数倍, 同时验证取整
+	unsigned rows = h / 5 + 1;
+
+	CeleBodyVec bodyFull, bodyBand;
+	vector<float> meanFull, sigFull, meanBand, sigBand;
+	double bkMeanFull, bkSigFull, bkMeanBand, bkSigBand;
+	if (write_fits(pathImg, raw.data(), w, h, 10.0f) && write_fits(pathZero, zero.data(), w, h, 0.0f)
+			&& write_fits(pathDark, dark.data(), w, h, 0.0f) && write_fits(pathFlat, flat.data(), w, h, 0.0f)
+			&& verify_file(&p, pathImg, 0,    bodyFull, meanFull, sigFull, bkMeanFull, bkSigFull)
+			&& verify_file(&p, pathImg, rows, bodyBand, meanBand, sigBand, bkMeanBand, bkSigBand)) {
+		size_t ndiffBody(0), ndiffGrid(0), i, n;
+		n = std::min(bodyFull.size(), bodyBand.size());
+		ndiffBody = std::max(bodyFull.size(), bodyBand.size()) - n;
+		for (i = 0; i < n; ++i) {
+			const CelestialBody &a = bodyFull[i], &b = bodyBand[i];
+			if (a.ptBary.x != b.ptBary.x || a.ptBary.y != b.ptBary.y || a.flux != b.flux
+					|| a.area != b.area || a.snr != b.snr || a.a != b.a || a.b != b.b)
+				++ndiffBody;
+		}
+		if (meanFull.size() != meanBand.size()) ndiffGrid = std::max(meanFull.size(), meanBand.size());
+		else {
+			for (i = 0; i < meanFull.size(); ++i) {
+				if (meanFull[i] != meanBand[i] || sigFull[i] != sigBand[i]) ++ndiffGrid;
+			}
+		}
+		output.VerifyBand(w, h, rows, bodyFull.size(), ndiffBody, ndiffGrid, bkMeanBand - bkMeanFull, bkSigBand - bkSigFull);
+	}
+	else _gLog.Write(LOG_FAULT, "band verification failed on %u x %u", w, h);
+
+	remove(pathImg.c_str());
+	remove(pathZero.c_str());
+	remove(pathDark.c_str());
+	remove(pathFlat.c_str());
+	rmdir(pathDir);
+}
+
+/*!
+ * @brief 评估完整处理流程
+ */
+static void bench_pipeline(Parameter* param, const vector<float>& raw, unsigned w, unsigned h, int frames, BenchOutput& output) {
+	int nslot = param->budget.frames ? int(param->budget.frames) : 2;
+	size_t pixels = size_t(w) * h;
+	BenchSlots slots(std::min(nslot, frames), pixels);
+	ADIWorkFlow workflow;
+	workflow.RegisterFrame(boost::bind(&BenchSlots::FrameResult, &slots, _1));
+	if (!workflow.Start(param)) {
+		_gLog.Write(LOG_FAULT, "failed to start pipeline");
+		return;
+	}
+
+	steady_clock::time_point t0 = steady_clock::now();
+	for (int k = 0; k < frames; ++k) {
+		// 复制计入耗时: 相当于相机读出后写入缓存区
+		int i = slots.Acquire();
+		float* buff = slots.buffs[i].data();
+		memcpy(buff, raw.data(), pixels * sizeof(float));
+
+		char name[40], dateobs[40];
+		sprintf(name, "bench%04d", k + 1);
+		SynthField::DateObs(k, dateobs);
+		ImgFrmPtr frame(new ImageFrame);
+		frame->filename = name;
+		frame->filetit  = name;
+		frame->dateobs  = dateobs;
+		frame->wImg     = w;
+		frame->hImg     = h;
+		frame->expdur   = 10.0;
+		frame->dataRaw  = boost::shared_array<float>(buff, [&slots, i](float*) { slots.Release(i); });
+		workflow.ProcessImage(frame);
+	}
+	slots.Wait(frames);
+	double sec = elapsed_ms(t0) * 1E-3;
+	workflow.Stop();
+	output.Pipeline(w, h, frames, sec, slots.latency);
+}
+
+int main(int argc, char** argv) {
+	BenchArgs args("adips-bench-reduce");
+	args.Option('s', "sizes",   "comma separated image sizes, default: 4096,9216,12288");
+	args.Option('m', "mode",    "kernel, pipeline, verify or all, default: all");
+	args.Option('k', "kernels", "pixel kernels, auto, all or one of scalar, sse2, avx2, avx512, default: auto");
+	args.Option('n', "runs",    "number of repeated runs per kernel, default: 5");
+	args.Option('f', "frames",  "number of frames per pipeline run, default: 8");
+	args.Option('c', "config",  "pipeline configuration file, default: built-in, reduction only");
+	args.Option('r', "seed",    "random seed, default: 1");
+	int runs(5), frames(8), seed(1);
+	std::string sizes("4096,9216,12288"), mode("all"), kernels("auto"), config;
+
+	if (args.Parse(argc, argv, [&](int ch, const char* arg) {
+		switch(ch) {
+		case 's': sizes = arg;        break;
+		case 'm': mode = arg;         break;
+		case 'k': kernels = arg;      break;
+		case 'n': runs = atoi(arg);   break;
+		case 'f': frames = atoi(arg); break;
+		case 'c': config = arg;       break;
+		case 'r': seed = atoi(arg);   break;
+		default: return false;
+		}
+		return true;
+	}) < 0) return -1;
+	vector<unsigned> sides;
+	for (char* tok = strtok(&sizes[0], ","); tok; tok = strtok(NULL, ",")) sides.push_back(unsigned(atoi(tok)));
+	bool doKernel = mode == "all" || mode == "kernel", doPipeline = mode == "all" || mode == "pipeline";
+	bool doVerify = mode == "all" || mode == "verify";
+	// 运算核: all依次评估CPU支持的全部版本
+	vector<std::string> isas;
+	if (kernels == "all") AKernels::Supported(isas);
+	else if (kernels == "auto" || AKernels::Find(kernels)) isas.push_back(kernels);
+	else {
+		printf("pixel kernels [%s] not supported\n", kernels.c_str());
+		return -2;
+	}
+	if (sides.empty() || runs < 1 || frames < 1 || (!doKernel && !doPipeline && !doVerify)
+			|| std::find_if(sides.begin(), sides.end(), [](unsigned s) { return s < 256; }) != sides.end()) {
+		args.Usage();
+		return -2;
+	}
+
+	// 配置参数: 未指定时使用缺省参数, 仅执行降噪环节
+	Parameter param;
+	if (config.empty()) {
+		char pathTmp[] = "/tmp/adips-bench-reduce.XXXXXX";
+		int fd = mkstemp(pathTmp);
+		if (fd < 0) return -3;
+		close(fd);
+		param.Init(pathTmp);
+		bool rslt = param.Load(pathTmp);
+		remove(pathTmp);
+		if (!rslt) return -3;
+		param.funcs.useAstrometry = param.funcs.useDiff = param.funcs.usePhotometry = param.funcs.useMotion = false;
+		param.output.rsltInter = param.output.rsltFinal = false;
+		param.output.pathManifest.clear();
+		param.trace.enable = false;
+		param.budget.frames = 2;
+	}
+	else if (!param.Load(config)) {
+		printf("failed to load configuration file [%s]\n", config.c_str());
+		return -3;
+	}
+
+	BenchOutput output;
+	if (!output.Open(args.pathOutput)) return -4;
+
+	for (size_t j = 0; j < sides.size(); ++j) {
+		unsigned side = sides[j];
+		SynthParam synpar;
+		SynthField field;
+		synpar.width = synpar.height = side;
+		synpar.seed  = uint32_t(seed);
+		field.Reset(synpar);
+		// 合成图像叠加预处理图像中的本底和暗流
+		vector<float> raw(size_t(side) * side);
+		field.Generate(0, raw.data());
+		for (size_t i = 0; i < raw.size(); ++i) raw[i] += 101.0f;
+
+		if (doVerify) {
+			verify_kernels(&param, raw, side, side, output);
+			verify_band(&param, raw, side, side, output);
+		}
+		for (size_t k = 0; k < isas.size(); ++k) {
+			AKernels::Select(isas[k]);
+			param.kernels.isa = isas[k];
+			if (doKernel)   bench_kernels(&param, raw, side, side, runs, output);
+			if (doPipeline) bench_pipeline(&param, raw, side, side, frames, output);
+		}
+	}
+
+	return 0;
+}
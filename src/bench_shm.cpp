@@ -0,0 +1,159 @@
+/*!
+ Name        : adips-bench-shm. 模拟采集进程, 经共享内存环形缓存区发布合成图像帧,
+               评估传输延迟和吞吐量
+ Author      : Xiaomeng Lu
+ Version     : 0.1
+ @note
+ - 默认仅作为生产者, 由adips --shm <name>消费
+ - -l: 创建子进程作为消费者, 接收帧后模拟处理耗时并归还, 统计发布至接收的延迟
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include "AShmRing.h"
+#include "SynthField.hpp"
+#include "BenchSuite.hpp"
+
+using std::vector;
+
+/*!
+ * @brief 消费者子进程: 接收帧, 统计发布至接收的延迟
+ */
+static int consume(const char* name, int msProc, const std::string& pathOutput) {
+	AShmRing ring;
+	for (int i = 0; i < 100 && !ring.Open(name); ++i) usleep(10000);
+	if (!ring.IsOpen()) {
+		printf("consumer: failed to open [%s]\n", name);
+		return -1;
+	}
+
+	vector<double> lat;
+	double sum(0.0);
+	int i;
+	while ((i = ring.Wait(-1)) >= 0) {
+		ShmSlot* slot = ring.Slot(i);
+		lat.push_back((AShmRing::Now() - slot->tmReady) * 1E-3);
+		// 读取部分像素, 模拟处理流程访问数据
+		const float* data = ring.Data(i);
+		for (unsigned k = 0; k < slot->w * slot->h; k += 1024) sum += data[k];
+		if (msProc > 0) usleep(msProc * 1000);
+		ring.Release(i);
+	}
+
+	int n = int(lat.size());
+	if (n) {
+		std::sort(lat.begin(), lat.end());
+		printf("consumer   : %d frames, publish-to-receive latency(us): median %.1f, 99%% %.1f, max %.1f\n",
+				n, lat[n / 2], lat[n * 99 / 100], lat[n - 1]);
+		fflush(stdout);
+		BenchJson output;
+		if (output.Open(pathOutput)) {
+			output.Begin("shm.consumer").Int("frames", n).Num("latency_median_us", lat[n / 2], "%.1f")
+				.Num("latency_p99_us", lat[n * 99 / 100], "%.1f").Num("latency_max_us", lat[n - 1], "%.1f").End();
+		}
+	}
+	return sum == 0.5 ? 1 : 0;	// 防止读取被优化
+}
+
+int main(int argc, char** argv) {
+	BenchArgs args("adips-bench-shm");
+	args.Option('n', "name",     "shared memory name, default: /adips-shm");
+	args.Option('w', "width",    "image width and height, default: 4096");
+	args.Option('s', "slots",    "number of slots, default: 4");
+	args.Option('f', "frames",   "number of frames, default: 100");
+	args.Option('r', "rate",     "frames per second, 0 for as fast as possible, default: 0");
+	args.Flag  ('l', "loopback", "consume frames in a child process instead of adips");
+	args.Option('p', "process",  "simulated processing time per frame in loopback mode, ms, default: 0");
+	int side(4096), nslot(4), nframe(100), msProc(0);
+	double rate(0.0);
+	bool loopback(false);
+	std::string name("/adips-shm");
+
+	if (args.Parse(argc, argv, [&](int ch, const char* arg) {
+		switch(ch) {
+		case 'n': name = arg;          break;
+		case 'w': side = atoi(arg);    break;
+		case 's': nslot = atoi(arg);   break;
+		case 'f': nframe = atoi(arg);  break;
+		case 'r': rate = atof(arg);    break;
+		case 'l': loopback = true;     break;
+		case 'p': msProc = atoi(arg);  break;
+		default: return false;
+		}
+		return true;
+	}) < 0) return -1;
+	if (side < 64 || nslot < 1 || nframe < 1 || rate < 0.0 || msProc < 0) {
+		args.Usage();
+		return -2;
+	}
+
+	AShmRing ring;
+	if (!ring.Create(name.c_str(), nslot, side, side)) {
+		printf("failed to create shared memory [%s]\n", name.c_str());
+		return -3;
+	}
+	printf("ring       : [%s], %d slots of %dx%d, %.1f MB\n", name.c_str(), nslot, side, side,
+			ring.Header()->slotBytes * nslot / 1048576.0);
+	fflush(stdout);
+
+	pid_t pid(0);
+	if (loopback && !(pid = fork())) return consume(name.c_str(), msProc, args.pathOutput);
+
+	// 合成图像: 噪声背景和随机分布的星. 每帧在模板上叠加帧序号, 模拟相机写入
+	size_t pixels = size_t(side) * side;
+	vector<float> frame(pixels);
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<double> pos(0.0, side);
+	SynthField::FillNoise(frame.data(), pixels, 1000.0, 10.0, rng);
+	for (int j = 0; j < side * side / 2000; ++j) {
+		double x(pos(rng)), y(pos(rng));
+		SynthField::AddPSF(frame.data(), side, side, x, y, 2000.0, M_SQRT2);
+	}
+	if (!loopback) {
+		printf("waiting for consumer: adips --shm %s\n", name.c_str());
+		fflush(stdout);
+	}
+
+	char fname[64], dateobs[32];
+	int64_t t0 = AShmRing::Now(), tNext(t0), tStall(0), t1;
+	for (int f = 0; f < nframe; ++f) {
+		if (rate > 0.0) {// 按帧率发布
+			int64_t wait = tNext - AShmRing::Now();
+			if (wait > 0) usleep(useconds_t(wait / 1000));
+			tNext += int64_t(1E9 / rate);
+		}
+		t1 = AShmRing::Now();
+		int i = ring.Acquire(-1);
+		tStall += AShmRing::Now() - t1;
+
+		float* data = ring.Data(i);
+		float bias = float(f % 16);
+		for (size_t k = 0; k < pixels; ++k) data[k] = frame[k] + bias;
+		sprintf(fname, "sim%06d", f);
+		sprintf(dateobs, "2021-05-01T12:%02d:%02d.000", (f / 60) % 60, f % 60);
+		ring.Publish(i, side, side, 1.0, dateobs, fname);
+	}
+	// 等待全部帧归还
+	for (int k = 0; k < nslot; ++k) {
+		while (ring.Slot(k)->state.load() != SLOT_FREE) usleep(1000);
+	}
+	double sec = (AShmRing::Now() - t0) * 1E-9;
+	printf("producer   : %d frames in %.2f s, %.1f frames/s, %.1f MB/s, stalled on full ring %.2f s\n",
+			nframe, sec, nframe / sec, nframe * pixels * sizeof(float) / 1048576.0 / sec, tStall * 1E-9);
+	fflush(stdout);
+	ring.Close();
+	if (pid > 0) waitpid(pid, NULL, 0);
+	BenchJson output;
+	if (!output.Open(args.pathOutput)) return -4;
+	output.Begin("shm.producer").Int("width", side).Int("height", side).Int("slots", nslot).Int("frames", nframe)
+		.Num("seconds", sec).Num("frames_per_s", nframe / sec, "%.1f")
+		.Num("mb_per_s", nframe * pixels * sizeof(float) / 1048576.0 / sec, "%.1f").Num("stall_s", tStall * 1E-9).End();
+
+	return 0;
+}
@@ -0,0 +1,151 @@
+/*!
+ Name        : adips-bench-solve. 以仿真视场评估盲定位成功率和耗时
+ Author      : Xiaomeng Lu
+ Version     : 0.1
+ @note
+ 仿真视场由索引中的参考星生成: 随机指向, 随机旋转和镜像, 比例尺随机偏差,
+ 位置噪声, 随机丢失部分星, 加入虚假目标
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include "APlateSolver.h"
+#include "BenchSuite.hpp"
+#include "GLog.h"
+
+using std::vector;
+
+GLog _gLog(stdout);
+
+int main(int argc, char** argv) {
+	BenchArgs args("adips-bench-solve", "<index file>");
+	args.Option('n', "frames",  "number of synthetic fields, default: 100");
+	args.Option('W', "width",   "image width, default: 4096");
+	args.Option('H', "height",  "image height, default: 4096");
+	args.Option('s', "scale",   "pixel scale in arcsec/pixel, default: fit field of index");
+	args.Flag  ('u', "unknown", "solve without scale hint");
+	args.Option('f', "false",   "fraction of false detections, default: 0.1");
+	args.Option('r', "seed",    "random seed, default: 1");
+	int nframe(100), seed(1), optndx;
+	unsigned w(4096), h(4096);
+	double scale(0.0), fracFalse(0.1);
+	bool unknown(false);
+
+	if ((optndx = args.Parse(argc, argv, [&](int ch, const char* arg) {
+		switch(ch) {
+		case 'n': nframe = atoi(arg);    break;
+		case 'W': w = atoi(arg);         break;
+		case 'H': h = atoi(arg);         break;
+		case 's': scale = atof(arg);     break;
+		case 'u': unknown = true;        break;
+		case 'f': fracFalse = atof(arg); break;
+		case 'r': seed = atoi(arg);      break;
+		default: return false;
+		}
+		return true;
+	})) < 0) return -1;
+	argc -= optndx;
+	argv += optndx;
+	if (argc != 1 || nframe <= 0 || !w || !h) {
+		args.Usage();
+		return -2;
+	}
+	BenchJson output;
+	if (!output.Open(args.pathOutput)) return -4;
+
+	ParamAstrometry param;
+	APlateSolver solver(&param);
+	if (!solver.LoadIndex(argv[0])) {
+		_gLog.Write(LOG_FAULT, "failed to load plate index [%s]", argv[0]);
+		return -3;
+	}
+	const APlateIndex& index = solver.Index();
+	const PlateIndexHeader* header = index.Header();
+	if (scale <= 0.0) scale = header->cellDeg * 2.0 * 3600.0 / std::max(w, h);
+	if (!unknown) {
+		param.scaleLow  = scale * 0.9;
+		param.scaleHigh = scale * 1.1;
+	}
+
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<double> uni(0.0, 1.0);
+	std::normal_distribution<double> gauss(0.0, 1.0);
+	vector<uint32_t> stars;
+	vector<double> latency;
+	CeleBodyVec bodies;
+	CelestialBody body;
+	WCSTan truth, wcs;
+	double radius = sqrt(double(w) * w + double(h) * h) * 0.5 * scale / 3600.0 * 1.05;
+	double sumQuad(0.0), sumVerify(0.0);
+	int i, nsolve(0), nquad, nverify;
+
+	for (i = 0; i < nframe; ++i) {
+		// 随机指向, 旋转, 镜像
+		const PlateIndexStar& center = index.Star(uint32_t(uni(rng) * header->nstar) % header->nstar);
+		double theta = uni(rng) * 2.0 * M_PI;
+		double s = scale * (1.0 + (uni(rng) - 0.5) * 0.06) / 3600.0;
+		double flip = uni(rng) < 0.5 ? -1.0 : 1.0;
+		truth.crval[0] = center.ra;
+		truth.crval[1] = center.dec;
+		truth.crpix[0] = w * 0.5;
+		truth.crpix[1] = h * 0.5;
+		truth.cd[0][0] = s * cos(theta) * flip;
+		truth.cd[0][1] = -s * sin(theta);
+		truth.cd[1][0] = s * sin(theta) * flip;
+		truth.cd[1][1] = s * cos(theta);
+
+		// 生成目标
+		bodies.clear();
+		index.ConeSearch(center.ra, center.dec, radius, stars);
+		for (vector<uint32_t>::iterator it = stars.begin(); it != stars.end(); ++it) {
+			const PlateIndexStar& star = index.Star(*it);
+			double x, y;
+			if (!truth.SkyToPixel(star.ra, star.dec, x, y) || x < 0.0 || y < 0.0 || x >= w || y >= h
+					|| uni(rng) < 0.1)
+				continue;
+			body.ptBary.x = x + gauss(rng) * 0.3;
+			body.ptBary.y = y + gauss(rng) * 0.3;
+			body.flux = pow(10.0, -0.4 * (star.mag - 25.0)) * (1.0 + gauss(rng) * 0.05);
+			bodies.push_back(body);
+		}
+		int nfalse = int(bodies.size() * fracFalse);
+		for (int j = 0; j < nfalse; ++j) {
+			body.ptBary.x = uni(rng) * w;
+			body.ptBary.y = uni(rng) * h;
+			body.flux = bodies[size_t(uni(rng) * bodies.size()) % bodies.size()].flux;
+			bodies.push_back(body);
+		}
+		std::shuffle(bodies.begin(), bodies.end(), rng);
+
+		// 盲定位, 中心误差小于5像素视为成功
+		bool rslt = solver.Solve(bodies, w, h, wcs);
+		latency.push_back(solver.LastStat(nquad, nverify));
+		sumQuad   += nquad;
+		sumVerify += nverify;
+		if (rslt) {
+			double ra, dc, x, y;
+			wcs.PixelToSky(w * 0.5, h * 0.5, ra, dc);
+			if (truth.SkyToPixel(ra, dc, x, y) && hypot(x - w * 0.5, y - h * 0.5) < 5.0) ++nsolve;
+		}
+	}
+
+	double mean(0.0);
+	for (i = 0; i < nframe; ++i) mean += latency[i];
+	mean /= nframe;
+	double median = quantile(latency, 0.5), p95 = quantile(latency, 0.95), maxms = quantile(latency, 1.0);
+	printf("index      : %u stars, %u quads, field %.2f deg\n", header->nstar, header->nquad, header->cellDeg * 2.0);
+	printf("image      : %u x %u, %.3f arcsec/pixel%s\n", w, h, scale, unknown ? ", scale unknown" : "");
+	printf("solve rate : %.1f%% (%d / %d)\n", nsolve * 100.0 / nframe, nsolve, nframe);
+	printf("latency(ms): mean %.2f, median %.2f, p95 %.2f, max %.2f\n", mean, median, p95, maxms);
+	printf("per frame  : %.1f quads, %.1f hypotheses\n", sumQuad / nframe, sumVerify / nframe);
+	output.Begin("solve").Int("width", w).Int("height", h).Num("scale", scale).Int("scale_known", !unknown)
+		.Int("frames", nframe).Int("solved", nsolve).Num("mean_ms", mean, "%.2f").Num("median_ms", median, "%.2f")
+		.Num("p95_ms", p95, "%.2f").Num("max_ms", maxms, "%.2f")
+		.Num("quads_per_frame", sumQuad / nframe, "%.1f").Num("hypotheses_per_frame", sumVerify / nframe, "%.1f").End();
+
+	return 0;
+}
@@ -0,0 +1,137 @@
+/*!
+ Name        : adips-bench-streak. 以合成图像评估拖线检测的完整性和耗时
+ Author      : Xiaomeng Lu
+ Version     : 0.1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include "AStreakDetect.h"
+#include "SynthField.hpp"
+#include "BenchSuite.hpp"
+
+using std::vector;
+
+/*!
+ * @brief 合成拖线
+ */
+struct SynStreak {
+	double x1, y1, x2, y2;
+};
+
+int main(int argc, char** argv) {
+	BenchArgs args("adips-bench-streak");
+	args.Option('w', "width",   "image width and height, default: 9216");
+	args.Option('n', "streaks", "number of streaks, default: 4");
+	args.Option('s', "stars",   "number of stars, default: 50000");
+	args.Option('b', "bright",  "peak SNR of streaks per pixel, default: 2.0");
+	args.Option('t', "threads", "number of threads, 0 for all cores, default: 0");
+	args.Option('f', "frames",  "number of repeated detections for timing, default: 3");
+	args.Option('r', "seed",    "random seed, default: 1");
+	int side(9216), nstreak(4), nstar(50000), nthread(0), nframe(3), seed(1);
+	double bright(2.0);
+
+	if (args.Parse(argc, argv, [&](int ch, const char* arg) {
+		switch(ch) {
+		case 'w': side = atoi(arg);    break;
+		case 'n': nstreak = atoi(arg); break;
+		case 's': nstar = atoi(arg);   break;
+		case 'b': bright = atof(arg);  break;
+		case 't': nthread = atoi(arg); break;
+		case 'f': nframe = atoi(arg);  break;
+		case 'r': seed = atoi(arg);    break;
+		default: return false;
+		}
+		return true;
+	}) < 0) return -1;
+	if (side < 256 || nstreak < 0 || nstar < 0 || nthread < 0 || nframe < 1) {
+		args.Usage();
+		return -2;
+	}
+	BenchJson output;
+	if (!output.Open(args.pathOutput)) return -4;
+
+	ParamStreak param;
+	param.enable  = true;
+	param.threads = nthread;
+	AStreakDetect detector(&param);
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<double> uni(0.0, 1.0);
+	const double back(1000.0), sig(10.0), psf(1.2);
+	int i, f;
+
+	// 背景, 恒星和拖线. 拖线长度在[0.1, 0.8]倍图像宽度内均匀分布
+	printf("generating %d x %d image, %d stars, %d streaks\n", side, side, nstar, nstreak);
+	vector<float> image(size_t(side) * side), work;
+	SynthField::FillNoise(image.data(), image.size(), back, sig, rng);
+	for (i = 0; i < nstar; ++i) {
+		double snr = 5.0 * pow(100.0, uni(rng));
+		double x = uni(rng) * side, y = uni(rng) * side;
+		SynthField::AddPSF(image.data(), side, side, x, y, snr * sig, psf);
+	}
+	vector<SynStreak> truth(nstreak);
+	for (i = 0; i < nstreak; ++i) {
+		SynStreak& st = truth[i];
+		double len = side * (0.1 + 0.7 * uni(rng)), pa = uni(rng) * M_PI;
+		double cx = side * (0.2 + 0.6 * uni(rng)), cy = side * (0.2 + 0.6 * uni(rng));
+		st.x1 = std::min(side - 1.0, std::max(0.0, cx - 0.5 * len * cos(pa)));
+		st.y1 = std::min(side - 1.0, std::max(0.0, cy - 0.5 * len * sin(pa)));
+		st.x2 = std::min(side - 1.0, std::max(0.0, cx + 0.5 * len * cos(pa)));
+		st.y2 = std::min(side - 1.0, std::max(0.0, cy + 0.5 * len * sin(pa)));
+		SynthField::AddLine(image.data(), side, side, st.x1, st.y1, st.x2, st.y2, bright * sig, psf);
+	}
+
+	// 重复检测. 检测会修改图像, 每次使用副本
+	StreakVec streaks;
+	vector<double> ms(nframe);
+	int npoint;
+	for (f = 0; f < nframe; ++f) {
+		work = image;
+		detector.Detect(work.data(), side, side, back, sig, streaks);
+		ms[f] = detector.LastStat(npoint);
+	}
+
+	// 评估: 检测端点到真实拖线的距离不超过3像素, 且倾角偏差不超过1度
+	vector<int> found(nstreak, 0);
+	int nfalse(0), nrecall(0);
+	double errTilt(0.0);
+	for (StreakVec::iterator it = streaks.begin(); it != streaks.end(); ++it) {
+		bool hit(false);
+		for (i = 0; i < nstreak && !hit; ++i) {
+			SynStreak& st = truth[i];
+			double dx(st.x2 - st.x1), dy(st.y2 - st.y1), l = sqrt(dx * dx + dy * dy);
+			double d1 = fabs((it->pt1.x - st.x1) * dy - (it->pt1.y - st.y1) * dx) / l;
+			double d2 = fabs((it->pt2.x - st.x1) * dy - (it->pt2.y - st.y1) * dx) / l;
+			double tilt = atan2(dy, dx) * R2D, dt;
+			if (tilt < 0.0) tilt += 180.0;
+			dt = fabs(tilt - it->tilt);
+			if (dt > 90.0) dt = 180.0 - dt;
+			if (d1 <= 3.0 && d2 <= 3.0 && dt <= 1.0) {
+				hit = true;
+				found[i] = 1;
+				errTilt += dt * dt;
+			}
+		}
+		if (!hit) ++nfalse;
+	}
+	for (i = 0; i < nstreak; ++i) nrecall += found[i];
+
+	printf("streaks    : %d detected, %d / %d recovered, %d false\n", int(streaks.size()), nrecall, nstreak, nfalse);
+	if (nrecall) printf("tilt error : %.3f deg rms\n", sqrt(errTilt / nrecall));
+	for (StreakVec::iterator it = streaks.begin(); it != streaks.end(); ++it) {
+		printf("  (%7.1f, %7.1f) - (%7.1f, %7.1f), length = %6.1f, width = %.2f, tilt = %6.2f, SNR = %.1f\n",
+				it->pt1.x, it->pt1.y, it->pt2.x, it->pt2.y, it->length, it->width, it->tilt, it->snr);
+	}
+	printf("votes      : %d binned pixels\n", npoint);
+	printf("latency(ms): median %.1f, max %.1f\n", quantile(ms, 0.5), quantile(ms, 1.0));
+	output.Begin("streak").Int("width", side).Int("height", side).Int("stars", nstar)
+		.Int("streaks", nstreak).Int("detected", int(streaks.size())).Int("recovered", nrecall).Int("false", nfalse)
+		.Num("tilt_rms_deg", nrecall ? sqrt(errTilt / nrecall) : 0.0).Int("votes", npoint)
+		.Num("median_ms", quantile(ms, 0.5), "%.1f").Num("max_ms", quantile(ms, 1.0), "%.1f").End();
+
+	return 0;
+}
@@ -0,0 +1,144 @@
+/*!
+ Name        : adips-bench-synstack. 以合成暗弱运动目标评估合成跟踪的召回率和耗时
+ Author      : Xiaomeng Lu
+ Version     : 0.1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <random>
+#include <vector>
+#include "AShiftStack.h"
+#include "SynthField.hpp"
+#include "BenchSuite.hpp"
+
+using std::vector;
+
+/*!
+ * @brief 合成目标
+ */
+struct SynMover {
+	double x, y;	/// 参考时刻位置, 量纲: 像素
+	double vx, vy;	/// 速度, 量纲: 像素/秒
+};
+
+int main(int argc, char** argv) {
+	BenchArgs args("adips-bench-synstack");
+	args.Option('w', "width",     "image width and height, default: 1024");
+	args.Option('f', "frames",    "number of frames, default: 16");
+	args.Option('c', "cadence",   "cadence in seconds, default: 60");
+	args.Option('m', "shift",     "maximum shift over the window in pixels, default: 12.6");
+	args.Option('a', "asteroids", "number of faint movers, default: 50");
+	args.Option('s', "snr",       "single-frame SNR of the movers, default: 2.0");
+	args.Option('t', "threads",   "number of threads, 0 for all cores, default: 0");
+	args.Flag  ('d', "direct",    "also time direct shift-and-add on a velocity sample");
+	args.Option('r', "seed",      "random seed, default: 1");
+	int side(1024), nframe(16), nast(50), nthread(0), seed(1);
+	double cadence(60.0), shift(12.6), snr1(2.0);
+	bool direct(false);
+
+	if (args.Parse(argc, argv, [&](int ch, const char* arg) {
+		switch(ch) {
+		case 'w': side = atoi(arg);    break;
+		case 'f': nframe = atoi(arg);  break;
+		case 'c': cadence = atof(arg); break;
+		case 'm': shift = atof(arg);   break;
+		case 'a': nast = atoi(arg);    break;
+		case 's': snr1 = atof(arg);    break;
+		case 't': nthread = atoi(arg); break;
+		case 'd': direct = true;       break;
+		case 'r': seed = atoi(arg);    break;
+		default: return false;
+		}
+		return true;
+	}) < 0) return -1;
+	if (side < 64 || nframe < 2 || cadence <= 0.0 || shift <= 0.0 || nast < 0 || nthread < 0) {
+		args.Usage();
+		return -2;
+	}
+	BenchJson output;
+	if (!output.Open(args.pathOutput)) return -4;
+
+	ParamSynTrack param;
+	param.frames  = nframe;
+	param.threads = nthread;
+	AShiftStack stack(&param);
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<double> uni(0.0, 1.0);
+	double span = cadence * (nframe - 1);
+	double vmax = shift / span, vmin = 2.0 / span;
+	const double sig(10.0), psf(1.0);	// 背景噪声; 点扩散函数高斯sigma, 量纲: 像素
+	// 单帧3*3邻域信噪比为snr1时的总流量. 3*3邻域包含高斯PSF约50%的流量
+	double flux = snr1 * 3.0 * sig / 0.5, peak = flux / (2.0 * M_PI * psf * psf);
+	int i, f;
+
+	vector<SynMover> movers(nast);
+	for (i = 0; i < nast; ++i) {
+		double rate = vmin + (vmax * 0.95 - vmin) * uni(rng);
+		double pa   = uni(rng) * 2.0 * M_PI;
+		movers[i].x  = 20.0 + uni(rng) * (side - 40.0);
+		movers[i].y  = 20.0 + uni(rng) * (side - 40.0);
+		movers[i].vx = rate * cos(pa);
+		movers[i].vy = rate * sin(pa);
+	}
+
+	printf("generating %d frames of %d x %d pixels\n", nframe, side, side);
+	for (f = 0; f < nframe; ++f) {
+		double t = f * cadence;
+		AShiftStack::FloatArray data(new float[size_t(side) * side]);
+		float* ptr = data.get();
+		SynthField::FillNoise(ptr, size_t(side) * side, 0.0, sig, rng);
+		for (i = 0; i < nast; ++i) {
+			double cx = movers[i].x + movers[i].vx * t, cy = movers[i].y + movers[i].vy * t;
+			SynthField::AddPSF(ptr, side, side, cx, cy, peak, psf);
+		}
+		stack.AddFrame(t, data, side, side, sig, 0, 0);
+	}
+
+	SynCandVec cands;
+	int nvel = stack.Search(vmin, vmax, cands);
+	double hitRate, ms = stack.LastStat(hitRate);
+
+	// 评估: 参考时刻位置偏差不超过2像素且窗口内位移偏差不超过2+step像素
+	vector<int> found(nast, 0);
+	int nfalse(0), nrecall(0);
+	for (SynCandVec::iterator it = cands.begin(); it != cands.end(); ++it) {
+		bool hit(false);
+		for (i = 0; i < nast; ++i) {
+			double dx(it->x - movers[i].x), dy(it->y - movers[i].y);
+			double dvx((it->vx - movers[i].vx) * span), dvy((it->vy - movers[i].vy) * span);
+			if (dx * dx + dy * dy <= 4.0 && dvx * dvx + dvy * dvy <= pow(2.0 + param.step, 2)) {
+				found[i] = hit = true;
+			}
+		}
+		if (!hit) ++nfalse;
+	}
+	for (i = 0; i < nast; ++i) nrecall += found[i];
+
+	printf("window     : %d frames, %.0f s, %d velocities, max shift %.1f pixels\n", nframe, span, nvel, shift);
+	printf("movers     : %d, single-frame SNR %.1f\n", nast, snr1);
+	printf("recall     : %.1f%% (%d / %d)\n", nast ? nrecall * 100.0 / nast : 0.0, nrecall, nast);
+	printf("candidates : %d, false %d\n", int(cands.size()), nfalse);
+	printf("hierarchy  : %.1f ms, %.2f ms per velocity, cache hit rate %.1f%%\n", ms, ms / nvel, hitRate * 100.0);
+
+	double msd(0.0);
+	if (direct) {// 逐帧平移叠加, 按抽样速度外推总耗时
+		vector<float> buff;
+		int nsample = std::min(nvel, 16);
+		steady_clock::time_point t0 = steady_clock::now();
+		for (i = 0; i < nsample; ++i) {
+			double pa = 2.0 * M_PI * i / nsample;
+			stack.StackDirect(vmax * 0.5 * cos(pa), vmax * 0.5 * sin(pa), buff);
+		}
+		msd = elapsed_ms(t0) / nsample;
+		printf("direct     : %.2f ms per velocity, single thread, %.1f ms extrapolated\n", msd, msd * nvel);
+	}
+	output.Begin("synstack").Int("width", side).Int("height", side).Int("frames", nframe).Int("velocities", nvel)
+		.Int("movers", nast).Num("snr", snr1, "%.1f").Int("recovered", nrecall).Int("candidates", int(cands.size()))
+		.Int("false", nfalse).Num("search_ms", ms, "%.1f").Num("cache_hit_rate", hitRate);
+	if (direct) output.Num("direct_ms_per_velocity", msd);
+	output.End();
+
+	return 0;
+}
@@ -0,0 +1,132 @@
+/*!
+ Name        : adips-bench-wcs. 评估TAN-SIP拟合精度及批量坐标转换耗时
+ Author      : Xiaomeng Lu
+ Version     : 0.1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include "WCSTan.hpp"
+#include "BenchSuite.hpp"
+
+using std::vector;
+
+int main(int argc, char** argv) {
+	BenchArgs args("adips-bench-wcs");
+	args.Option('n', "sources", "number of sources to convert, default: 200000");
+	args.Option('p', "pairs",   "number of matched pairs for fitting, default: 500");
+	args.Option('s', "sip",     "SIP order, default: 3");
+	args.Option('r', "seed",    "random seed, default: 1");
+	int nsrc(200000), npair(500), order(3), seed(1);
+
+	if (args.Parse(argc, argv, [&](int ch, const char* arg) {
+		switch(ch) {
+		case 'n': nsrc = atoi(arg);  break;
+		case 'p': npair = atoi(arg); break;
+		case 's': order = atoi(arg); break;
+		case 'r': seed = atoi(arg);  break;
+		default: return false;
+		}
+		return true;
+	}) < 0) return -1;
+	if (nsrc <= 0 || npair < 10) {
+		args.Usage();
+		return -2;
+	}
+	BenchJson output;
+	if (!output.Open(args.pathOutput)) return -4;
+
+	// 真值: 4k x 4k, 1.5角秒/像素, 三阶桶形畸变
+	const double w(4096.0), h(4096.0);
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<double> uni(0.0, 1.0);
+	std::normal_distribution<double> gauss(0.0, 0.05);
+	WCSTan truth;
+	double rot = uni(rng) * 2.0 * M_PI, scale = 1.5 / 3600.0, k3 = -2E-10;
+	int i;
+
+	truth.valid    = true;
+	truth.crval[0] = uni(rng) * 360.0;
+	truth.crval[1] = asin(uni(rng) * 1.8 - 0.9) * R2D;
+	truth.crpix[0] = w * 0.5;
+	truth.crpix[1] = h * 0.5;
+	truth.cd[0][0] = -scale * cos(rot);
+	truth.cd[0][1] =  scale * sin(rot);
+	truth.cd[1][0] =  scale * sin(rot);
+	truth.cd[1][1] =  scale * cos(rot);
+	truth.sipOrder = 3;
+	truth.a[3][0] = truth.a[1][2] = k3;
+	truth.b[2][1] = truth.b[0][3] = k3;
+	truth.a[2][0] = 3E-8;
+	truth.b[0][2] = -2E-8;
+
+	// 匹配星对. 赤道坐标由真值正向计算
+	vector<double> px(npair), py(npair), pra(npair), pdc(npair);
+	for (i = 0; i < npair; ++i) {
+		double x = uni(rng) * w, y = uni(rng) * h;
+		truth.PixelToSky(x, y, pra[i], pdc[i]);
+		px[i] = x + gauss(rng);
+		py[i] = y + gauss(rng);
+	}
+	WCSTan wcs;
+	double ms = time_ms([&]() {
+		wcs.Fit(npair, px.data(), py.data(), pra.data(), pdc.data(), NULL, w * 0.5, h * 0.5,
+				truth.crval[0] + 0.01, truth.crval[1] - 0.01, order);
+	}, 10);
+	// 拟合精度: 网格点上与真值的偏差
+	double errMax(0.0), ra, dc, x, y;
+	for (y = 0.0; y <= h; y += h / 32) {
+		for (x = 0.0; x <= w; x += w / 32) {
+			truth.PixelToSky(x, y, ra, dc);
+			double dx = (ra - wcs.crval[0]) * cos(dc * D2R), dy = dc - wcs.crval[1];
+			wcs.PixelToSky(x, y, ra, dc);
+			dx -= (ra - wcs.crval[0]) * cos(dc * D2R);
+			dy -= dc - wcs.crval[1];
+			errMax = std::max(errMax, sqrt(dx * dx + dy * dy) * 3600.0);
+		}
+	}
+	printf("fit        : %d pairs, SIP order %d/%d, rms %.3f\", max error %.3f\", %.2f ms\n",
+			wcs.nmatch, wcs.sipOrder, wcs.sipInvOrder, wcs.rms, errMax, ms);
+
+	// 批量转换与逐点转换
+	vector<double> sx(nsrc), sy(nsrc), sra(nsrc), sdc(nsrc), bra(nsrc), bdc(nsrc), bx(nsrc), by(nsrc);
+	for (i = 0; i < nsrc; ++i) {
+		sx[i] = uni(rng) * w;
+		sy[i] = uni(rng) * h;
+	}
+	double msScalarP2S = time_ms([&]() {
+		for (int j = 0; j < nsrc; ++j) wcs.PixelToSky(sx[j], sy[j], sra[j], sdc[j]);
+	}, 5);
+	double msBatchP2S = time_ms([&]() {
+		wcs.PixelToSky(nsrc, sx.data(), sy.data(), bra.data(), bdc.data());
+	}, 5);
+	double msScalarS2P = time_ms([&]() {
+		for (int j = 0; j < nsrc; ++j) wcs.SkyToPixel(sra[j], sdc[j], x, y);
+	}, 5);
+	double msBatchS2P = time_ms([&]() {
+		wcs.SkyToPixel(nsrc, bra.data(), bdc.data(), bx.data(), by.data());
+	}, 5);
+
+	double dSky(0.0), dPix(0.0);
+	for (i = 0; i < nsrc; ++i) {
+		double dra = fabs(bra[i] - sra[i]);
+		if (dra > 180.0) dra = 360.0 - dra;
+		dSky = std::max(dSky, std::max(dra * cos(sdc[i] * D2R), fabs(bdc[i] - sdc[i])) * 3600.0);
+		dPix = std::max(dPix, std::max(fabs(bx[i] - sx[i]), fabs(by[i] - sy[i])));
+	}
+	printf("pixel->sky : %d sources, scalar %.2f ms, batch %.2f ms, max difference %.1e\"\n",
+			nsrc, msScalarP2S, msBatchP2S, dSky);
+	printf("sky->pixel : %d sources, scalar %.2f ms, batch %.2f ms, round trip error %.1e pixel\n",
+			nsrc, msScalarS2P, msBatchS2P, dPix);
+	output.Begin("wcs").Int("pairs", wcs.nmatch).Int("sip_order", wcs.sipOrder).Num("rms_arcsec", wcs.rms)
+		.Num("max_error_arcsec", errMax).Num("fit_ms", ms, "%.2f").Int("sources", nsrc)
+		.Num("pix2sky_scalar_ms", msScalarP2S, "%.2f").Num("pix2sky_batch_ms", msBatchP2S, "%.2f")
+		.Num("sky2pix_scalar_ms", msScalarS2P, "%.2f").Num("sky2pix_batch_ms", msBatchS2P, "%.2f")
+		.Num("batch_sky_diff_arcsec", dSky, "%.1e").Num("round_trip_pixel", dPix, "%.1e").End();
+
+	return 0;
+}
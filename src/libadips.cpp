@@ -0,0 +1,96 @@
+/*!
+ * @file libadips.cpp 天文数字图像处理库接口
+ * @version 0.1
+ * @date 2021-05
+ */
+
+#include <boost/bind/bind.hpp>
+#include "libadips.h"
+#include "ADIWorkFlow.h"
+#include "GLog.h"
+
+using namespace boost::placeholders;
+
+GLog _gLog(stdout);
+
+ADIPipeline::ADIPipeline() {
+	pending_ = 0;
+}
+
+ADIPipeline::~ADIPipeline() {
+	Stop();
+}
+
+void ADIPipeline::RegisterResult(const CBResultSlot& slot) {
+	if (!cbRslt_.empty()) cbRslt_.disconnect_all_slots();
+	cbRslt_.connect(slot);
+}
+
+bool ADIPipeline::Start(const char* filepath) {
+	Parameter param;
+	if (!param.Load(filepath)) {
+		_gLog.Write(LOG_FAULT, "failed to load configuration file [%s]", filepath);
+		return false;
+	}
+	return Start(param);
+}
+
+bool ADIPipeline::Start(const Parameter& param) {
+	if (workflow_) return false;
+
+	param_   = param;
+	pending_ = 0;
+	// 不关联ios: 处理队列清空后继续等待新的帧
+	const ADIWorkFlow::CBFrameSlot& slot = boost::bind(&ADIPipeline::FrameResult, this, _1);
+	workflow_.reset(new ADIWorkFlow);
+	workflow_->RegisterFrame(slot);
+	if (!workflow_->Start(&param_)) {
+		workflow_.reset();
+		return false;
+	}
+	return true;
+}
+
+void ADIPipeline::Stop() {
+	if (workflow_) {
+		workflow_->Stop();
+		workflow_.reset();
+	}
+}
+
+bool ADIPipeline::ProcessImage(float* data, unsigned w, unsigned h, double expdur, const char* dateobs, const char* name) {
+	if (!workflow_ || !data || !w || !h) return false;
+
+	ImgFrmPtr frame(new ImageFrame);
+	frame->filename = name ? name : "";
+	frame->filetit  = frame->filename;
+	frame->dateobs  = dateobs ? dateobs : "";
+	frame->wImg     = w;
+	frame->hImg     = h;
+	frame->expdur   = expdur;
+	frame->dataRaw  = boost::shared_array<float>(data, [](float*) {});	// 存储区由调用者管理
+	{
+		mutex_lock lck(mtx_);
+		++pending_;
+	}
+	if (!workflow_->ProcessImage(frame)) {// 处理流程已中断
+		mutex_lock lck(mtx_);
+		--pending_;
+		return false;
+	}
+	return true;
+}
+
+int ADIPipeline::Pending() {
+	mutex_lock lck(mtx_);
+	return pending_;
+}
+
+void ADIPipeline::FrameResult(ImgFrmPtr frame) {
+	{
+		mutex_lock lck(mtx_);
+		--pending_;
+	}
+	frame->dataRaw.reset();	// 结果回调后调用者可复用存储区
+	cbRslt_(frame);
+}
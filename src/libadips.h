@@ -0,0 +1,100 @@
+/*!
+ * @file libadips.h 天文数字图像处理库接口
+ * @version 0.1
+ * @date 2021-05
+ * @note
+ * 供相机控制等程序嵌入数据处理流程, 直接处理内存中的图像帧, 无需写入并读回FITS文件:
+ * - 内存数据不复制, 作为处理缓存区被就地修改(预处理、坏像素修正、拖线屏蔽).
+ *   在该帧结果回调前, 调用者不得修改或释放数据存储区
+ * - 结果回调每帧执行一次, 包括处理失败的帧. 回调在处理线程中执行, 不应阻塞
+ * - 处理流程中的帧数或内存超出预算(Parameter::budget)时, ProcessImage阻塞. 不得在结果回调中调用
+ * - 结果: ImageFrame::bodies(星表)、ImageFrame::wcs(succAstro为真时有效)等
+ * - 链接: -ladips -lcfitsio 及boost system/thread/date_time/chrono/filesystem库
+ * 示例:
+ * @code
+ * ADIPipeline pipeline;
+ * pipeline.RegisterResult([](ImgFrmPtr frame) { ... });
+ * pipeline.Start("adips.xml");
+ * pipeline.ProcessImage(data, 4096, 4096, 10.0, "2021-05-01T12:00:00.000", "frame0001");
+ * ...
+ * pipeline.Stop();
+ * @endcode
+ */
+
+#ifndef LIBADIPS_H_
+#define LIBADIPS_H_
+
+#include <boost/smart_ptr/shared_ptr.hpp>
+#include <boost/signals2.hpp>
+#include <boost/thread/mutex.hpp>
+#include "ImageFrame.hpp"
+#include "Parameter.hpp"
+
+class ADIWorkFlow;
+
+class ADIPipeline {
+public:
+	ADIPipeline();
+	virtual ~ADIPipeline();
+
+public:
+	typedef boost::signals2::signal<void (ImgFrmPtr)> CBResult;	///< 处理结果回调函数
+	typedef CBResult::slot_type CBResultSlot;	///< 处理结果回调函数插槽
+
+protected:
+	typedef boost::unique_lock<boost::mutex> mutex_lock;
+
+protected:
+	Parameter param_;	/// 配置参数
+	boost::shared_ptr<ADIWorkFlow> workflow_;	/// 数据处理流程
+	CBResult cbRslt_;	/// 回调函数
+	boost::mutex mtx_;	/// 互斥锁: 未完成帧计数
+	int pending_;		/// 未完成帧数
+
+public:
+	/*!
+	 * @brief 注册处理结果回调函数
+	 * @param slot 函数插槽
+	 */
+	void RegisterResult(const CBResultSlot& slot);
+	/*!
+	 * @brief 启动数据处理流程
+	 * @param filepath  配置文件路径
+	 * @return
+	 * 配置文件加载及启动结果
+	 */
+	bool Start(const char* filepath);
+	/*!
+	 * @brief 启动数据处理流程
+	 * @param param  配置参数
+	 */
+	bool Start(const Parameter& param);
+	/*!
+	 * @brief 停止数据处理流程. 未完成的帧被丢弃
+	 */
+	void Stop();
+	/*!
+	 * @brief 处理内存中的单帧图像
+	 * @param data     图像数据, 按行存储. 不复制, 在结果回调前须保持有效
+	 * @param w        图像宽度
+	 * @param h        图像高度
+	 * @param expdur   曝光时间, 量纲: 秒
+	 * @param dateobs  曝光起始时间, 格式: CCYY-MM-DDThh:mm:ss<.sss<sss>>, UTC
+	 * @param name     帧名称, 用于日志和结果标识
+	 * @return
+	 * 数据处理流程未启动、已中断或参数无效时返回false
+	 */
+	bool ProcessImage(float* data, unsigned w, unsigned h, double expdur, const char* dateobs, const char* name);
+	/*!
+	 * @brief 已提交但未完成的帧数
+	 */
+	int Pending();
+
+protected:
+	/*!
+	 * @brief 数据处理流程结果回调函数
+	 */
+	void FrameResult(ImgFrmPtr frame);
+};
+
+#endif /* LIBADIPS_H_ */
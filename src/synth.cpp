@@ -0,0 +1,131 @@
+/*!
+ Name        : adips-synth. 生成合成星场FITS图像序列, 用于性能评估和回归测试
+ Author      : Xiaomeng Lu
+ Version     : 0.1
+ Note        :
+ - 相同参数生成相同图像. 文件名: <prefix>NNNN.fit
+ - 文件头包含DATE-OBS和EXPTIME, 可直接由adips处理
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <longnam.h>
+#include <fitsio.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "SynthField.hpp"
+
+using std::vector;
+
+void Usage() {
+	printf("Usage:\n");
+	printf(" adips-synth [options] <output directory>\n");
+	printf("\nOptions\n");
+	printf(" -h / --help     : print this help message\n");
+	printf(" -w / --width    : image width and height, default: 4096\n");
+	printf(" -n / --frames   : number of frames, default: 10\n");
+	printf(" -p / --prefix   : file name prefix, default: synth\n");
+	printf(" -d / --density  : stars per million pixels, default: 1000\n");
+	printf(" -f / --fwhm     : PSF FWHM in pixels, default: 2.5\n");
+	printf(" -k / --sky      : sky background in ADU, default: 1000\n");
+	printf(" -g / --gradient : background gradient across the frame relative to sky, default: 0.05\n");
+	printf(" -x / --hot      : hot pixels per million pixels, default: 10\n");
+	printf(" -c / --cosmic   : cosmic rays per million pixels per frame, default: 2\n");
+	printf(" -s / --streaks  : satellite streaks per frame, default: 1\n");
+	printf(" -m / --movers   : number of moving objects, default: 20\n");
+	printf(" -v / --rate     : moving object rate in pixels per frame, default: 2.0\n");
+	printf(" -r / --seed     : random seed, default: 1\n");
+}
+
+/*!
+ * @brief 写入FITS文件
+ */
+static int write_fits(const char* filepath, const float* data, unsigned w, unsigned h, const char* dateobs, float expdur) {
+	fitsfile* hFits;
+	long naxes[2] = { long(w), long(h) };
+	int state(0);
+
+	fits_create_file(&hFits, (std::string("!") + filepath).c_str(), &state);
+	if (state) return 1;
+	fits_create_img(hFits, FLOAT_IMG, 2, naxes, &state);
+	fits_write_key(hFits, TSTRING, "DATE-OBS", (void*) dateobs, "exposure start time (UTC)", &state);
+	fits_write_key(hFits, TFLOAT,  "EXPTIME",  &expdur, "exposure time (s)", &state);
+	fits_write_key(hFits, TSTRING, "INSTRUME", (void*) "adips-synth", "synthetic image", &state);
+	fits_write_img(hFits, TFLOAT, 1, size_t(w) * h, (void*) data, &state);
+	int closeState(0);
+	fits_close_file(hFits, &closeState);
+	return state || closeState ? 2 : 0;
+}
+
+int main(int argc, char** argv) {
+	struct option longopts[] = {
+		{ "help",     no_argument,       NULL, 'h' },
+		{ "width",    required_argument, NULL, 'w' },
+		{ "frames",   required_argument, NULL, 'n' },
+		{ "prefix",   required_argument, NULL, 'p' },
+		{ "density",  required_argument, NULL, 'd' },
+		{ "fwhm",     required_argument, NULL, 'f' },
+		{ "sky",      required_argument, NULL, 'k' },
+		{ "gradient", required_argument, NULL, 'g' },
+		{ "hot",      required_argument, NULL, 'x' },
+		{ "cosmic",   required_argument, NULL, 'c' },
+		{ "streaks",  required_argument, NULL, 's' },
+		{ "movers",   required_argument, NULL, 'm' },
+		{ "rate",     required_argument, NULL, 'v' },
+		{ "seed",     required_argument, NULL, 'r' },
+		{ NULL,       0,                 NULL,  0  }
+	};
+	char optstr[] = "hw:n:p:d:f:k:g:x:c:s:m:v:r:";
+	int ch, optndx, nframe(10), side(4096);
+	std::string prefix("synth");
+	SynthParam param;
+
+	while ((ch = getopt_long(argc, argv, optstr, longopts, &optndx)) != -1) {
+		switch(ch) {
+		case 'w': side = atoi(optarg);              break;
+		case 'n': nframe = atoi(optarg);            break;
+		case 'p': prefix = optarg;                  break;
+		case 'd': param.density = atof(optarg);     break;
+		case 'f': param.fwhm = atof(optarg);        break;
+		case 'k': param.sky = atof(optarg);         break;
+		case 'g': param.gradX = atof(optarg);       break;
+		case 'x': param.hot = atoi(optarg);         break;
+		case 'c': param.cosmic = atoi(optarg);      break;
+		case 's': param.streaks = atoi(optarg);     break;
+		case 'm': param.movers = atoi(optarg);      break;
+		case 'v': param.moverRate = atof(optarg);   break;
+		case 'r': param.seed = uint32_t(atoi(optarg)); break;
+		default:
+			Usage();
+			return -1;
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 1 || side < 64 || nframe < 1 || param.density < 0.0 || param.fwhm <= 0.0 || param.sky <= 0.0) {
+		Usage();
+		return -2;
+	}
+	param.width = param.height = unsigned(side);
+
+	SynthField field;
+	vector<float> data(size_t(side) * side);
+	char filepath[300], dateobs[40];
+	field.Reset(param);
+	for (int i = 0; i < nframe; ++i) {
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		field.Generate(unsigned(i), data.data());
+		SynthField::DateObs(unsigned(i), dateobs);
+		snprintf(filepath, sizeof(filepath), "%s/%s%04d.fit", argv[0], prefix.c_str(), i + 1);
+		if (write_fits(filepath, data.data(), side, side, dateobs, 10.0f)) {
+			printf("failed to write [%s]\n", filepath);
+			return -3;
+		}
+		printf("%s  %s  %.1f ms\n", filepath, dateobs,
+				std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+	}
+
+	return 0;
+}